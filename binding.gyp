@@ -1,22 +1,48 @@
 {
-  "targets": [{
-    "target_name" : "nlav",
+  "variables": {
+    # Build the nlav_bench target as well (node-gyp rebuild --nlav_bench=1), see src/bench.ts
+    "nlav_bench%": 0
+  },
+  "target_defaults": {
     'sources' : [ 
+      "native/avcodec/codec-context-template.cpp",
       "native/avcodec/codec-context.cpp",
       "native/avcodec/codec.cpp",
+      "native/avcodec/frame-buffer-pool.cpp",
       "native/avcodec/index.cpp",
+      "native/avcodec/packet-arena.cpp",
       "native/avcodec/packet.cpp",
       "native/avcodec/profile.cpp",
 
+      "native/avfilter/filter-graph.cpp",
+      "native/avfilter/index.cpp",
+
+      "native/avformat/format-context.cpp",
+      "native/avformat/index.cpp",
+      "native/avformat/io-context.cpp",
+      "native/avformat/stream.cpp",
+
       "native/avutil/avutil.cpp",
       "native/avutil/buffer.cpp",
       "native/avutil/channel-layout.cpp",
       "native/avutil/class.cpp",
       "native/avutil/dict.cpp",
       "native/avutil/frame.cpp",
+      "native/avutil/frame-ops.cpp",
+      "native/avutil/frame-stats.cpp",
+      "native/avutil/hwcontext.cpp",
       "native/avutil/index.cpp",
+      "native/avutil/kernels.cpp",
+      "native/avutil/shared-memory.cpp",
       "native/libavaddon.cpp",
-      "native/resource.cpp"
+      "native/resource.cpp",
+      "native/scheduler.cpp",
+
+      "native/swresample/index.cpp",
+      "native/swresample/resampler.cpp",
+
+      "native/swscale/index.cpp",
+      "native/swscale/scaler.cpp"
     ],
     'cflags!': [ '-fno-exceptions' ],
     'cflags_cc!': [ '-fno-exceptions' ],
@@ -93,7 +119,14 @@
             "-l../dist/ffmpeg/lib/avfilter",
             "-l../dist/ffmpeg/lib/swresample",
             "-l../dist/ffmpeg/lib/swscale"
-        ],
+        ]
+      }]
+    ]
+  },
+  "targets": [{
+    "target_name" : "nlav",
+    "conditions": [
+      ['OS=="win"', {
         "copies": [
             {
               "destination": "build/Release/",
@@ -122,5 +155,19 @@
           ]
       }]
     ]
-  }]
+  }],
+  "conditions": [
+    ['nlav_bench==1', {
+      "targets": [{
+        # The addon with native micro-benchmarks added to its exports (see native/bench)
+        "target_name": "nlav_bench",
+        "sources": [
+          "native/bench/index.cpp"
+        ],
+        "defines": [
+          "NLAV_BENCH"
+        ]
+      }]
+    }]
+  ]
 }
@@ -0,0 +1,182 @@
+#include "codec-context-template.h"
+#include "codec-context.h"
+#include "codec.h"
+#include "../avutil/dict.h"
+
+extern "C" {
+    #include <libavutil/opt.h>
+}
+
+struct NAVCodecContextTemplateSetters {
+    std::vector<NAVCodecContext::SetterCallback> callbacks;
+};
+
+NAVCodecContextTemplate::NAVCodecContextTemplate(const Napi::CallbackInfo& info):
+    NAVResource(info),
+    setters(std::make_shared<NAVCodecContextTemplateSetters>())
+{
+    auto env = info.Env();
+    auto codecClass = LibAvAddon::Self(env)->GetConstructor(NAVCodec::ExportName())->Value();
+
+    if (info.Length() < 1 || !info[0].IsObject() || !info[0].As<Napi::Object>().InstanceOf(codecClass)) {
+        Napi::TypeError::New(env, "Expected an AVCodec").ThrowAsJavaScriptException();
+        return;
+    }
+
+    state.codec = NAVCodec::Unwrap(info[0].As<Napi::Object>())->GetHandle();
+    codecReference = Napi::Persistent(info[0].As<Napi::Object>());
+    SetHandle(&state);
+
+    if (info.Length() > 1 && !info[1].IsUndefined() && !info[1].IsNull() && !SetProperties(env, info[1]))
+        return;
+    
+    if (info.Length() > 2 && !info[2].IsUndefined() && !info[2].IsNull())
+        SetOptions(env, info[2]);
+}
+
+void NAVCodecContextTemplate::Free() {
+    av_dict_free(&state.options);
+    codecReference.Reset();
+    properties.Reset();
+    SetHandle(nullptr);
+}
+
+/**
+ * Keep a frozen copy of the given AVCodecContext properties, after looking up their setters. Throws 
+ * (returning false) if one is unknown or read-only.
+ */
+bool NAVCodecContextTemplate::SetProperties(const Napi::Env &env, const Napi::Value &value) {
+    if (!value.IsObject()) {
+        Napi::TypeError::New(env, "Expected an object of AVCodecContext properties").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    auto object = value.As<Napi::Object>();
+    auto names = object.GetPropertyNames();
+    auto copy = Napi::Object::New(env);
+
+    propertyNames.clear();
+    for (uint32_t i = 0, max = names.Length(); i < max; ++i) {
+        std::string name = names.Get(i).ToString().Utf8Value();
+        propertyNames.push_back(name);
+        copy.Set(name, object.Get(name));
+    }
+
+    if (!NAVCodecContext::FindSetters(env, propertyNames, setters->callbacks))
+        return false;
+    
+    copy.Freeze();
+    properties = Napi::Persistent(copy);
+    return true;
+}
+
+/**
+ * Keep the given open() options (an AVDictionary, or an object of strings/numbers), after setting them on
+ * a context of our own: values libavcodec cannot parse and options neither AVCodecContext nor the codec 
+ * has throw (returning false) here, rather than for each context.
+ */
+bool NAVCodecContextTemplate::SetOptions(const Napi::Env &env, const Napi::Value &value) {
+    auto dictionaryClass = LibAvAddon::Self(env)->GetConstructor(NAVDictionary::ExportName())->Value();
+    AVDictionary *options = nullptr;
+
+    if (!value.IsObject()) {
+        Napi::TypeError::New(env, "Expected an AVDictionary or an object of options").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    auto object = value.As<Napi::Object>();
+
+    if (object.InstanceOf(dictionaryClass)) {
+        av_dict_copy(&options, NAVDictionary::Unwrap(object)->GetHandle(), 0);
+    } else {
+        auto names = object.GetPropertyNames();
+        for (uint32_t i = 0, max = names.Length(); i < max; ++i) {
+            std::string name = names.Get(i).ToString().Utf8Value();
+            av_dict_set(&options, name.c_str(), object.Get(name).ToString().Utf8Value().c_str(), 0);
+        }
+    }
+
+    AVCodecContext *context = avcodec_alloc_context3(state.codec);
+    AVDictionary *unknown = nullptr;
+    int result = context ? 0 : AVERROR(ENOMEM);
+
+    av_dict_copy(&unknown, options, 0);
+    if (context)
+        result = av_opt_set_dict2(context, &unknown, AV_OPT_SEARCH_CHILDREN);
+    avcodec_free_context(&context);
+
+    if (result >= 0 && av_dict_count(unknown) > 0) {
+        std::string name = av_dict_get(unknown, "", nullptr, AV_DICT_IGNORE_SUFFIX)->key;
+        av_dict_free(&unknown);
+        av_dict_free(&options);
+
+        Napi::TypeError::New(env, "Unknown option '" + name + "' of codec " + state.codec->name).ThrowAsJavaScriptException();
+        return false;
+    }
+
+    av_dict_free(&unknown);
+
+    if (result < 0) {
+        av_dict_free(&options);
+        nlav_throw(env, result, "av_opt_set_dict2");
+        return false;
+    }
+
+    state.options = options;
+    return true;
+}
+
+/**
+ * Create a context for the codec, with the properties and then the options of the template applied. The 
+ * options are set on the context directly, the way avcodec_open2() would set them, so open() needs none.
+ */
+Napi::Value NAVCodecContextTemplate::NewContext(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto object = LibAvAddon::ConstructWrapped(env, NAVCodecContext::ExportName(), { codecReference.Value() });
+    auto context = NAVCodecContext::Unwrap(object);
+
+    if (!properties.IsEmpty()) {
+        context->ApplySetters(info, properties.Value(), propertyNames, setters->callbacks);
+
+        if (env.IsExceptionPending()) {
+            context->Dispose(env);
+            return env.Undefined();
+        }
+    }
+
+    if (state.options) {
+        AVDictionary *options = nullptr;
+        av_dict_copy(&options, state.options, 0);
+
+        int result = av_opt_set_dict2(context->GetHandle(), &options, AV_OPT_SEARCH_CHILDREN);
+        av_dict_free(&options);
+
+        if (result < 0) {
+            context->Dispose(env);
+            return nlav_throw(env, result, "av_opt_set_dict2");
+        }
+    }
+
+    return object;
+}
+
+Napi::Value NAVCodecContextTemplate::GetCodec(const Napi::CallbackInfo& info) {
+    return codecReference.Value();
+}
+
+Napi::Value NAVCodecContextTemplate::GetProperties(const Napi::CallbackInfo& info) {
+    if (properties.IsEmpty())
+        return info.Env().Null();
+    
+    return properties.Value();
+}
+
+Napi::Value NAVCodecContextTemplate::GetOptions(const Napi::CallbackInfo& info) {
+    auto object = Napi::Object::New(info.Env());
+    AVDictionaryEntry *entry = nullptr;
+
+    while ((entry = av_dict_get(state.options, "", entry, AV_DICT_IGNORE_SUFFIX)))
+        object.Set(entry->key, entry->value);
+    
+    return object;
+}
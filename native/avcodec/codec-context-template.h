@@ -0,0 +1,69 @@
+#include "../common.h"
+
+#include <napi.h>
+#include "../resource.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libavutil/dict.h>
+}
+
+struct NAVCodecContextTemplateSetters;
+
+/**
+ * The codec and the checked open() options of a template.
+ */
+struct NAVCodecContextTemplateState {
+    ~NAVCodecContextTemplateState() {
+        av_dict_free(&options);
+    }
+
+    const AVCodec *codec = nullptr;
+    AVDictionary *options = nullptr;
+};
+
+/**
+ * Properties and options for creating many codec contexts the same way. Property names are looked up and
+ * options are checked (on a context of our own) once, when the template is created. newContext() then
+ * creates a context and applies both in a single call, rather than assigning each property and building 
+ * an AVDictionary of options for open() every time.
+ */
+class NAVCodecContextTemplate : public NAVResource<NAVCodecContextTemplate, NAVCodecContextTemplateState> {
+    public:
+        NAVCodecContextTemplate(const Napi::CallbackInfo& info);
+
+        inline static std::string ExportName() { return "AVCodecContextTemplate"; }
+        inline static Napi::Function ClassDefinition(const Napi::Env &env) {
+            return DefineClass(env, "AVCodecContextTemplate", {
+                R_METHOD("newContext", &NAVCodecContextTemplate::NewContext),
+
+                R_GETTER("codec", &NAVCodecContextTemplate::GetCodec),
+                R_GETTER("properties", &NAVCodecContextTemplate::GetProperties),
+                R_GETTER("options", &NAVCodecContextTemplate::GetOptions)
+            });
+        }
+
+        virtual void Free();
+        virtual bool IsResourceMappingEnabled() { return false; }
+
+    private:
+        bool SetProperties(const Napi::Env &env, const Napi::Value &value);
+        bool SetOptions(const Napi::Env &env, const Napi::Value &value);
+
+        NAVCodecContextTemplateState state;
+        Napi::ObjectReference codecReference;
+
+        // A frozen copy of the properties, and their setters in the same order
+        Napi::ObjectReference properties;
+        std::vector<std::string> propertyNames;
+        std::shared_ptr<NAVCodecContextTemplateSetters> setters;
+
+        Napi::Value NewContext(const Napi::CallbackInfo& info);
+
+        Napi::Value GetCodec(const Napi::CallbackInfo& info);
+        Napi::Value GetProperties(const Napi::CallbackInfo& info);
+        Napi::Value GetOptions(const Napi::CallbackInfo& info);
+};
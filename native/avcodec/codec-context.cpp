@@ -5,11 +5,43 @@
 #include "../avutil/dict.h"
 #include "../avcodec/packet.h"
 #include "../avutil/frame.h"
+#include "../avutil/frame-stats.h"
+#include "../avformat/format-context.h"
+#include "../avutil/hwcontext.h"
+#include "../avutil/shared-memory.h"
+#include "../swresample/resampler.h"
 
-#include <iostream>
+#include <algorithm>
+
+/**
+ * Number of open contexts with fairThreadCount which share the cores.
+ */
+static std::atomic<int> nlavc_fair_contexts(0);
+
+/**
+ * Number of contexts with fairThreadCount expected to share the cores (see configureFairThreads()), 0 
+ * to only count the open ones.
+ */
+static std::atomic<int> nlavc_fair_expected(0);
 
 NAVCodecContext::NAVCodecContext(const Napi::CallbackInfo& info):
-    NAVResource(info)
+    NAVResource(info),
+    scheduler(nullptr),
+    threadWaiting(false),
+    wakePending(false),
+    inQueue(NLAV_DEFAULT_QUEUE_CAPACITY),
+    running(true),
+    producerAttached(false),
+    stopping(false),
+    routedItems(0),
+    alive(std::make_shared<bool>(true)),
+    framePool(std::make_shared<NAVFramePool>()),
+    packetPool(std::make_shared<NAVPacketPool>()),
+    stats(std::make_shared<NAVCodecContextStats>()),
+    effectiveLowWaterMark(NLAV_DEFAULT_QUEUE_CAPACITY / 2),
+    drainRequested(false),
+    batchSize(1),
+    maxBatchLatencyUs(0)
 {
     if (ConstructFromHandle(info))
         return;
@@ -19,316 +51,1965 @@ NAVCodecContext::NAVCodecContext(const Napi::CallbackInfo& info):
     SetHandle(handle);
 }
 
-void NAVCodecContext::ThreadMain() {
-    std::unique_lock<std::mutex> lock(mutex);
-    AVCodecContext *context = GetHandle();
-    bool isEncoder = av_codec_is_encoder(context->codec);
-    bool isDecoder = av_codec_is_decoder(context->codec);
-    lock.unlock();
-    
-    while (running) {
-        bool fed = FeedToCodec();
+void NAVCodecContext::ThreadMain() {
+    while (running) {
+        if (!Step())
+            WaitForWork();
+    }
+}
+
+/**
+ * Pool worker only (see useThreadPool). Work for a few rounds, then let the worker move on to the next 
+ * context. We are never run by two workers at once, so the codec still sees our items in order.
+ */
+bool NAVCodecContext::RunScheduled() {
+    for (int i = 0; i < NLAV_SCHEDULED_STEPS && running; ++i) {
+        if (!Step()) {
+            // A partial batch must still go out once it is maxBatchLatencyUs old
+            if (running && HasDeliverableBatch())
+                scheduler.load()->ScheduleAt(this, BatchDeadline());
+            
+            return false;
+        }
+    }
+
+    return running;
+}
+
+/**
+ * Codec thread only. Feed queued items to the codec and pull what it has produced. Returns false if 
+ * there was nothing to do.
+ */
+bool NAVCodecContext::Step() {
+    bool fed = FeedToCodec();
+    bool pulled = false;
+
+    if (isEncoder)
+        pulled = PullFromEncoder(GetHandle());
+    else if (isDecoder)
+        pulled = PullFromDecoder(GetHandle());
+
+    return fed || pulled;
+}
+
+/**
+ * Park the codec thread until there is something for it to do. If the codec refused the item at the 
+ * front of the queue (EAGAIN), more queued items will not help, so we wait for an explicit Wake() 
+ * instead (a new callback, a new item or shutdown).
+ */
+void NAVCodecContext::WaitForWork() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    threadWaiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    auto ready = [this]() {
+        return !running || wakePending.load(std::memory_order_relaxed) || (!codecStalled && !inQueue.Empty());
+    };
+
+    // A partial batch must still go out once it is maxBatchLatencyUs old
+    if (HasDeliverableBatch())
+        threadWake.wait_until(lock, BatchDeadline(), ready);
+    else
+        threadWake.wait(lock, ready);
+
+    threadWaiting.store(false, std::memory_order_relaxed);
+    wakePending.store(false, std::memory_order_relaxed);
+}
+
+/**
+ * Wake the codec thread if it is parked in WaitForWork(). The mutex is only taken when the thread 
+ * is actually waiting, so the common case (the thread is busy encoding/decoding) is lock-free.
+ * On the thread pool, we are scheduled to run instead (or to run again if we are running).
+ */
+void NAVCodecContext::Wake() {
+    auto pool = scheduler.load();
+    if (pool) {
+        pool->Schedule(this);
+        return;
+    }
+
+    wakePending.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (!threadWaiting.load(std::memory_order_relaxed))
+        return;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    threadWake.notify_one();
+}
+
+bool NAVCodecContext::AttachProducer(NAVCodecContext *producerContext) {
+    if (producerAttached)
+        return false;
+    
+    std::unique_lock<std::mutex> lock(producerMutex);
+    this->producerContext = producerContext;
+    producerAttached = true;
+    return true;
+}
+
+void NAVCodecContext::DetachProducer() {
+    std::unique_lock<std::mutex> lock(producerMutex);
+    producerContext = nullptr;
+    producerAttached = false;
+}
+
+bool NAVCodecContext::PushFromProducer(AVPacket *packet, const std::atomic<bool> &cancelled) {
+    WorkItem item;
+    item.packet = packet;
+    item.owned = true;
+
+    return PushItemFromProducer(item, cancelled);
+}
+
+bool NAVCodecContext::TryPushFromProducer(AVFrame *frame) {
+    WorkItem item;
+    item.frame = frame;
+    item.owned = true;
+    item.endOfStream = !frame;
+    item.queued = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(producerMutex);
+
+    if (!running || inQueue.Size() >= maxQueuedItems)
+        return false;
+
+    AVRational to = GetHandle()->time_base;
+    if (frame && frame->time_base.num && to.num && av_cmp_q(frame->time_base, to) != 0) {
+        if (frame->pts != AV_NOPTS_VALUE)
+            frame->pts = av_rescale_q(frame->pts, frame->time_base, to);
+        if (frame->pkt_duration > 0)
+            frame->pkt_duration = av_rescale_q(frame->pkt_duration, frame->time_base, to);
+        frame->time_base = to;
+    }
+
+    if (!inQueue.Push(item))
+        return false;
+    
+    lock.unlock();
+    Wake();
+    return true;
+}
+
+bool NAVCodecContext::PushEndOfStreamFromProducer(const std::atomic<bool> &cancelled) {
+    WorkItem item;
+    item.endOfStream = true;
+
+    return PushItemFromProducer(item, cancelled);
+}
+
+bool NAVCodecContext::PushItemFromProducer(WorkItem item, const std::atomic<bool> &cancelled) {
+    std::unique_lock<std::mutex> lock(producerMutex);
+
+    while (running && !cancelled) {
+        item.queued = std::chrono::steady_clock::now();
+        if (inQueue.Size() < maxQueuedItems && inQueue.Push(item)) {
+            lock.unlock();
+            Wake();
+            return true;
+        }
+
+        producerWake.wait(lock);
+    }
+
+    return false;
+}
+
+void NAVCodecContext::WakeProducer() {
+    std::unique_lock<std::mutex> lock(producerMutex);
+    producerWake.notify_all();
+
+    // Held under producerMutex, so that the producer cannot be detached (and freed) meanwhile
+    if (producerContext)
+        producerContext->Wake();
+}
+
+/**
+ * Throw if a native producer is attached, in which case Javascript must not queue items itself.
+ */
+bool NAVCodecContext::CheckNoProducer(const Napi::Env &env) {
+    if (!producerAttached)
+        return true;
+    
+    Napi::Error::New(env, "Items for this codec context are sent natively (see AVFormatContext#routeStream() and AVCodecContext#routeFrames())").ThrowAsJavaScriptException();
+    return false;
+}
+
+/**
+ * Queue an item for the codec thread. JS thread only (the queue has a single producer).
+ */
+bool NAVCodecContext::EnqueueWork(WorkItem item) {
+    // Items waiting in pendingSends go first, otherwise the codec would see them out of order
+    if (!pendingSends.empty() || inQueue.Size() >= maxQueuedItems)
+        return false;
+
+    item.queued = std::chrono::steady_clock::now();
+    if (!inQueue.Push(item))
+        return false;
+
+    Wake();
+    return true;
+}
+
+/**
+ * Queue an item for the codec thread, or park it in pendingSends until the codec thread has made 
+ * room for it. The returned promise resolves once the item has been queued. JS thread only.
+ */
+Napi::Value NAVCodecContext::EnqueueWorkAsync(const Napi::Env &env, WorkItem item) {
+    auto deferred = Napi::Promise::Deferred::New(env);
+
+    if (EnqueueWork(item)) {
+        deferred.Resolve(env.Undefined());
+    } else {
+        pendingSends.push_back(PendingSend { item, deferred });
+        RequestDrain(env);
+    }
+
+    return deferred.Promise();
+}
+
+/**
+ * Codec thread only. Remove the front item of the queue, and let the JS thread know if the queue 
+ * has dropped to the low water mark while it is waiting for room.
+ */
+void NAVCodecContext::PopWorkItem() {
+    auto item = inQueue.Peek();
+    if (item)
+        FreeWorkItem(*item);
+    
+    inQueue.Pop();
+
+    if (producerAttached.load(std::memory_order_relaxed))
+        WakeProducer();
+
+    if (drainRequested.load(std::memory_order_relaxed) 
+        && inQueue.Size() <= effectiveLowWaterMark.load(std::memory_order_relaxed)
+        && drainRequested.exchange(false)
+    ) {
+        onDrainTSFN.NonBlockingCall([this](Napi::Env env, Napi::Function) {
+            OnQueueDrained(env);
+        });
+    }
+}
+
+/**
+ * Ask the codec thread to call OnQueueDrained() once the queue has dropped to the low water mark.
+ * While a request is outstanding we hold a reference to ourselves, so that the context cannot be 
+ * collected (and its thread stopped) with sends still pending. JS thread only.
+ */
+void NAVCodecContext::RequestDrain(const Napi::Env &env) {
+    if (drainArmed)
+        return;
+    
+    if (!onDrainTSFN) {
+        auto noop = Napi::Function::New(env, [](const Napi::CallbackInfo&) { });
+        onDrainTSFN = Napi::ThreadSafeFunction::New(env, noop, "AVContext#onDrain", 0, 1);
+    }
+
+    drainArmed = true;
+    Ref();
+    onDrainTSFN.Ref(env);
+
+    drainRequested.store(true);
+
+    // The codec thread may have emptied the queue before it could see the request
+    if (inQueue.Size() <= effectiveLowWaterMark.load(std::memory_order_relaxed) && drainRequested.exchange(false)) {
+        onDrainTSFN.NonBlockingCall([this](Napi::Env env, Napi::Function) {
+            OnQueueDrained(env);
+        });
+    }
+}
+
+void NAVCodecContext::OnQueueDrained(Napi::Env env) {
+    drainArmed = false;
+
+    // Disposed while the drain was in flight
+    if (!GetHandle()) {
+        Unref();
+        return;
+    }
+
+    onDrainTSFN.Unref(env);
+
+    while (!pendingSends.empty() && inQueue.Size() < maxQueuedItems) {
+        auto &pending = pendingSends.front();
+        pending.item.queued = std::chrono::steady_clock::now();
+        if (!inQueue.Push(pending.item))
+            break;
+        
+        // A flush() resolves once the codec is drained instead (see OnEnded())
+        if (!pending.item.resolvesFlush)
+            pending.deferred.Resolve(env.Undefined());
+        pendingSends.pop_front();
+    }
+
+    Wake();
+
+    if (!pendingSends.empty()) {
+        RequestDrain(env);
+    } else if (drainNotify) {
+        drainNotify = false;
+        if (onDrainValid)
+            onDrain.Call({});
+    }
+
+    Unref();
+}
+
+size_t NAVCodecContext::GetEffectiveLowWaterMark() {
+    if (queueLowWaterMark >= 0)
+        return std::min((size_t)queueLowWaterMark, maxQueuedItems - 1);
+    
+    return maxQueuedItems / 2;
+}
+
+AVFrame *NAVCodecContext::GetPoolFrame() {
+    return framePool->Acquire();
+}
+
+void NAVCodecContext::FreePoolFrame(AVFrame *frame) {
+    framePool->Release(frame);
+}
+
+AVPacket *NAVCodecContext::GetPoolPacket() {
+    return packetPool->Acquire();
+}
+
+void NAVCodecContext::FreePoolPacket(AVPacket *packet) {
+    packetPool->Release(packet);
+}
+
+/**
+ * Wrap a frame received from the codec. The frame returns to our pool (rather than being freed) 
+ * once JS is done with it. JS thread only.
+ */
+Napi::Value NAVCodecContext::WrapPoolFrame(const Napi::Env &env, std::shared_ptr<NAVFramePool> pool, AVFrame *frame) {
+    LibAvAddon::Self(env)->FlushDeferredReleases();
+
+    auto instance = NAVFrame::FromHandle(env, frame, true);
+    instance->SetPool(pool);
+    return instance->Value();
+}
+
+/**
+ * Wrap a packet received from the codec. The packet returns to our pool (rather than being freed) 
+ * once JS is done with it. JS thread only.
+ */
+Napi::Value NAVCodecContext::WrapPoolPacket(const Napi::Env &env, std::shared_ptr<NAVPacketPool> pool, AVPacket *packet) {
+    LibAvAddon::Self(env)->FlushDeferredReleases();
+
+    auto instance = NAVPacket::FromHandle(env, packet, true);
+    instance->SetPool(pool);
+    return instance->Value();
+}
+
+/**
+ * Report an error to onError. Without onError, the error only shows in getStats(). Codec thread only.
+ */
+void NAVCodecContext::SendError(std::string code, std::string message) {
+    stats->errors.fetch_add(1, std::memory_order_relaxed);
+
+    if (!this->onErrorValid)
+        return;
+
+    onErrorTSFN.BlockingCall([=](Napi::Env env, Napi::Function jsCallback) {
+        Napi::Object error = Napi::Object::New(env);
+        error.Set("code", code);
+        error.Set("message", message);
+        jsCallback.Call({ error });
+    });
+}
+
+bool NAVCodecContext::FeedToCodec() {
+    auto handle = GetHandle();
+    bool fed = false;
+    WorkItem *workItem;
+
+    // Nothing goes in until the codec has given back everything it had (see OnCodecDrained())
+    codecStalled = endOfStream;
+
+    while (running && !endOfStream && (workItem = inQueue.Peek())) {
+        int result = 0;
+
+        if (workItem->endOfStream) {
+            result = isEncoder ? avcodec_send_frame(handle, nullptr) : avcodec_send_packet(handle, nullptr);
+
+            endOfStream = true;
+            endResolvesFlush = workItem->resolvesFlush;
+            PopWorkItem();
+
+            // With AVERROR_EOF the codec is draining already, and we see its end when pulling. Otherwise
+            // its end would never come, which must not hold up ours.
+            if (result < 0 && result != AVERROR_EOF) {
+                SendError("averror:" + std::to_string(result), "An error occurred while draining the codec");
+                OnCodecDrained();
+            }
+
+            return true;
+        }
+
+        auto started = std::chrono::steady_clock::now();
+
+        if (workItem->frame) {
+            result = avcodec_send_frame(handle, workItem->frame);
+        } else if (workItem->packet) {
+            result = avcodec_send_packet(handle, workItem->packet);
+        }
+
+        // Leave the item at the front of the queue, we'll retry once the codec has 
+        // produced some output.
+        if (result == AVERROR(EAGAIN)) {
+            stats->sendEagain.fetch_add(1, std::memory_order_relaxed);
+            codecStalled = true;
+            break;
+        }
+
+        if (result >= 0) {
+            stats->send.RecordSince(started);
+            stats->queueWait.RecordSince(workItem->queued);
+        }
+
+        if (result < 0) {
+            SendError("averror:" + std::to_string(result), "An error occurred during avcodec_send. Discarding queued item.");
+            PopWorkItem();
+            break;
+        }
+
+        fed = true;
+        PopWorkItem();
+    }
+
+    return fed;
+}
+
+bool NAVCodecContext::PullFromDecoder(AVCodecContext *context) {
+    bool pulled = false;
+
+    while (running) {
+        // While draining, output nobody takes is still pulled so that we get to the end
+        if (!onFrameValid && frameRoutes.empty() && !endOfStream)
+            break;
+        
+        // An encoder we route to is full. It wakes us once it has room again.
+        if (!FlushRouteBacklog())
+            break;
+        
+        auto frame = GetPoolFrame();
+        auto started = std::chrono::steady_clock::now();
+        int result = avcodec_receive_frame(context, frame);
+
+        if (AVERROR(result) == EAGAIN) {
+            stats->receiveEagain.fetch_add(1, std::memory_order_relaxed);
+            FreePoolFrame(frame);
+            FlushBatches(false);
+            break;
+        }
+
+        if (result == AVERROR_EOF) {
+            FreePoolFrame(frame);
+            FlushBatches(true);
+
+            // A codec which cannot be flushed stays at its end (see OnCodecDrained())
+            if (endOfStream) {
+                OnCodecDrained();
+                pulled = true;
+            }
+            break;
+        }
+
+        if (result < 0) {
+            FreePoolFrame(frame);
+            FlushBatches(true);
+            SendError("averror:" + result, "An error occurred during avcodec_receive_frame");
+            break;
+        }
+
+        stats->receive.RecordSince(started);
+
+        // Nothing comes out of the resampler for this frame yet
+        if (resampler && !(frame = ResampleFrame(frame)))
+            continue;
+
+        if (frameStatistics)
+            ComputeFrameStatistics(frame);
+
+        RouteFrame(frame);
+
+        if (onFrameValid)
+            DeliverFrame(frame);
+        else
+            FreePoolFrame(frame);
+
+        pulled = true;
+    }
+
+    return pulled;
+}
+
+bool NAVCodecContext::PullFromEncoder(AVCodecContext *context) {
+    bool pulled = false;
+
+    while (running) {
+        // While draining, output nobody takes is still pulled so that we get to the end
+        if (!onPacketValid && !packetRoute && !packetArena && !endOfStream)
+            break;
+
+        auto packet = GetPoolPacket();
+        auto started = std::chrono::steady_clock::now();
+        int result = avcodec_receive_packet(context, packet);
+
+        if (AVERROR(result) == EAGAIN) {
+            stats->receiveEagain.fetch_add(1, std::memory_order_relaxed);
+            FreePoolPacket(packet);
+            FlushBatches(false);
+            break;
+        }
+
+        if (result == AVERROR_EOF) {
+            FreePoolPacket(packet);
+            FlushBatches(true);
+
+            // A codec which cannot be flushed stays at its end (see OnCodecDrained())
+            if (endOfStream) {
+                OnCodecDrained();
+                pulled = true;
+            }
+            break;
+        }
+
+        if (result < 0) {
+            FreePoolPacket(packet);
+            FlushBatches(true);
+            SendError("averror:" + result, "An error occurred during avcodec_receive_packet");
+            break;
+        }
+
+        stats->receive.RecordSince(started);
+
+        RoutePacket(packet);
+
+        if (packetArena)
+            WriteToArena(packet);
+        else if (onPacketValid)
+            DeliverPacket(packet);
+        else
+            FreePoolPacket(packet);
+
+        pulled = true;
+    }
+
+    return pulled;
+}
+
+/**
+ * Hand a decoded frame to each encoder it is routed to. The copies reference the same buffers, so
+ * fanning out does not copy any picture/sample data. Copies for which an encoder has no room wait in
+ * routeBacklog, rather than blocking us (and possibly the pool worker the encoder needs). Codec 
+ * thread only.
+ */
+void NAVCodecContext::RouteFrame(AVFrame *frame) {
+    AVRational from = frame->time_base.num ? frame->time_base : GetHandle()->pkt_timebase;
+
+    for (auto route : frameRoutes) {
+        AVFrame *routed = av_frame_clone(frame);
+        if (!routed)
+            continue;
+
+        // Let the encoder choose frame types. It rescales the timestamps to its own time base, as it
+        // may be disposed of while we are running (see TryPushFromProducer()).
+        routed->pict_type = AV_PICTURE_TYPE_NONE;
+        routed->time_base = from;
+
+        if (routeBacklog.empty() && route->TryPushFromProducer(routed))
+            ++routedItems;
+        else
+            routeBacklog.push_back(std::make_pair(route, routed));
+    }
+}
+
+/**
+ * Retry the routed frames which are waiting for room. Returns true once none are left. Codec thread 
+ * only.
+ */
+bool NAVCodecContext::FlushRouteBacklog() {
+    while (!routeBacklog.empty()) {
+        auto &entry = routeBacklog.front();
+        if (!entry.first->TryPushFromProducer(entry.second))
+            return false;
+        
+        // Without a frame, this is the end of stream (see OnCodecDrained())
+        if (entry.second)
+            ++routedItems;
+        routeBacklog.pop_front();
+    }
+
+    return true;
+}
+
+/**
+ * Run a decoded frame through the resampler, which takes the frame. Returns the converted frame, or null
+ * if the resampler holds on to all of the samples for now (or failed, which has been reported). Codec
+ * thread only.
+ */
+AVFrame *NAVCodecContext::ResampleFrame(AVFrame *frame) {
+    auto output = GetPoolFrame();
+
+    // Decoded timestamps are in the packet time base
+    if (!frame->time_base.num)
+        frame->time_base = GetHandle()->pkt_timebase;
+
+    int result = resampler->Convert(frame, output);
+    FreePoolFrame(frame);
+
+    if (result < 0) {
+        FreePoolFrame(output);
+        SendError("averror:" + std::to_string(result), "An error occurred during swr_convert_frame");
+        return nullptr;
+    }
+
+    if (output->nb_samples == 0) {
+        FreePoolFrame(output);
+        return nullptr;
+    }
+
+    return output;
+}
+
+/**
+ * Hand an encoded packet to the format context it is routed to. The muxer converts its timestamps from
+ * our time base to the stream's. Codec thread only.
+ */
+void NAVCodecContext::RoutePacket(AVPacket *packet) {
+    if (!packetRoute)
+        return;
+
+    AVPacket *routed = av_packet_clone(packet);
+    if (!routed)
+        return;
+
+    routed->stream_index = packetRouteStream;
+    routed->time_base = GetHandle()->time_base;
+
+    if (packetRoute->QueuePacket(routed))
+        ++routedItems;
+    else
+        av_packet_free(&routed);
+}
+
+/**
+ * Attach the statistics of a decoded frame to its metadata (see frameStatistics), comparing video with 
+ * the previous frame. Frames we cannot compute statistics for (hardware frames, ...) go without. Codec 
+ * thread only.
+ */
+void NAVCodecContext::ComputeFrameStatistics(AVFrame *frame) {
+    bool video = frame->width > 0;
+    AVFrame *previous = video && statisticsPrevious && statisticsPrevious->buf[0] ? statisticsPrevious : nullptr;
+
+    // The previous frame does not count when the format or size has changed
+    if (previous && !nlav_check_statistics(frame, previous).empty())
+        previous = nullptr;
+    
+    if (!nlav_check_statistics(frame, previous).empty())
+        return;
+    
+    NAVFrameStatistics statistics;
+    nlav_compute_statistics(frame, previous, *frameStatistics, statistics);
+    nlav_attach_statistics(frame, statistics);
+
+    if (!video)
+        return;
+    
+    if (!statisticsPrevious)
+        statisticsPrevious = av_frame_alloc();
+    
+    av_frame_unref(statisticsPrevious);
+    av_frame_ref(statisticsPrevious, frame);
+}
+
+/**
+ * The codec has given back everything it had after an end of stream (see flush()). Drain the resampler,
+ * pass the end along our frame routes, and make the codec ready for more input, which only encoders 
+ * with AV_CODEC_CAP_ENCODER_FLUSH support. Codec thread only.
+ */
+void NAVCodecContext::OnCodecDrained() {
+    auto handle = GetHandle();
+
+    if (resampler) {
+        auto frame = GetPoolFrame();
+        int result = resampler->Convert(nullptr, frame);
+
+        if (result < 0 || frame->nb_samples == 0) {
+            FreePoolFrame(frame);
+            if (result < 0)
+                SendError("averror:" + std::to_string(result), "An error occurred while flushing the resampler");
+        } else {
+            RouteFrame(frame);
+
+            if (onFrameValid)
+                DeliverFrame(frame);
+            else
+                FreePoolFrame(frame);
+            
+            FlushBatches(true);
+        }
+    }
+
+    // The encoders we route to end after the frames we routed to them
+    for (auto route : frameRoutes) {
+        if (!routeBacklog.empty() || !route->TryPushFromProducer(nullptr))
+            routeBacklog.push_back(std::make_pair(route, (AVFrame*)nullptr));
+    }
+
+    if (isDecoder || (handle->codec->capabilities & AV_CODEC_CAP_ENCODER_FLUSH))
+        avcodec_flush_buffers(handle);
+    
+    // The next stream starts without a previous frame
+    if (statisticsPrevious)
+        av_frame_unref(statisticsPrevious);
+    
+    endOfStream = false;
+
+    // Along with our output, so that onEnd comes after the last of it
+    bool resolvesFlush = endResolvesFlush;
+    std::shared_ptr<bool> alive = this->alive;
+    auto callback = [this, alive, resolvesFlush](Napi::Env env, Napi::Function) {
+        if (*alive)
+            OnEnded(env, resolvesFlush);
+    };
+
+    endResolvesFlush = false;
+
+    if (isDecoder && onFrameValid)
+        onFrameTSFN.BlockingCall(callback);
+    else if (isEncoder && onPacketValid)
+        onPacketTSFN.BlockingCall(callback);
+    else
+        onEndTSFN.BlockingCall(callback);
+}
+
+/**
+ * JS thread only. An end of stream has made it through the codec.
+ */
+void NAVCodecContext::OnEnded(Napi::Env env, bool resolvesFlush) {
+    if (resolvesFlush && !flushDeferreds.empty()) {
+        flushDeferreds.front().Resolve(env.Undefined());
+        flushDeferreds.pop_front();
+        Unref();
+    }
+
+    if (!onEnd.IsEmpty())
+        onEnd.Call({});
+}
+
+/**
+ * Copy an encoded packet into the packet arena and let onPacket know where the write offset is now. 
+ * While a call is pending, packets written meanwhile are covered by it, as the offset is read when it 
+ * runs. Frees the packet. Codec thread only.
+ */
+void NAVCodecContext::WriteToArena(AVPacket *packet) {
+    bool written = packetArena->Write(packet);
+    FreePoolPacket(packet);
+
+    if (!written || !onPacketValid || packetArena->signalPending.exchange(true))
+        return;
+
+    auto arena = packetArena;
+    std::shared_ptr<bool> alive = this->alive;
+    auto stats = this->stats;
+    auto posted = std::chrono::steady_clock::now();
+    onPacketTSFN.BlockingCall([arena, alive, stats, posted](Napi::Env env, Napi::Function jsCallback) {
+        stats->delivery.RecordSince(posted);
+        arena->signalPending = false;
+
+        // The memory belongs to the Uint8Array we keep referenced
+        if (*alive)
+            jsCallback.Call({ Napi::Number::New(env, arena->WriteOffset()) });
+    });
+}
+
+/**
+ * Send a frame to the main thread, either on its own or as part of a batch once batchSize 
+ * frames have been collected. Codec thread only.
+ */
+void NAVCodecContext::DeliverFrame(AVFrame *frame) {
+    if (batchSize <= 1 && !HasPendingBatch()) {
+        auto pool = framePool;
+        auto stats = this->stats;
+        auto posted = std::chrono::steady_clock::now();
+        onFrameTSFN.BlockingCall([frame, pool, stats, posted](Napi::Env env, Napi::Function jsCallback) {
+            stats->delivery.RecordSince(posted);
+            jsCallback.Call({ WrapPoolFrame(env, pool, frame) });
+        });
+        return;
+    }
+
+    if (!HasPendingBatch())
+        batchStarted = std::chrono::steady_clock::now();
+    
+    frameBatch.push_back(frame);
+    if (frameBatch.size() >= batchSize)
+        FlushBatches(true);
+}
+
+/**
+ * Send a packet to the main thread, either on its own or as part of a batch once batchSize 
+ * packets have been collected. Codec thread only.
+ */
+void NAVCodecContext::DeliverPacket(AVPacket *packet) {
+    if (batchSize <= 1 && !HasPendingBatch()) {
+        auto pool = packetPool;
+        auto stats = this->stats;
+        auto posted = std::chrono::steady_clock::now();
+        onPacketTSFN.BlockingCall([packet, pool, stats, posted](Napi::Env env, Napi::Function jsCallback) {
+            stats->delivery.RecordSince(posted);
+            jsCallback.Call({ WrapPoolPacket(env, pool, packet) });
+        });
+        return;
+    }
+
+    if (!HasPendingBatch())
+        batchStarted = std::chrono::steady_clock::now();
+    
+    packetBatch.push_back(packet);
+    if (packetBatch.size() >= batchSize)
+        FlushBatches(true);
+}
+
+/**
+ * Send any collected frames/packets to the main thread as a single array. Unless force is set, 
+ * a partial batch is held back until it is maxBatchLatencyUs old. Codec thread only.
+ */
+void NAVCodecContext::FlushBatches(bool force) {
+    if (!HasPendingBatch())
+        return;
+    
+    if (!force && std::chrono::steady_clock::now() < BatchDeadline())
+        return;
+
+    if (!frameBatch.empty() && onFrameValid) {
+        std::vector<AVFrame*> batch;
+        batch.swap(frameBatch);
+
+        auto pool = framePool;
+        auto stats = this->stats;
+        auto posted = std::chrono::steady_clock::now();
+        onFrameTSFN.BlockingCall([batch, pool, stats, posted](Napi::Env env, Napi::Function jsCallback) {
+            stats->delivery.RecordSince(posted);
+            auto array = Napi::Array::New(env, batch.size());
+            for (uint32_t i = 0, max = batch.size(); i < max; ++i)
+                array.Set(i, WrapPoolFrame(env, pool, batch[i]));
+            jsCallback.Call({ array });
+        });
+    }
+
+    if (!packetBatch.empty() && onPacketValid) {
+        std::vector<AVPacket*> batch;
+        batch.swap(packetBatch);
+
+        auto pool = packetPool;
+        auto stats = this->stats;
+        auto posted = std::chrono::steady_clock::now();
+        onPacketTSFN.BlockingCall([batch, pool, stats, posted](Napi::Env env, Napi::Function jsCallback) {
+            stats->delivery.RecordSince(posted);
+            auto array = Napi::Array::New(env, batch.size());
+            for (uint32_t i = 0, max = batch.size(); i < max; ++i)
+                array.Set(i, WrapPoolPacket(env, pool, batch[i]));
+            jsCallback.Call({ array });
+        });
+    }
+}
+
+bool NAVCodecContext::HasPendingBatch() {
+    return !frameBatch.empty() || !packetBatch.empty();
+}
+
+/**
+ * Whether WaitForWork() needs to wake up to flush a partial batch. Without a callback the batch  
+ * cannot be delivered anyway, it goes out once a callback is set again.
+ */
+bool NAVCodecContext::HasDeliverableBatch() {
+    return (!frameBatch.empty() && onFrameValid) || (!packetBatch.empty() && onPacketValid);
+}
+
+std::chrono::steady_clock::time_point NAVCodecContext::BatchDeadline() {
+    return batchStarted + std::chrono::microseconds(maxBatchLatencyUs.load());
+}
+
+size_t NAVCodecContext::GetExternalMemorySize() {
+    return sizeof(AVCodecContext) + GetHandle()->extradata_size;
+}
+
+bool NAVCodecContext::CheckDisposable(const Napi::Env &env) {
+    if (!opening)
+        return true;
+
+    // Freeing the context would have to wait for avcodec_open2(), stalling the event loop
+    Napi::Error::New(env, "This AVCodecContext is being opened, wait for openAsync() before disposing of it").ThrowAsJavaScriptException();
+    return false;
+}
+
+void NAVCodecContext::Free() {
+    // Waits for an openAsync() in progress. dispose() is refused meanwhile, so only the garbage collector 
+    // tearing down the env can get here while one is.
+    std::unique_lock<std::mutex> openLock(openMutex);
+
+    // If we are a decoder, then extradata will only be set by us, and we own that data.
+    // If it is set, we need to free it using av_free. 
+    // (If we are an encoder, the data is owned --and freed-- by libavcodec)
+
+    if (av_codec_is_decoder(GetHandle()->codec) && GetHandle()->extradata) {
+        av_freep(&GetHandle()->extradata);
+        GetHandle()->extradata_size = 0;
+    }
+
+    // End the thread before releasing the context it is using. Waking the producer also ensures that 
+    // it has stopped pushing before we empty the queue below.
+    running = false;
+    stopping = true;
+    WakeProducer();
+    for (auto route : frameRoutes)
+        route->WakeProducer();
+
+    if (thread) {
+        Wake();
+        thread->join();
+        delete thread;
+        thread = nullptr;
+    }
+
+    // Waits for the pool worker running us, if any. We are not run again afterwards.
+    if (scheduler)
+        scheduler.load()->Remove(this);
+
+    for (auto route : frameRoutes)
+        route->DetachProducer();
+
+    for (auto &entry : routeBacklog)
+        av_frame_free(&entry.second);
+    routeBacklog.clear();
+
+    frameRoutes.clear();
+    packetRoute = nullptr;
+    routeReferences.clear();
+
+    resampler.reset();
+    resamplerReference.Reset();
+
+    frameStatistics.reset();
+    av_frame_free(&statisticsPrevious);
+
+    packetArena.reset();
+    packetArenaReference.Reset();
+
+    if (fairThreadCounted) {
+        --nlavc_fair_contexts;
+        fairThreadCounted = false;
+    }
+
+    // Items queued by an attached producer are ours to free
+
+    WorkItem *item;
+    while ((item = inQueue.Peek())) {
+        FreeWorkItem(*item);
+        inQueue.Pop();
+    }
+
+    // Anything still waiting for a batch to fill up will never be delivered
+
+    for (auto frame : frameBatch)
+        FreePoolFrame(frame);
+    for (auto packet : packetBatch)
+        FreePoolPacket(packet);
+    frameBatch.clear();
+    packetBatch.clear();
+
+    // Sends still waiting for room will never be queued. This only happens when the context is disposed
+    // explicitly, as we hold a reference to ourselves while there are pending sends.
+    
+    while (!pendingSends.empty()) {
+        auto &pending = pendingSends.front();
+        FreeWorkItem(pending.item);
+        if (!pending.item.resolvesFlush)
+            pending.deferred.Reject(Napi::Error::New(Env(), "The codec context was disposed before the item could be queued").Value());
+        pendingSends.pop_front();
+    }
+
+    while (!flushDeferreds.empty()) {
+        flushDeferreds.front().Reject(Napi::Error::New(Env(), "The codec context was disposed before it was flushed").Value());
+        flushDeferreds.pop_front();
+        Unref();
+    }
+
+    // Ends still on their way to the JS thread are dropped
+    *alive = false;
+
+    if (onDrainTSFN)
+        onDrainTSFN.Release();
+    if (onEndTSFN)
+        onEndTSFN.Release();
+
+    av_buffer_unref(&hwFramesRef);
+
+    auto handle = GetHandle();
+    avcodec_free_context(&handle);
+    SetHandle(handle);
+
+    // Decoded frames still holding its buffers keep them until they are freed
+    bufferPool.reset();
+}
+
+/**
+ * Our share of the cores, among the contexts expected to share them, or those open with fairThreadCount 
+ * (counting us from now on) if there are more. Without an expected count, the share depends on the order
+ * the contexts are opened in: the first one gets every core. Shared pool workers spend most of their 
+ * time waiting for the codec threads of the context they run, so they are not counted against the 
+ * cores. Any thread.
+ */
+int NAVCodecContext::TakeFairThreadCount() {
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    int contexts = std::max(++nlavc_fair_contexts, nlavc_fair_expected.load());
+
+    return std::max(1, std::min(NLAV_MAX_FAIR_THREADS, cores / contexts));
+}
+
+/**
+ * The options of open()/openAsync(): the first AVDictionary argument, as open() has also been called with
+ * a codec first, like avcodec_open2().
+ */
+static NAVDictionary *nlavc_open_options(const Napi::CallbackInfo& info) {
+    auto dictionaryClass = LibAvAddon::Self(info.Env())->GetConstructor(NAVDictionary::ExportName())->Value();
+
+    for (size_t i = 0, max = info.Length(); i < max; ++i) {
+        if (info[i].IsObject() && info[i].As<Napi::Object>().InstanceOf(dictionaryClass))
+            return NAVDictionary::Unwrap(info[i].As<Napi::Object>());
+    }
+
+    return nullptr;
+}
+
+int NAVCodecContext::OpenCodec(AVDictionary **options) {
+    auto handle = GetHandle();
+
+    if (fairThreadCount && handle->thread_count == 0) {
+        handle->thread_count = TakeFairThreadCount();
+        fairThreadCounted = true;
+    }
+
+    // Decoders without direct rendering (DR1) must allocate their frames with the default get_buffer2
+    bool pooled = bufferPoolSize > 0 && av_codec_is_decoder(handle->codec) 
+        && handle->codec->type == AVMEDIA_TYPE_VIDEO && (handle->codec->capabilities & AV_CODEC_CAP_DR1);
+    
+    if (pooled) {
+        int prewarm = bufferPoolPrewarm < 0 ? bufferPoolSize : bufferPoolPrewarm;
+        bufferPool = std::make_shared<NAVFrameBufferPool>(bufferPoolSize, prewarm, bufferPoolSharedMemory);
+        handle->opaque = this;
+        handle->get_buffer2 = &NAVCodecContext::GetBuffer;
+    }
+
+    int result = avcodec_open2(handle, handle->codec, options);
+
+    if (result < 0) {
+        if (fairThreadCounted) {
+            --nlavc_fair_contexts;
+            fairThreadCounted = false;
+            handle->thread_count = 0;
+        }
+
+        if (pooled) {
+            handle->get_buffer2 = avcodec_default_get_buffer2;
+            bufferPool.reset();
+        }
+        return result;
+    }
+
+    isEncoder = av_codec_is_encoder(handle->codec);
+    isDecoder = av_codec_is_decoder(handle->codec);
+
+    if (bufferPool)
+        bufferPool->Prewarm(handle);
+    
+    return result;
+}
+
+/**
+ * JS thread only. Set up what the codec thread needs from the JS thread, before it starts.
+ */
+void NAVCodecContext::PrepareThread(const Napi::Env &env) {
+    if (onEndTSFN)
+        return;
+    
+    auto noop = Napi::Function::New(env, [](const Napi::CallbackInfo&) { });
+    onEndTSFN = Napi::ThreadSafeFunction::New(env, noop, "AVContext#onEnd", 0, 1);
+
+    // An end of stream must not keep the process alive
+    onEndTSFN.Unref(env);
+}
+
+void NAVCodecContext::StartThread() {
+    if (useThreadPool) {
+        scheduler = NAVScheduler::Shared();
+        Wake();
+    } else {
+        thread = new std::thread([](NAVCodecContext *context) { context->ThreadMain(); }, this);
+    }
+}
+
+Napi::Value NAVCodecContext::Open(const Napi::CallbackInfo& info) {
+    if (opened) {
+        Napi::Error::New(info.Env(), "This codec context is already opened. You cannot reuse a codec context.").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+
+    NAVDictionary *nOptions = nlavc_open_options(info);
+    AVDictionary *options = nOptions ? nOptions->GetHandle() : nullptr;
+
+    int result = OpenCodec(&options);
+
+    if (result < 0)
+        return nlav_throw(info.Env(), result, "avcodec_open2");
+
+    opened = true;
+    
+    if (nOptions)
+        nOptions->SetHandle(options);
+
+    PrepareThread(info.Env());
+    StartThread();
+
+    return info.Env().Undefined();
+}
+
+/**
+ * Runs avcodec_open2() and starts the codec thread on a libuv worker thread, as opening an encoder can
+ * take a while (x264 and friends set up lookahead threads and tables, hardware encoders open a session).
+ */
+class NAVCodecOpenWorker : public Napi::AsyncWorker {
+    public:
+        NAVCodecOpenWorker(Napi::Env env, NAVCodecContext *context, NAVDictionary *options):
+            Napi::AsyncWorker(env, "AVCodecContext#openAsync"),
+            deferred(Napi::Promise::Deferred::New(env)),
+            context(context),
+            nOptions(options),
+            options(options ? options->GetHandle() : nullptr)
+        {
+            contextReference = Napi::Persistent(context->Value());
+            if (options)
+                optionsReference = Napi::Persistent(options->Value());
+        }
+
+        Napi::Promise Promise() {
+            return deferred.Promise();
+        }
+
+    protected:
+        void Execute() {
+            // Keeps dispose() from freeing the context under us, see Free()
+            std::unique_lock<std::mutex> lock(context->openMutex);
+
+            if (!context->GetHandle()) {
+                disposed = true;
+                return;
+            }
+
+            result = context->OpenCodec(&options);
+            if (result >= 0)
+                context->StartThread();
+        }
+
+        void OnOK() {
+            auto env = Env();
+            context->opening = false;
+
+            if (disposed || context->IsDisposed()) {
+                deferred.Reject(Napi::Error::New(env, "The codec context was disposed before it could be opened").Value());
+                return;
+            }
+
+            if (result < 0) {
+                context->opened = false;
+                deferred.Reject(Napi::Error::New(env, "[avcodec_open2] libav: " + nlavu_get_error_string(result)).Value());
+                return;
+            }
+
+            if (nOptions)
+                nOptions->SetHandle(options);
+            
+            deferred.Resolve(env.Undefined());
+        }
+
+    private:
+        Napi::Promise::Deferred deferred;
+        NAVCodecContext *context;
+        NAVDictionary *nOptions;
+        AVDictionary *options;
+        Napi::ObjectReference contextReference;
+        Napi::ObjectReference optionsReference;
+        bool disposed = false;
+        int result = 0;
+};
+
+Napi::Value NAVCodecContext::OpenAsync(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (opened) {
+        Napi::Error::New(env, "This codec context is already opened. You cannot reuse a codec context.").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    // Opened from here on, so that the properties libavcodec is reading cannot be changed meanwhile.
+    // Frames/packets sent meanwhile are queued, and go to the codec once it is open.
+    opened = true;
+    opening = true;
+    PrepareThread(env);
+
+    auto worker = new NAVCodecOpenWorker(env, this, nlavc_open_options(info));
+    auto promise = worker->Promise();
+    worker->Queue();
+
+    return promise;
+}
+
+/**
+ * Queue an end of stream. The codec gives back the frames/packets it still holds on to, the end is 
+ * passed along our frame routes, and the returned promise resolves after the last of the output has 
+ * gone to onFrame/onPacket (followed by onEnd). The codec can then be used for a new stream (encoders
+ * only if they support it, see AV_CODEC_CAP_ENCODER_FLUSH).
+ */
+Napi::Value NAVCodecContext::Flush(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (!CheckNoProducer(env))
+        return env.Undefined();
+    
+    if (!opened) {
+        Napi::Error::New(env, "The codec context must be opened before it can be flushed").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    WorkItem item;
+    item.endOfStream = true;
+    item.resolvesFlush = true;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    flushDeferreds.push_back(deferred);
+
+    // Until the end has made it through, see OnEnded()
+    Ref();
+
+    if (!EnqueueWork(item)) {
+        pendingSends.push_back(PendingSend { item, deferred });
+        RequestDrain(env);
+    }
+
+    return deferred.Promise();
+}
+
+Napi::Value NAVCodecContext::Configure(const Napi::CallbackInfo& info) {
+    return ApplyProperties(info);
+}
+
+bool NAVCodecContext::CheckRoutable(const Napi::Env &env) {
+    if (!opened)
+        return true;
+
+    Napi::Error::New(env, "Routes must be set up before the codec context is opened").ThrowAsJavaScriptException();
+    return false;
+}
+
+Napi::Value NAVCodecContext::RouteFrames(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (!CheckRoutable(env))
+        return env.Undefined();
+
+    if (!av_codec_is_decoder(GetHandle()->codec)) {
+        Napi::Error::New(env, "Only decoders can route frames").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto object = info[0].As<Napi::Object>();
+    auto target = NAVCodecContext::Unwrap(object);
+
+    if (target == this || !av_codec_is_encoder(target->GetHandle()->codec)) {
+        Napi::Error::New(env, "Frames can only be routed to an encoder").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (!target->AttachProducer(this)) {
+        Napi::Error::New(env, "The codec context is already fed by another producer").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    frameRoutes.push_back(target);
+    routeReferences.push_back(Napi::Persistent(object));
+
+    return env.Undefined();
+}
+
+Napi::Value NAVCodecContext::RoutePackets(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (!CheckRoutable(env))
+        return env.Undefined();
+
+    if (!av_codec_is_encoder(GetHandle()->codec)) {
+        Napi::Error::New(env, "Only encoders can route packets").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (packetRoute) {
+        Napi::Error::New(env, "The packets of this codec context are already routed").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto object = info[0].As<Napi::Object>();
+    auto target = NAVFormatContext::Unwrap(object);
+    int index = info[1].As<Napi::Number>().Int32Value();
+
+    if (index < 0 || (unsigned int)index >= target->GetHandle()->nb_streams) {
+        Napi::RangeError::New(env, "There is no stream with index " + std::to_string(index)).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    packetRoute = target;
+    packetRouteStream = index;
+    routeReferences.push_back(Napi::Persistent(object));
+
+    return env.Undefined();
+}
+
+/**
+ * The packet (decoders) or frame (encoders) of a send, which the codec thread only gets to later. It 
+ * queues a new reference, so that the caller may reuse, release or dispose of its own right away.
+ */
+bool NAVCodecContext::GetInputItem(const Napi::CallbackInfo& info, WorkItem &item, bool frame) {
+    auto env = info.Env();
+    std::string type = frame ? "AVFrame" : "AVPacket";
+
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected an " + type + " to send").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    auto object = info[0].As<Napi::Object>();
+
+    if (frame ? !NAVFrame::Unwrap(object)->GetHandle() : !NAVPacket::Unwrap(object)->GetHandle()) {
+        Napi::Error::New(env, "Cannot send a disposed " + type).ThrowAsJavaScriptException();
+        return false;
+    }
+
+    if (frame)
+        item.frame = av_frame_clone(NAVFrame::Unwrap(object)->GetHandle());
+    else
+        item.packet = av_packet_clone(NAVPacket::Unwrap(object)->GetHandle());
+    
+    if (!item.frame && !item.packet) {
+        nlav_throw(env, AVERROR(ENOMEM), frame ? "av_frame_clone" : "av_packet_clone");
+        return false;
+    }
+
+    item.owned = true;
+    return true;
+}
+
+/**
+ * Free the packet/frame of an item which was never queued, if it is ours.
+ */
+void NAVCodecContext::FreeWorkItem(WorkItem &item) {
+    if (item.owned) {
+        av_packet_free(&item.packet);
+        av_frame_free(&item.frame);
+    }
+}
+
+Napi::Value NAVCodecContext::SendPacket(const Napi::CallbackInfo& info) {
+    if (!CheckNoProducer(info.Env()))
+        return info.Env().Undefined();
+
+    WorkItem item;
+    if (!GetInputItem(info, item, false))
+        return info.Env().Undefined();
+
+    bool queued = EnqueueWork(item);
+    if (!queued) {
+        FreeWorkItem(item);
+        drainNotify = true;
+        RequestDrain(info.Env());
+    }
+
+    return Napi::Boolean::New(info.Env(), queued);
+}
+
+Napi::Value NAVCodecContext::SendPacketAsync(const Napi::CallbackInfo& info) {
+    if (!CheckNoProducer(info.Env()))
+        return info.Env().Undefined();
+
+    WorkItem item;
+    if (!GetInputItem(info, item, false))
+        return info.Env().Undefined();
+
+    return EnqueueWorkAsync(info.Env(), item);
+}
+
+Napi::Value NAVCodecContext::ReceiveFrame(const Napi::CallbackInfo& info) {
+    NAVFrame *frame;
+
+    if (info.Length() > 0)
+        frame = NAVFrame::Unwrap(info[0].As<Napi::Object>());
+    else
+        frame = LibAvAddon::Construct<NAVFrame>(info.Env());
+    
+    int result = avcodec_receive_frame(GetHandle(), frame->GetHandle());
+    if (result < 0)
+        return nlav_throw(info.Env(), result, "avcodec_receive_frame");
+
+    frame->UpdateExternalMemory(info.Env());
+    return frame->Value();
+}
+
+Napi::Value NAVCodecContext::SendFrame(const Napi::CallbackInfo& info) {
+    if (!CheckNoProducer(info.Env()))
+        return info.Env().Undefined();
+
+    WorkItem item;
+    if (!GetInputItem(info, item, true))
+        return info.Env().Undefined();
+
+    bool queued = EnqueueWork(item);
+    if (!queued) {
+        FreeWorkItem(item);
+        drainNotify = true;
+        RequestDrain(info.Env());
+    }
+
+    return Napi::Boolean::New(info.Env(), queued);
+}
+
+Napi::Value NAVCodecContext::SendFrameAsync(const Napi::CallbackInfo& info) {
+    if (!CheckNoProducer(info.Env()))
+        return info.Env().Undefined();
+
+    WorkItem item;
+    if (!GetInputItem(info, item, true))
+        return info.Env().Undefined();
+
+    return EnqueueWorkAsync(info.Env(), item);
+}
+
+Napi::Value NAVCodecContext::ReceivePacket(const Napi::CallbackInfo& info) {
+    NAVPacket *packet;
+
+    if (info.Length() > 0)
+        packet = NAVPacket::Unwrap(info[0].As<Napi::Object>());
+    else
+        packet = LibAvAddon::Construct<NAVPacket>(info.Env());
+    
+    int result = avcodec_receive_packet(GetHandle(), packet->GetHandle());
+    if (result < 0)
+        return nlav_throw(info.Env(), result, "avcodec_receive_packet");
+
+    packet->UpdateExternalMemory(info.Env());
+    return packet->Value();
+}
+
+Napi::Value NAVCodecContext::GetQueueDepth(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), inQueue.Size());
+}
 
-        if (isEncoder)
-            PullFromEncoder(context);
-        else if (isDecoder)
-            PullFromDecoder(context);
+Napi::Value NAVCodecContext::GetQueueHighWaterMark(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), inQueue.HighWaterMark());
+}
 
-        if (!fed)
-            WaitForWork();
-    }
+Napi::Value NAVCodecContext::GetMaxQueuedItems(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), maxQueuedItems);
 }
 
-void NAVCodecContext::WaitForWork() {
-    std::unique_lock<std::mutex> lock(mutex);
+void NAVCodecContext::SetMaxQueuedItems(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    int64_t max = value.As<Napi::Number>().Int64Value();
 
-    if (inQueue.size() > 0)
+    if (max < 1) {
+        Napi::RangeError::New(info.Env(), "maxQueuedItems must be at least 1").ThrowAsJavaScriptException();
         return;
+    }
+
+    // The ring can only be resized while the codec thread is not running and nothing is queued
+    if ((size_t)max > inQueue.Capacity()) {
+        if (opened || !inQueue.Empty()) {
+            Napi::RangeError::New(
+                info.Env(), 
+                "maxQueuedItems cannot be raised above " + std::to_string(inQueue.Capacity()) 
+                + " once the context is opened or has queued items"
+            ).ThrowAsJavaScriptException();
+            return;
+        }
 
-    threadWake.wait(lock);
+        inQueue.Reset(max);
+    }
+
+    maxQueuedItems = max;
+    effectiveLowWaterMark.store(GetEffectiveLowWaterMark());
 }
 
-AVFrame *NAVCodecContext::GetPoolFrame() {
-    std::unique_lock<std::mutex> lock(mutex);
+Napi::Value NAVCodecContext::GetQueueLowWaterMark(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetEffectiveLowWaterMark());
+}
 
-    if (framePool.size() == 0)
-        framePool.push(av_frame_alloc());
+void NAVCodecContext::SetQueueLowWaterMark(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (value.IsNull() || value.IsUndefined())
+        queueLowWaterMark = -1;
+    else
+        queueLowWaterMark = std::max((int64_t)0, value.As<Napi::Number>().Int64Value());
     
-    auto frame = framePool.front();
-    framePool.pop();
-    framePoolHeight += 1;
+    effectiveLowWaterMark.store(GetEffectiveLowWaterMark());
+}
+
+Napi::Value NAVCodecContext::GetPoolStats(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto frames = Napi::Object::New(env);
+    auto packets = Napi::Object::New(env);
+    auto stats = Napi::Object::New(env);
+
+    frames.Set("hits", Napi::Number::New(env, framePool->Hits()));
+    frames.Set("misses", Napi::Number::New(env, framePool->Misses()));
+    frames.Set("idle", Napi::Number::New(env, framePool->Idle()));
+    packets.Set("hits", Napi::Number::New(env, packetPool->Hits()));
+    packets.Set("misses", Napi::Number::New(env, packetPool->Misses()));
+    packets.Set("idle", Napi::Number::New(env, packetPool->Idle()));
+    stats.Set("frames", frames);
+    stats.Set("packets", packets);
+
+    if (bufferPool) {
+        auto buffers = Napi::Object::New(env);
+        auto counters = bufferPool->GetStats();
+
+        buffers.Set("frames", Napi::Number::New(env, counters->frames.load()));
+        buffers.Set("allocations", Napi::Number::New(env, counters->allocations.load()));
+        buffers.Set("overflows", Napi::Number::New(env, counters->overflows.load()));
+        buffers.Set("layouts", Napi::Number::New(env, counters->layouts.load()));
+        stats.Set("buffers", buffers);
+    }
 
-    return frame;
+    return stats;
 }
 
-void NAVCodecContext::FreePoolFrame(AVFrame *frame) {
-    framePool.push(frame);
-    framePoolHeight -= 1;
+Napi::Value NAVCodecContext::GetRoutedItems(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), routedItems.load());
+}
 
-    // Burn a single frame beyond the current height
-    if (framePool.size() > framePoolHeight + 4) {
-        auto burnt = framePool.front();
-        framePool.pop();
-        av_frame_free(&burnt);
-    }
+static Napi::Object nlavc_histogram_object(const Napi::Env &env, const NAVLatencyHistogram &histogram) {
+    auto object = Napi::Object::New(env);
+
+    object.Set("count", Napi::Number::New(env, histogram.Count()));
+    object.Set("meanUs", Napi::Number::New(env, histogram.Mean()));
+    object.Set("p50Us", Napi::Number::New(env, histogram.Percentile(0.5)));
+    object.Set("p90Us", Napi::Number::New(env, histogram.Percentile(0.9)));
+    object.Set("p99Us", Napi::Number::New(env, histogram.Percentile(0.99)));
+    object.Set("maxUs", Napi::Number::New(env, histogram.Max()));
+
+    return object;
 }
 
-AVPacket *NAVCodecContext::GetPoolPacket() {
-    std::unique_lock<std::mutex> lock(mutex);
+Napi::Value NAVCodecContext::GetStats(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto object = Napi::Object::New(env);
 
-    if (packetPool.size() == 0)
-        packetPool.push(av_packet_alloc());
-    
-    auto frame = packetPool.front();
-    packetPool.pop();
-    packetPoolHeight += 1;
+    object.Set("queueWait", nlavc_histogram_object(env, stats->queueWait));
+    object.Set("send", nlavc_histogram_object(env, stats->send));
+    object.Set("receive", nlavc_histogram_object(env, stats->receive));
+    object.Set("delivery", nlavc_histogram_object(env, stats->delivery));
+    object.Set("sendEagain", Napi::Number::New(env, stats->sendEagain.load()));
+    object.Set("receiveEagain", Napi::Number::New(env, stats->receiveEagain.load()));
+    object.Set("errors", Napi::Number::New(env, stats->errors.load()));
+    object.Set("queueDepth", Napi::Number::New(env, inQueue.Size()));
+    object.Set("queueHighWaterMark", Napi::Number::New(env, inQueue.HighWaterMark()));
+    object.Set("pools", GetPoolStats(info));
 
-    return frame;
+    return object;
 }
 
-void NAVCodecContext::FreePoolPacket(AVPacket *frame) {
-    packetPool.push(frame);
-    packetPoolHeight -= 1;
+Napi::Value NAVCodecContext::ConfigureThreadPool(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    int64_t threads = info[0].IsNumber() ? info[0].As<Napi::Number>().Int64Value() : 0;
+
+    if (threads < 0) {
+        Napi::RangeError::New(env, "The number of threads cannot be negative").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
 
-    // Burn a single frame beyond the current height
-    if (packetPool.size() > packetPoolHeight + 4) {
-        auto burnt = packetPool.front();
-        packetPool.pop();
-        av_packet_free(&burnt);
+    if (!NAVScheduler::Configure(threads)) {
+        Napi::Error::New(env, "The thread pool has already been started").ThrowAsJavaScriptException();
+        return env.Undefined();
     }
+
+    return env.Undefined();
 }
 
-void NAVCodecContext::SendError(std::string code, std::string message) {
+Napi::Value NAVCodecContext::ConfigureFairThreads(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    int64_t contexts = info[0].IsNumber() ? info[0].As<Napi::Number>().Int64Value() : 0;
 
-    if (!this->onErrorValid) {
-        std::cerr << "[AVCodecContext thread]: Error [discarded]: " << code << ": " << message << std::endl;
-        return;
+    if (contexts < 0 || contexts > INT32_MAX) {
+        Napi::RangeError::New(env, "The number of contexts must be between 0 and 2^31 - 1").ThrowAsJavaScriptException();
+        return env.Undefined();
     }
 
-    std::cerr << "[AVCodecContext thread]: Error: " << code << ": " << message << std::endl;
-
-    onErrorTSFN.BlockingCall([=](Napi::Env env, Napi::Function jsCallback) {
-        Napi::Object error = Napi::Object::New(env);
-        error.Set("code", code);
-        error.Set("message", message);
-        jsCallback.Call({ error });
-    });
+    nlavc_fair_expected = (int)contexts;
+    return env.Undefined();
 }
 
-void NAVCodecContext::ThreadLog(std::string message) {
-    if (!threadTracing)
-        return;
+Napi::Value NAVCodecContext::ThreadPoolStats(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto stats = Napi::Object::New(env);
+    bool started = NAVScheduler::Started();
+    NAVSchedulerStats pool = {};
 
-    std::cout << "[AVCodecContext thread] " << message << std::endl;
+    if (started)
+        pool = NAVScheduler::Shared()->GetStats();
+    else
+        pool.threads = NAVScheduler::ConfiguredThreads();
+
+    stats.Set("started", Napi::Boolean::New(env, started));
+    stats.Set("threads", Napi::Number::New(env, pool.threads));
+    stats.Set("queued", Napi::Number::New(env, pool.queued));
+    stats.Set("tasksRun", Napi::Number::New(env, pool.tasksRun));
+    stats.Set("steals", Napi::Number::New(env, pool.steals));
+    stats.Set("busyUs", Napi::Number::New(env, pool.busyUs));
+    stats.Set("uptimeUs", Napi::Number::New(env, pool.uptimeUs));
+    stats.Set("utilization", Napi::Number::New(env, 
+        pool.uptimeUs > 0 ? (double)pool.busyUs / ((double)pool.threads * pool.uptimeUs) : 0
+    ));
+
+    return stats;
 }
 
-bool NAVCodecContext::FeedToCodec() {
-    std::unique_lock<std::mutex> lock(mutex);
-    auto handle = GetHandle();
-    std::deque<WorkItem> localQueue;
+Napi::Value NAVCodecContext::GetUseThreadPool(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), useThreadPool);
+}
 
-    localQueue = inQueue;
-    inQueue.clear();
-    lock.unlock();
+void NAVCodecContext::SetUseThreadPool(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (CheckNotOpened(info.Env(), "useThreadPool"))
+        useThreadPool = value.ToBoolean().Value();
+}
 
-    if (localQueue.size() == 0)
-        return false;
-    
-    bool fed = false;
+Napi::Value NAVCodecContext::GetFairThreadCount(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), fairThreadCount);
+}
 
-    while (running && localQueue.size() > 0) {
-        auto workItem = localQueue.front();
-        int result;
+void NAVCodecContext::SetFairThreadCount(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (CheckNotOpened(info.Env(), "fairThreadCount"))
+        fairThreadCount = value.ToBoolean().Value();
+}
 
-        if (workItem.frame) {
-            result = avcodec_send_frame(handle, workItem.frame);
-        } else if (workItem.packet) {
-            result = avcodec_send_packet(handle, workItem.packet);
-        }
+Napi::Value NAVCodecContext::GetBufferPoolSize(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), bufferPoolSize);
+}
 
-        if (result == AVERROR(EAGAIN))
-            break;
+void NAVCodecContext::SetBufferPoolSize(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (CheckNotOpened(info.Env(), "bufferPoolSize"))
+        bufferPoolSize = std::max(0, value.As<Napi::Number>().Int32Value());
+}
 
-        if (result < 0) {
-            SendError("averror:" + std::to_string(result), "An error occurred during avcodec_send. Discarding queued item.");
-            localQueue.pop_front();
-            break;
-        }
+Napi::Value NAVCodecContext::GetBufferPoolPrewarm(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), bufferPoolPrewarm < 0 ? bufferPoolSize : bufferPoolPrewarm);
+}
 
-        fed = true;
-        localQueue.pop_front();
-    }
+void NAVCodecContext::SetBufferPoolPrewarm(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (!CheckNotOpened(info.Env(), "bufferPoolPrewarm"))
+        return;
+    
+    if (value.IsNull() || value.IsUndefined())
+        bufferPoolPrewarm = -1;
+    else
+        bufferPoolPrewarm = std::max(0, value.As<Napi::Number>().Int32Value());
+}
+
+Napi::Value NAVCodecContext::GetBufferPoolSharedMemory(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), bufferPoolSharedMemory);
+}
 
-    // Return unprocessed items back to the queue
-    if (localQueue.size() > 0) {
-        std::unique_lock<std::mutex> lock(mutex);
+void NAVCodecContext::SetBufferPoolSharedMemory(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    auto env = info.Env();
+    bool enabled = value.ToBoolean().Value();
 
-        while (localQueue.size() > 0) {
-            inQueue.push_front(localQueue.back());
-            localQueue.pop_back();
-        }
+    if (!CheckNotOpened(env, "bufferPoolSharedMemory"))
+        return;
+    
+    if (enabled && !nlav_shared_memory_supported()) {
+        Napi::Error::New(env, "Shared memory buffers are not supported on this platform").ThrowAsJavaScriptException();
+        return;
     }
 
-    return fed;
+    bufferPoolSharedMemory = enabled;
 }
 
-bool NAVCodecContext::PullFromDecoder(AVCodecContext *context) {
-    while (running) {
-        if (!onFrameValid)
-            break;
-        
-        auto frame = GetPoolFrame();
-        int result = avcodec_receive_frame(context, frame);
+/**
+ * get_buffer2 callback of decoders with a bufferPoolSize. Any thread libavcodec decodes on.
+ */
+int NAVCodecContext::GetBuffer(AVCodecContext *context, AVFrame *frame, int flags) {
+    auto self = (NAVCodecContext*)context->opaque;
+    return self->bufferPool->GetBuffer(context, frame, flags);
+}
 
-        if (AVERROR(result) == EAGAIN) {
-            FreePoolFrame(frame);
-            break;
-        }
+bool NAVCodecContext::CheckNotOpened(const Napi::Env &env, std::string property) {
+    if (!opened)
+        return true;
 
-        if (result < 0) {
-            SendError("averror:" + result, "An error occurred during avcodec_receive_frame");
-            break;
-        }
+    Napi::Error::New(env, property + " must be set before the codec context is opened").ThrowAsJavaScriptException();
+    return false;
+}
 
-        // Send to the main thread
+/**
+ * get_format callback of decoders with a hardware device: pick the device's pixel format when the codec 
+ * offers it, so that frames are decoded into GPU memory, and fall back to software decoding otherwise 
+ * (for instance for a profile the hardware does not support). Codec thread only.
+ */
+AVPixelFormat NAVCodecContext::GetHardwareFormat(AVCodecContext *context, const AVPixelFormat *formats) {
+    auto self = (NAVCodecContext*)context->opaque;
 
-        onFrameTSFN.BlockingCall([=](Napi::Env env, Napi::Function jsCallback) {
-            jsCallback.Call({ NAVFrame::FromHandleWrapped(env, frame, true) });
-        });
+    for (auto format = formats; *format != AV_PIX_FMT_NONE; ++format) {
+        if (*format != self->hwPixelFormat)
+            continue;
+        
+        // Decoding into the given frames context lets us hand the frames to an encoder using the same one
+        if (self->hwFramesRef && !context->hw_frames_ctx)
+            context->hw_frames_ctx = av_buffer_ref(self->hwFramesRef);
+        
+        return *format;
     }
 
-    return true;
+    av_log(context, AV_LOG_VERBOSE, "The hardware pixel format is not offered, decoding in software\n");
+    return avcodec_default_get_format(context, formats);
 }
 
-bool NAVCodecContext::PullFromEncoder(AVCodecContext *context) {
-    ThreadLog("Pulling from encoder...");
+Napi::Value NAVCodecContext::GetHwDeviceContext(const Napi::CallbackInfo& info) {
+    return NAVHWDeviceContext::FromHandleWrapped(info.Env(), GetHandle()->hw_device_ctx, false);
+}
 
-    while (running) {
-        if (!onPacketValid)
-            break;
+/**
+ * Decode/encode on the given device. For decoders, the codec must support the device type, and frames are
+ * then decoded into GPU memory (see hwPixelFormat and AVFrame#transferData()).
+ */
+void NAVCodecContext::SetHwDeviceContext(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    auto env = info.Env();
+    auto handle = GetHandle();
 
-        auto packet = GetPoolPacket();
-        int result = avcodec_receive_packet(context, packet);
+    if (!CheckNotOpened(env, "hwDeviceContext"))
+        return;
+    
+    if (value.IsNull() || value.IsUndefined()) {
+        av_buffer_unref(&handle->hw_device_ctx);
+        hwPixelFormat = AV_PIX_FMT_NONE;
+        handle->get_format = avcodec_default_get_format;
+        return;
+    }
 
-        if (AVERROR(result) == EAGAIN || result == AVERROR_EOF) {
-            ThreadLog("Encoder is starved.");
-            FreePoolPacket(packet);
-            break;
-        }
+    auto device = NAVHWDeviceContext::Unwrap(value.As<Napi::Object>());
+    auto type = device->GetDeviceContext()->type;
+    AVPixelFormat format = AV_PIX_FMT_NONE;
+    const AVCodecHWConfig *config;
 
-        if (result < 0) {
-            SendError("averror:" + result, "An error occurred during avcodec_receive_packet");
+    for (int i = 0; (config = avcodec_get_hw_config(handle->codec, i)); ++i) {
+        if (config->device_type == type && (config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX)) {
+            format = config->pix_fmt;
             break;
         }
+    }
 
-        // Send to the main thread
-        ThreadLog("** Received packet!");
-        onPacketTSFN.BlockingCall([=](Napi::Env env, Napi::Function jsCallback) {
-            jsCallback.Call({ NAVPacket::FromHandleWrapped(env, packet, true) });
-        });
+    if (format == AV_PIX_FMT_NONE && av_codec_is_decoder(handle->codec)) {
+        Napi::Error::New(env, std::string("The codec does not support ") + av_hwdevice_get_type_name(type) + " devices").ThrowAsJavaScriptException();
+        return;
     }
 
-    return true;
+    av_buffer_unref(&handle->hw_device_ctx);
+    handle->hw_device_ctx = av_buffer_ref(device->GetHandle());
+    hwPixelFormat = format;
+
+    if (av_codec_is_decoder(handle->codec)) {
+        handle->opaque = this;
+        handle->get_format = &NAVCodecContext::GetHardwareFormat;
+    }
 }
 
-void NAVCodecContext::Free() {
-    // If we are a decoder, then extradata will only be set by us, and we own that data.
-    // If it is set, we need to free it using av_free. 
-    // (If we are an encoder, the data is owned --and freed-- by libavcodec)
+/**
+ * For decoders, the frames context libavcodec decodes into (null until the first frame has been decoded, 
+ * unless it was set). For encoders, the frames context the input frames come from.
+ */
+Napi::Value NAVCodecContext::GetHwFramesContext(const Napi::CallbackInfo& info) {
+    auto handle = GetHandle();
+    auto ref = handle->hw_frames_ctx ? handle->hw_frames_ctx : hwFramesRef;
 
-    if (av_codec_is_decoder(GetHandle()->codec) && GetHandle()->extradata) {
-        av_freep(&GetHandle()->extradata);
-        GetHandle()->extradata_size = 0;
-    }
+    return NAVHWFramesContext::FromHandleWrapped(info.Env(), ref, false);
+}
 
-    running = false;
+void NAVCodecContext::SetHwFramesContext(const Napi::CallbackInfo& info, const Napi::Value &value) {
     auto handle = GetHandle();
-    avcodec_free_context(&handle);
 
-    // End the thread
-    threadWake.notify_one();
-    thread->join();
+    if (!CheckNotOpened(info.Env(), "hwFramesContext"))
+        return;
     
-    SetHandle(handle);
-}
+    av_buffer_unref(&hwFramesRef);
+    if (av_codec_is_encoder(handle->codec))
+        av_buffer_unref(&handle->hw_frames_ctx);
 
-Napi::Value NAVCodecContext::Open(const Napi::CallbackInfo& info) {
-    if (opened) {
-        Napi::Error::New(info.Env(), "This codec context is already opened. You cannot reuse a codec context.").ThrowAsJavaScriptException();
-        return info.Env().Undefined();
+    if (value.IsNull() || value.IsUndefined())
+        return;
+    
+    auto frames = NAVHWFramesContext::Unwrap(value.As<Napi::Object>());
+    hwFramesRef = av_buffer_ref(frames->GetHandle());
+
+    // Hardware encoders take their input format from the frames context
+    if (av_codec_is_encoder(handle->codec)) {
+        handle->hw_frames_ctx = av_buffer_ref(hwFramesRef);
+        handle->pix_fmt = frames->GetFramesContext()->format;
     }
+}
+
+Napi::Value NAVCodecContext::GetHwPixelFormat(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), hwPixelFormat);
+}
 
-    NAVDictionary *nOptions = nullptr;
-    AVDictionary *options = nullptr;
-    if (info.Length() > 1) {
-        nOptions = NAVDictionary::Unwrap(info[1].As<Napi::Object>());
-        options = nOptions->GetHandle();
+Napi::Value NAVCodecContext::GetResampler(const Napi::CallbackInfo& info) {
+    if (resamplerReference.IsEmpty())
+        return info.Env().Null();
+
+    return resamplerReference.Value();
+}
+
+void NAVCodecContext::SetResampler(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    auto env = info.Env();
+
+    if (!CheckNotOpened(env, "resampler"))
+        return;
+
+    resampler.reset();
+    resamplerReference.Reset();
+
+    if (value.IsNull() || value.IsUndefined())
+        return;
+    
+    if (!av_codec_is_decoder(GetHandle()->codec) || GetHandle()->codec_type != AVMEDIA_TYPE_AUDIO) {
+        Napi::Error::New(env, "Only audio decoders can have a resampler").ThrowAsJavaScriptException();
+        return;
     }
 
-    auto handle = GetHandle();
-    int result = avcodec_open2(handle, handle->codec, &options);
+    auto object = value.As<Napi::Object>();
+    resampler = NAVResampler::Unwrap(object)->GetState();
+    resamplerReference = Napi::Persistent(object);
+}
 
-    if (result < 0)
-        return nlav_throw(info.Env(), result, "avcodec_open2");
+Napi::Value NAVCodecContext::GetFrameStatistics(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
 
-    opened = true;
+    if (!frameStatistics)
+        return env.Null();
     
-    if (nOptions)
-        nOptions->SetHandle(options);
+    auto options = Napi::Object::New(env);
+    options.Set("histogram", Napi::Boolean::New(env, frameStatistics->histogram));
+    options.Set("blackThreshold", Napi::Number::New(env, frameStatistics->blackThreshold));
+    options.Set("blackRatio", Napi::Number::New(env, frameStatistics->blackRatio));
+    options.Set("frozenThreshold", Napi::Number::New(env, frameStatistics->frozenThreshold));
+    return options;
+}
 
-    thread = new std::thread([](NAVCodecContext *context) { context->ThreadMain(); }, this);
+void NAVCodecContext::SetFrameStatistics(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    auto env = info.Env();
 
-    return info.Env().Undefined();
+    if (!CheckNotOpened(env, "frameStatistics"))
+        return;
+
+    frameStatistics.reset();
+
+    if (value.IsNull() || value.IsUndefined() || (value.IsBoolean() && !value.As<Napi::Boolean>().Value()))
+        return;
+    
+    if (!av_codec_is_decoder(GetHandle()->codec)) {
+        Napi::Error::New(env, "Only decoders can compute frameStatistics").ThrowAsJavaScriptException();
+        return;
+    }
+
+    auto options = std::make_shared<NAVFrameStatisticsOptions>();
+    NAVFrame *previous;
+
+    if (value.IsObject() && !nlav_get_statistics_options(env, value, *options, previous))
+        return;
+
+    frameStatistics = options;
 }
 
-Napi::Value NAVCodecContext::SendPacket(const Napi::CallbackInfo& info) {
-    auto packet = NAVPacket::Unwrap(info[0].As<Napi::Object>());
-    auto result = avcodec_send_packet(GetHandle(), packet->GetHandle());
-    if (result < 0)
-        return nlav_throw(info.Env(), result, "avcodec_send_packet");
-    return info.Env().Undefined();
+Napi::Value NAVCodecContext::GetPacketArena(const Napi::CallbackInfo& info) {
+    if (packetArenaReference.IsEmpty())
+        return info.Env().Null();
+    
+    return packetArenaReference.Value();
 }
 
-Napi::Value NAVCodecContext::ReceiveFrame(const Napi::CallbackInfo& info) {
-    NAVFrame *frame;
+void NAVCodecContext::SetPacketArena(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    auto env = info.Env();
 
-    if (info.Length() > 0)
-        frame = NAVFrame::Unwrap(info[0].As<Napi::Object>());
-    else
-        frame = LibAvAddon::Construct<NAVFrame>(info.Env());
+    if (!CheckNotOpened(env, "packetArena"))
+        return;
+
+    packetArena.reset();
+    packetArenaReference.Reset();
+
+    if (value.IsNull() || value.IsUndefined())
+        return;
     
-    int result = avcodec_receive_frame(GetHandle(), frame->GetHandle());
-    if (result < 0)
-        return nlav_throw(info.Env(), result, "avcodec_receive_frame");
+    if (!av_codec_is_encoder(GetHandle()->codec)) {
+        Napi::Error::New(env, "Only encoders can write packets to a packetArena").ThrowAsJavaScriptException();
+        return;
+    }
 
-    return frame->Value();
+    if (!value.IsTypedArray() || value.As<Napi::TypedArray>().TypedArrayType() != napi_uint8_array) {
+        Napi::TypeError::New(env, "packetArena must be a Uint8Array").ThrowAsJavaScriptException();
+        return;
+    }
+
+    auto array = value.As<Napi::Uint8Array>();
+
+    if (!NAVPacketArena::IsValid(array.Data(), array.ByteLength())) {
+        Napi::Error::New(env, 
+            "packetArena must start at a multiple of 8 bytes, and be at least " 
+            + std::to_string(NLAV_ARENA_CONTROL_SIZE + 2 * NLAV_ARENA_HEADER_SIZE) + " bytes long"
+        ).ThrowAsJavaScriptException();
+        return;
+    }
+
+    packetArena = std::make_shared<NAVPacketArena>(array.Data(), array.ByteLength());
+    packetArenaReference = Napi::Persistent(value.As<Napi::Object>());
 }
 
-Napi::Value NAVCodecContext::SendFrame(const Napi::CallbackInfo& info) {
-    NAVFrame *frame = NAVFrame::Unwrap(info[0].As<Napi::Object>());
-    std::unique_lock<std::mutex> lock(mutex);
-    WorkItem item;
+Napi::Value NAVCodecContext::GetBatchSize(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), batchSize.load());
+}
 
-    item.frame = frame->GetHandle();
-    inQueue.push_back(item);
+void NAVCodecContext::SetBatchSize(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    int64_t size = value.As<Napi::Number>().Int64Value();
 
-    threadWake.notify_one();
-    return Napi::Boolean::New(info.Env(), true);
+    if (size < 1) {
+        Napi::RangeError::New(info.Env(), "batchSize must be at least 1").ThrowAsJavaScriptException();
+        return;
+    }
+
+    batchSize = size;
+    Wake();
 }
 
-Napi::Value NAVCodecContext::ReceivePacket(const Napi::CallbackInfo& info) {
-    NAVPacket *packet;
+Napi::Value NAVCodecContext::GetMaxBatchLatencyUs(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), maxBatchLatencyUs.load());
+}
 
-    if (info.Length() > 0)
-        packet = NAVPacket::Unwrap(info[0].As<Napi::Object>());
-    else
-        packet = LibAvAddon::Construct<NAVPacket>(info.Env());
-    
-    int result = avcodec_receive_packet(GetHandle(), packet->GetHandle());
-    if (result < 0)
-        return nlav_throw(info.Env(), result, "avcodec_receive_packet");
+void NAVCodecContext::SetMaxBatchLatencyUs(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    int64_t latency = value.As<Napi::Number>().Int64Value();
 
-    return packet->Value();
+    if (latency < 0) {
+        Napi::RangeError::New(info.Env(), "maxBatchLatencyUs cannot be negative").ThrowAsJavaScriptException();
+        return;
+    }
+
+    maxBatchLatencyUs = latency;
+    Wake();
 }
 
 Napi::Value NAVCodecContext::GetOnFrame(const Napi::CallbackInfo& info) {
@@ -336,13 +2017,13 @@ Napi::Value NAVCodecContext::GetOnFrame(const Napi::CallbackInfo& info) {
 }
 
 void NAVCodecContext::SetOnFrame(const Napi::CallbackInfo& info, const Napi::Value &value) {
-    auto func = info[0].As<Napi::Function>();
+    auto func = value.As<Napi::Function>();
 
     if (func != info.Env().Null() && func != info.Env().Undefined()) {
         onFrame = Napi::Persistent(func);
         onFrameTSFN = Napi::ThreadSafeFunction::New(info.Env(), func, "AVContext#onFrame", 0, 1);
         onFrameValid = true;
-        threadWake.notify_one();
+        Wake();
     } else {
         if (!onFrame.IsEmpty())
             onFrame.Unref();
@@ -357,13 +2038,13 @@ Napi::Value NAVCodecContext::GetOnPacket(const Napi::CallbackInfo& info) {
 }
 
 void NAVCodecContext::SetOnPacket(const Napi::CallbackInfo& info, const Napi::Value &value) {
-    auto func = info[0].As<Napi::Function>();
+    auto func = value.As<Napi::Function>();
 
     if (func != info.Env().Null() && func != info.Env().Undefined()) {
         onPacket = Napi::Persistent(func);
         onPacketTSFN = Napi::ThreadSafeFunction::New(info.Env(), func, "AVContext#onPacket", 0, 1);
         onPacketValid = true;
-        threadWake.notify_one();
+        Wake();
     } else {
         if (!onPacket.IsEmpty())
             onPacket.Unref();
@@ -378,7 +2059,7 @@ Napi::Value NAVCodecContext::GetOnError(const Napi::CallbackInfo& info) {
 }
 
 void NAVCodecContext::SetOnError(const Napi::CallbackInfo& info, const Napi::Value &value) {
-    auto func = info[0].As<Napi::Function>();
+    auto func = value.As<Napi::Function>();
 
     if (func != info.Env().Null() && func != info.Env().Undefined()) {
         onError = Napi::Persistent(func);
@@ -393,6 +2074,38 @@ void NAVCodecContext::SetOnError(const Napi::CallbackInfo& info, const Napi::Val
     }
 }
 
+Napi::Value NAVCodecContext::GetOnDrain(const Napi::CallbackInfo& info) {
+    return onDrain.Value();
+}
+
+void NAVCodecContext::SetOnDrain(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    auto func = value.As<Napi::Function>();
+
+    if (func != info.Env().Null() && func != info.Env().Undefined()) {
+        onDrain = Napi::Persistent(func);
+        onDrainValid = true;
+    } else {
+        if (!onDrain.IsEmpty())
+            onDrain.Unref();
+        onDrain = Napi::FunctionReference();
+        onDrainValid = false;
+    }
+}
+
+
+Napi::Value NAVCodecContext::GetOnEnd(const Napi::CallbackInfo& info) {
+    return onEnd.Value();
+}
+
+void NAVCodecContext::SetOnEnd(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (value.IsFunction()) {
+        onEnd = Napi::Persistent(value.As<Napi::Function>());
+    } else {
+        if (!onEnd.IsEmpty())
+            onEnd.Unref();
+        onEnd = Napi::FunctionReference();
+    }
+}
 
 Napi::Value NAVCodecContext::GetClass(const Napi::CallbackInfo& info) {
     return NAVClass::FromHandleWrapped(info.Env(), (AVClass*)GetHandle()->av_class, false);
@@ -476,10 +2189,10 @@ void NAVCodecContext::SetExtraData(const Napi::CallbackInfo& info, const Napi::V
 
     Napi::ArrayBuffer buffer;
 
-    if (info[0].IsTypedArray()) {
-        buffer = info[0].As<Napi::TypedArray>().ArrayBuffer();
-    } else if (info[0].IsArrayBuffer()) {
-        buffer = info[0].As<Napi::ArrayBuffer>();
+    if (value.IsTypedArray()) {
+        buffer = value.As<Napi::TypedArray>().ArrayBuffer();
+    } else if (value.IsArrayBuffer()) {
+        buffer = value.As<Napi::ArrayBuffer>();
     } else {
         Napi::TypeError::New(info.Env(), "extraData must be set to a TypedArray or an ArrayBuffer.").ThrowAsJavaScriptException();
         return;
@@ -490,6 +2203,7 @@ void NAVCodecContext::SetExtraData(const Napi::CallbackInfo& info, const Napi::V
     
     GetHandle()->extradata = extra;
     GetHandle()->extradata_size = size;
+    UpdateExternalMemory(info.Env());
 }
 
 void NAVCodecContext::SetTimeBase(const Napi::CallbackInfo& info, const Napi::Value& value) {
@@ -1069,12 +2783,34 @@ Napi::Value NAVCodecContext::GetErrorRecognitionFlags(const Napi::CallbackInfo&
     return Napi::Number::New(info.Env(), GetHandle()->err_recognition);
 }
 
+void NAVCodecContext::SetThreadCount(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    if (CheckNotOpened(info.Env(), "threadCount"))
+        GetHandle()->thread_count = value.As<Napi::Number>().Int32Value();
+}
+
+Napi::Value NAVCodecContext::GetThreadCount(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->thread_count);
+}
+
+void NAVCodecContext::SetThreadType(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    if (CheckNotOpened(info.Env(), "threadType"))
+        GetHandle()->thread_type = value.As<Napi::Number>().Int32Value();
+}
+
+Napi::Value NAVCodecContext::GetThreadType(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->thread_type);
+}
+
+Napi::Value NAVCodecContext::GetActiveThreadType(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->active_thread_type);
+}
+
 
 Napi::Value NAVCodecContext::GetChannelLayout(const Napi::CallbackInfo& info) {
     return Napi::Number::New(info.Env(), GetHandle()->channel_layout);
 }
 
 void NAVCodecContext::SetChannelLayout(const Napi::CallbackInfo& info, const Napi::Value& value) {
-    auto layout = info[0].As<Napi::Number>().Int32Value();
+    auto layout = value.As<Napi::Number>().Int32Value();
     GetHandle()->channel_layout = layout;
 }
\ No newline at end of file
@@ -2,34 +2,161 @@
 
 #include <napi.h>
 #include "../resource.h"
+#include "../spsc-queue.h"
+#include "../handle-pool.h"
+#include "../scheduler.h"
+#include "../latency-histogram.h"
+#include "frame-buffer-pool.h"
+#include "packet-arena.h"
+#include <memory>
 #include <thread>
-#include <queue>
+#include <deque>
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <chrono>
+#include <vector>
 
 extern "C" {
     #include <libavcodec/avcodec.h>
 }
 
+class NAVFormatContext;
+struct NAVResamplerState;
+struct NAVFrameStatisticsOptions;
+
 struct WorkItem {
-    AVPacket *packet;
-    AVFrame *frame;
+    AVPacket *packet = nullptr;
+    AVFrame *frame = nullptr;
+
+    /**
+     * The packet/frame is a reference of our own, from a send (see NAVCodecContext::GetInputItem()) or 
+     * an attached producer (see NAVCodecContext::PushFromProducer()), and is freed by the codec thread 
+     * once it has been sent.
+     */
+    bool owned = false;
+
+    /**
+     * End of stream: the codec is drained (see flush()), and the end is passed along our routes.
+     * Without a frame/packet.
+     */
+    bool endOfStream = false;
+
+    /**
+     * The end of stream was queued by flush(), whose promise is resolved once the codec is drained.
+     */
+    bool resolvesFlush = false;
+
+    /**
+     * When the item went into the work queue (see NAVCodecContextStats::queueWait)
+     */
+    std::chrono::steady_clock::time_point queued;
 };
 
-class NAVCodecContext : public NAVResource<NAVCodecContext, AVCodecContext> {
+/**
+ * Hot path measurements of a codec context (see getStats()). Always on: recording a sample is a few
+ * relaxed atomic increments. Shared with the calls posted to the JS thread, which may outlive us.
+ */
+struct NAVCodecContextStats {
+    NAVCodecContextStats():
+        sendEagain(0),
+        receiveEagain(0),
+        errors(0)
+    {
+    }
+
+    // From entering the work queue to having been sent to the codec
+    NAVLatencyHistogram queueWait;
+
+    // avcodec_send_frame()/avcodec_send_packet() and avcodec_receive_frame()/avcodec_receive_packet() 
+    // calls which took or gave a frame/packet
+    NAVLatencyHistogram send;
+    NAVLatencyHistogram receive;
+
+    // From posting output to the JS thread to onFrame/onPacket being called (see batchSize)
+    NAVLatencyHistogram delivery;
+
+    std::atomic<uint64_t> sendEagain;
+    std::atomic<uint64_t> receiveEagain;
+    std::atomic<uint64_t> errors;
+};
+
+/**
+ * A send which is waiting for room in the work queue (see sendFrameAsync/sendPacketAsync)
+ */
+struct PendingSend {
+    WorkItem item;
+    Napi::Promise::Deferred deferred;
+};
+
+/**
+ * Default for maxQueuedItems: number of frames/packets which can be queued for the codec thread 
+ * before sendFrame()/sendPacket() start refusing new items.
+ */
+#define NLAV_DEFAULT_QUEUE_CAPACITY 128
+
+/**
+ * Number of feed/pull rounds a codec context does each time it runs on the shared thread pool before
+ * it gives the worker to the next context (see useThreadPool).
+ */
+#define NLAV_SCHEDULED_STEPS 8
+
+/**
+ * Most threads fairThreadCount gives a codec, like libavcodec's own limit when it picks the thread 
+ * count itself (MAX_AUTO_THREADS).
+ */
+#define NLAV_MAX_FAIR_THREADS 16
+
+class NAVCodecContext : public NAVResource<NAVCodecContext, AVCodecContext>, public NAVScheduledTask {
+    friend class NAVCodecOpenWorker;
+
     public:
         NAVCodecContext(const Napi::CallbackInfo& info);
         
         inline static std::string ExportName() { return "AVCodecContext"; }
         inline static Napi::Function ClassDefinition(const Napi::Env &env) {
             return DefineClass(env, "AVCodecContext", {
+                StaticMethod("configureThreadPool", &NAVCodecContext::ConfigureThreadPool),
+                StaticMethod("threadPoolStats", &NAVCodecContext::ThreadPoolStats),
+                StaticMethod("configureFairThreads", &NAVCodecContext::ConfigureFairThreads),
+
                 R_ACCESSOR("onFrame", &NAVCodecContext::GetOnFrame, &NAVCodecContext::SetOnFrame),
                 R_ACCESSOR("onPacket", &NAVCodecContext::GetOnPacket, &NAVCodecContext::SetOnPacket),
                 R_ACCESSOR("onError", &NAVCodecContext::GetOnError, &NAVCodecContext::SetOnError),
+                R_ACCESSOR("onDrain", &NAVCodecContext::GetOnDrain, &NAVCodecContext::SetOnDrain),
+                R_ACCESSOR("onEnd", &NAVCodecContext::GetOnEnd, &NAVCodecContext::SetOnEnd),
 
                 R_METHOD("open", &NAVCodecContext::Open),
+                R_METHOD("openAsync", &NAVCodecContext::OpenAsync),
+                R_METHOD("flush", &NAVCodecContext::Flush),
+                R_METHOD("configure", &NAVCodecContext::Configure),
                 R_METHOD("sendPacket", &NAVCodecContext::SendPacket),
                 R_METHOD("sendFrame", &NAVCodecContext::SendFrame),
+                R_METHOD("sendPacketAsync", &NAVCodecContext::SendPacketAsync),
+                R_METHOD("sendFrameAsync", &NAVCodecContext::SendFrameAsync),
+                R_METHOD("routeFrames", &NAVCodecContext::RouteFrames),
+                R_METHOD("routePackets", &NAVCodecContext::RoutePackets),
+                R_METHOD("getStats", &NAVCodecContext::GetStats),
+
+                R_GETTER("queueDepth", &NAVCodecContext::GetQueueDepth),
+                R_GETTER("queueHighWaterMark", &NAVCodecContext::GetQueueHighWaterMark),
+                R_ACCESSOR("maxQueuedItems", &NAVCodecContext::GetMaxQueuedItems, &NAVCodecContext::SetMaxQueuedItems),
+                R_ACCESSOR("queueLowWaterMark", &NAVCodecContext::GetQueueLowWaterMark, &NAVCodecContext::SetQueueLowWaterMark),
+                R_GETTER("poolStats", &NAVCodecContext::GetPoolStats),
+                R_GETTER("routedItems", &NAVCodecContext::GetRoutedItems),
+                R_ACCESSOR("batchSize", &NAVCodecContext::GetBatchSize, &NAVCodecContext::SetBatchSize),
+                R_ACCESSOR("maxBatchLatencyUs", &NAVCodecContext::GetMaxBatchLatencyUs, &NAVCodecContext::SetMaxBatchLatencyUs),
+                R_ACCESSOR("useThreadPool", &NAVCodecContext::GetUseThreadPool, &NAVCodecContext::SetUseThreadPool),
+                R_ACCESSOR("fairThreadCount", &NAVCodecContext::GetFairThreadCount, &NAVCodecContext::SetFairThreadCount),
+                R_ACCESSOR("bufferPoolSize", &NAVCodecContext::GetBufferPoolSize, &NAVCodecContext::SetBufferPoolSize),
+                R_ACCESSOR("bufferPoolPrewarm", &NAVCodecContext::GetBufferPoolPrewarm, &NAVCodecContext::SetBufferPoolPrewarm),
+                R_ACCESSOR("bufferPoolSharedMemory", &NAVCodecContext::GetBufferPoolSharedMemory, &NAVCodecContext::SetBufferPoolSharedMemory),
+                R_ACCESSOR("hwDeviceContext", &NAVCodecContext::GetHwDeviceContext, &NAVCodecContext::SetHwDeviceContext),
+                R_ACCESSOR("hwFramesContext", &NAVCodecContext::GetHwFramesContext, &NAVCodecContext::SetHwFramesContext),
+                R_GETTER("hwPixelFormat", &NAVCodecContext::GetHwPixelFormat),
+                R_ACCESSOR("resampler", &NAVCodecContext::GetResampler, &NAVCodecContext::SetResampler),
+                R_ACCESSOR("frameStatistics", &NAVCodecContext::GetFrameStatistics, &NAVCodecContext::SetFrameStatistics),
+                R_ACCESSOR("packetArena", &NAVCodecContext::GetPacketArena, &NAVCodecContext::SetPacketArena),
 
                 R_GETTER("class", &NAVCodecContext::GetClass),
                 R_GETTER("codecType", &NAVCodecContext::GetCodecType),
@@ -114,63 +241,298 @@ class NAVCodecContext : public NAVResource<NAVCodecContext, AVCodecContext> {
                 R_ACCESSOR("rateControlInitialBufferOccupancy", &NAVCodecContext::GetRateControlInitialBufferOccupancy, &NAVCodecContext::SetRateControlInitialBufferOccupancy),
                 R_ACCESSOR("trellis", &NAVCodecContext::GetTrellis, &NAVCodecContext::SetTrellis),
                 R_ACCESSOR("workaroundBugs", &NAVCodecContext::GetWorkaroundBugs, &NAVCodecContext::SetWorkaroundBugs),
-                R_ACCESSOR("errorRecognitionFlags", &NAVCodecContext::GetErrorRecognitionFlags, &NAVCodecContext::SetErrorRecognitionFlags)
+                R_ACCESSOR("errorRecognitionFlags", &NAVCodecContext::GetErrorRecognitionFlags, &NAVCodecContext::SetErrorRecognitionFlags),
+                R_ACCESSOR("threadCount", &NAVCodecContext::GetThreadCount, &NAVCodecContext::SetThreadCount),
+                R_ACCESSOR("threadType", &NAVCodecContext::GetThreadType, &NAVCodecContext::SetThreadType),
+                R_GETTER("activeThreadType", &NAVCodecContext::GetActiveThreadType)
             });
         }
 
         virtual void Free();
+        virtual size_t GetExternalMemorySize();
+        virtual bool CheckDisposable(const Napi::Env &env);
 
         void ThreadMain();
+        virtual bool RunScheduled();
+
+        /**
+         * Let another native thread (the read thread of an AVFormatContext, or a decoder's codec thread) 
+         * feed packets/frames to this context instead of Javascript. While a producer is attached sendPacket()/sendFrame() throw, as the work 
+         * queue has room for a single producer only. Returns false if a producer is already attached. 
+         * A producing codec context is woken whenever there is room in the queue again. JS thread only.
+         */
+        bool AttachProducer(NAVCodecContext *producerContext = nullptr);
+        void DetachProducer();
+
+        /**
+         * Producer thread only. Queue a packet for the codec thread, which frees it once it has been sent, 
+         * waiting for room in the queue if necessary. Returns false (and does not take the packet) if the 
+         * context is shutting down or `cancelled` became true while waiting.
+         */
+        bool PushFromProducer(AVPacket *packet, const std::atomic<bool> &cancelled);
+
+        /**
+         * Producer thread only. Queue a frame for the codec thread, which frees it once it has been sent.
+         * Returns false (and does not take the frame) if there is no room in the queue or the context is 
+         * shutting down. Never waits, as the producer may be sharing a pool worker with us. A frame with
+         * a time base gets its timestamps in our time base, checked under producerMutex so that we cannot
+         * be freed meanwhile.
+         */
+        bool TryPushFromProducer(AVFrame *frame);
+
+        /**
+         * Producer thread only. Queue the end of the stream, waiting for room like PushFromProducer().
+         */
+        bool PushEndOfStreamFromProducer(const std::atomic<bool> &cancelled);
+
+        /**
+         * Wake a producer waiting in PushFromProducer() so that it sees that it was cancelled, or a 
+         * producing codec context so that it retries its pushes. Any thread.
+         */
+        void WakeProducer();
 
     private:
+        bool Step();
         bool FeedToCodec();
         bool PullFromDecoder(AVCodecContext *context);
         bool PullFromEncoder(AVCodecContext *context);
+        bool PushItemFromProducer(WorkItem item, const std::atomic<bool> &cancelled);
+
+        // Native routes (see routeFrames()/routePackets())
+
+        bool CheckRoutable(const Napi::Env &env);
+        void RouteFrame(AVFrame *frame);
+        bool FlushRouteBacklog();
+        void RoutePacket(AVPacket *packet);
+        AVFrame *ResampleFrame(AVFrame *frame);
+        void ComputeFrameStatistics(AVFrame *frame);
+        void WriteToArena(AVPacket *packet);
+
+        // End of stream (see flush())
+
+        void OnCodecDrained();
+        void OnEnded(Napi::Env env, bool resolvesFlush);
         
         // Threading infrastructure
 
+        int OpenCodec(AVDictionary **options);
+        int TakeFairThreadCount();
+        void PrepareThread(const Napi::Env &env);
+        void StartThread();
+        bool CheckNoProducer(const Napi::Env &env);
+        bool GetInputItem(const Napi::CallbackInfo& info, WorkItem &item, bool frame);
+        static void FreeWorkItem(WorkItem &item);
+        bool CheckNotOpened(const Napi::Env &env, std::string property);
+        bool EnqueueWork(WorkItem item);
+        Napi::Value EnqueueWorkAsync(const Napi::Env &env, WorkItem item);
+        void PopWorkItem();
         void WaitForWork();
+        void Wake();
+        size_t GetEffectiveLowWaterMark();
+
+        // Backpressure (see PopWorkItem() and OnQueueDrained())
+
+        void RequestDrain(const Napi::Env &env);
+        void OnQueueDrained(Napi::Env env);
+
+        // Batched delivery (see batchSize)
+
+        void DeliverFrame(AVFrame *frame);
+        void DeliverPacket(AVPacket *packet);
+        void FlushBatches(bool force);
+        bool HasPendingBatch();
+        bool HasDeliverableBatch();
+        std::chrono::steady_clock::time_point BatchDeadline();
+
         AVFrame *GetPoolFrame();
         void FreePoolFrame(AVFrame *frame);
         AVPacket *GetPoolPacket();
-        void FreePoolPacket(AVPacket *frame);
+        void FreePoolPacket(AVPacket *packet);
+        static Napi::Value WrapPoolFrame(const Napi::Env &env, std::shared_ptr<NAVFramePool> pool, AVFrame *frame);
+        static Napi::Value WrapPoolPacket(const Napi::Env &env, std::shared_ptr<NAVPacketPool> pool, AVPacket *packet);
+        static AVPixelFormat GetHardwareFormat(AVCodecContext *context, const AVPixelFormat *formats);
+        static int GetBuffer(AVCodecContext *context, AVFrame *frame, int flags);
         void SendError(std::string code, std::string message);
-        void ThreadLog(std::string message);
 
         bool opened = false;
-        bool threadTracing = false;
-        std::queue<AVFrame*> framePool;
-        std::queue<AVPacket*> packetPool;
+        std::mutex openMutex;
+
+        // While openAsync() runs, during which we cannot be disposed of (see CheckDisposable()). JS thread only.
+        bool opening = false;
 
-        uint32_t framePoolHeight = 0;
-        uint32_t packetPoolHeight = 0;
+        // See fairThreadCount. Counted while we are open with a thread count of our own.
+        bool fairThreadCount = false;
+        bool fairThreadCounted = false;
+        bool isEncoder = false;
+        bool isDecoder = false;
+
+        // Decoders: where get_buffer2 takes the planes of decoded frames from (see bufferPoolSize). 
+        // A bufferPoolPrewarm of -1 warms up the whole pool.
+        int bufferPoolSize = 0;
+        int bufferPoolPrewarm = -1;
+        bool bufferPoolSharedMemory = false;
+        std::shared_ptr<NAVFrameBufferPool> bufferPool;
         
         std::thread *thread = nullptr;
+        bool useThreadPool = false;
+        std::atomic<NAVScheduler*> scheduler;
+
+        // Hardware acceleration (see hwDeviceContext). A decoder hands hwFramesRef to libavcodec from 
+        // get_format, an encoder is given it directly.
+        AVPixelFormat hwPixelFormat = AV_PIX_FMT_NONE;
+        AVBufferRef *hwFramesRef = nullptr;
+
+        // Decoders: converts decoded audio before it is delivered or routed (see resampler)
+        std::shared_ptr<NAVResamplerState> resampler;
+        Napi::ObjectReference resamplerReference;
+
+        // Decoders: statistics attached to the metadata of decoded frames (see frameStatistics), and the
+        // last decoded video frame for frozen frame detection (codec thread only)
+        std::shared_ptr<NAVFrameStatisticsOptions> frameStatistics;
+        AVFrame *statisticsPrevious = nullptr;
+
+        // Encoders: the memory packets are written into instead of going to onPacket (see packetArena)
+        std::shared_ptr<NAVPacketArena> packetArena;
+        Napi::ObjectReference packetArenaReference;
+
         std::mutex mutex;
         std::condition_variable threadWake;
-        std::deque<WorkItem> inQueue;
-        std::queue<WorkItem> outQueue;
-        bool running = true;
+        std::atomic<bool> threadWaiting;
+        std::atomic<bool> wakePending;
+        SPSCQueue<WorkItem> inQueue;
+        bool codecStalled = false;
+        std::atomic<bool> running;
+
+        std::atomic<bool> producerAttached;
+        std::mutex producerMutex;
+        std::condition_variable producerWake;
+        NAVCodecContext *producerContext = nullptr;
+
+        // Where our output goes besides onFrame/onPacket. Only changed before open().
+        std::vector<NAVCodecContext*> frameRoutes;
+        NAVFormatContext *packetRoute = nullptr;
+        int packetRouteStream = -1;
+        std::vector<Napi::ObjectReference> routeReferences;
+
+        // Codec thread only: routed frames for which the encoder had no room yet, in order
+        std::deque<std::pair<NAVCodecContext*, AVFrame*>> routeBacklog;
+        std::atomic<bool> stopping;
+        std::atomic<int64_t> routedItems;
+
+        // Codec thread only: an end of stream was sent to the codec, which is being drained
+        bool endOfStream = false;
+        bool endResolvesFlush = false;
+
+        // Promises of flush(), in order. JS thread only.
+        std::deque<Napi::Promise::Deferred> flushDeferreds;
+
+        // Cleared by Free(). Calls posted to the JS thread which may outlive us check it first.
+        std::shared_ptr<bool> alive;
+
+        // Shared with the NAVFrame/NAVPacket instances we hand out, which may outlive us
+        std::shared_ptr<NAVFramePool> framePool;
+        std::shared_ptr<NAVPacketPool> packetPool;
+        std::shared_ptr<NAVCodecContextStats> stats;
+
+        size_t maxQueuedItems = NLAV_DEFAULT_QUEUE_CAPACITY;
+        int64_t queueLowWaterMark = -1;
+        std::atomic<size_t> effectiveLowWaterMark;
+        std::atomic<bool> drainRequested;
+        bool drainArmed = false;
+        bool drainNotify = false;
+        std::deque<PendingSend> pendingSends;
+        Napi::ThreadSafeFunction onDrainTSFN;
+
+        std::atomic<uint32_t> batchSize;
+        std::atomic<int64_t> maxBatchLatencyUs;
+        std::vector<AVFrame*> frameBatch;
+        std::vector<AVPacket*> packetBatch;
+        std::chrono::steady_clock::time_point batchStarted;
 
         Napi::FunctionReference onFrame;
         Napi::FunctionReference onPacket;
         Napi::FunctionReference onError;
+        Napi::FunctionReference onDrain;
+        Napi::FunctionReference onEnd;
 
         bool onFrameValid = false;
         bool onPacketValid = false; 
         bool onErrorValid = false;
+        bool onDrainValid = false;
 
         Napi::ThreadSafeFunction onFrameTSFN;
         Napi::ThreadSafeFunction onPacketTSFN;
         Napi::ThreadSafeFunction onErrorTSFN;
 
+        // Signals the end of stream when there is no onFrame/onPacket to send it along with
+        Napi::ThreadSafeFunction onEndTSFN;
+
         // Functional
 
         Napi::Value Open(const Napi::CallbackInfo& info);
+        Napi::Value OpenAsync(const Napi::CallbackInfo& info);
+        Napi::Value Flush(const Napi::CallbackInfo& info);
+        Napi::Value Configure(const Napi::CallbackInfo& info);
         Napi::Value SendPacket(const Napi::CallbackInfo& info);
         Napi::Value ReceiveFrame(const Napi::CallbackInfo& info);
         Napi::Value SendFrame(const Napi::CallbackInfo& info);
         Napi::Value ReceivePacket(const Napi::CallbackInfo& info);
+        Napi::Value SendPacketAsync(const Napi::CallbackInfo& info);
+        Napi::Value SendFrameAsync(const Napi::CallbackInfo& info);
+        Napi::Value RouteFrames(const Napi::CallbackInfo& info);
+        Napi::Value RoutePackets(const Napi::CallbackInfo& info);
+
+        // Thread pool
+
+        static Napi::Value ConfigureThreadPool(const Napi::CallbackInfo& info);
+        static Napi::Value ConfigureFairThreads(const Napi::CallbackInfo& info);
+        static Napi::Value ThreadPoolStats(const Napi::CallbackInfo& info);
+        Napi::Value GetUseThreadPool(const Napi::CallbackInfo& info);
+        void SetUseThreadPool(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetFairThreadCount(const Napi::CallbackInfo& info);
+        void SetFairThreadCount(const Napi::CallbackInfo& info, const Napi::Value &value);
+
+        // Frame buffer pools
+
+        Napi::Value GetBufferPoolSize(const Napi::CallbackInfo& info);
+        void SetBufferPoolSize(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetBufferPoolPrewarm(const Napi::CallbackInfo& info);
+        void SetBufferPoolPrewarm(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetBufferPoolSharedMemory(const Napi::CallbackInfo& info);
+        void SetBufferPoolSharedMemory(const Napi::CallbackInfo& info, const Napi::Value &value);
+
+        // Hardware acceleration
+
+        Napi::Value GetHwDeviceContext(const Napi::CallbackInfo& info);
+        void SetHwDeviceContext(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetHwFramesContext(const Napi::CallbackInfo& info);
+        void SetHwFramesContext(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetHwPixelFormat(const Napi::CallbackInfo& info);
+        Napi::Value GetResampler(const Napi::CallbackInfo& info);
+        void SetResampler(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetFrameStatistics(const Napi::CallbackInfo& info);
+        void SetFrameStatistics(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetPacketArena(const Napi::CallbackInfo& info);
+        void SetPacketArena(const Napi::CallbackInfo& info, const Napi::Value &value);
+
+        // Queue statistics
+
+        Napi::Value GetQueueDepth(const Napi::CallbackInfo& info);
+        Napi::Value GetQueueHighWaterMark(const Napi::CallbackInfo& info);
+        Napi::Value GetMaxQueuedItems(const Napi::CallbackInfo& info);
+        void SetMaxQueuedItems(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetQueueLowWaterMark(const Napi::CallbackInfo& info);
+        void SetQueueLowWaterMark(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetPoolStats(const Napi::CallbackInfo& info);
+        Napi::Value GetRoutedItems(const Napi::CallbackInfo& info);
+        Napi::Value GetStats(const Napi::CallbackInfo& info);
+
+        // Batching
+
+        Napi::Value GetBatchSize(const Napi::CallbackInfo& info);
+        void SetBatchSize(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetMaxBatchLatencyUs(const Napi::CallbackInfo& info);
+        void SetMaxBatchLatencyUs(const Napi::CallbackInfo& info, const Napi::Value &value);
 
         // Events
 
@@ -180,6 +542,10 @@ class NAVCodecContext : public NAVResource<NAVCodecContext, AVCodecContext> {
         void SetOnPacket(const Napi::CallbackInfo& info, const Napi::Value &value);
         Napi::Value GetOnError(const Napi::CallbackInfo& info);
         void SetOnError(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetOnDrain(const Napi::CallbackInfo& info);
+        void SetOnDrain(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetOnEnd(const Napi::CallbackInfo& info);
+        void SetOnEnd(const Napi::CallbackInfo& info, const Napi::Value &value);
 
         // Properties
         Napi::Value GetClass(const Napi::CallbackInfo& info);
@@ -346,6 +712,11 @@ class NAVCodecContext : public NAVResource<NAVCodecContext, AVCodecContext> {
         void SetWorkaroundBugs(const Napi::CallbackInfo& info, const Napi::Value& value);
         Napi::Value GetErrorRecognitionFlags(const Napi::CallbackInfo& info);
         void SetErrorRecognitionFlags(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetThreadCount(const Napi::CallbackInfo& info);
+        void SetThreadCount(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetThreadType(const Napi::CallbackInfo& info);
+        void SetThreadType(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetActiveThreadType(const Napi::CallbackInfo& info);
 
         Napi::Value GetChannelLayout(const Napi::CallbackInfo& info);
         void SetChannelLayout(const Napi::CallbackInfo& info, const Napi::Value& value);
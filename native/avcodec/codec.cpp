@@ -16,6 +16,12 @@ void NAVCodec::Free() {
     // Do nothing. We never own codecs.
 }
 
+bool NAVCodec::CheckDisposable(const Napi::Env &env) {
+    // There is nothing to free, and disposing of the instance would break it for everyone else getting 
+    // it from findDecoder() & co.
+    return false;
+}
+
 Napi::Value NAVCodec::GetVersion(const Napi::CallbackInfo& info) {
     return Napi::Number::New(info.Env(), avcodec_version());
 }
@@ -29,51 +35,66 @@ Napi::Value NAVCodec::GetLicense(const Napi::CallbackInfo& info) {
 }
 
 
+/**
+ * Codecs and the lists describing them never change, so the arrays are built once per env (see 
+ * LibAvAddon::GetCached()). They are frozen, as every caller gets the same one.
+ */
+static Napi::Value nlavc_cached_array(const Napi::Env &env, const void *handle, const char *key, const std::function<Napi::Array()> &build) {
+    return LibAvAddon::Self(env)->GetCached(handle, key, [&]() {
+        auto array = build();
+        array.Freeze();
+        return (Napi::Value)array;
+    });
+}
+
 Napi::Value NAVCodec::All(const Napi::CallbackInfo& info) {
-    void *iter = nullptr;
-    std::vector<Napi::Value> vec;
+    return nlavc_cached_array(info.Env(), nullptr, "codecs", [&]() {
+        void *iter = nullptr;
+        std::vector<Napi::Value> vec;
 
-    while (auto codec = av_codec_iterate(&iter)) {
-        vec.push_back(NAVCodec::FromHandleWrapped(info.Env(), (AVCodec*)codec, false));
-    }
+        while (auto codec = av_codec_iterate(&iter)) {
+            vec.push_back(NAVCodec::FromHandleWrapped(info.Env(), (AVCodec*)codec, false));
+        }
 
-    return VectorToArray(info.Env(), vec);
+        return VectorToArray(info.Env(), vec);
+    });
 }
 
-Napi::Value NAVCodec::FindDecoder(const Napi::CallbackInfo& info) {
-    if (info[0].IsString()) {
-        return NAVCodec::FromHandleWrapped(
-            info.Env(),
-            (AVCodec*)avcodec_find_decoder_by_name(info[0].ToString().Utf8Value().c_str()),
-            false
-        );
-    } else if (info[0].IsNumber()) {
-        return NAVCodec::FromHandleWrapped(
-            info.Env(),
-            (AVCodec*)avcodec_find_decoder((AVCodecID)info[0].ToNumber().Int32Value()),
-            false
-        );
-    }
+/**
+ * Look up a decoder/encoder by name or ID, remembering the result, as the lookups walk the list of all
+ * codecs comparing names. Codecs which are not found are not remembered.
+ */
+static Napi::Value nlavc_find_codec(const Napi::CallbackInfo& info, bool decoder) {
+    std::string key;
+
+    if (info[0].IsString())
+        key = std::string(decoder ? "decoder:" : "encoder:") + info[0].ToString().Utf8Value();
+    else if (info[0].IsNumber())
+        key = std::string(decoder ? "decoder#" : "encoder#") + std::to_string(info[0].ToNumber().Int32Value());
+    else
+        return info.Env().Undefined();
+
+    return LibAvAddon::Self(info.Env())->GetCached(nullptr, key.c_str(), [&]() {
+        const AVCodec *codec;
 
-    return info.Env().Undefined();
+        if (info[0].IsString()) {
+            auto name = info[0].ToString().Utf8Value();
+            codec = decoder ? avcodec_find_decoder_by_name(name.c_str()) : avcodec_find_encoder_by_name(name.c_str());
+        } else {
+            auto id = (AVCodecID)info[0].ToNumber().Int32Value();
+            codec = decoder ? avcodec_find_decoder(id) : avcodec_find_encoder(id);
+        }
+
+        return NAVCodec::FromHandleWrapped(info.Env(), (AVCodec*)codec, false);
+    });
 }
 
-Napi::Value NAVCodec::FindEncoder(const Napi::CallbackInfo& info) {
-    if (info[0].IsString()) {
-        return NAVCodec::FromHandleWrapped(
-            info.Env(),
-            (AVCodec*)avcodec_find_encoder_by_name(info[0].ToString().Utf8Value().c_str()),
-            false
-        );
-    } else if (info[0].IsNumber()) {
-        return NAVCodec::FromHandleWrapped(
-            info.Env(),
-            (AVCodec*)avcodec_find_encoder((AVCodecID)info[0].ToNumber().Int32Value()),
-            false
-        );
-    }
+Napi::Value NAVCodec::FindDecoder(const Napi::CallbackInfo& info) {
+    return nlavc_find_codec(info, true);
+}
 
-    return info.Env().Undefined();
+Napi::Value NAVCodec::FindEncoder(const Napi::CallbackInfo& info) {
+    return nlavc_find_codec(info, false);
 }
 
 Napi::Value NAVCodec::NewContext(const Napi::CallbackInfo& info) {
@@ -104,38 +125,60 @@ Napi::Value NAVCodec::GetDecoderMaxLowResolution(const Napi::CallbackInfo& info)
     return Napi::Number::New(info.Env(), GetHandle()->max_lowres);
 }
 
+// The lists below are null when the codec does not say, which is the same as an empty list here
+
 Napi::Value NAVCodec::GetSupportedFrameRates(const Napi::CallbackInfo& info) {
-    return NRationalArrayZeroTerminated(info.Env(), GetHandle()->supported_framerates);
+    return nlavc_cached_array(info.Env(), GetHandle(), "supportedFrameRates", [&]() {
+        if (!GetHandle()->supported_framerates)
+            return Napi::Array::New(info.Env());
+        
+        return NRationalArrayZeroTerminated(info.Env(), GetHandle()->supported_framerates);
+    });
 }
 
 Napi::Value NAVCodec::GetPixelFormats(const Napi::CallbackInfo& info) {
-    return VectorToArray(
-        info.Env(), 
-        Transform<int, Napi::Value>(
-            TerminatedArray((int*)GetHandle()->pix_fmts, -1),
-            WrapNumbers<int>(info.Env())
-        )
-    );
+    return nlavc_cached_array(info.Env(), GetHandle(), "pixelFormats", [&]() {
+        if (!GetHandle()->pix_fmts)
+            return Napi::Array::New(info.Env());
+        
+        return VectorToArray(
+            info.Env(), 
+            Transform<int, Napi::Value>(
+                TerminatedArray((int*)GetHandle()->pix_fmts, -1),
+                WrapNumbers<int>(info.Env())
+            )
+        );
+    });
 }
 
 Napi::Value NAVCodec::GetSupportedSampleRates(const Napi::CallbackInfo& info) {
-    return VectorToArray(
-        info.Env(), 
-        Transform<int, Napi::Value>(
-            TerminatedArray(GetHandle()->supported_samplerates, 0),
-            WrapNumbers<int>(info.Env())
-        )
-    );
+    return nlavc_cached_array(info.Env(), GetHandle(), "supportedSampleRates", [&]() {
+        if (!GetHandle()->supported_samplerates)
+            return Napi::Array::New(info.Env());
+        
+        return VectorToArray(
+            info.Env(), 
+            Transform<int, Napi::Value>(
+                TerminatedArray(GetHandle()->supported_samplerates, 0),
+                WrapNumbers<int>(info.Env())
+            )
+        );
+    });
 }
 
 Napi::Value NAVCodec::GetSampleFormats(const Napi::CallbackInfo& info) {
-    return VectorToArray(
-        info.Env(), 
-        Transform<AVSampleFormat, Napi::Value>(
-            TerminatedArray(GetHandle()->sample_fmts, (AVSampleFormat)-1),
-            WrapNumbers<AVSampleFormat>(info.Env())
-        )
-    );
+    return nlavc_cached_array(info.Env(), GetHandle(), "sampleFormats", [&]() {
+        if (!GetHandle()->sample_fmts)
+            return Napi::Array::New(info.Env());
+        
+        return VectorToArray(
+            info.Env(), 
+            Transform<AVSampleFormat, Napi::Value>(
+                TerminatedArray(GetHandle()->sample_fmts, (AVSampleFormat)-1),
+                WrapNumbers<AVSampleFormat>(info.Env())
+            )
+        );
+    });
 }
 
 Napi::Value NAVCodec::GetPrivateClass(const Napi::CallbackInfo& info) {
@@ -143,20 +186,22 @@ Napi::Value NAVCodec::GetPrivateClass(const Napi::CallbackInfo& info) {
 }
 
 Napi::Value NAVCodec::GetProfiles(const Napi::CallbackInfo& info) {
-    std::vector<const AVProfile*> vec;
-    const AVProfile *profiles = GetHandle()->profiles;
-    while (profiles->profile != FF_PROFILE_UNKNOWN)
-        vec.push_back(profiles++);
-    
-    return VectorToArray(
-        info.Env(),
-        Transform<const AVProfile*, Napi::Value>(
-            vec, 
-            [&](const AVProfile *profile) { 
-                return (Napi::Value)NAVProfile::FromHandleWrapped(info.Env(), (AVProfile*)profile, false); 
-            }
-        )
-    );
+    return nlavc_cached_array(info.Env(), GetHandle(), "profiles", [&]() {
+        std::vector<const AVProfile*> vec;
+        const AVProfile *profiles = GetHandle()->profiles;
+        while (profiles && profiles->profile != FF_PROFILE_UNKNOWN)
+            vec.push_back(profiles++);
+        
+        return VectorToArray(
+            info.Env(),
+            Transform<const AVProfile*, Napi::Value>(
+                vec, 
+                [&](const AVProfile *profile) { 
+                    return (Napi::Value)NAVProfile::FromHandleWrapped(info.Env(), (AVProfile*)profile, false); 
+                }
+            )
+        );
+    });
 }
 
 Napi::Value NAVCodec::GetWrapperName(const Napi::CallbackInfo& info) {
@@ -164,26 +209,31 @@ Napi::Value NAVCodec::GetWrapperName(const Napi::CallbackInfo& info) {
 }
 
 Napi::Value NAVCodec::GetChannelLayouts(const Napi::CallbackInfo& info) {
+    return nlavc_cached_array(info.Env(), GetHandle(), "channelLayouts", [&]() {
 #ifdef FFMPEG_5_1
-    std::vector <Napi::Value> vec;
-    auto layouts = GetHandle()->ch_layouts;
+        std::vector <Napi::Value> vec;
+        auto layouts = GetHandle()->ch_layouts;
 
-    while (layouts->order != 0 || layouts->nb_channels != 0) {
-        vec.push_back(NAVChannelLayout::FromHandle(info.Env(), (AVChannelLayout*)layouts++, false)->Value());
-    }
+        while (layouts && (layouts->order != 0 || layouts->nb_channels != 0)) {
+            vec.push_back(NAVChannelLayout::FromHandle(info.Env(), (AVChannelLayout*)layouts++, false)->Value());
+        }
 
-    return VectorToArray(info.Env(), vec);
+        return VectorToArray(info.Env(), vec);
 #else
-    return VectorToArray(
-        info.Env(),
-        Transform<uint64_t, Napi::Value>(
-            TerminatedArray<uint64_t>(GetHandle()->channel_layouts, 0),
-            [&](uint64_t value) {
-                return Napi::Number::New(info.Env(), value);
-            }
-        )
-    );
+        if (!GetHandle()->channel_layouts)
+            return Napi::Array::New(info.Env());
+        
+        return VectorToArray(
+            info.Env(),
+            Transform<uint64_t, Napi::Value>(
+                TerminatedArray<uint64_t>(GetHandle()->channel_layouts, 0),
+                [&](uint64_t value) {
+                    return Napi::Number::New(info.Env(), value);
+                }
+            )
+        );
 #endif
+    });
 }
 
 Napi::Value NAVCodec::GetIsEncoder(const Napi::CallbackInfo& info) {
@@ -48,6 +48,7 @@ class NAVCodec : public NAVResource<NAVCodec, AVCodec> {
         }
 
         virtual void Free();
+        virtual bool CheckDisposable(const Napi::Env &env);
     private:
         // libavcodec core
 
@@ -0,0 +1,223 @@
+#include "frame-buffer-pool.h"
+#include "../avutil/shared-memory.h"
+
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+    #include <libavutil/imgutils.h>
+    #include <libavutil/pixdesc.h>
+}
+
+/**
+ * What libavcodec allocates beyond the planes themselves: 16 bytes of overread padding, and room to 
+ * align the planes for SIMD (STRIDE_ALIGN, at most 64 with AVX-512).
+ */
+#define NLAV_FRAME_BUFFER_PADDING (16 + 64 - 1)
+
+/**
+ * The opaque of a plane pool, freed along with it once all of its buffers have been returned.
+ */
+struct NAVPlanePoolState {
+    int maxBuffers;
+    bool sharedMemory;
+    std::atomic<int> allocated;
+    std::shared_ptr<NAVFrameBufferPoolStats> stats;
+};
+
+static AVBufferRef *nlav_plane_pool_alloc(void *opaque, size_t size) {
+    auto state = (NAVPlanePoolState*)opaque;
+
+    // Capped: av_buffer_pool_get() fails, and the frame is allocated without the pool
+    if (state->allocated.fetch_add(1) >= state->maxBuffers) {
+        state->allocated.fetch_sub(1);
+        return nullptr;
+    }
+
+    auto buffer = state->sharedMemory ? nlav_shared_buffer_alloc(size) : av_buffer_alloc(size);
+    if (!buffer) {
+        state->allocated.fetch_sub(1);
+        return nullptr;
+    }
+
+    state->stats->allocations += 1;
+    return buffer;
+}
+
+static void nlav_plane_pool_free(void *opaque) {
+    delete (NAVPlanePoolState*)opaque;
+}
+
+NAVFrameBufferPool::NAVFrameBufferPool(int maxFrames, int prewarmFrames, bool sharedMemory):
+    maxFrames(std::max(1, maxFrames)),
+    prewarmFrames(std::min(maxFrames, std::max(0, prewarmFrames))),
+    sharedMemory(sharedMemory),
+    stats(std::make_shared<NAVFrameBufferPoolStats>())
+{
+}
+
+NAVFrameBufferPool::~NAVFrameBufferPool() {
+    for (auto &layout : layouts)
+        FreeLayout(layout);
+}
+
+void NAVFrameBufferPool::FreeLayout(Layout &layout) {
+    for (int i = 0; i < 4; ++i)
+        av_buffer_pool_uninit(&layout.planes[i]);
+}
+
+/**
+ * Compute the line sizes and plane sizes for the given layout like avcodec_default_get_buffer2() (widening
+ * the lines until each one meets the codec's alignment), and create a pool for each of its planes.
+ */
+bool NAVFrameBufferPool::CreateLayout(AVCodecContext *context, Layout &layout) {
+    int width = layout.width;
+    int height = layout.height;
+    int linesizeAlign[AV_NUM_DATA_POINTERS];
+    bool unaligned;
+
+    avcodec_align_dimensions2(context, &width, &height, linesizeAlign);
+
+    do {
+        if (av_image_fill_linesizes(layout.linesize, layout.format, width) < 0)
+            return false;
+        
+        width += width & ~(width - 1);
+        unaligned = false;
+        for (int i = 0; i < 4; ++i)
+            unaligned |= (layout.linesize[i] % linesizeAlign[i]) != 0;
+    } while (unaligned);
+
+    ptrdiff_t linesize[4];
+    size_t sizes[4];
+
+    for (int i = 0; i < 4; ++i)
+        linesize[i] = layout.linesize[i];
+    
+    if (av_image_fill_plane_sizes(sizes, layout.format, height, linesize) < 0)
+        return false;
+
+    for (int i = 0; i < 4; ++i) {
+        layout.planes[i] = nullptr;
+        if (sizes[i] == 0)
+            continue;
+        
+        auto state = new NAVPlanePoolState();
+        state->maxBuffers = maxFrames;
+        state->sharedMemory = sharedMemory;
+        state->allocated = 0;
+        state->stats = stats;
+
+        layout.planes[i] = av_buffer_pool_init2(sizes[i] + NLAV_FRAME_BUFFER_PADDING, state, nlav_plane_pool_alloc, nlav_plane_pool_free);
+        if (!layout.planes[i]) {
+            delete state;
+            FreeLayout(layout);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * The pools for the given layout, created if needed. Null if it cannot be pooled. Called with the mutex held.
+ */
+NAVFrameBufferPool::Layout *NAVFrameBufferPool::FindLayout(AVCodecContext *context, AVPixelFormat format, int width, int height) {
+    for (auto &layout : layouts) {
+        if (layout.format == format && layout.width == width && layout.height == height)
+            return &layout;
+    }
+
+    // Palettes, bitstream formats and hardware surfaces are left to libavcodec
+    auto descriptor = av_pix_fmt_desc_get(format);
+    if (!descriptor || (descriptor->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL)))
+        return nullptr;
+    
+    if (width <= 0 || height <= 0)
+        return nullptr;
+    
+    Layout layout;
+    layout.format = format;
+    layout.width = width;
+    layout.height = height;
+    
+    if (!CreateLayout(context, layout))
+        return nullptr;
+    
+    // Frames still holding buffers of the evicted pools keep them until they are freed
+    if (layouts.size() >= NLAV_MAX_FRAME_BUFFER_LAYOUTS) {
+        FreeLayout(layouts.front());
+        layouts.pop_front();
+    }
+
+    layouts.push_back(layout);
+    stats->layouts += 1;
+    Warm(layouts.back());
+
+    return &layouts.back();
+}
+
+/**
+ * Allocate the buffers of prewarmFrames frames in the pools of a new layout. Returning them leaves them
+ * idle in the pools.
+ */
+void NAVFrameBufferPool::Warm(Layout &layout) {
+    std::vector<AVBufferRef*> buffers;
+
+    for (int i = 0; i < 4 && layout.planes[i]; ++i) {
+        for (int j = 0; j < prewarmFrames; ++j)
+            buffers.push_back(av_buffer_pool_get(layout.planes[i]));
+    }
+
+    for (auto &buffer : buffers)
+        av_buffer_unref(&buffer);
+}
+
+int NAVFrameBufferPool::GetBuffer(AVCodecContext *context, AVFrame *frame, int flags) {
+    if (context->codec_type != AVMEDIA_TYPE_VIDEO)
+        return avcodec_default_get_buffer2(context, frame, flags);
+    
+    std::unique_lock<std::mutex> lock(mutex);
+    auto layout = FindLayout(context, (AVPixelFormat)frame->format, frame->width, frame->height);
+
+    if (!layout) {
+        lock.unlock();
+        return avcodec_default_get_buffer2(context, frame, flags);
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        if (!layout->planes[i])
+            break;
+        
+        frame->buf[i] = av_buffer_pool_get(layout->planes[i]);
+        if (!frame->buf[i]) {
+            lock.unlock();
+            for (int j = 0; j < i; ++j)
+                av_buffer_unref(&frame->buf[j]);
+            
+            stats->overflows += 1;
+            return avcodec_default_get_buffer2(context, frame, flags);
+        }
+
+        frame->data[i] = frame->buf[i]->data;
+        frame->linesize[i] = layout->linesize[i];
+    }
+
+    lock.unlock();
+    stats->frames += 1;
+
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+void NAVFrameBufferPool::Prewarm(AVCodecContext *context) {
+    if (context->codec_type != AVMEDIA_TYPE_VIDEO)
+        return;
+    
+    // What libavcodec will ask for (see ff_get_buffer())
+    int width = std::max(context->width, context->coded_width);
+    int height = std::max(context->height, context->coded_height);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    FindLayout(context, context->pix_fmt, width, height);
+}
@@ -0,0 +1,97 @@
+#include "../common.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libavutil/buffer.h>
+}
+
+/**
+ * Number of (format, width, height) layouts a NAVFrameBufferPool keeps pools for. A stream rarely 
+ * changes its resolution, and the pools of the oldest layout are released to make room for a new one.
+ */
+#define NLAV_MAX_FRAME_BUFFER_LAYOUTS 4
+
+/**
+ * Counters of a NAVFrameBufferPool (see poolStats.buffers). Shared with the plane pools, which live until
+ * the last buffer taken from them has been returned.
+ */
+struct NAVFrameBufferPoolStats {
+    NAVFrameBufferPoolStats():
+        frames(0),
+        allocations(0),
+        overflows(0),
+        layouts(0)
+    {
+    }
+
+    // Frames whose planes came from the pools
+    std::atomic<uint64_t> frames;
+
+    // Plane buffers allocated by the pools, including the ones allocated to warm them up
+    std::atomic<uint64_t> allocations;
+
+    // Frames allocated by avcodec_default_get_buffer2() instead, as a pool was at its cap
+    std::atomic<uint64_t> overflows;
+
+    // Layouts pools were created for
+    std::atomic<uint64_t> layouts;
+};
+
+/**
+ * Plane buffer pools for a decoder's get_buffer2, one AVBufferPool per plane for each (format, width, 
+ * height) the decoder asks for, laid out the way avcodec_default_get_buffer2() would. Each plane pool 
+ * allocates at most maxFrames buffers, so the memory a decoder uses for its frames is known up front, 
+ * and prewarmFrames of them are allocated along with the pools (see Prewarm()) instead of while decoding.
+ * With sharedMemory, the buffers are allocated in shared memory which other processes can map (see 
+ * nlav_shared_buffer_alloc()).
+ *
+ * GetBuffer() is thread-safe, as required by frame threaded decoders. Frames may outlive the pool: 
+ * the AVBufferPools are only freed once all of their buffers have been returned.
+ */
+class NAVFrameBufferPool {
+    public:
+        NAVFrameBufferPool(int maxFrames, int prewarmFrames, bool sharedMemory = false);
+        ~NAVFrameBufferPool();
+
+        /**
+         * get_buffer2 implementation (see NAVCodecContext::GetBuffer()). Falls back to 
+         * avcodec_default_get_buffer2() for layouts which cannot be pooled and when a pool is at its cap.
+         */
+        int GetBuffer(AVCodecContext *context, AVFrame *frame, int flags);
+
+        /**
+         * Create (and warm up) the pools for the layout the decoder was opened with, if it is known 
+         * (width, height and pixel format set), so that the first frames do not allocate anything.
+         */
+        void Prewarm(AVCodecContext *context);
+
+        std::shared_ptr<NAVFrameBufferPoolStats> GetStats() { return stats; }
+        int GetMaxFrames() { return maxFrames; }
+
+    private:
+        struct Layout {
+            AVPixelFormat format;
+            int width;
+            int height;
+            int linesize[4];
+            AVBufferPool *planes[4];
+        };
+
+        Layout *FindLayout(AVCodecContext *context, AVPixelFormat format, int width, int height);
+        bool CreateLayout(AVCodecContext *context, Layout &layout);
+        void Warm(Layout &layout);
+        static void FreeLayout(Layout &layout);
+
+        int maxFrames;
+        int prewarmFrames;
+        bool sharedMemory;
+        std::mutex mutex;
+        std::deque<Layout> layouts;
+        std::shared_ptr<NAVFrameBufferPoolStats> stats;
+};
@@ -1,6 +1,7 @@
 #include "index.h"
 #include "codec.h"
 #include "codec-context.h"
+#include "codec-context-template.h"
 #include "profile.h"
 #include "packet.h"
 
@@ -12,5 +13,6 @@ void nlavc_init(Napi::Env env, Napi::Object exports) {
     NAVProfile::Register(env, exports);
     NAVCodec::Register(env, exports);
     NAVCodecContext::Register(env, exports);
+    NAVCodecContextTemplate::Register(env, exports);
     NAVPacket::Register(env, exports);
 }
\ No newline at end of file
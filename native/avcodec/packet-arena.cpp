@@ -0,0 +1,92 @@
+#include "packet-arena.h"
+
+#include <string.h>
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "control words must be plain uint32 values");
+
+// Offsets are uint32, and kept in the range of an Int32Array index for the reader
+#define NLAV_ARENA_MAX_RING_SIZE 0x7ffffff8
+
+static uint64_t nlav_arena_align(uint64_t size) {
+    return (size + 7) & ~(uint64_t)7;
+}
+
+NAVPacketArena::NAVPacketArena(uint8_t *data, size_t size):
+    signalPending(false),
+    data(data),
+    ring(data + NLAV_ARENA_CONTROL_SIZE)
+{
+    size_t available = size - NLAV_ARENA_CONTROL_SIZE;
+    ringSize = (uint32_t)(available < NLAV_ARENA_MAX_RING_SIZE ? available : NLAV_ARENA_MAX_RING_SIZE) & ~7u;
+
+    // Whatever was in the memory before, the ring starts out empty
+    for (int i = 0; i < NLAV_ARENA_CONTROL_SIZE / 4; ++i)
+        Control(i).store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+bool NAVPacketArena::IsValid(const uint8_t *data, size_t size) {
+    return ((uintptr_t)data & 7) == 0 && size >= NLAV_ARENA_CONTROL_SIZE + 2 * NLAV_ARENA_HEADER_SIZE;
+}
+
+std::atomic<uint32_t> &NAVPacketArena::Control(int index) {
+    return reinterpret_cast<std::atomic<uint32_t>*>(data)[index];
+}
+
+uint32_t NAVPacketArena::WriteOffset() {
+    return Control(NLAV_ARENA_WRITE_OFFSET).load(std::memory_order_acquire);
+}
+
+bool NAVPacketArena::Write(const AVPacket *packet) {
+    // We are the only writer of the write offset and counters
+    uint32_t write = Control(NLAV_ARENA_WRITE_OFFSET).load(std::memory_order_relaxed);
+    uint32_t read = Control(NLAV_ARENA_READ_OFFSET).load(std::memory_order_acquire);
+    uint64_t needed = nlav_arena_align(NLAV_ARENA_HEADER_SIZE + (uint64_t)(packet->size > 0 ? packet->size : 0));
+    bool fits = false;
+    bool wraps = false;
+
+    // A read offset we never wrote is a reader bug, and nothing can be written safely
+    if (read < ringSize && (read & 7) == 0 && needed <= ringSize) {
+        if (write >= read) {
+            // Ending right at the end of the ring makes the write offset 0, which must not be the read offset
+            if (write + needed < ringSize || (write + needed == ringSize && read != 0))
+                fits = true;
+            else if (needed < read)
+                fits = wraps = true;
+        } else {
+            fits = write + needed < read;
+        }
+    }
+
+    if (!fits) {
+        auto &dropped = Control(NLAV_ARENA_DROPPED);
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        return false;
+    }
+
+    if (wraps) {
+        int32_t marker = -1;
+        memcpy(ring + write, &marker, sizeof(marker));
+        write = 0;
+    }
+
+    uint8_t *record = ring + write;
+    int32_t header[4] = { packet->size, packet->flags, packet->stream_index, 0 };
+    int64_t timing[3] = { packet->pts, packet->dts, packet->duration };
+
+    memcpy(record, header, sizeof(header));
+    memcpy(record + sizeof(header), timing, sizeof(timing));
+    if (packet->size > 0)
+        memcpy(record + NLAV_ARENA_HEADER_SIZE, packet->data, packet->size);
+
+    write += (uint32_t)needed;
+    if (write == ringSize)
+        write = 0;
+
+    auto &written = Control(NLAV_ARENA_WRITTEN);
+    written.store(written.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    // Publishes the record along with it
+    Control(NLAV_ARENA_WRITE_OFFSET).store(write, std::memory_order_release);
+    return true;
+}
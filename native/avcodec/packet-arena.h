@@ -0,0 +1,69 @@
+#include "../common.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+}
+
+/**
+ * Size of the control words at the start of a packet arena, a cache line so that the words the encoder
+ * thread writes do not share it with the first record.
+ */
+#define NLAV_ARENA_CONTROL_SIZE 64
+
+/**
+ * Indices of the control words (uint32, native byte order) at the start of a packet arena.
+ */
+#define NLAV_ARENA_WRITE_OFFSET 0   // Where the next record goes in the ring, written by the encoder
+#define NLAV_ARENA_READ_OFFSET 1    // Where the oldest unread record is, written by the reader
+#define NLAV_ARENA_WRITTEN 2        // Number of records written
+#define NLAV_ARENA_DROPPED 3        // Number of packets dropped because the ring was full
+
+/**
+ * Size of the header of each record: int32 size, int32 flags, int32 stream index, int32 reserved,
+ * then int64 pts, dts and duration. The payload follows, and the next record starts at the next
+ * multiple of 8. A size of -1 marks the end of the ring, the next record is at its start.
+ */
+#define NLAV_ARENA_HEADER_SIZE 40
+
+/**
+ * A ring buffer the encoder thread writes packets into, back to back, in memory owned by Javascript
+ * (see packetArena). Positions are byte offsets into the ring, which starts after the control words.
+ * The ring is empty when the write offset equals the read offset, so a record is never written up to
+ * the read offset. Packets for which there is no room are dropped rather than waiting, so that a
+ * reader falling behind does not stall the encoder (and whatever feeds it).
+ */
+class NAVPacketArena {
+    public:
+        NAVPacketArena(uint8_t *data, size_t size);
+
+        /**
+         * Whether the given memory can hold a packet arena: room for the control words and a couple of
+         * records, starting at a multiple of 8 bytes.
+         */
+        static bool IsValid(const uint8_t *data, size_t size);
+
+        /**
+         * Copy the packet in as a record, and publish it by advancing the write offset. False if it
+         * was dropped for lack of room. Encoder thread only.
+         */
+        bool Write(const AVPacket *packet);
+
+        uint32_t WriteOffset();
+
+        /**
+         * Set when the reader has been told about the write offset and has not been called yet, so
+         * that a burst of packets results in a single call (see NAVCodecContext::WriteToArena()).
+         */
+        std::atomic<bool> signalPending;
+
+    private:
+        std::atomic<uint32_t> &Control(int index);
+
+        uint8_t *data;
+        uint8_t *ring;
+        uint32_t ringSize;
+};
@@ -1,6 +1,49 @@
 #include "packet.h"
 #include "../avutil/buffer.h"
 
+extern "C" {
+    #include <libavcodec/avcodec.h>
+}
+
+/**
+ * Keeps the JS memory behind a zero-copy packet alive until libav releases the buffer
+ */
+struct NAVPacketExternalData {
+    std::shared_ptr<NAVReleaseQueue> releases;
+    Napi::Reference<Napi::ArrayBuffer> *arrayBuffer;
+};
+
+static void ReleaseExternalData(void *opaque, uint8_t *data) {
+    auto external = (NAVPacketExternalData*)opaque;
+    auto arrayBuffer = external->arrayBuffer;
+
+    // The last reference may be dropped by a codec thread, or after a worker thread's env is gone
+    external->releases->Defer([arrayBuffer]() {
+        delete arrayBuffer;
+    });
+
+    delete external;
+}
+
+/**
+ * Whether the last AV_INPUT_BUFFER_PADDING_SIZE bytes of the given view (which must have that many) 
+ * are zero, so that they can serve as the padding libavcodec requires after packet data. The padding 
+ * must be part of the view: memory beyond it may be handed out to or written by anyone (the next 
+ * slice of Node's Buffer pool for instance), and is read by the codec thread long after this check.
+ */
+static bool HasPadding(Napi::Uint8Array &view) {
+    if (!view.Data())
+        return false;
+    
+    const uint8_t *padding = view.Data() + view.ByteLength() - AV_INPUT_BUFFER_PADDING_SIZE;
+    for (int i = 0; i < AV_INPUT_BUFFER_PADDING_SIZE; ++i) {
+        if (padding[i])
+            return false;
+    }
+
+    return true;
+}
+
 NAVPacket::NAVPacket(const Napi::CallbackInfo& info):
     NAVResource(info)
 {
@@ -10,22 +53,100 @@ NAVPacket::NAVPacket(const Napi::CallbackInfo& info):
     
     SetHandle(av_packet_alloc());
 
+    LibAvAddon::Self(info.Env())->FlushDeferredReleases();
+
     if (info.Length() > 0) {
         auto externalBuffer = info[0].As<Napi::Uint8Array>();
         auto length = externalBuffer.ByteLength();
+        bool zeroCopy = info.Length() > 1 && info[1].ToBoolean().Value();
+
+        // The view ends with the padding, which is not part of the packet data
+        if (zeroCopy) {
+            if (length < AV_INPUT_BUFFER_PADDING_SIZE) {
+                Napi::RangeError::New(info.Env(), "The data must end with AV_INPUT_BUFFER_PADDING_SIZE (" 
+                    + std::to_string(AV_INPUT_BUFFER_PADDING_SIZE) + ") bytes of padding").ThrowAsJavaScriptException();
+                return;
+            }
+
+            length -= AV_INPUT_BUFFER_PADDING_SIZE;
+        }
 
-        uint8_t *buffer = (uint8_t*)av_malloc(length);
-        memcpy(buffer, externalBuffer.Data(), length);
-        av_packet_from_data(GetHandle(), buffer, length);
+        if (zeroCopy && HasPadding(externalBuffer)) {
+            auto external = new NAVPacketExternalData();
+            external->releases = LibAvAddon::Self(info.Env())->GetReleaseQueue();
+            external->arrayBuffer = new Napi::Reference<Napi::ArrayBuffer>(
+                Napi::Reference<Napi::ArrayBuffer>::New(externalBuffer.ArrayBuffer(), 1)
+            );
+
+            jsMemory = externalBuffer.Data();
+
+            // Read-only, so that libav copies the data rather than writing to the caller's memory
+            auto handle = GetHandle();
+            handle->buf = av_buffer_create(
+                externalBuffer.Data(), 
+                length + AV_INPUT_BUFFER_PADDING_SIZE, 
+                &ReleaseExternalData, 
+                external, 
+                AV_BUFFER_FLAG_READONLY
+            );
+
+            if (!handle->buf) {
+                delete external->arrayBuffer;
+                delete external;
+                Napi::Error::New(info.Env(), "Failed to allocate packet buffer").ThrowAsJavaScriptException();
+                return;
+            }
+
+            handle->data = handle->buf->data;
+            handle->size = length;
+        } else {
+            uint8_t *buffer = (uint8_t*)av_malloc(length + AV_INPUT_BUFFER_PADDING_SIZE);
+            memcpy(buffer, externalBuffer.Data(), length);
+            memset(buffer + length, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+            av_packet_from_data(GetHandle(), buffer, length);
+        }
+
+        UpdateExternalMemory(info.Env());
     }
 }
 
 void NAVPacket::Free() {
     auto handle = GetHandle();
+
+    cachedSideData.Reset();
+    cachedSideDataArray = nullptr;
+    cachedSideDataCount = 0;
+
+    if (pool) {
+        SetHandle(nullptr);
+        pool->Release(handle);
+        pool.reset();
+        return;
+    }
+
     av_packet_free(&handle);
     SetHandle(handle);
 }
 
+void NAVPacket::SetPool(std::shared_ptr<NAVPacketPool> pool) {
+    this->pool = pool;
+}
+
+Napi::Value NAVPacket::Release(const Napi::CallbackInfo& info) {
+    Dispose(info.Env());
+    return info.Env().Undefined();
+}
+
+size_t NAVPacket::GetExternalMemorySize() {
+    auto handle = GetHandle();
+
+    // Memory borrowed from a JS ArrayBuffer is already accounted for by V8
+    if (handle->buf && handle->buf->data == jsMemory)
+        return sizeof(AVPacket);
+
+    return sizeof(AVPacket) + (handle->buf ? handle->buf->size : handle->size);
+}
+
 void NAVPacket::RefHandle() {
     // Some AVPackets do not have a buf reference (only data+size).
     // - Since we need NAVBuffer to safely (and singly) expose a data buffer into
@@ -34,6 +155,7 @@ void NAVPacket::RefHandle() {
     //   the lifetime of the NAVPacket instance.
     av_packet_make_refcounted(GetHandle());
     SetHandle(av_packet_clone(GetHandle()));
+    pool.reset();
 }
 
 Napi::Value NAVPacket::GetBuffer(const Napi::CallbackInfo& info) {
@@ -76,14 +198,66 @@ void NAVPacket::SetFlags(const Napi::CallbackInfo& info, const Napi::Value& valu
     GetHandle()->flags = info[0].As<Napi::Number>().Int32Value();
 }
 
+/**
+ * The side data as AVPacketSideData instances. The array is only rebuilt when side data is added or
+ * removed, so reading sideData (or sideData.length) repeatedly does not wrap every entry each time.
+ */
 Napi::Value NAVPacket::GetSideData(const Napi::CallbackInfo& info) {
-    return NAVPacketSideData::FromHandlesWrapped(info.Env(), GetHandle()->side_data, GetHandle()->side_data_elems, false);
+    auto handle = GetHandle();
+
+    if (cachedSideData.IsEmpty() || cachedSideDataArray != handle->side_data || cachedSideDataCount != handle->side_data_elems) {
+        cachedSideData = Napi::Persistent(
+            NAVPacketSideData::FromHandlesWrapped(info.Env(), handle->side_data, handle->side_data_elems, false).As<Napi::Object>()
+        );
+        cachedSideDataArray = handle->side_data;
+        cachedSideDataCount = handle->side_data_elems;
+    }
+
+    return cachedSideData.Value();
 }
 
 Napi::Value NAVPacket::GetSideDataCount(const Napi::CallbackInfo& info) {
     return Napi::Number::New(info.Env(), GetHandle()->side_data_elems);
 }
 
+Napi::Value NAVPacket::GetSideDataTypes(const Napi::CallbackInfo& info) {
+    auto handle = GetHandle();
+    auto env = info.Env();
+    auto types = Napi::Array::New(env, handle->side_data_elems);
+
+    for (int i = 0; i < handle->side_data_elems; ++i) {
+        auto entry = Napi::Object::New(env);
+        entry.Set("type", Napi::Number::New(env, handle->side_data[i].type));
+        entry.Set("size", Napi::Number::New(env, handle->side_data[i].size));
+        types.Set(i, entry);
+    }
+
+    return types;
+}
+
+/**
+ * A copy of the side data of the given type as a plain Uint8Array, without an AVPacketSideData
+ * instance. Packet side data is not reference counted, so unlike AVFrame#getSideDataRaw() this copies
+ * (side data of packets is small).
+ */
+Napi::Value NAVPacket::GetSideDataRaw(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto type = (AVPacketSideDataType)info[0].As<Napi::Number>().Int32Value();
+#if LIBAVCODEC_VERSION_MAJOR >= 59
+    size_t size = 0;
+#else
+    int size = 0;
+#endif
+    auto data = av_packet_get_side_data(GetHandle(), type, &size);
+
+    if (!data)
+        return env.Null();
+
+    auto arrayBuffer = Napi::ArrayBuffer::New(env, size);
+    memcpy(arrayBuffer.Data(), data, size);
+    return Napi::Uint8Array::New(env, size, arrayBuffer, 0);
+}
+
 Napi::Value NAVPacket::GetDuration(const Napi::CallbackInfo& info) {
     return Napi::Number::New(info.Env(), GetHandle()->duration);
 }
@@ -119,24 +293,20 @@ void NAVPacket::SetTimeBase(const Napi::CallbackInfo& info, const Napi::Value& v
 NAVPacketSideData::NAVPacketSideData(const Napi::CallbackInfo& info):
     NAVResource(info)
 {
-    if (ConstructFromHandle(info)) {
-        if (!ownedArrayBuffer.IsEmpty())
-            ownedArrayBuffer.Unref();
-
-        auto handle = GetHandle();
-        ownedArrayBuffer = Napi::Reference<Napi::ArrayBuffer>::New(
-            Napi::ArrayBuffer::New(info.Env(), handle->data, handle->size),
-            1
-        );
+    if (ConstructFromHandle(info))
         return;
-    }
 }
 
 void NAVPacketSideData::Free() {
-    ownedArrayBuffer.Unref();
+    ownedArrayBuffer.Reset();
 }
 
 Napi::Value NAVPacketSideData::GetData(const Napi::CallbackInfo& info) {
+    if (ownedArrayBuffer.IsEmpty()) {
+        auto handle = GetHandle();
+        ownedArrayBuffer = Napi::Persistent(Napi::ArrayBuffer::New(info.Env(), handle->data, handle->size));
+    }
+
     return ownedArrayBuffer.Value();
 }
 
@@ -2,6 +2,8 @@
 
 #include <napi.h>
 #include "../resource.h"
+#include "../handle-pool.h"
+#include <memory>
 
 extern "C" {
     #include <libavcodec/packet.h>
@@ -22,16 +24,35 @@ class NAVPacket : public NAVResource<NAVPacket, AVPacket> {
                 R_ACCESSOR("flags", &NAVPacket::GetFlags, &NAVPacket::SetFlags),
                 R_GETTER("sideData", &NAVPacket::GetSideData),
                 R_GETTER("sideDataCount", &NAVPacket::GetSideDataCount),
+                R_GETTER("sideDataTypes", &NAVPacket::GetSideDataTypes),
+                R_METHOD("getSideDataRaw", &NAVPacket::GetSideDataRaw),
                 R_ACCESSOR("duration", &NAVPacket::GetDuration, &NAVPacket::SetDuration),
                 R_ACCESSOR("position", &NAVPacket::GetPosition, &NAVPacket::SetPosition),
                 R_ACCESSOR("opaqueBuffer", &NAVPacket::GetOpaqueBuffer, &NAVPacket::SetOpaqueBuffer),
-                R_ACCESSOR("timeBase", &NAVPacket::GetTimeBase, &NAVPacket::SetTimeBase)
+                R_ACCESSOR("timeBase", &NAVPacket::GetTimeBase, &NAVPacket::SetTimeBase),
+                R_METHOD("release", &NAVPacket::Release)
             });
         }
 
         virtual void Free();
         virtual void RefHandle();
+        virtual size_t GetExternalMemorySize();
+
+        /**
+         * Return the handle to the given pool (instead of freeing it) once this packet is finalized 
+         * or released.
+         */
+        void SetPool(std::shared_ptr<NAVPacketPool> pool);
     private:
+        std::shared_ptr<NAVPacketPool> pool;
+        void *jsMemory = nullptr;
+
+        // Cache for sideData, valid as long as the packet's side data array is the one it was built from
+        AVPacketSideData *cachedSideDataArray = nullptr;
+        int cachedSideDataCount = 0;
+        Napi::ObjectReference cachedSideData;
+
+        Napi::Value Release(const Napi::CallbackInfo& info);
         Napi::Value GetBuffer(const Napi::CallbackInfo& info);
         Napi::Value GetPts(const Napi::CallbackInfo& info);
         void SetPts(const Napi::CallbackInfo& info, const Napi::Value& value);
@@ -44,6 +65,8 @@ class NAVPacket : public NAVResource<NAVPacket, AVPacket> {
         void SetFlags(const Napi::CallbackInfo& info, const Napi::Value& value);
         Napi::Value GetSideData(const Napi::CallbackInfo& info);
         Napi::Value GetSideDataCount(const Napi::CallbackInfo& info);
+        Napi::Value GetSideDataTypes(const Napi::CallbackInfo& info);
+        Napi::Value GetSideDataRaw(const Napi::CallbackInfo& info);
         Napi::Value GetDuration(const Napi::CallbackInfo& info);
         void SetDuration(const Napi::CallbackInfo& info, const Napi::Value& value);
         Napi::Value GetPosition(const Napi::CallbackInfo& info);
@@ -71,6 +94,7 @@ class NAVPacketSideData : public NAVResource<NAVPacketSideData, AVPacketSideData
 
         void Free();
     private:
+        // Created on first access of data, most side data is never looked at
         Napi::Reference<Napi::ArrayBuffer> ownedArrayBuffer;
 
         Napi::Value GetData(const Napi::CallbackInfo& info);
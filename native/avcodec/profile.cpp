@@ -11,6 +11,11 @@ void NAVProfile::Free() {
     // Do nothing. We never own AVProfiles.
 }
 
+bool NAVProfile::CheckDisposable(const Napi::Env &env) {
+    // Shared through AVCodec#profiles, see NAVCodec::CheckDisposable()
+    return false;
+}
+
 Napi::Value NAVProfile::GetId(const Napi::CallbackInfo& info) {
     return Napi::Number::New(info.Env(), GetHandle()->profile);
 }
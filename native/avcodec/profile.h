@@ -20,6 +20,7 @@ class NAVProfile : public NAVResource<NAVProfile, AVProfile> {
         }
 
         virtual void Free();
+        virtual bool CheckDisposable(const Napi::Env &env);
     private:
         
         Napi::Value GetId(const Napi::CallbackInfo& info);
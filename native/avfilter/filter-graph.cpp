@@ -0,0 +1,815 @@
+#include "filter-graph.h"
+#include "../avutil/frame.h"
+#include "../avutil/channel-layout.h"
+#include "../avcodec/codec-context.h"
+#include "../libavaddon.h"
+
+extern "C" {
+    #include <libavfilter/buffersrc.h>
+    #include <libavfilter/buffersink.h>
+    #include <libavutil/mem.h>
+}
+
+NAVFilterGraph::NAVFilterGraph(const Napi::CallbackInfo& info):
+    NAVResource(info),
+    scheduler(nullptr),
+    wakePending(false),
+    running(true),
+    inQueue(NLAV_DEFAULT_QUEUE_CAPACITY),
+    maxQueuedItems(NLAV_DEFAULT_QUEUE_CAPACITY),
+    drainRequested(false),
+    framePool(std::make_shared<NAVFramePool>()),
+    postedFrames(std::make_shared<std::atomic<int>>(0)),
+    alive(std::make_shared<bool>(true)),
+    onFrameValid(false),
+    onErrorValid(false),
+    onEndValid(false)
+{
+    if (ConstructFromHandle(info))
+        return;
+
+    auto graph = avfilter_graph_alloc();
+    if (!graph) {
+        Napi::Error::New(info.Env(), "Failed to allocate the filter graph").ThrowAsJavaScriptException();
+        return;
+    }
+
+    SetHandle(graph);
+}
+
+void NAVFilterGraph::ThreadMain() {
+    while (running) {
+        if (!Step())
+            WaitForWork();
+    }
+}
+
+/**
+ * Pool worker only (see useThreadPool). Work for a few rounds, then let the worker move on.
+ */
+bool NAVFilterGraph::RunScheduled() {
+    for (int i = 0; i < NLAV_SCHEDULED_STEPS && running; ++i) {
+        if (!Step())
+            return false;
+    }
+
+    return running;
+}
+
+/**
+ * Filter thread only. Feed one queued frame to the graph, then pull everything the graph has produced,
+ * so that frames do not pile up inside the graph. Returns false if there was nothing to do.
+ */
+bool NAVFilterGraph::Step() {
+    // JS is behind with the frames we posted: the rest waits in the graph (and the queue) meanwhile
+    if (Backlogged())
+        return false;
+
+    bool fed = FeedToGraph();
+    bool pulled = PullFromGraph();
+
+    return fed || pulled;
+}
+
+/**
+ * Filter thread only. Frames stay queued while nobody listens for the filtered frames.
+ */
+bool NAVFilterGraph::FeedToGraph() {
+    if (!onFrameValid)
+        return false;
+
+    auto item = inQueue.Peek();
+    if (!item)
+        return false;
+
+    auto &source = sources[item->input];
+
+    if (!source.ended) {
+        // Takes the reference of the frame. Without a frame, this marks the end of the input.
+        int result = av_buffersrc_add_frame_flags(source.context, item->frame, 0);
+        if (result < 0)
+            SendError("averror:" + std::to_string(result), "An error occurred during av_buffersrc_add_frame_flags");
+
+        if (!item->frame)
+            source.ended = true;
+    }
+
+    PopWorkItem();
+    return true;
+}
+
+bool NAVFilterGraph::PullFromGraph() {
+    bool pulled = false;
+
+    for (size_t i = 0, max = sinks.size(); i < max && running && onFrameValid; ++i) {
+        auto &sink = sinks[i];
+
+        while (!sink.ended && running && onFrameValid && !Backlogged()) {
+            auto frame = framePool->Acquire();
+            int result = av_buffersink_get_frame(sink.context, frame);
+
+            if (result == AVERROR(EAGAIN)) {
+                framePool->Release(frame);
+                break;
+            }
+
+            if (result == AVERROR_EOF) {
+                framePool->Release(frame);
+                sink.ended = true;
+
+                if (++endedSinks == sinks.size() && onEndValid) {
+                    onEndTSFN.BlockingCall([](Napi::Env env, Napi::Function jsCallback) {
+                        jsCallback.Call({});
+                    });
+                }
+                break;
+            }
+
+            if (result < 0) {
+                framePool->Release(frame);
+                SendError("averror:" + std::to_string(result), "An error occurred during av_buffersink_get_frame");
+                break;
+            }
+
+            frame->time_base = av_buffersink_get_time_base(sink.context);
+            DeliverFrame(frame, i);
+            pulled = true;
+        }
+    }
+
+    return pulled;
+}
+
+/**
+ * Wrap a filtered frame. The frame returns to our pool once JS is done with it. JS thread only.
+ */
+Napi::Value NAVFilterGraph::WrapPoolFrame(const Napi::Env &env, std::shared_ptr<NAVFramePool> pool, AVFrame *frame) {
+    LibAvAddon::Self(env)->FlushDeferredReleases();
+
+    auto instance = NAVFrame::FromHandle(env, frame, true);
+    instance->SetPool(pool);
+    return instance->Value();
+}
+
+/**
+ * Send a filtered frame to the main thread. The call queue of onFrame is unbounded, so this never blocks:
+ * the graph is kept from running ahead by counting the frames posted, and Step() stops once 
+ * NLAV_FILTER_MAX_POSTED_FRAMES of them are on their way. The call that brings the count back under 
+ * the limit wakes us. Filter thread only.
+ */
+void NAVFilterGraph::DeliverFrame(AVFrame *frame, int output) {
+    auto pool = framePool;
+    auto posted = postedFrames;
+    std::shared_ptr<bool> alive = this->alive;
+
+    ++*posted;
+    auto status = onFrameTSFN.NonBlockingCall([this, frame, pool, output, posted, alive](Napi::Env env, Napi::Function jsCallback) {
+        if (posted->fetch_sub(1) == NLAV_FILTER_MAX_POSTED_FRAMES && *alive)
+            Wake();
+
+        jsCallback.Call({ WrapPoolFrame(env, pool, frame), Napi::Number::New(env, output) });
+    });
+
+    // The callback was released meanwhile
+    if (status != napi_ok) {
+        --*posted;
+        pool->Release(frame);
+    }
+}
+
+void NAVFilterGraph::SendError(std::string code, std::string message) {
+    if (!onErrorValid)
+        return;
+
+    onErrorTSFN.BlockingCall([=](Napi::Env env, Napi::Function jsCallback) {
+        Napi::Object error = Napi::Object::New(env);
+        error.Set("code", code);
+        error.Set("message", message);
+        jsCallback.Call({ error });
+    });
+}
+
+// Threading infrastructure ////////////////////////////////////////////////////////////
+
+/**
+ * Whether as many frames as we let JS fall behind by are posted to onFrame. Any thread.
+ */
+bool NAVFilterGraph::Backlogged() {
+    return postedFrames->load() >= NLAV_FILTER_MAX_POSTED_FRAMES;
+}
+
+/**
+ * Park the filter thread until there is something for it to do. Once JS catches up with a backlog, 
+ * DeliverFrame()'s call wakes us.
+ */
+void NAVFilterGraph::WaitForWork() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    threadWake.wait(lock, [this]() {
+        return !running || wakePending.load() || (onFrameValid && !inQueue.Empty() && !Backlogged());
+    });
+
+    wakePending = false;
+}
+
+/**
+ * Wake the filter thread, or schedule us on the thread pool. Any thread.
+ */
+void NAVFilterGraph::Wake() {
+    auto pool = scheduler.load();
+    if (pool) {
+        pool->Schedule(this);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    wakePending = true;
+    threadWake.notify_one();
+}
+
+/**
+ * Queue an item for the filter thread. JS thread only (the queue has a single producer).
+ */
+bool NAVFilterGraph::EnqueueWork(NAVFilterItem item) {
+    // Items waiting in pendingSends go first, otherwise the graph would see them out of order
+    if (!pendingSends.empty() || inQueue.Size() >= maxQueuedItems || !inQueue.Push(item))
+        return false;
+
+    Wake();
+    return true;
+}
+
+/**
+ * Queue an item for the filter thread, or park it in pendingSends until there is room for it. The
+ * returned promise resolves once the item has been queued. JS thread only.
+ */
+Napi::Value NAVFilterGraph::EnqueueWorkAsync(const Napi::Env &env, NAVFilterItem item) {
+    auto deferred = Napi::Promise::Deferred::New(env);
+
+    if (EnqueueWork(item)) {
+        deferred.Resolve(env.Undefined());
+    } else {
+        pendingSends.push_back(NAVFilterPendingSend { item, deferred });
+        RequestDrain(env);
+    }
+
+    return deferred.Promise();
+}
+
+/**
+ * Filter thread only. Remove the front item of the queue (which has been sent), and let the JS thread
+ * know that there is room again if it is waiting for it.
+ */
+void NAVFilterGraph::PopWorkItem() {
+    auto item = inQueue.Peek();
+    if (item)
+        av_frame_free(&item->frame);
+
+    inQueue.Pop();
+
+    if (drainRequested.load(std::memory_order_relaxed) && drainRequested.exchange(false)) {
+        onDrainTSFN.NonBlockingCall([this](Napi::Env env, Napi::Function) {
+            OnQueueDrained(env);
+        });
+    }
+}
+
+/**
+ * Ask the filter thread to call OnQueueDrained() once it has made room in the queue. While a request
+ * is outstanding we hold a reference to ourselves, so that the graph cannot be collected with sends
+ * still pending. JS thread only.
+ */
+void NAVFilterGraph::RequestDrain(const Napi::Env &env) {
+    if (drainArmed)
+        return;
+
+    if (!onDrainTSFN) {
+        auto noop = Napi::Function::New(env, [](const Napi::CallbackInfo&) { });
+        onDrainTSFN = Napi::ThreadSafeFunction::New(env, noop, "AVFilterGraph#onDrain", 0, 1);
+    }
+
+    drainArmed = true;
+    Ref();
+    onDrainTSFN.Ref(env);
+
+    drainRequested.store(true);
+
+    // The filter thread may have emptied the queue before it could see the request
+    if (inQueue.Size() < maxQueuedItems && drainRequested.exchange(false)) {
+        onDrainTSFN.NonBlockingCall([this](Napi::Env env, Napi::Function) {
+            OnQueueDrained(env);
+        });
+    }
+}
+
+void NAVFilterGraph::OnQueueDrained(Napi::Env env) {
+    drainArmed = false;
+
+    // Disposed while the drain was in flight
+    if (!GetHandle()) {
+        Unref();
+        return;
+    }
+
+    onDrainTSFN.Unref(env);
+
+    while (!pendingSends.empty() && inQueue.Size() < maxQueuedItems) {
+        auto &pending = pendingSends.front();
+        if (!inQueue.Push(pending.item))
+            break;
+
+        pending.deferred.Resolve(env.Undefined());
+        pendingSends.pop_front();
+    }
+
+    Wake();
+
+    if (!pendingSends.empty())
+        RequestDrain(env);
+
+    Unref();
+}
+
+void NAVFilterGraph::Free() {
+    // End the thread before releasing the graph it is using
+    running = false;
+    *alive = false;
+
+    if (thread) {
+        Wake();
+        thread->join();
+        delete thread;
+        thread = nullptr;
+    }
+
+    // Waits for the pool worker running us, if any. We are not run again afterwards.
+    if (scheduler)
+        scheduler.load()->Remove(this);
+
+    NAVFilterItem *item;
+    while ((item = inQueue.Peek())) {
+        av_frame_free(&item->frame);
+        inQueue.Pop();
+    }
+
+    // Sends still waiting for room will never be queued. This only happens when the graph is disposed
+    // explicitly, as we hold a reference to ourselves while there are pending sends.
+
+    while (!pendingSends.empty()) {
+        auto &pending = pendingSends.front();
+        av_frame_free(&pending.item.frame);
+        pending.deferred.Reject(Napi::Error::New(Env(), "The filter graph was disposed before the frame could be queued").Value());
+        pendingSends.pop_front();
+    }
+
+    if (onDrainTSFN)
+        onDrainTSFN.Release();
+    if (onFrameValid)
+        onFrameTSFN.Release();
+    if (onErrorValid)
+        onErrorTSFN.Release();
+    if (onEndValid)
+        onEndTSFN.Release();
+
+    onFrameValid = onErrorValid = onEndValid = false;
+
+    sources.clear();
+    sinks.clear();
+
+    auto handle = GetHandle();
+    avfilter_graph_free(&handle);
+    SetHandle(handle);
+}
+
+// Setup ///////////////////////////////////////////////////////////////////////////////
+
+bool NAVFilterGraph::CheckNotOpened(const Napi::Env &env, std::string property) {
+    if (!opened)
+        return true;
+
+    Napi::Error::New(env, property + " must be set before the filter graph is opened").ThrowAsJavaScriptException();
+    return false;
+}
+
+/**
+ * Add a buffer/abuffer source or buffersink/abuffersink sink. Sources take the parameters of the frames
+ * they receive: width, height, pixelFormat (and optionally sampleAspectRatio/frameRate) for video, or
+ * sampleRate, sampleFormat and channelLayout for audio, as well as their timeBase. Returns the index of
+ * the endpoint, as used by sendFrame() and onFrame.
+ */
+Napi::Value NAVFilterGraph::AddEndpoint(const Napi::CallbackInfo& info, bool input) {
+    auto env = info.Env();
+    auto &endpoints = input ? sources : sinks;
+
+    if (!CheckNotOpened(env, input ? "Inputs" : "Outputs"))
+        return env.Undefined();
+
+    auto params = info.Length() > 0 && info[0].IsObject() ? info[0].As<Napi::Object>() : Napi::Object::New(env);
+    bool audio = params.Has("sampleRate") || params.Has("sampleFormat")
+        || (params.Has("mediaType") && params.Get("mediaType").As<Napi::Number>().Int32Value() == AVMEDIA_TYPE_AUDIO);
+
+    NAVFilterEndpoint endpoint;
+    std::string prefix = input ? "in" : "out";
+
+    if (params.Has("name"))
+        endpoint.name = params.Get("name").As<Napi::String>().Utf8Value();
+    else
+        endpoint.name = endpoints.empty() ? prefix : prefix + std::to_string(endpoints.size());
+
+    if (FindEndpoint(endpoints, endpoint.name.c_str())) {
+        Napi::Error::New(env, "There already is an endpoint named '" + endpoint.name + "'").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    std::string args;
+
+    if (input) {
+        AVRational timeBase = params.Has("timeBase") ? FromNRational(env, params.Get("timeBase")) : AVRational { 0, 1 };
+
+        if (audio) {
+            int sampleRate = params.Get("sampleRate").As<Napi::Number>().Int32Value();
+            char layout[64] = { 0 };
+
+#ifdef FFMPEG_5_1
+            auto channelLayout = NAVChannelLayout::Unwrap(params.Get("channelLayout").As<Napi::Object>());
+            av_channel_layout_describe(channelLayout->GetHandle(), layout, sizeof(layout));
+#else
+            snprintf(layout, sizeof(layout), "0x%llx", (unsigned long long)params.Get("channelLayout").As<Napi::Number>().Int64Value());
+#endif
+
+            if (!timeBase.num)
+                timeBase = AVRational { 1, sampleRate };
+
+            args = "time_base=" + std::to_string(timeBase.num) + "/" + std::to_string(timeBase.den)
+                + ":sample_rate=" + std::to_string(sampleRate)
+                + ":sample_fmt=" + std::to_string(params.Get("sampleFormat").As<Napi::Number>().Int32Value())
+                + ":channel_layout=" + layout;
+        } else {
+            if (!timeBase.num) {
+                Napi::TypeError::New(env, "Video inputs need a timeBase").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+
+            AVRational aspect = params.Has("sampleAspectRatio") ? FromNRational(env, params.Get("sampleAspectRatio")) : AVRational { 1, 1 };
+
+            args = "video_size=" + std::to_string(params.Get("width").As<Napi::Number>().Int32Value())
+                + "x" + std::to_string(params.Get("height").As<Napi::Number>().Int32Value())
+                + ":pix_fmt=" + std::to_string(params.Get("pixelFormat").As<Napi::Number>().Int32Value())
+                + ":time_base=" + std::to_string(timeBase.num) + "/" + std::to_string(timeBase.den)
+                + ":pixel_aspect=" + std::to_string(aspect.num) + "/" + std::to_string(aspect.den);
+
+            if (params.Has("frameRate")) {
+                AVRational frameRate = FromNRational(env, params.Get("frameRate"));
+                args += ":frame_rate=" + std::to_string(frameRate.num) + "/" + std::to_string(frameRate.den);
+            }
+        }
+    }
+
+    auto filter = avfilter_get_by_name(input ? (audio ? "abuffer" : "buffer") : (audio ? "abuffersink" : "buffersink"));
+    int result = avfilter_graph_create_filter(&endpoint.context, filter, endpoint.name.c_str(), input ? args.c_str() : nullptr, nullptr, GetHandle());
+
+    if (result < 0)
+        return nlav_throw(env, result, "avfilter_graph_create_filter");
+
+    endpoints.push_back(endpoint);
+    return Napi::Number::New(env, endpoints.size() - 1);
+}
+
+NAVFilterEndpoint *NAVFilterGraph::FindEndpoint(std::vector<NAVFilterEndpoint> &endpoints, const char *name) {
+    for (auto &endpoint : endpoints) {
+        if (name ? endpoint.name == name : !endpoint.linked)
+            return &endpoint;
+    }
+
+    return nullptr;
+}
+
+/**
+ * Connect the open pads of a parsed graph description with our sources (the open inputs of the
+ * description) or sinks (its open outputs). Labeled pads go to the endpoint of the same name, unlabeled
+ * ones to the next endpoint not connected yet.
+ */
+int NAVFilterGraph::Link(AVFilterInOut *pads, bool inputs) {
+    auto &endpoints = inputs ? sources : sinks;
+
+    for (auto pad = pads; pad; pad = pad->next) {
+        auto endpoint = FindEndpoint(endpoints, pad->name);
+        if (!endpoint || endpoint->linked)
+            return AVERROR(EINVAL);
+
+        int result = inputs
+            ? avfilter_link(endpoint->context, 0, pad->filter_ctx, pad->pad_idx)
+            : avfilter_link(pad->filter_ctx, pad->pad_idx, endpoint->context, 0);
+
+        if (result < 0)
+            return result;
+
+        endpoint->linked = true;
+    }
+
+    return 0;
+}
+
+/**
+ * Parse the graph description (as for ffmpeg -filter_complex), connect it to the inputs and outputs,
+ * and start filtering.
+ */
+Napi::Value NAVFilterGraph::Open(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (opened) {
+        Napi::Error::New(env, "This filter graph is already opened").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (sources.empty() || sinks.empty()) {
+        Napi::Error::New(env, "The filter graph needs at least one input and one output (see addInput()/addOutput())").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto description = info[0].As<Napi::String>().Utf8Value();
+    AVFilterInOut *inputs = nullptr;
+    AVFilterInOut *outputs = nullptr;
+
+    int result = avfilter_graph_parse2(GetHandle(), description.c_str(), &inputs, &outputs);
+    if (result < 0)
+        return nlav_throw(env, result, "avfilter_graph_parse2");
+
+    int linkedInputs = Link(inputs, true);
+    int linkedOutputs = linkedInputs < 0 ? 0 : Link(outputs, false);
+
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+
+    if (linkedInputs < 0 || linkedOutputs < 0) {
+        Napi::Error::New(env, "The inputs/outputs of the graph description do not match the ones of the filter graph").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    for (auto &endpoint : sources) {
+        if (!endpoint.linked) {
+            Napi::Error::New(env, "Input '" + endpoint.name + "' is not used by the graph description").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+    }
+
+    for (auto &endpoint : sinks) {
+        if (!endpoint.linked) {
+            Napi::Error::New(env, "Output '" + endpoint.name + "' is not used by the graph description").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+    }
+
+    result = avfilter_graph_config(GetHandle(), nullptr);
+    if (result < 0)
+        return nlav_throw(env, result, "avfilter_graph_config");
+
+    opened = true;
+
+    if (useThreadPool) {
+        scheduler = NAVScheduler::Shared();
+        Wake();
+    } else {
+        thread = new std::thread([](NAVFilterGraph *graph) { graph->ThreadMain(); }, this);
+    }
+
+    return env.Undefined();
+}
+
+Napi::Value NAVFilterGraph::Configure(const Napi::CallbackInfo& info) {
+    return ApplyProperties(info);
+}
+
+Napi::Value NAVFilterGraph::Dump(const Napi::CallbackInfo& info) {
+    auto dump = avfilter_graph_dump(GetHandle(), nullptr);
+    if (!dump)
+        return info.Env().Null();
+
+    auto string = Napi::String::New(info.Env(), dump);
+    av_free(dump);
+    return string;
+}
+
+// Sending frames //////////////////////////////////////////////////////////////////////
+
+/**
+ * The frame for sendFrame(frame, input). The queued frame references the data of the given one, so
+ * the given frame can be reused right away.
+ */
+bool NAVFilterGraph::GetItem(const Napi::CallbackInfo& info, NAVFilterItem &item) {
+    auto env = info.Env();
+
+    if (!opened) {
+        Napi::Error::New(env, "The filter graph must be opened first").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    item.input = info.Length() > 1 ? info[1].As<Napi::Number>().Int32Value() : 0;
+
+    if (item.input < 0 || (size_t)item.input >= sources.size()) {
+        Napi::RangeError::New(env, "There is no input with index " + std::to_string(item.input)).ThrowAsJavaScriptException();
+        return false;
+    }
+
+    auto frameClass = LibAvAddon::Self(env)->GetConstructor(NAVFrame::ExportName())->Value();
+
+    if (!info[0].IsObject() || !info[0].As<Napi::Object>().InstanceOf(frameClass)) {
+        Napi::TypeError::New(env, "Expected an AVFrame to filter").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    auto frame = NAVFrame::Unwrap(info[0].As<Napi::Object>());
+    if (!frame->GetHandle()) {
+        Napi::Error::New(env, "The frame has been disposed").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    item.frame = av_frame_clone(frame->GetHandle());
+
+    if (!item.frame) {
+        Napi::Error::New(env, "Failed to reference the frame").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Queue a frame for the given input (0 by default). Returns false if the queue is full, in which case the
+ * frame is not taken.
+ */
+Napi::Value NAVFilterGraph::SendFrame(const Napi::CallbackInfo& info) {
+    NAVFilterItem item;
+
+    if (!GetItem(info, item))
+        return info.Env().Undefined();
+
+    bool queued = EnqueueWork(item);
+    if (!queued)
+        av_frame_free(&item.frame);
+
+    return Napi::Boolean::New(info.Env(), queued);
+}
+
+Napi::Value NAVFilterGraph::SendFrameAsync(const Napi::CallbackInfo& info) {
+    NAVFilterItem item;
+
+    if (!GetItem(info, item))
+        return info.Env().Undefined();
+
+    return EnqueueWorkAsync(info.Env(), item);
+}
+
+/**
+ * Mark the end of all inputs, so that the filters output what they have been holding back. onEnd is
+ * called once all outputs have ended. Resolves once queued.
+ */
+Napi::Value NAVFilterGraph::Flush(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (!opened) {
+        Napi::Error::New(env, "The filter graph must be opened first").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    Napi::Value promise;
+    for (size_t i = 0, max = sources.size(); i < max; ++i) {
+        NAVFilterItem item;
+        item.input = i;
+        promise = EnqueueWorkAsync(env, item);
+    }
+
+    // Items are queued in order, so the last one settles last
+    return promise;
+}
+
+// Properties //////////////////////////////////////////////////////////////////////////
+
+Napi::Value NAVFilterGraph::GetOnFrame(const Napi::CallbackInfo& info) {
+    return onFrame.IsEmpty() ? info.Env().Null() : onFrame.Value();
+}
+
+void NAVFilterGraph::SetOnFrame(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (onFrameValid) {
+        onFrameValid = false;
+        onFrameTSFN.Release();
+    }
+
+    onFrame.Reset();
+
+    if (value.IsFunction()) {
+        auto func = value.As<Napi::Function>();
+        onFrame = Napi::Persistent(func);
+        onFrameTSFN = Napi::ThreadSafeFunction::New(info.Env(), func, "AVFilterGraph#onFrame", 0, 1);
+        onFrameValid = true;
+        Wake();
+    }
+}
+
+Napi::Value NAVFilterGraph::GetOnError(const Napi::CallbackInfo& info) {
+    return onError.IsEmpty() ? info.Env().Null() : onError.Value();
+}
+
+void NAVFilterGraph::SetOnError(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (onErrorValid) {
+        onErrorValid = false;
+        onErrorTSFN.Release();
+    }
+
+    onError.Reset();
+
+    if (value.IsFunction()) {
+        auto func = value.As<Napi::Function>();
+        onError = Napi::Persistent(func);
+        onErrorTSFN = Napi::ThreadSafeFunction::New(info.Env(), func, "AVFilterGraph#onError", 0, 1);
+        onErrorValid = true;
+    }
+}
+
+Napi::Value NAVFilterGraph::GetOnEnd(const Napi::CallbackInfo& info) {
+    return onEnd.IsEmpty() ? info.Env().Null() : onEnd.Value();
+}
+
+void NAVFilterGraph::SetOnEnd(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (onEndValid) {
+        onEndValid = false;
+        onEndTSFN.Release();
+    }
+
+    onEnd.Reset();
+
+    if (value.IsFunction()) {
+        auto func = value.As<Napi::Function>();
+        onEnd = Napi::Persistent(func);
+        onEndTSFN = Napi::ThreadSafeFunction::New(info.Env(), func, "AVFilterGraph#onEnd", 0, 1);
+        onEndValid = true;
+    }
+}
+
+Napi::Value NAVFilterGraph::AddInput(const Napi::CallbackInfo& info) {
+    return AddEndpoint(info, true);
+}
+
+Napi::Value NAVFilterGraph::AddOutput(const Napi::CallbackInfo& info) {
+    return AddEndpoint(info, false);
+}
+
+Napi::Value NAVFilterGraph::GetOpened(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), opened);
+}
+
+Napi::Value NAVFilterGraph::GetInputs(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), sources.size());
+}
+
+Napi::Value NAVFilterGraph::GetOutputs(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), sinks.size());
+}
+
+Napi::Value NAVFilterGraph::GetQueueDepth(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), inQueue.Size());
+}
+
+Napi::Value NAVFilterGraph::GetMaxQueuedItems(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), maxQueuedItems);
+}
+
+void NAVFilterGraph::SetMaxQueuedItems(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    int64_t max = value.As<Napi::Number>().Int64Value();
+
+    if (max < 1) {
+        Napi::RangeError::New(info.Env(), "maxQueuedItems must be at least 1").ThrowAsJavaScriptException();
+        return;
+    }
+
+    // The ring can only be resized while the filter thread is not running
+    if ((size_t)max > inQueue.Capacity()) {
+        if (!CheckNotOpened(info.Env(), "maxQueuedItems above " + std::to_string(inQueue.Capacity())))
+            return;
+
+        inQueue.Reset(max);
+    }
+
+    maxQueuedItems = max;
+}
+
+Napi::Value NAVFilterGraph::GetThreads(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->nb_threads);
+}
+
+/**
+ * Number of threads libavfilter uses within filters which support slice threading. 0 means automatic.
+ */
+void NAVFilterGraph::SetThreads(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (CheckNotOpened(info.Env(), "threads"))
+        GetHandle()->nb_threads = value.As<Napi::Number>().Int32Value();
+}
+
+Napi::Value NAVFilterGraph::GetUseThreadPool(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), useThreadPool);
+}
+
+void NAVFilterGraph::SetUseThreadPool(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (CheckNotOpened(info.Env(), "useThreadPool"))
+        useThreadPool = value.ToBoolean().Value();
+}
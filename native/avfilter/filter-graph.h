@@ -0,0 +1,185 @@
+#include "../common.h"
+
+#include <napi.h>
+#include "../resource.h"
+#include "../spsc-queue.h"
+#include "../handle-pool.h"
+#include "../scheduler.h"
+#include <memory>
+#include <thread>
+#include <deque>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C" {
+    #include <libavfilter/avfilter.h>
+}
+
+/**
+ * Number of filtered frames posted to onFrame which JS has not been given yet, at which the filter thread
+ * stops running the graph until JS catches up (see NAVFilterGraph::DeliverFrame()).
+ */
+#define NLAV_FILTER_MAX_POSTED_FRAMES 8
+
+/**
+ * A frame for one of the inputs of a filter graph. Without a frame, the input has reached its end.
+ */
+struct NAVFilterItem {
+    AVFrame *frame = nullptr;
+    int input = 0;
+};
+
+/**
+ * A send which is waiting for room in the work queue (see sendFrameAsync)
+ */
+struct NAVFilterPendingSend {
+    NAVFilterItem item;
+    Napi::Promise::Deferred deferred;
+};
+
+/**
+ * An input (buffer/abuffer) or output (buffersink/abuffersink) of a filter graph, matched by name with
+ * the labels of the graph description.
+ */
+struct NAVFilterEndpoint {
+    std::string name;
+    AVFilterContext *context = nullptr;
+    bool linked = false;
+    bool ended = false;
+};
+
+/**
+ * A libavfilter graph running on a thread of its own or on the shared thread pool (see useThreadPool),
+ * like NAVCodecContext. Frames are sent in with sendFrame()/sendFrameAsync(), and the filtered frames
+ * come out through onFrame, so filtering never blocks the JS thread.
+ */
+class NAVFilterGraph : public NAVResource<NAVFilterGraph, AVFilterGraph>, public NAVScheduledTask {
+    public:
+        NAVFilterGraph(const Napi::CallbackInfo& info);
+
+        inline static std::string ExportName() { return "AVFilterGraph"; }
+        inline static Napi::Function ClassDefinition(const Napi::Env &env) {
+            return DefineClass(env, "AVFilterGraph", {
+                R_ACCESSOR("onFrame", &NAVFilterGraph::GetOnFrame, &NAVFilterGraph::SetOnFrame),
+                R_ACCESSOR("onError", &NAVFilterGraph::GetOnError, &NAVFilterGraph::SetOnError),
+                R_ACCESSOR("onEnd", &NAVFilterGraph::GetOnEnd, &NAVFilterGraph::SetOnEnd),
+
+                R_METHOD("addInput", &NAVFilterGraph::AddInput),
+                R_METHOD("addOutput", &NAVFilterGraph::AddOutput),
+                R_METHOD("open", &NAVFilterGraph::Open),
+                R_METHOD("configure", &NAVFilterGraph::Configure),
+                R_METHOD("sendFrame", &NAVFilterGraph::SendFrame),
+                R_METHOD("sendFrameAsync", &NAVFilterGraph::SendFrameAsync),
+                R_METHOD("flush", &NAVFilterGraph::Flush),
+                R_METHOD("dump", &NAVFilterGraph::Dump),
+
+                R_GETTER("opened", &NAVFilterGraph::GetOpened),
+                R_GETTER("inputs", &NAVFilterGraph::GetInputs),
+                R_GETTER("outputs", &NAVFilterGraph::GetOutputs),
+                R_GETTER("queueDepth", &NAVFilterGraph::GetQueueDepth),
+                R_ACCESSOR("maxQueuedItems", &NAVFilterGraph::GetMaxQueuedItems, &NAVFilterGraph::SetMaxQueuedItems),
+                R_ACCESSOR("threads", &NAVFilterGraph::GetThreads, &NAVFilterGraph::SetThreads),
+                R_ACCESSOR("useThreadPool", &NAVFilterGraph::GetUseThreadPool, &NAVFilterGraph::SetUseThreadPool)
+            });
+        }
+
+        virtual void Free();
+        virtual bool RunScheduled();
+
+    private:
+        void ThreadMain();
+        bool Step();
+        bool FeedToGraph();
+        bool PullFromGraph();
+        bool Backlogged();
+        void DeliverFrame(AVFrame *frame, int output);
+        void SendError(std::string code, std::string message);
+
+        bool CheckNotOpened(const Napi::Env &env, std::string property);
+        Napi::Value AddEndpoint(const Napi::CallbackInfo& info, bool input);
+        int Link(AVFilterInOut *pads, bool inputs);
+        NAVFilterEndpoint *FindEndpoint(std::vector<NAVFilterEndpoint> &endpoints, const char *name);
+        bool GetItem(const Napi::CallbackInfo& info, NAVFilterItem &item);
+
+        // Threading infrastructure (see NAVCodecContext)
+
+        bool EnqueueWork(NAVFilterItem item);
+        Napi::Value EnqueueWorkAsync(const Napi::Env &env, NAVFilterItem item);
+        void PopWorkItem();
+        void WaitForWork();
+        void Wake();
+        void RequestDrain(const Napi::Env &env);
+        void OnQueueDrained(Napi::Env env);
+
+        static Napi::Value WrapPoolFrame(const Napi::Env &env, std::shared_ptr<NAVFramePool> pool, AVFrame *frame);
+
+        bool opened = false;
+        std::vector<NAVFilterEndpoint> sources;
+        std::vector<NAVFilterEndpoint> sinks;
+        size_t endedSinks = 0;
+
+        std::thread *thread = nullptr;
+        bool useThreadPool = false;
+        std::atomic<NAVScheduler*> scheduler;
+
+        std::mutex mutex;
+        std::condition_variable threadWake;
+        std::atomic<bool> wakePending;
+        std::atomic<bool> running;
+        SPSCQueue<NAVFilterItem> inQueue;
+        size_t maxQueuedItems;
+
+        // Sends waiting for room in the queue, in order. JS thread only.
+        std::deque<NAVFilterPendingSend> pendingSends;
+        Napi::ThreadSafeFunction onDrainTSFN;
+        std::atomic<bool> drainRequested;
+        bool drainArmed = false;
+
+        // Shared with the NAVFrame instances we hand out, which may outlive us
+        std::shared_ptr<NAVFramePool> framePool;
+
+        // Frames posted to onFrame which have not reached JS yet, shared with the posted calls (see 
+        // DeliverFrame()). They only wake us while alive, which Free() clears.
+        std::shared_ptr<std::atomic<int>> postedFrames;
+        std::shared_ptr<bool> alive;
+
+        Napi::FunctionReference onFrame;
+        Napi::FunctionReference onError;
+        Napi::FunctionReference onEnd;
+        std::atomic<bool> onFrameValid;
+        std::atomic<bool> onErrorValid;
+        std::atomic<bool> onEndValid;
+        Napi::ThreadSafeFunction onFrameTSFN;
+        Napi::ThreadSafeFunction onErrorTSFN;
+        Napi::ThreadSafeFunction onEndTSFN;
+
+        Napi::Value GetOnFrame(const Napi::CallbackInfo& info);
+        void SetOnFrame(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetOnError(const Napi::CallbackInfo& info);
+        void SetOnError(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetOnEnd(const Napi::CallbackInfo& info);
+        void SetOnEnd(const Napi::CallbackInfo& info, const Napi::Value &value);
+
+        Napi::Value AddInput(const Napi::CallbackInfo& info);
+        Napi::Value AddOutput(const Napi::CallbackInfo& info);
+        Napi::Value Open(const Napi::CallbackInfo& info);
+        Napi::Value Configure(const Napi::CallbackInfo& info);
+        Napi::Value SendFrame(const Napi::CallbackInfo& info);
+        Napi::Value SendFrameAsync(const Napi::CallbackInfo& info);
+        Napi::Value Flush(const Napi::CallbackInfo& info);
+        Napi::Value Dump(const Napi::CallbackInfo& info);
+
+        Napi::Value GetOpened(const Napi::CallbackInfo& info);
+        Napi::Value GetInputs(const Napi::CallbackInfo& info);
+        Napi::Value GetOutputs(const Napi::CallbackInfo& info);
+        Napi::Value GetQueueDepth(const Napi::CallbackInfo& info);
+        Napi::Value GetMaxQueuedItems(const Napi::CallbackInfo& info);
+        void SetMaxQueuedItems(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetThreads(const Napi::CallbackInfo& info);
+        void SetThreads(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetUseThreadPool(const Napi::CallbackInfo& info);
+        void SetUseThreadPool(const Napi::CallbackInfo& info, const Napi::Value &value);
+};
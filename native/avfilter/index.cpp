@@ -0,0 +1,6 @@
+#include "index.h"
+#include "filter-graph.h"
+
+void nlavfi_init(Napi::Env env, Napi::Object exports) {
+    NAVFilterGraph::Register(env, exports);
+}
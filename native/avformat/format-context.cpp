@@ -0,0 +1,1456 @@
+#include "format-context.h"
+#include "stream.h"
+#include "io-context.h"
+#include "../common.h"
+#include "../avcodec/codec-context.h"
+#include "../avcodec/packet.h"
+#include "../avutil/dict.h"
+
+NAVFormatContext::NAVFormatContext(const Napi::CallbackInfo& info):
+    NAVResource(info),
+    stopRequested(false),
+    packetPool(std::make_shared<NAVPacketPool>()),
+    inFlight(0),
+    readAheadPackets(NLAV_DEFAULT_READ_AHEAD),
+    batchSize(1),
+    maxBatchLatencyUs(0),
+    writeBatchSize(NLAV_DEFAULT_WRITE_BATCH),
+    maxWriteLatencyUs(0),
+    flushAfterBatch(false)
+{
+    if (ConstructFromHandle(info))
+        return;
+
+    SetHandle(AllocateContext(this));
+}
+
+/**
+ * Allocate a format context whose blocking I/O is interrupted once the read thread is asked to stop.
+ */
+AVFormatContext *NAVFormatContext::AllocateContext(NAVFormatContext *self) {
+    auto context = avformat_alloc_context();
+
+    if (context) {
+        context->interrupt_callback.callback = &NAVFormatContext::InterruptCallback;
+        context->interrupt_callback.opaque = self;
+    }
+
+    return context;
+}
+
+int NAVFormatContext::InterruptCallback(void *opaque) {
+    return ((NAVFormatContext*)opaque)->stopRequested.load(std::memory_order_relaxed) ? 1 : 0;
+}
+
+size_t NAVFormatContext::GetExternalMemorySize() {
+    return sizeof(AVFormatContext);
+}
+
+void NAVFormatContext::Free() {
+    // End the threads before releasing the context they are using
+    StopThread();
+    StopWriter();
+
+    if (probing) {
+        stopRequested = true;
+        if (ioContext)
+            ioContext->Interrupt(true);
+    }
+
+    // Waits for an async open/probe which is using the context (see NAVFormatProbeWorker)
+    std::unique_lock<std::mutex> probeLock(probeMutex);
+    FinishProbe();
+
+    for (auto route : routes) {
+        if (route)
+            route->DetachProducer();
+    }
+
+    routes.clear();
+    routeReferences.clear();
+
+    // The threads are done with the I/O context, even if OnStopped() & co. have yet to run
+    if (ioContext)
+        ioContext->busy -= ioBusy;
+
+    ioBusy = 0;
+    ioContext = nullptr;
+    ioReference.Reset();
+
+    // Stream wrappers would otherwise outlive their streams
+
+    auto env = Env();
+    auto handle = GetHandle();
+
+    for (unsigned int i = 0; i < handle->nb_streams; ++i) {
+        auto stream = LibAvAddon::Self(env)->GetResource<NAVStream>(handle->streams[i]);
+        if (stream)
+            stream->Dispose(env);
+    }
+
+    if (inputOpened) {
+        avformat_close_input(&handle);
+    } else {
+        CloseOutput();
+        avformat_free_context(handle);
+        handle = nullptr;
+    }
+
+    SetHandle(handle);
+}
+
+/**
+ * Use our custom I/O context (if any) for the given context, such as a newly allocated one.
+ */
+void NAVFormatContext::ApplyIOContext(AVFormatContext *context) {
+    if (!ioContext)
+        return;
+
+    context->pb = ioContext->GetHandle();
+    context->flags |= AVFMT_FLAG_CUSTOM_IO;
+}
+
+/**
+ * Mark our custom I/O context (if any) as in use by a thread or async open/probe, so that it cannot be
+ * disposed of under it. Balanced by ReleaseIOContext(). JS thread only.
+ */
+void NAVFormatContext::AcquireIOContext() {
+    if (!ioContext)
+        return;
+
+    ++ioContext->busy;
+    ++ioBusy;
+}
+
+void NAVFormatContext::ReleaseIOContext() {
+    if (!ioContext || ioBusy == 0)
+        return;
+
+    --ioContext->busy;
+    --ioBusy;
+}
+
+bool NAVFormatContext::CheckNotProbing(const Napi::Env &env) {
+    if (!probing)
+        return true;
+
+    Napi::Error::New(env, "This is not possible while the format context is reading its input (see openInputAsync() / findStreamInfoAsync())").ThrowAsJavaScriptException();
+    return false;
+}
+
+bool NAVFormatContext::CheckNotReading(const Napi::Env &env) {
+    if (!CheckNotProbing(env))
+        return false;
+
+    if (!readerActive)
+        return true;
+
+    Napi::Error::New(env, "This is not possible while the format context is reading (see stopReading())").ThrowAsJavaScriptException();
+    return false;
+}
+
+/**
+ * For settings the write thread uses, which are only read once it is done (see writeTrailer()).
+ */
+bool NAVFormatContext::CheckNotWriting(const Napi::Env &env) {
+    if (!writerActive)
+        return true;
+
+    Napi::Error::New(env, "This is not possible while the format context is writing (see writeTrailer())").ThrowAsJavaScriptException();
+    return false;
+}
+
+Napi::Value NAVFormatContext::OpenInput(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (inputOpened || outputOpened) {
+        Napi::Error::New(env, "This format context is already opened. You cannot reuse a format context.").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (!CheckNotReading(env))
+        return env.Undefined();
+
+    std::string url = info[0].As<Napi::String>().Utf8Value();
+    const AVInputFormat *format = nullptr;
+
+    if (info.Length() > 1 && info[1].IsString()) {
+        std::string formatName = info[1].As<Napi::String>().Utf8Value();
+        format = av_find_input_format(formatName.c_str());
+
+        if (!format) {
+            Napi::Error::New(env, "Unknown input format '" + formatName + "'").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+    }
+
+    NAVDictionary *nOptions = nullptr;
+    AVDictionary *options = nullptr;
+    if (info.Length() > 2 && info[2].IsObject()) {
+        nOptions = NAVDictionary::Unwrap(info[2].As<Napi::Object>());
+        options = nOptions->GetHandle();
+    }
+
+    auto handle = GetHandle();
+    int result = avformat_open_input(&handle, url.c_str(), format, &options);
+
+    if (nOptions)
+        nOptions->SetHandle(options);
+
+    FinishOpenInput(handle, result);
+    if (result < 0)
+        return nlav_throw(env, result, "avformat_open_input");
+
+    return env.Undefined();
+}
+
+/**
+ * Take over the context avformat_open_input() gave back. JS thread only.
+ */
+void NAVFormatContext::FinishOpenInput(AVFormatContext *handle, int result) {
+    if (result < 0) {
+        // avformat_open_input() frees the context when it fails, start over with a new one
+        SetHandle(nullptr);
+        SetHandle(AllocateContext(this));
+        ApplyIOContext(GetHandle());
+        return;
+    }
+
+    inputOpened = true;
+    SetHandle(handle);
+}
+
+/**
+ * Take over the outcome of an async open, if it has not been taken over yet: the worker may be done
+ * with the context before its completion runs (and before dispose()). JS thread only, with
+ * probeMutex held.
+ */
+void NAVFormatContext::FinishProbe() {
+    if (!openPending)
+        return;
+
+    openPending = false;
+    FinishOpenInput(openedHandle, openResult);
+    openedHandle = nullptr;
+}
+
+Napi::Value NAVFormatContext::FindStreamInfo(const Napi::CallbackInfo& info) {
+    if (!CheckNotReading(info.Env()))
+        return info.Env().Undefined();
+
+    int result = avformat_find_stream_info(GetHandle(), nullptr);
+    if (result < 0)
+        return nlav_throw(info.Env(), result, "avformat_find_stream_info");
+
+    return info.Env().Undefined();
+}
+
+/**
+ * Runs avformat_open_input() or avformat_find_stream_info() on a libuv worker thread. Both read the
+ * input, which for a custom I/O context only arrives once the JS thread is free to write it.
+ */
+class NAVFormatProbeWorker : public Napi::AsyncWorker {
+    public:
+        NAVFormatProbeWorker(Napi::Env env, NAVFormatContext *context, bool open):
+            Napi::AsyncWorker(env, open ? "AVFormatContext#openInputAsync" : "AVFormatContext#findStreamInfoAsync"),
+            deferred(Napi::Promise::Deferred::New(env)),
+            context(context),
+            open(open)
+        {
+            contextReference = Napi::Persistent(context->Value());
+        }
+
+        Napi::Promise Promise() {
+            return deferred.Promise();
+        }
+
+        std::string url;
+        const AVInputFormat *format = nullptr;
+        NAVDictionary *nOptions = nullptr;
+        AVDictionary *options = nullptr;
+        Napi::ObjectReference optionsReference;
+
+    protected:
+        void Execute() {
+            // Keeps dispose() from freeing the context under us, see Free()
+            std::unique_lock<std::mutex> lock(context->probeMutex);
+
+            auto handle = context->GetHandle();
+            if (!handle) {
+                disposed = true;
+                return;
+            }
+
+            if (!open) {
+                result = avformat_find_stream_info(handle, nullptr);
+                return;
+            }
+
+            result = avformat_open_input(&handle, url.c_str(), format, &options);
+            context->openedHandle = handle;
+            context->openResult = result;
+            context->openPending = true;
+        }
+
+        void OnOK() {
+            auto env = Env();
+
+            {
+                std::unique_lock<std::mutex> lock(context->probeMutex);
+                context->FinishProbe();
+            }
+
+            context->probing = false;
+            context->ReleaseIOContext();
+
+            // avformat_open_input() replaces the dictionary (with the unused options) even when it fails
+            if (open && nOptions)
+                nOptions->SetHandle(options);
+
+            if (disposed || !context->GetHandle()) {
+                deferred.Reject(Napi::Error::New(env, "The format context was disposed before the input could be read").Value());
+                return;
+            }
+
+            if (result < 0) {
+                std::string function = open ? "avformat_open_input" : "avformat_find_stream_info";
+                deferred.Reject(Napi::Error::New(env, "[" + function + "] libav: " + nlavu_get_error_string(result)).Value());
+                return;
+            }
+
+            deferred.Resolve(env.Undefined());
+        }
+
+    private:
+        Napi::Promise::Deferred deferred;
+        NAVFormatContext *context;
+        Napi::ObjectReference contextReference;
+        bool open;
+        bool disposed = false;
+        int result = 0;
+};
+
+Napi::Value NAVFormatContext::OpenInputAsync(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (inputOpened || outputOpened) {
+        Napi::Error::New(env, "This format context is already opened. You cannot reuse a format context.").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (!CheckNotReading(env))
+        return env.Undefined();
+
+    auto worker = new NAVFormatProbeWorker(env, this, true);
+    worker->url = info[0].As<Napi::String>().Utf8Value();
+
+    if (info.Length() > 1 && info[1].IsString()) {
+        std::string formatName = info[1].As<Napi::String>().Utf8Value();
+        worker->format = av_find_input_format(formatName.c_str());
+
+        if (!worker->format) {
+            delete worker;
+            Napi::Error::New(env, "Unknown input format '" + formatName + "'").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+    }
+
+    if (info.Length() > 2 && info[2].IsObject()) {
+        worker->nOptions = NAVDictionary::Unwrap(info[2].As<Napi::Object>());
+        worker->options = worker->nOptions->GetHandle();
+        worker->optionsReference = Napi::Persistent(info[2].As<Napi::Object>());
+    }
+
+    probing = true;
+    stopRequested = false;
+    AcquireIOContext();
+    if (ioContext)
+        ioContext->Interrupt(false);
+
+    auto promise = worker->Promise();
+    worker->Queue();
+
+    return promise;
+}
+
+Napi::Value NAVFormatContext::FindStreamInfoAsync(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (!inputOpened) {
+        Napi::Error::New(env, "The format context must be opened with openInput() first").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (!CheckNotReading(env))
+        return env.Undefined();
+
+    probing = true;
+    stopRequested = false;
+    AcquireIOContext();
+    if (ioContext)
+        ioContext->Interrupt(false);
+
+    auto worker = new NAVFormatProbeWorker(env, this, false);
+    auto promise = worker->Promise();
+    worker->Queue();
+
+    return promise;
+}
+
+Napi::Value NAVFormatContext::ReadFrame(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (!CheckNotReading(env))
+        return env.Undefined();
+
+    NAVPacket *packet;
+
+    if (info.Length() > 0 && info[0].IsObject()) {
+        packet = NAVPacket::UnwrapArgument(env, info[0]);
+        if (!packet)
+            return env.Undefined();
+        
+        av_packet_unref(packet->GetHandle());
+    } else {
+        packet = LibAvAddon::Construct<NAVPacket>(env);
+    }
+
+    int result = av_read_frame(GetHandle(), packet->GetHandle());
+
+    if (result == AVERROR_EOF)
+        return env.Null();
+
+    if (result < 0)
+        return nlav_throw(env, result, "av_read_frame");
+
+    packet->UpdateExternalMemory(env);
+    return packet->Value();
+}
+
+Napi::Value NAVFormatContext::StartReading(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (!inputOpened) {
+        Napi::Error::New(env, "The format context must be opened with openInput() first").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (!CheckNotReading(env))
+        return env.Undefined();
+
+    auto noop = Napi::Function::New(env, [](const Napi::CallbackInfo&) { });
+    eventsTSFN = Napi::ThreadSafeFunction::New(env, noop, "AVFormatContext#read", 0, 1);
+
+    // Keep ourselves alive until OnStopped(), as the thread's events refer to us
+
+    readerActive = true;
+    stopRequested = false;
+    inFlight = 0;
+    AcquireIOContext();
+    Ref();
+
+    if (ioContext)
+        ioContext->Interrupt(false);
+
+    thread = new std::thread([](NAVFormatContext *context) { context->ThreadMain(); }, this);
+
+    return env.Undefined();
+}
+
+Napi::Value NAVFormatContext::StopReading(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+
+    if (!readerActive) {
+        deferred.Resolve(env.Undefined());
+        return deferred.Promise();
+    }
+
+    // Resolved by OnStopped(), once all packets the thread has read have been delivered
+    stopDeferreds.push_back(deferred);
+    StopThread();
+
+    return deferred.Promise();
+}
+
+Napi::Value NAVFormatContext::RouteStream(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (!CheckNotReading(env))
+        return env.Undefined();
+
+    int index = info[0].As<Napi::Number>().Int32Value();
+    if (index < 0 || (unsigned int)index >= GetHandle()->nb_streams) {
+        Napi::RangeError::New(env, "There is no stream with index " + std::to_string(index)).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto object = info[1].As<Napi::Object>();
+    auto context = NAVCodecContext::Unwrap(object);
+
+    if ((size_t)index < routes.size() && routes[index] == context)
+        return env.Undefined();
+
+    if (!context->AttachProducer()) {
+        Napi::Error::New(env, "The codec context is already fed by another stream").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if ((size_t)index >= routes.size())
+        routes.resize(index + 1, nullptr);
+
+    if (routes[index])
+        routes[index]->DetachProducer();
+
+    routes[index] = context;
+    routeReferences[index] = Napi::Persistent(object);
+
+    return env.Undefined();
+}
+
+Napi::Value NAVFormatContext::UnrouteStream(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (!CheckNotReading(env))
+        return env.Undefined();
+
+    int index = info[0].As<Napi::Number>().Int32Value();
+    if (index < 0 || (size_t)index >= routes.size() || !routes[index])
+        return env.Undefined();
+
+    routes[index]->DetachProducer();
+    routes[index] = nullptr;
+    routeReferences.erase(index);
+
+    return env.Undefined();
+}
+
+void NAVFormatContext::ThreadMain() {
+    AVFormatContext *context = GetHandle();
+    AVPacket *packet = av_packet_alloc();
+    bool ended = false;
+
+    while (WaitForReadAhead()) {
+        int result = av_read_frame(context, packet);
+
+        // Some inputs (devices in particular) have nothing to offer right now
+        if (result == AVERROR(EAGAIN)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        if (result == AVERROR_EOF) {
+            ended = true;
+            break;
+        }
+
+        if (result < 0) {
+            if (!stopRequested)
+                PostError(result, "av_read_frame");
+            break;
+        }
+
+        // Routed packets go straight to the codec context's queue. This blocks while the codec
+        // context is full, which in turn holds back reading.
+
+        int index = packet->stream_index;
+        if (index >= 0 && (size_t)index < routes.size() && routes[index]) {
+            AVPacket *routed = av_packet_alloc();
+            av_packet_move_ref(routed, packet);
+
+            if (!routes[index]->PushFromProducer(routed, stopRequested))
+                av_packet_free(&routed);
+            continue;
+        }
+
+        AVPacket *delivered = packetPool->Acquire();
+        av_packet_move_ref(delivered, packet);
+        DeliverPacket(delivered);
+    }
+
+    av_packet_free(&packet);
+    FlushBatch(true);
+
+    // The codec contexts we route to drain what they still hold on to, then pass the end along
+    if (ended) {
+        for (auto route : routes) {
+            if (route)
+                route->PushEndOfStreamFromProducer(stopRequested);
+        }
+    }
+
+    eventsTSFN.NonBlockingCall([this, ended](Napi::Env env, Napi::Function) {
+        OnStopped(env, ended);
+    });
+    eventsTSFN.Release();
+}
+
+/**
+ * Read thread only. Wait until Javascript has caught up with the packets we delivered (see
+ * readAheadPackets). Returns false once the thread should stop.
+ */
+bool NAVFormatContext::WaitForReadAhead() {
+    if (inFlight.load() < readAheadPackets.load())
+        return !stopRequested;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    threadWake.wait(lock, [this]() {
+        return stopRequested || inFlight.load() < readAheadPackets.load();
+    });
+
+    return !stopRequested;
+}
+
+void NAVFormatContext::WakeReader() {
+    std::unique_lock<std::mutex> lock(mutex);
+    threadWake.notify_one();
+}
+
+/**
+ * Ask the read thread to stop, interrupting blocking I/O and sends to routed codec contexts, and
+ * wait for it to finish. JS thread only.
+ */
+void NAVFormatContext::StopThread() {
+    if (!thread)
+        return;
+
+    stopRequested = true;
+    WakeReader();
+
+    if (ioContext)
+        ioContext->Interrupt(true);
+
+    for (auto route : routes) {
+        if (route)
+            route->WakeProducer();
+    }
+
+    thread->join();
+    delete thread;
+    thread = nullptr;
+}
+
+/**
+ * Send a packet to the main thread, either on its own or as part of a batch once batchSize
+ * packets have been collected. Read thread only.
+ */
+void NAVFormatContext::DeliverPacket(AVPacket *packet) {
+    if (batchSize <= 1 && packetBatch.empty()) {
+        PostPackets(std::vector<AVPacket*> { packet }, false);
+        return;
+    }
+
+    if (packetBatch.empty())
+        batchStarted = std::chrono::steady_clock::now();
+
+    packetBatch.push_back(packet);
+    FlushBatch(packetBatch.size() >= batchSize);
+}
+
+/**
+ * Send the collected packets to the main thread as a single array. Unless force is set, a partial
+ * batch is held back until it is maxBatchLatencyUs old. As this is only checked after each read, a
+ * partial batch may be held longer while the input has no data. Read thread only.
+ */
+void NAVFormatContext::FlushBatch(bool force) {
+    if (packetBatch.empty())
+        return;
+
+    auto deadline = batchStarted + std::chrono::microseconds(maxBatchLatencyUs.load());
+    if (!force && std::chrono::steady_clock::now() < deadline)
+        return;
+
+    std::vector<AVPacket*> batch;
+    batch.swap(packetBatch);
+    PostPackets(batch, true);
+}
+
+void NAVFormatContext::PostPackets(std::vector<AVPacket*> packets, bool asArray) {
+    inFlight += packets.size();
+
+    auto status = eventsTSFN.NonBlockingCall([this, packets, asArray](Napi::Env env, Napi::Function) {
+        OnPackets(env, packets, asArray);
+    });
+
+    if (status != napi_ok) {
+        inFlight -= packets.size();
+        for (auto packet : packets)
+            packetPool->Release(packet);
+    }
+}
+
+void NAVFormatContext::PostError(int code, std::string context) {
+    std::string message = "An error occurred during " + context + ": " + nlavu_get_error_string(code);
+
+    eventsTSFN.NonBlockingCall([this, code, message](Napi::Env env, Napi::Function) {
+        if (onError.IsEmpty())
+            return;
+
+        Napi::Object error = Napi::Object::New(env);
+        error.Set("code", "averror:" + std::to_string(code));
+        error.Set("message", message);
+        onError.Call({ error });
+    });
+}
+
+/**
+ * Wrap a packet read by the thread. The packet returns to our pool (rather than being freed) once
+ * JS is done with it. JS thread only.
+ */
+Napi::Value NAVFormatContext::WrapPacket(const Napi::Env &env, AVPacket *packet) {
+    auto instance = NAVPacket::FromHandle(env, packet, true);
+    instance->SetPool(packetPool);
+    return instance->Value();
+}
+
+void NAVFormatContext::OnPackets(Napi::Env env, std::vector<AVPacket*> packets, bool asArray) {
+    LibAvAddon::Self(env)->FlushDeferredReleases();
+
+    inFlight -= packets.size();
+    WakeReader();
+
+    if (onPacket.IsEmpty()) {
+        for (auto packet : packets)
+            packetPool->Release(packet);
+        return;
+    }
+
+    if (!asArray) {
+        onPacket.Call({ WrapPacket(env, packets[0]) });
+        return;
+    }
+
+    auto array = Napi::Array::New(env, packets.size());
+    for (uint32_t i = 0, max = packets.size(); i < max; ++i)
+        array.Set(i, WrapPacket(env, packets[i]));
+    onPacket.Call({ array });
+}
+
+void NAVFormatContext::OnStopped(Napi::Env env, bool ended) {
+    // The thread stopped on its own (end of input or an error)
+    if (thread) {
+        thread->join();
+        delete thread;
+        thread = nullptr;
+    }
+
+    readerActive = false;
+    stopRequested = false;
+    ReleaseIOContext();
+
+    for (auto &deferred : stopDeferreds)
+        deferred.Resolve(env.Undefined());
+    stopDeferreds.clear();
+
+    if (ended && !onEnd.IsEmpty())
+        onEnd.Call({});
+
+    Unref();
+}
+
+Napi::Value NAVFormatContext::OpenOutput(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (inputOpened || outputOpened) {
+        Napi::Error::New(env, "This format context is already opened. You cannot reuse a format context.").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (!CheckNotReading(env))
+        return env.Undefined();
+
+    std::string url = info[0].As<Napi::String>().Utf8Value();
+    std::string formatName;
+    bool hasFormat = info.Length() > 1 && info[1].IsString();
+
+    if (hasFormat)
+        formatName = info[1].As<Napi::String>().Utf8Value();
+
+    AVFormatContext *context = nullptr;
+    int result = avformat_alloc_output_context2(&context, nullptr, hasFormat ? formatName.c_str() : nullptr, url.c_str());
+
+    if (result < 0)
+        return nlav_throw(env, result, "avformat_alloc_output_context2");
+
+    // Keep the settings made so far, and our interrupt callback
+    auto previous = GetHandle();
+    context->interrupt_callback = previous->interrupt_callback;
+    context->flags = previous->flags;
+    context->max_interleave_delta = previous->max_interleave_delta;
+    ApplyIOContext(context);
+
+    // The output itself is opened by the write thread (see OpenAndWriteHeader()), as connecting to a
+    // network output can take a while
+
+    SetHandle(nullptr);
+    avformat_free_context(previous);
+    SetHandle(context);
+    outputOpened = true;
+
+    // Packets routed from encoders may arrive before writeHeader(), they wait in the queue
+    std::unique_lock<std::mutex> lock(writeMutex);
+    writeQueueOpen = true;
+
+    return env.Undefined();
+}
+
+Napi::Value NAVFormatContext::NewStream(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (!outputOpened || writerActive) {
+        Napi::Error::New(env, "Streams can only be added after openOutput() and before writeHeader()").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto handle = GetHandle();
+    AVStream *stream = avformat_new_stream(handle, nullptr);
+
+    if (!stream) {
+        Napi::Error::New(env, "Failed to allocate a new stream").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    // Describe the stream using an (opened) encoder
+    if (info.Length() > 0 && info[0].IsObject()) {
+        auto context = NAVCodecContext::Unwrap(info[0].As<Napi::Object>());
+        int result = avcodec_parameters_from_context(stream->codecpar, context->GetHandle());
+
+        if (result < 0)
+            return nlav_throw(env, result, "avcodec_parameters_from_context");
+
+        stream->time_base = context->GetHandle()->time_base;
+    }
+
+    return NAVStream::FromStream(env, stream, Value());
+}
+
+Napi::Value NAVFormatContext::WriteHeader(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (!outputOpened) {
+        Napi::Error::New(env, "The format context must be opened with openOutput() first").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (writerActive || writerClosing) {
+        Napi::Error::New(env, "The header has already been written").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    // Used by the write thread until OnHeaderWritten()
+    headerOptionsDictionary = nullptr;
+    headerOptions = nullptr;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        headerOptionsDictionary = NAVDictionary::Unwrap(info[0].As<Napi::Object>());
+        headerOptions = headerOptionsDictionary->GetHandle();
+        headerOptionsReference = Napi::Persistent(info[0].As<Napi::Object>());
+    }
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    headerDeferreds.push_back(deferred);
+
+    auto noop = Napi::Function::New(env, [](const Napi::CallbackInfo&) { });
+    eventsTSFN = Napi::ThreadSafeFunction::New(env, noop, "AVFormatContext#write", 0, 1);
+
+    // Keep ourselves alive until OnWriterStopped(), as the thread's events refer to us
+
+    writerActive = true;
+    stopRequested = false;
+    AcquireIOContext();
+    Ref();
+
+    writer = new std::thread([](NAVFormatContext *context) { context->WriterMain(); }, this);
+
+    return deferred.Promise();
+}
+
+bool NAVFormatContext::CheckWriting(const Napi::Env &env) {
+    if (writerActive && !writerClosing)
+        return true;
+
+    Napi::Error::New(env, "Packets can only be written between writeHeader() and writeTrailer()").ThrowAsJavaScriptException();
+    return false;
+}
+
+Napi::Value NAVFormatContext::WritePacket(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (!CheckWriting(env))
+        return env.Undefined();
+
+    auto packet = NAVPacket::UnwrapArgument(env, info[0]);
+    if (!packet)
+        return env.Undefined();
+
+    // A new reference: the data is shared with the JS packet, which remains usable
+    AVPacket *queued = av_packet_clone(packet->GetHandle());
+
+    if (!queued) {
+        Napi::Error::New(env, "Failed to reference the packet").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (!QueuePacket(queued))
+        av_packet_free(&queued);
+
+    return env.Undefined();
+}
+
+bool NAVFormatContext::QueuePacket(AVPacket *packet) {
+    std::unique_lock<std::mutex> lock(writeMutex);
+
+    if (!writeQueueOpen)
+        return false;
+
+    if (writeQueue.empty())
+        writeQueueStarted = std::chrono::steady_clock::now();
+
+    writeQueue.push_back(packet);
+
+    // Otherwise the write thread is already waiting for the batch's deadline
+    if (writeQueue.size() == 1 || writeQueue.size() >= writeBatchSize)
+        writeWake.notify_one();
+
+    return true;
+}
+
+Napi::Value NAVFormatContext::Flush(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+
+    if (!CheckWriting(env))
+        return env.Undefined();
+
+    std::unique_lock<std::mutex> lock(writeMutex);
+    flushDeferreds.push_back(std::make_pair(++flushRequests, deferred));
+    writeWake.notify_one();
+
+    return deferred.Promise();
+}
+
+Napi::Value NAVFormatContext::WriteTrailer(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+
+    if (!CheckWriting(env))
+        return env.Undefined();
+
+    // Resolved by OnWriterStopped(), once the queued packets and the trailer have been written
+    trailerDeferreds.push_back(deferred);
+
+    std::unique_lock<std::mutex> lock(writeMutex);
+    writerClosing = true;
+    writeQueueOpen = false;
+    writeWake.notify_one();
+
+    return deferred.Promise();
+}
+
+/**
+ * Open the output (unless it needs no file, or is our custom I/O context) and write the header. On 
+ * failure, function is set to the libav function which failed. Write thread only.
+ */
+int NAVFormatContext::OpenAndWriteHeader(std::string &function) {
+    AVFormatContext *context = GetHandle();
+
+    if (!context->pb && !(context->oformat->flags & AVFMT_NOFILE)) {
+        function = "avio_open2";
+        int result = avio_open2(&context->pb, context->url, AVIO_FLAG_WRITE, &context->interrupt_callback, nullptr);
+        if (result < 0)
+            return result;
+    }
+
+    function = "avformat_write_header";
+    return avformat_write_header(context, &headerOptions);
+}
+
+/**
+ * Write thread only. Wait until there is work to do: a full batch, a partial batch which is
+ * maxWriteLatencyUs old, a flush, or the end of writing.
+ */
+void NAVFormatContext::WaitForWriteBatch(std::unique_lock<std::mutex> &lock) {
+    while (true) {
+        if (stopRequested || writerClosing || flushRequests > flushesDone)
+            return;
+
+        if (writeQueue.size() >= writeBatchSize)
+            return;
+
+        if (writeQueue.empty()) {
+            writeWake.wait(lock);
+            continue;
+        }
+
+        auto deadline = writeQueueStarted + std::chrono::microseconds(maxWriteLatencyUs.load());
+        if (std::chrono::steady_clock::now() >= deadline)
+            return;
+
+        writeWake.wait_until(lock, deadline);
+    }
+}
+
+void NAVFormatContext::WriterMain() {
+    AVFormatContext *context = GetHandle();
+    std::vector<AVPacket*> batch;
+    std::string function;
+    int result = OpenAndWriteHeader(function);
+
+    eventsTSFN.NonBlockingCall([this, result, function](Napi::Env env, Napi::Function) {
+        OnHeaderWritten(env, result, function);
+    });
+
+    // Without a header, the packets queued so far (and from now on) are dropped
+    if (result < 0) {
+        std::unique_lock<std::mutex> lock(writeMutex);
+        writeQueueOpen = false;
+
+        for (auto packet : writeQueue)
+            av_packet_free(&packet);
+        writeQueue.clear();
+    }
+
+    while (result >= 0) {
+        uint64_t flushRequest;
+        bool closing;
+
+        {
+            std::unique_lock<std::mutex> lock(writeMutex);
+            WaitForWriteBatch(lock);
+
+            if (stopRequested)
+                break;
+
+            batch.assign(writeQueue.begin(), writeQueue.end());
+            writeQueue.clear();
+            flushRequest = flushRequests;
+            closing = writerClosing;
+        }
+
+        // av_interleaved_write_frame() takes over our reference. Once writing failed, the rest of
+        // the packets are dropped.
+
+        for (auto packet : batch) {
+            int index = packet->stream_index;
+            if (packet->time_base.num && index >= 0 && (unsigned int)index < context->nb_streams) {
+                av_packet_rescale_ts(packet, packet->time_base, context->streams[index]->time_base);
+                packet->time_base = context->streams[index]->time_base;
+            }
+
+            if (result >= 0) {
+                result = av_interleaved_write_frame(context, packet);
+                if (result < 0)
+                    PostError(result, "av_interleaved_write_frame");
+            }
+
+            av_packet_free(&packet);
+        }
+
+        batch.clear();
+
+        if (closing) {
+            if (result >= 0)
+                result = av_write_trailer(context);
+            break;
+        }
+
+        // Push out packets buffered by the muxer (for formats which support it) and by the I/O
+        // context, for live outputs. Interleaving may still hold back packets.
+
+        if (result >= 0 && (flushAfterBatch || flushRequest > flushesDone)) {
+            av_write_frame(context, nullptr);
+            if (context->pb)
+                avio_flush(context->pb);
+        }
+
+        if (flushRequest > flushesDone) {
+            flushesDone = flushRequest;
+            eventsTSFN.NonBlockingCall([this, flushRequest](Napi::Env env, Napi::Function) {
+                OnFlushed(env, flushRequest);
+            });
+        }
+    }
+
+    eventsTSFN.NonBlockingCall([this, result](Napi::Env env, Napi::Function) {
+        OnWriterStopped(env, result);
+    });
+    eventsTSFN.Release();
+}
+
+/**
+ * Stop the write thread (if any) without writing the trailer, dropping the packets it has not written
+ * yet. JS thread only.
+ */
+void NAVFormatContext::StopWriter() {
+    {
+        std::unique_lock<std::mutex> lock(writeMutex);
+        writeQueueOpen = false;
+
+        if (writer) {
+            stopRequested = true;
+            writeWake.notify_one();
+        }
+    }
+
+    if (writer) {
+        writer->join();
+        delete writer;
+        writer = nullptr;
+    }
+
+    for (auto packet : writeQueue)
+        av_packet_free(&packet);
+    writeQueue.clear();
+}
+
+void NAVFormatContext::CloseOutput() {
+    auto handle = GetHandle();
+
+    if (!outputOpened || !handle || !handle->oformat || (handle->flags & AVFMT_FLAG_CUSTOM_IO))
+        return;
+
+    if (!(handle->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&handle->pb);
+}
+
+void NAVFormatContext::OnHeaderWritten(Napi::Env env, int result, std::string function) {
+    if (headerOptionsDictionary)
+        headerOptionsDictionary->SetHandle(headerOptions);
+    
+    headerOptionsDictionary = nullptr;
+    headerOptions = nullptr;
+    headerOptionsReference.Reset();
+
+    for (auto &deferred : headerDeferreds) {
+        if (result < 0)
+            deferred.Reject(Napi::Error::New(env, "[" + function + "] libav: " + nlavu_get_error_string(result)).Value());
+        else
+            deferred.Resolve(env.Undefined());
+    }
+    headerDeferreds.clear();
+}
+
+void NAVFormatContext::OnFlushed(Napi::Env env, uint64_t request) {
+    std::vector<Napi::Promise::Deferred> resolved;
+
+    {
+        std::unique_lock<std::mutex> lock(writeMutex);
+        auto it = flushDeferreds.begin();
+        for (; it != flushDeferreds.end() && it->first <= request; ++it)
+            resolved.push_back(it->second);
+        flushDeferreds.erase(flushDeferreds.begin(), it);
+    }
+
+    for (auto &deferred : resolved)
+        deferred.Resolve(env.Undefined());
+}
+
+void NAVFormatContext::OnWriterStopped(Napi::Env env, int result) {
+    // The thread stopped on its own (after the trailer or an error)
+    if (writer) {
+        writer->join();
+        delete writer;
+        writer = nullptr;
+    }
+
+    writerActive = false;
+    writerClosing = false;
+    stopRequested = false;
+    ReleaseIOContext();
+    CloseOutput();
+
+    for (auto &flush : flushDeferreds)
+        flush.second.Resolve(env.Undefined());
+    flushDeferreds.clear();
+
+    for (auto &deferred : trailerDeferreds) {
+        if (result < 0)
+            deferred.Reject(Napi::Error::New(env, "An error occurred while writing: " + nlavu_get_error_string(result)).Value());
+        else
+            deferred.Resolve(env.Undefined());
+    }
+    trailerDeferreds.clear();
+
+    Unref();
+}
+
+Napi::Value NAVFormatContext::GetOnPacket(const Napi::CallbackInfo& info) {
+    return onPacket.IsEmpty() ? info.Env().Null() : onPacket.Value();
+}
+
+void NAVFormatContext::SetOnPacket(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (value.IsFunction())
+        onPacket = Napi::Persistent(value.As<Napi::Function>());
+    else
+        onPacket.Reset();
+}
+
+Napi::Value NAVFormatContext::GetOnError(const Napi::CallbackInfo& info) {
+    return onError.IsEmpty() ? info.Env().Null() : onError.Value();
+}
+
+void NAVFormatContext::SetOnError(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (value.IsFunction())
+        onError = Napi::Persistent(value.As<Napi::Function>());
+    else
+        onError.Reset();
+}
+
+Napi::Value NAVFormatContext::GetOnEnd(const Napi::CallbackInfo& info) {
+    return onEnd.IsEmpty() ? info.Env().Null() : onEnd.Value();
+}
+
+void NAVFormatContext::SetOnEnd(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (value.IsFunction())
+        onEnd = Napi::Persistent(value.As<Napi::Function>());
+    else
+        onEnd.Reset();
+}
+
+Napi::Value NAVFormatContext::GetReading(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), readerActive);
+}
+
+Napi::Value NAVFormatContext::GetReadAheadPackets(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), readAheadPackets.load());
+}
+
+void NAVFormatContext::SetReadAheadPackets(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    int64_t packets = value.As<Napi::Number>().Int64Value();
+
+    if (packets < 1) {
+        Napi::RangeError::New(info.Env(), "readAheadPackets must be at least 1").ThrowAsJavaScriptException();
+        return;
+    }
+
+    readAheadPackets = packets;
+    WakeReader();
+}
+
+Napi::Value NAVFormatContext::GetBatchSize(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), batchSize.load());
+}
+
+void NAVFormatContext::SetBatchSize(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    int64_t size = value.As<Napi::Number>().Int64Value();
+
+    if (size < 1) {
+        Napi::RangeError::New(info.Env(), "batchSize must be at least 1").ThrowAsJavaScriptException();
+        return;
+    }
+
+    batchSize = size;
+}
+
+Napi::Value NAVFormatContext::GetMaxBatchLatencyUs(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), maxBatchLatencyUs.load());
+}
+
+void NAVFormatContext::SetMaxBatchLatencyUs(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    int64_t latency = value.As<Napi::Number>().Int64Value();
+
+    if (latency < 0) {
+        Napi::RangeError::New(info.Env(), "maxBatchLatencyUs cannot be negative").ThrowAsJavaScriptException();
+        return;
+    }
+
+    maxBatchLatencyUs = latency;
+}
+
+Napi::Value NAVFormatContext::GetWriting(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), writerActive);
+}
+
+Napi::Value NAVFormatContext::GetQueuedPackets(const Napi::CallbackInfo& info) {
+    std::unique_lock<std::mutex> lock(writeMutex);
+    return Napi::Number::New(info.Env(), writeQueue.size());
+}
+
+Napi::Value NAVFormatContext::GetWriteBatchSize(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), writeBatchSize.load());
+}
+
+void NAVFormatContext::SetWriteBatchSize(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    int64_t size = value.As<Napi::Number>().Int64Value();
+
+    if (size < 1) {
+        Napi::RangeError::New(info.Env(), "writeBatchSize must be at least 1").ThrowAsJavaScriptException();
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(writeMutex);
+    writeBatchSize = size;
+    writeWake.notify_one();
+}
+
+Napi::Value NAVFormatContext::GetMaxWriteLatencyUs(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), maxWriteLatencyUs.load());
+}
+
+void NAVFormatContext::SetMaxWriteLatencyUs(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    int64_t latency = value.As<Napi::Number>().Int64Value();
+
+    if (latency < 0) {
+        Napi::RangeError::New(info.Env(), "maxWriteLatencyUs cannot be negative").ThrowAsJavaScriptException();
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(writeMutex);
+    maxWriteLatencyUs = latency;
+    writeWake.notify_one();
+}
+
+Napi::Value NAVFormatContext::GetFlushAfterBatch(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), flushAfterBatch.load());
+}
+
+void NAVFormatContext::SetFlushAfterBatch(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    flushAfterBatch = value.ToBoolean().Value();
+}
+
+/**
+ * The read thread may add streams for formats without a header, and an async open/probe adds them and
+ * works out their parameters, so that is refused meanwhile.
+ */
+Napi::Value NAVFormatContext::GetStreams(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto handle = GetHandle();
+
+    if ((handle->ctx_flags & AVFMTCTX_NOHEADER) ? !CheckNotReading(env) : !CheckNotProbing(env))
+        return env.Undefined();
+
+    auto array = Napi::Array::New(env, handle->nb_streams);
+
+    for (unsigned int i = 0; i < handle->nb_streams; ++i)
+        array.Set(i, NAVStream::FromStream(env, handle->streams[i], Value()));
+
+    return array;
+}
+
+Napi::Value NAVFormatContext::GetFormatName(const Napi::CallbackInfo& info) {
+    auto handle = GetHandle();
+
+    if (handle->iformat)
+        return Napi::String::New(info.Env(), handle->iformat->name);
+
+    if (handle->oformat)
+        return Napi::String::New(info.Env(), handle->oformat->name);
+
+    return info.Env().Null();
+}
+
+Napi::Value NAVFormatContext::GetUrl(const Napi::CallbackInfo& info) {
+    if (!GetHandle()->url)
+        return info.Env().Null();
+
+    return Napi::String::New(info.Env(), GetHandle()->url);
+}
+
+// startTime, duration and bitRate are worked out by findStreamInfo(). Demuxers which update them do
+// so while reading, which is harmless for a plain number.
+
+Napi::Value NAVFormatContext::GetStartTime(const Napi::CallbackInfo& info) {
+    if (!CheckNotProbing(info.Env()))
+        return info.Env().Undefined();
+
+    return Napi::Number::New(info.Env(), GetHandle()->start_time);
+}
+
+Napi::Value NAVFormatContext::GetDuration(const Napi::CallbackInfo& info) {
+    if (!CheckNotProbing(info.Env()))
+        return info.Env().Undefined();
+
+    return Napi::Number::New(info.Env(), GetHandle()->duration);
+}
+
+Napi::Value NAVFormatContext::GetBitRate(const Napi::CallbackInfo& info) {
+    if (!CheckNotProbing(info.Env()))
+        return info.Env().Undefined();
+
+    return Napi::Number::New(info.Env(), GetHandle()->bit_rate);
+}
+
+Napi::Value NAVFormatContext::GetMetadata(const Napi::CallbackInfo& info) {
+    // Demuxers may replace entries while reading (see AVFMT_EVENT_FLAG_METADATA_UPDATED)
+    if (!CheckNotReading(info.Env()))
+        return info.Env().Undefined();
+
+    // A copy, as the dictionary belongs to the format context
+    AVDictionary *copy = nullptr;
+    av_dict_copy(&copy, GetHandle()->metadata, 0);
+
+    return NAVDictionary::FromHandleWrapped(info.Env(), copy, true);
+}
+
+Napi::Value NAVFormatContext::GetFlags(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->flags);
+}
+
+void NAVFormatContext::SetFlags(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    if (!CheckNotReading(info.Env()) || !CheckNotWriting(info.Env()))
+        return;
+
+    GetHandle()->flags = value.As<Napi::Number>().Int32Value();
+}
+
+Napi::Value NAVFormatContext::GetProbeSize(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->probesize);
+}
+
+void NAVFormatContext::SetProbeSize(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    if (!CheckNotReading(info.Env()))
+        return;
+
+    GetHandle()->probesize = value.As<Napi::Number>().Int64Value();
+}
+
+Napi::Value NAVFormatContext::GetMaxAnalyzeDuration(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->max_analyze_duration);
+}
+
+void NAVFormatContext::SetMaxAnalyzeDuration(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    if (!CheckNotReading(info.Env()))
+        return;
+
+    GetHandle()->max_analyze_duration = value.As<Napi::Number>().Int64Value();
+}
+
+Napi::Value NAVFormatContext::GetMaxInterleaveDelta(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->max_interleave_delta);
+}
+
+void NAVFormatContext::SetMaxInterleaveDelta(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    if (!CheckNotReading(info.Env()) || !CheckNotWriting(info.Env()))
+        return;
+
+    GetHandle()->max_interleave_delta = value.As<Napi::Number>().Int64Value();
+}
+
+Napi::Value NAVFormatContext::GetIOContext(const Napi::CallbackInfo& info) {
+    return ioReference.IsEmpty() ? info.Env().Null() : ioReference.Value();
+}
+
+void NAVFormatContext::SetIOContext(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    auto env = info.Env();
+
+    if (inputOpened || outputOpened) {
+        Napi::Error::New(env, "The I/O context must be set before openInput() / openOutput()").ThrowAsJavaScriptException();
+        return;
+    }
+
+    if (!CheckNotReading(env))
+        return;
+
+    auto handle = GetHandle();
+
+    if (!value.IsObject()) {
+        ioContext = nullptr;
+        ioReference.Reset();
+        handle->pb = nullptr;
+        handle->flags &= ~AVFMT_FLAG_CUSTOM_IO;
+        return;
+    }
+
+    ioContext = NAVIOContext::Unwrap(value.As<Napi::Object>());
+    ioReference = Napi::Persistent(value.As<Napi::Object>());
+    ApplyIOContext(handle);
+}
@@ -0,0 +1,274 @@
+#include "../common.h"
+
+#include <napi.h>
+#include "../resource.h"
+#include "../handle-pool.h"
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <deque>
+#include <map>
+
+extern "C" {
+    #include <libavformat/avformat.h>
+}
+
+class NAVCodecContext;
+class NAVIOContext;
+class NAVDictionary;
+
+/**
+ * Default for readAheadPackets: number of packets the read thread may deliver to Javascript before
+ * they have been handled by onPacket.
+ */
+#define NLAV_DEFAULT_READ_AHEAD 64
+
+/**
+ * Default for writeBatchSize: number of queued packets which wake the write thread.
+ */
+#define NLAV_DEFAULT_WRITE_BATCH 1
+
+class NAVFormatContext : public NAVResource<NAVFormatContext, AVFormatContext> {
+    friend class NAVFormatProbeWorker;
+
+    public:
+        NAVFormatContext(const Napi::CallbackInfo& info);
+
+        inline static std::string ExportName() { return "AVFormatContext"; }
+        inline static Napi::Function ClassDefinition(const Napi::Env &env) {
+            return DefineClass(env, "AVFormatContext", {
+                R_ACCESSOR("onPacket", &NAVFormatContext::GetOnPacket, &NAVFormatContext::SetOnPacket),
+                R_ACCESSOR("onError", &NAVFormatContext::GetOnError, &NAVFormatContext::SetOnError),
+                R_ACCESSOR("onEnd", &NAVFormatContext::GetOnEnd, &NAVFormatContext::SetOnEnd),
+
+                R_METHOD("openInput", &NAVFormatContext::OpenInput),
+                R_METHOD("findStreamInfo", &NAVFormatContext::FindStreamInfo),
+                R_METHOD("openInputAsync", &NAVFormatContext::OpenInputAsync),
+                R_METHOD("findStreamInfoAsync", &NAVFormatContext::FindStreamInfoAsync),
+                R_METHOD("readFrame", &NAVFormatContext::ReadFrame),
+                R_METHOD("startReading", &NAVFormatContext::StartReading),
+                R_METHOD("stopReading", &NAVFormatContext::StopReading),
+                R_METHOD("routeStream", &NAVFormatContext::RouteStream),
+                R_METHOD("unrouteStream", &NAVFormatContext::UnrouteStream),
+
+                R_METHOD("openOutput", &NAVFormatContext::OpenOutput),
+                R_METHOD("newStream", &NAVFormatContext::NewStream),
+                R_METHOD("writeHeader", &NAVFormatContext::WriteHeader),
+                R_METHOD("writePacket", &NAVFormatContext::WritePacket),
+                R_METHOD("flush", &NAVFormatContext::Flush),
+                R_METHOD("writeTrailer", &NAVFormatContext::WriteTrailer),
+
+                R_GETTER("reading", &NAVFormatContext::GetReading),
+                R_ACCESSOR("readAheadPackets", &NAVFormatContext::GetReadAheadPackets, &NAVFormatContext::SetReadAheadPackets),
+                R_ACCESSOR("batchSize", &NAVFormatContext::GetBatchSize, &NAVFormatContext::SetBatchSize),
+                R_ACCESSOR("maxBatchLatencyUs", &NAVFormatContext::GetMaxBatchLatencyUs, &NAVFormatContext::SetMaxBatchLatencyUs),
+
+                R_GETTER("writing", &NAVFormatContext::GetWriting),
+                R_GETTER("queuedPackets", &NAVFormatContext::GetQueuedPackets),
+                R_ACCESSOR("writeBatchSize", &NAVFormatContext::GetWriteBatchSize, &NAVFormatContext::SetWriteBatchSize),
+                R_ACCESSOR("maxWriteLatencyUs", &NAVFormatContext::GetMaxWriteLatencyUs, &NAVFormatContext::SetMaxWriteLatencyUs),
+                R_ACCESSOR("flushAfterBatch", &NAVFormatContext::GetFlushAfterBatch, &NAVFormatContext::SetFlushAfterBatch),
+
+                R_GETTER("streams", &NAVFormatContext::GetStreams),
+                R_GETTER("formatName", &NAVFormatContext::GetFormatName),
+                R_GETTER("url", &NAVFormatContext::GetUrl),
+                R_GETTER("startTime", &NAVFormatContext::GetStartTime),
+                R_GETTER("duration", &NAVFormatContext::GetDuration),
+                R_GETTER("bitRate", &NAVFormatContext::GetBitRate),
+                R_GETTER("metadata", &NAVFormatContext::GetMetadata),
+                R_ACCESSOR("flags", &NAVFormatContext::GetFlags, &NAVFormatContext::SetFlags),
+                R_ACCESSOR("probeSize", &NAVFormatContext::GetProbeSize, &NAVFormatContext::SetProbeSize),
+                R_ACCESSOR("maxAnalyzeDuration", &NAVFormatContext::GetMaxAnalyzeDuration, &NAVFormatContext::SetMaxAnalyzeDuration),
+                R_ACCESSOR("maxInterleaveDelta", &NAVFormatContext::GetMaxInterleaveDelta, &NAVFormatContext::SetMaxInterleaveDelta),
+                R_ACCESSOR("ioContext", &NAVFormatContext::GetIOContext, &NAVFormatContext::SetIOContext),
+            });
+        }
+
+        virtual void Free();
+        virtual size_t GetExternalMemorySize();
+
+        void ThreadMain();
+        void WriterMain();
+
+        /**
+         * Queue a packet for the write thread, which takes it over. Packets with a time base are rescaled
+         * to their stream's time base. Returns false (and does not take the packet) if the output is not
+         * open or no longer accepts packets. Any thread.
+         */
+        bool QueuePacket(AVPacket *packet);
+
+    private:
+        static AVFormatContext *AllocateContext(NAVFormatContext *self);
+        static int InterruptCallback(void *opaque);
+        bool CheckNotProbing(const Napi::Env &env);
+        bool CheckNotReading(const Napi::Env &env);
+        bool CheckNotWriting(const Napi::Env &env);
+        void ApplyIOContext(AVFormatContext *context);
+        void AcquireIOContext();
+        void ReleaseIOContext();
+        void FinishOpenInput(AVFormatContext *handle, int result);
+        void FinishProbe();
+
+        // Read thread (see startReading())
+
+        bool WaitForReadAhead();
+        void WakeReader();
+        void StopThread();
+        void DeliverPacket(AVPacket *packet);
+        void FlushBatch(bool force);
+        void PostPackets(std::vector<AVPacket*> packets, bool asArray);
+        void PostError(int code, std::string context);
+        void OnPackets(Napi::Env env, std::vector<AVPacket*> packets, bool asArray);
+        Napi::Value WrapPacket(const Napi::Env &env, AVPacket *packet);
+        void OnStopped(Napi::Env env, bool ended);
+
+        // Write thread (see writeHeader())
+
+        bool CheckWriting(const Napi::Env &env);
+        int OpenAndWriteHeader(std::string &function);
+        void WaitForWriteBatch(std::unique_lock<std::mutex> &lock);
+        void StopWriter();
+        void CloseOutput();
+        void OnHeaderWritten(Napi::Env env, int result, std::string function);
+        void OnFlushed(Napi::Env env, uint64_t request);
+        void OnWriterStopped(Napi::Env env, int result);
+
+        bool inputOpened = false;
+        bool outputOpened = false;
+
+        // Async open/probe (see openInputAsync()). The worker holds probeMutex while it uses the context,
+        // and leaves what avformat_open_input() gave back for the JS thread to take over (see FinishProbe()).
+        std::mutex probeMutex;
+        bool probing = false;
+        bool openPending = false;
+        AVFormatContext *openedHandle = nullptr;
+        int openResult = 0;
+
+        std::thread *thread = nullptr;
+        std::mutex mutex;
+        std::condition_variable threadWake;
+        std::atomic<bool> stopRequested;
+        bool readerActive = false;
+        std::vector<Napi::Promise::Deferred> stopDeferreds;
+        Napi::ThreadSafeFunction eventsTSFN;
+
+        std::shared_ptr<NAVPacketPool> packetPool;
+        std::atomic<size_t> inFlight;
+        std::atomic<size_t> readAheadPackets;
+
+        std::atomic<uint32_t> batchSize;
+        std::atomic<int64_t> maxBatchLatencyUs;
+        std::vector<AVPacket*> packetBatch;
+        std::chrono::steady_clock::time_point batchStarted;
+
+        // Streams whose packets go straight to a codec context, by stream index. Only changed while
+        // the read thread is not running.
+        std::vector<NAVCodecContext*> routes;
+        std::map<int, Napi::ObjectReference> routeReferences;
+
+        // Packets waiting for the write thread, guarded by writeMutex (as is writeQueueOpen)
+        std::thread *writer = nullptr;
+        std::mutex writeMutex;
+        std::condition_variable writeWake;
+        std::deque<AVPacket*> writeQueue;
+        std::chrono::steady_clock::time_point writeQueueStarted;
+        bool writeQueueOpen = false;
+        bool writerActive = false;
+        bool writerClosing = false;
+        uint64_t flushRequests = 0;
+        uint64_t flushesDone = 0;
+        std::vector<std::pair<uint64_t, Napi::Promise::Deferred>> flushDeferreds;
+        std::vector<Napi::Promise::Deferred> trailerDeferreds;
+
+        // The header is written by the write thread, with these options (see writeHeader()). Handed back
+        // to the dictionary by OnHeaderWritten().
+        AVDictionary *headerOptions = nullptr;
+        NAVDictionary *headerOptionsDictionary = nullptr;
+        Napi::ObjectReference headerOptionsReference;
+        std::vector<Napi::Promise::Deferred> headerDeferreds;
+
+        std::atomic<uint32_t> writeBatchSize;
+        std::atomic<int64_t> maxWriteLatencyUs;
+        std::atomic<bool> flushAfterBatch;
+
+        // Custom I/O (see ioContext)
+        NAVIOContext *ioContext = nullptr;
+        Napi::ObjectReference ioReference;
+        int ioBusy = 0;
+
+        Napi::FunctionReference onPacket;
+        Napi::FunctionReference onError;
+        Napi::FunctionReference onEnd;
+
+        // Functional
+
+        Napi::Value OpenInput(const Napi::CallbackInfo& info);
+        Napi::Value FindStreamInfo(const Napi::CallbackInfo& info);
+        Napi::Value OpenInputAsync(const Napi::CallbackInfo& info);
+        Napi::Value FindStreamInfoAsync(const Napi::CallbackInfo& info);
+        Napi::Value ReadFrame(const Napi::CallbackInfo& info);
+        Napi::Value StartReading(const Napi::CallbackInfo& info);
+        Napi::Value StopReading(const Napi::CallbackInfo& info);
+        Napi::Value RouteStream(const Napi::CallbackInfo& info);
+        Napi::Value UnrouteStream(const Napi::CallbackInfo& info);
+        Napi::Value OpenOutput(const Napi::CallbackInfo& info);
+        Napi::Value NewStream(const Napi::CallbackInfo& info);
+        Napi::Value WriteHeader(const Napi::CallbackInfo& info);
+        Napi::Value WritePacket(const Napi::CallbackInfo& info);
+        Napi::Value Flush(const Napi::CallbackInfo& info);
+        Napi::Value WriteTrailer(const Napi::CallbackInfo& info);
+
+        // Events
+
+        Napi::Value GetOnPacket(const Napi::CallbackInfo& info);
+        void SetOnPacket(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetOnError(const Napi::CallbackInfo& info);
+        void SetOnError(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetOnEnd(const Napi::CallbackInfo& info);
+        void SetOnEnd(const Napi::CallbackInfo& info, const Napi::Value &value);
+
+        // Read thread settings
+
+        Napi::Value GetReading(const Napi::CallbackInfo& info);
+        Napi::Value GetReadAheadPackets(const Napi::CallbackInfo& info);
+        void SetReadAheadPackets(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetBatchSize(const Napi::CallbackInfo& info);
+        void SetBatchSize(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetMaxBatchLatencyUs(const Napi::CallbackInfo& info);
+        void SetMaxBatchLatencyUs(const Napi::CallbackInfo& info, const Napi::Value &value);
+
+        // Write thread settings
+
+        Napi::Value GetWriting(const Napi::CallbackInfo& info);
+        Napi::Value GetQueuedPackets(const Napi::CallbackInfo& info);
+        Napi::Value GetWriteBatchSize(const Napi::CallbackInfo& info);
+        void SetWriteBatchSize(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetMaxWriteLatencyUs(const Napi::CallbackInfo& info);
+        void SetMaxWriteLatencyUs(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetFlushAfterBatch(const Napi::CallbackInfo& info);
+        void SetFlushAfterBatch(const Napi::CallbackInfo& info, const Napi::Value &value);
+
+        // Properties
+
+        Napi::Value GetStreams(const Napi::CallbackInfo& info);
+        Napi::Value GetFormatName(const Napi::CallbackInfo& info);
+        Napi::Value GetUrl(const Napi::CallbackInfo& info);
+        Napi::Value GetStartTime(const Napi::CallbackInfo& info);
+        Napi::Value GetDuration(const Napi::CallbackInfo& info);
+        Napi::Value GetBitRate(const Napi::CallbackInfo& info);
+        Napi::Value GetMetadata(const Napi::CallbackInfo& info);
+        Napi::Value GetFlags(const Napi::CallbackInfo& info);
+        void SetFlags(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetProbeSize(const Napi::CallbackInfo& info);
+        void SetProbeSize(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetMaxAnalyzeDuration(const Napi::CallbackInfo& info);
+        void SetMaxAnalyzeDuration(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetMaxInterleaveDelta(const Napi::CallbackInfo& info);
+        void SetMaxInterleaveDelta(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetIOContext(const Napi::CallbackInfo& info);
+        void SetIOContext(const Napi::CallbackInfo& info, const Napi::Value& value);
+};
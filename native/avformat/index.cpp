@@ -0,0 +1,10 @@
+#include "index.h"
+#include "format-context.h"
+#include "stream.h"
+#include "io-context.h"
+
+void nlavf_init(Napi::Env env, Napi::Object exports) {
+    NAVFormatContext::Register(env, exports);
+    NAVStream::Register(env, exports);
+    NAVIOContext::Register(env, exports);
+}
\ No newline at end of file
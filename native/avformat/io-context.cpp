@@ -0,0 +1,378 @@
+#include "io-context.h"
+#include <string.h>
+#include <algorithm>
+
+NAVIOContext::NAVIOContext(const Napi::CallbackInfo& info):
+    NAVResource(info),
+    ring(NLAV_IO_RING_CHUNKS),
+    interrupted(false),
+    ended(false),
+    consumedChunks(0),
+    bufferedBytes(0),
+    highWaterMark(NLAV_DEFAULT_IO_HIGH_WATER_MARK),
+    waitingForDrain(false),
+    totalSize(-1),
+    bytesRead(0),
+    bytesWritten(0),
+    alive(std::make_shared<bool>(true))
+{
+    auto env = info.Env();
+
+    jsThread = std::this_thread::get_id();
+    writable = info.Length() > 0 && info[0].ToBoolean().Value();
+
+    int bufferSize = NLAV_DEFAULT_IO_BUFFER_SIZE;
+    if (info.Length() > 1 && info[1].IsNumber())
+        bufferSize = info[1].As<Napi::Number>().Int32Value();
+
+    if (bufferSize <= 0) {
+        Napi::RangeError::New(env, "The buffer size must be positive").ThrowAsJavaScriptException();
+        return;
+    }
+
+    auto buffer = (unsigned char*)av_malloc(bufferSize);
+    auto context = buffer ? avio_alloc_context(
+        buffer, bufferSize, writable ? 1 : 0, this,
+        writable ? nullptr : &NAVIOContext::ReadCallback,
+        writable ? &NAVIOContext::WriteCallback : nullptr,
+        &NAVIOContext::SeekCallback
+    ) : nullptr;
+
+    if (!context) {
+        av_free(buffer);
+        Napi::Error::New(env, "Failed to allocate the I/O context").ThrowAsJavaScriptException();
+        return;
+    }
+
+    // Only the size can be queried (see totalSize)
+    context->seekable = 0;
+    SetHandle(context);
+
+    // Does not keep the event loop alive
+    auto noop = Napi::Function::New(env, [](const Napi::CallbackInfo&) { });
+    eventsTSFN = Napi::ThreadSafeFunction::New(env, noop, "AVIOContext#events", 0, 1);
+    eventsTSFN.Unref(env);
+}
+
+void NAVIOContext::Free() {
+    Interrupt(true);
+    *alive = false;
+
+    auto handle = GetHandle();
+    if (handle) {
+        av_freep(&handle->buffer);
+        avio_context_free(&handle);
+    }
+
+    SetHandle(handle);
+
+    chunkReferences.clear();
+    overflow.clear();
+
+    if (eventsTSFN)
+        eventsTSFN.Release();
+}
+
+bool NAVIOContext::CheckDisposable(const Napi::Env &env) {
+    if (busy == 0)
+        return true;
+
+    Napi::Error::New(env, "This AVIOContext is in use by a format context, stop it (or dispose of it) before disposing of the I/O context").ThrowAsJavaScriptException();
+    return false;
+}
+
+size_t NAVIOContext::GetExternalMemorySize() {
+    auto handle = GetHandle();
+    return sizeof(AVIOContext) + (handle ? handle->buffer_size : 0);
+}
+
+void NAVIOContext::Interrupt(bool interrupted) {
+    this->interrupted = interrupted;
+    WakeReader();
+}
+
+void NAVIOContext::WakeReader() {
+    std::unique_lock<std::mutex> lock(mutex);
+    dataWake.notify_all();
+}
+
+int NAVIOContext::ReadCallback(void *opaque, uint8_t *buffer, int size) {
+    return ((NAVIOContext*)opaque)->Read(buffer, size);
+}
+
+/**
+ * Copy as much buffered input as fits straight from the chunks into libavformat's buffer, waiting
+ * while there is none. A wait on the JS thread (a synchronous openInput() for instance) would never
+ * end, as that is the thread writing the input, so there EAGAIN is returned instead.
+ */
+int NAVIOContext::Read(uint8_t *buffer, int size) {
+    int count = 0;
+
+    while (true) {
+        NAVIOChunk *chunk;
+
+        while (count < size && (chunk = ring.Peek())) {
+            size_t copied = std::min(chunk->size - readOffset, (size_t)(size - count));
+            memcpy(buffer + count, chunk->data + readOffset, copied);
+            count += copied;
+            readOffset += copied;
+
+            if (readOffset == chunk->size) {
+                ring.Pop();
+                readOffset = 0;
+                ++consumedChunks;
+            }
+        }
+
+        if (count > 0)
+            break;
+
+        if (std::this_thread::get_id() == jsThread) {
+            // Take in the chunks waiting for room in the ring, nothing else can arrive meanwhile
+            ReleaseConsumed();
+            PushChunks();
+
+            if (!ring.Empty())
+                continue;
+
+            return interrupted ? AVERROR_EXIT : (ended ? AVERROR_EOF : AVERROR(EAGAIN));
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        dataWake.wait(lock, [this]() { return !ring.Empty() || ended || interrupted; });
+
+        if (ring.Empty())
+            return interrupted ? AVERROR_EXIT : AVERROR_EOF;
+    }
+
+    bufferedBytes -= count;
+    bytesRead += count;
+    CheckDrain();
+
+    return count;
+}
+
+/**
+ * Reading thread only. Tell JS it can write again once the buffered input is down to half of
+ * highWaterMark, or once the ring is empty (while chunks are waiting for room in it).
+ */
+void NAVIOContext::CheckDrain() {
+    if (!waitingForDrain)
+        return;
+
+    if (bufferedBytes > highWaterMark / 2 && !ring.Empty())
+        return;
+
+    if (!waitingForDrain.exchange(false))
+        return;
+
+    std::shared_ptr<bool> alive = this->alive;
+    eventsTSFN.NonBlockingCall([this, alive](Napi::Env env, Napi::Function) {
+        if (*alive)
+            OnDrain(env);
+    });
+}
+
+int NAVIOContext::WriteCallback(void *opaque, uint8_t *buffer, int size) {
+    auto self = (NAVIOContext*)opaque;
+
+    // libavformat reuses its buffer, the copy is handed to JS as is
+    auto copy = (uint8_t*)malloc(size);
+    if (!copy)
+        return AVERROR(ENOMEM);
+
+    memcpy(copy, buffer, size);
+    self->bytesWritten += size;
+
+    std::shared_ptr<bool> alive = self->alive;
+    auto status = self->eventsTSFN.NonBlockingCall([self, alive, copy, size](Napi::Env env, Napi::Function) {
+        if (!*alive || self->onData.IsEmpty()) {
+            free(copy);
+            return;
+        }
+
+        self->onData.Call({
+            Napi::Buffer<uint8_t>::New(env, copy, size, [](Napi::Env, uint8_t *data) { free(data); })
+        });
+    });
+
+    if (status != napi_ok) {
+        free(copy);
+        return AVERROR_EXIT;
+    }
+
+    return size;
+}
+
+int64_t NAVIOContext::SeekCallback(void *opaque, int64_t offset, int whence) {
+    auto self = (NAVIOContext*)opaque;
+
+    if (whence & AVSEEK_SIZE)
+        return self->totalSize >= 0 ? self->totalSize.load() : AVERROR(ENOSYS);
+
+    return AVERROR(ENOSYS);
+}
+
+/**
+ * JS thread only. Move waiting chunks into the ring while it has room.
+ */
+void NAVIOContext::PushChunks() {
+    bool pushed = false;
+
+    while (!overflow.empty() && ring.Push(overflow.front().first)) {
+        chunkReferences.push_back(std::move(overflow.front().second));
+        overflow.pop_front();
+        pushed = true;
+    }
+
+    if (endRequested && overflow.empty() && !ended) {
+        ended = true;
+        pushed = true;
+    }
+
+    if (pushed)
+        WakeReader();
+}
+
+/**
+ * JS thread only. Let go of the chunks the reading thread is done with.
+ */
+void NAVIOContext::ReleaseConsumed() {
+    size_t consumed = consumedChunks.load();
+
+    while (releasedChunks < consumed && !chunkReferences.empty()) {
+        chunkReferences.pop_front();
+        ++releasedChunks;
+    }
+}
+
+/**
+ * JS thread only. Whether writing should pause until onDrain. If so, the reading thread is asked to
+ * signal the drain.
+ */
+bool NAVIOContext::ShouldPause() {
+    if (overflow.empty() && bufferedBytes < highWaterMark)
+        return false;
+
+    waitingForDrain = true;
+
+    // The reading thread may have caught up before seeing waitingForDrain
+    PushChunks();
+    if (overflow.empty() && bufferedBytes <= highWaterMark / 2 && waitingForDrain.exchange(false))
+        return false;
+
+    return true;
+}
+
+void NAVIOContext::OnDrain(Napi::Env env) {
+    ReleaseConsumed();
+    PushChunks();
+
+    if (ShouldPause())
+        return;
+
+    if (!onDrain.IsEmpty())
+        onDrain.Call({});
+}
+
+Napi::Value NAVIOContext::Write(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (writable || endRequested) {
+        Napi::Error::New(env, writable ? "This I/O context is for output, see onData" : "end() has already been called").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (!info[0].IsTypedArray() || info[0].As<Napi::TypedArray>().TypedArrayType() != napi_uint8_array) {
+        Napi::TypeError::New(env, "Expected a Uint8Array or Buffer").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto array = info[0].As<Napi::Uint8Array>();
+    ReleaseConsumed();
+
+    // Referenced rather than copied: the chunk must not be modified until it has been read
+    if (array.ByteLength() > 0) {
+        NAVIOChunk chunk;
+        chunk.data = array.Data();
+        chunk.size = array.ByteLength();
+
+        bufferedBytes += chunk.size;
+        overflow.push_back(std::make_pair(chunk, Napi::Persistent(array)));
+        PushChunks();
+    }
+
+    return Napi::Boolean::New(env, !ShouldPause());
+}
+
+Napi::Value NAVIOContext::End(const Napi::CallbackInfo& info) {
+    endRequested = true;
+    PushChunks();
+
+    return info.Env().Undefined();
+}
+
+Napi::Value NAVIOContext::GetOnDrain(const Napi::CallbackInfo& info) {
+    return onDrain.IsEmpty() ? info.Env().Null() : onDrain.Value();
+}
+
+void NAVIOContext::SetOnDrain(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (value.IsFunction())
+        onDrain = Napi::Persistent(value.As<Napi::Function>());
+    else
+        onDrain.Reset();
+}
+
+Napi::Value NAVIOContext::GetOnData(const Napi::CallbackInfo& info) {
+    return onData.IsEmpty() ? info.Env().Null() : onData.Value();
+}
+
+void NAVIOContext::SetOnData(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    if (value.IsFunction())
+        onData = Napi::Persistent(value.As<Napi::Function>());
+    else
+        onData.Reset();
+}
+
+Napi::Value NAVIOContext::GetWritable(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), writable);
+}
+
+Napi::Value NAVIOContext::GetEnded(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), endRequested);
+}
+
+Napi::Value NAVIOContext::GetBufferedBytes(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), bufferedBytes.load());
+}
+
+Napi::Value NAVIOContext::GetHighWaterMark(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), highWaterMark.load());
+}
+
+void NAVIOContext::SetHighWaterMark(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    int64_t bytes = value.As<Napi::Number>().Int64Value();
+
+    if (bytes < 1) {
+        Napi::RangeError::New(info.Env(), "highWaterMark must be at least 1").ThrowAsJavaScriptException();
+        return;
+    }
+
+    highWaterMark = bytes;
+}
+
+Napi::Value NAVIOContext::GetTotalSize(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), totalSize.load());
+}
+
+void NAVIOContext::SetTotalSize(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    totalSize = value.IsNumber() ? value.As<Napi::Number>().Int64Value() : -1;
+}
+
+Napi::Value NAVIOContext::GetBytesRead(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), bytesRead.load());
+}
+
+Napi::Value NAVIOContext::GetBytesWritten(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), bytesWritten.load());
+}
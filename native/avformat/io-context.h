@@ -0,0 +1,150 @@
+#include "../common.h"
+
+#include <napi.h>
+#include "../resource.h"
+#include "../spsc-queue.h"
+#include <memory>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <deque>
+#include <thread>
+
+extern "C" {
+    #include <libavformat/avio.h>
+}
+
+/**
+ * Default size of the buffer libavformat reads into / writes from (see avio_alloc_context()).
+ */
+#define NLAV_DEFAULT_IO_BUFFER_SIZE 32768
+
+/**
+ * Default for highWaterMark: number of buffered input bytes at which write() asks for a pause.
+ */
+#define NLAV_DEFAULT_IO_HIGH_WATER_MARK (1024 * 1024)
+
+/**
+ * Number of chunks the input ring can hold. Chunks beyond that wait on the JS side.
+ */
+#define NLAV_IO_RING_CHUNKS 256
+
+/**
+ * An input chunk: a view on the memory of a Uint8Array which is kept alive on the JS side until the
+ * chunk has been consumed.
+ */
+struct NAVIOChunk {
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+};
+
+/**
+ * An AVIOContext backed by Javascript. Input is written from JS in chunks, which libavformat reads
+ * (on whichever thread it runs) straight out of the chunks' memory, blocking while there is no data.
+ * Reads on the JS thread cannot wait for more input (it would have to be written on that very thread),
+ * they fail with EAGAIN instead (see openInputAsync()). Output is passed to onData.
+ */
+class NAVIOContext : public NAVResource<NAVIOContext, AVIOContext> {
+    public:
+        NAVIOContext(const Napi::CallbackInfo& info);
+
+        inline static std::string ExportName() { return "AVIOContext"; }
+        inline static Napi::Function ClassDefinition(const Napi::Env &env) {
+            return DefineClass(env, "AVIOContext", {
+                R_METHOD("write", &NAVIOContext::Write),
+                R_METHOD("end", &NAVIOContext::End),
+
+                R_ACCESSOR("onDrain", &NAVIOContext::GetOnDrain, &NAVIOContext::SetOnDrain),
+                R_ACCESSOR("onData", &NAVIOContext::GetOnData, &NAVIOContext::SetOnData),
+
+                R_GETTER("writable", &NAVIOContext::GetWritable),
+                R_GETTER("ended", &NAVIOContext::GetEnded),
+                R_GETTER("bufferedBytes", &NAVIOContext::GetBufferedBytes),
+                R_ACCESSOR("highWaterMark", &NAVIOContext::GetHighWaterMark, &NAVIOContext::SetHighWaterMark),
+                R_ACCESSOR("totalSize", &NAVIOContext::GetTotalSize, &NAVIOContext::SetTotalSize),
+                R_GETTER("bytesRead", &NAVIOContext::GetBytesRead),
+                R_GETTER("bytesWritten", &NAVIOContext::GetBytesWritten),
+            });
+        }
+
+        virtual void Free();
+        virtual size_t GetExternalMemorySize();
+        virtual bool CheckDisposable(const Napi::Env &env);
+
+        /**
+         * Number of format contexts reading or writing through this context (on their read/write thread or
+         * in openInputAsync() / findStreamInfoAsync()). It cannot be disposed of meanwhile. JS thread only.
+         */
+        int busy = 0;
+
+        /**
+         * Make reads fail with AVERROR_EXIT instead of waiting for data (interrupted = true), for
+         * instance while the format context using us stops its thread.
+         */
+        void Interrupt(bool interrupted);
+
+    private:
+        static int ReadCallback(void *opaque, uint8_t *buffer, int size);
+        static int WriteCallback(void *opaque, uint8_t *buffer, int size);
+        static int64_t SeekCallback(void *opaque, int64_t offset, int whence);
+
+        int Read(uint8_t *buffer, int size);
+        void CheckDrain();
+        void ReleaseConsumed();
+        void PushChunks();
+        bool ShouldPause();
+        void WakeReader();
+        void OnDrain(Napi::Env env);
+
+        bool writable = false;
+
+        // Input. The ring has a single producer (the JS thread) and consumer (the reading thread).
+
+        SPSCQueue<NAVIOChunk> ring;
+        size_t readOffset = 0;
+        std::mutex mutex;
+        std::condition_variable dataWake;
+        std::atomic<bool> interrupted;
+        std::atomic<bool> ended;
+        bool endRequested = false;
+        std::thread::id jsThread;
+
+        // JS thread only: references to the chunks in the ring (in order), and chunks for which
+        // there was no room in the ring yet
+        std::deque<Napi::Reference<Napi::Uint8Array>> chunkReferences;
+        std::deque<std::pair<NAVIOChunk, Napi::Reference<Napi::Uint8Array>>> overflow;
+        size_t releasedChunks = 0;
+        std::atomic<size_t> consumedChunks;
+
+        std::atomic<size_t> bufferedBytes;
+        std::atomic<size_t> highWaterMark;
+        std::atomic<bool> waitingForDrain;
+        std::atomic<int64_t> totalSize;
+        std::atomic<int64_t> bytesRead;
+        std::atomic<int64_t> bytesWritten;
+
+        // Calls posted to eventsTSFN may run after we are disposed of, they only touch us while alive, 
+        // which Free() clears
+        Napi::ThreadSafeFunction eventsTSFN;
+        std::shared_ptr<bool> alive;
+        Napi::FunctionReference onDrain;
+        Napi::FunctionReference onData;
+
+        Napi::Value Write(const Napi::CallbackInfo& info);
+        Napi::Value End(const Napi::CallbackInfo& info);
+
+        Napi::Value GetOnDrain(const Napi::CallbackInfo& info);
+        void SetOnDrain(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetOnData(const Napi::CallbackInfo& info);
+        void SetOnData(const Napi::CallbackInfo& info, const Napi::Value &value);
+
+        Napi::Value GetWritable(const Napi::CallbackInfo& info);
+        Napi::Value GetEnded(const Napi::CallbackInfo& info);
+        Napi::Value GetBufferedBytes(const Napi::CallbackInfo& info);
+        Napi::Value GetHighWaterMark(const Napi::CallbackInfo& info);
+        void SetHighWaterMark(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetTotalSize(const Napi::CallbackInfo& info);
+        void SetTotalSize(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetBytesRead(const Napi::CallbackInfo& info);
+        Napi::Value GetBytesWritten(const Napi::CallbackInfo& info);
+};
@@ -0,0 +1,162 @@
+#include "stream.h"
+#include "../avcodec/codec-context.h"
+#include "../avutil/dict.h"
+
+NAVStream::NAVStream(const Napi::CallbackInfo& info):
+    NAVResource(info)
+{
+    if (ConstructFromHandle(info))
+        return;
+
+    Napi::TypeError::New(info.Env(), "AVStream cannot be constructed directly, see AVFormatContext#streams and AVFormatContext#newStream()").ThrowAsJavaScriptException();
+}
+
+void NAVStream::Free() {
+    // The stream itself belongs to the format context
+    if (!owner.IsEmpty())
+        owner.Reset();
+}
+
+Napi::Value NAVStream::FromStream(const Napi::Env &env, AVStream *stream, Napi::Object owner) {
+    if (!stream)
+        return env.Null();
+
+    auto instance = FromHandle(env, stream, true);
+    if (instance->owner.IsEmpty())
+        instance->owner = Napi::Persistent(owner);
+
+    return instance->Value();
+}
+
+Napi::Value NAVStream::CopyParametersTo(const Napi::CallbackInfo& info) {
+    auto context = NAVCodecContext::Unwrap(info[0].As<Napi::Object>());
+    int result = avcodec_parameters_to_context(context->GetHandle(), GetHandle()->codecpar);
+
+    if (result < 0)
+        return nlav_throw(info.Env(), result, "avcodec_parameters_to_context");
+
+    context->GetHandle()->pkt_timebase = GetHandle()->time_base;
+    return info.Env().Undefined();
+}
+
+Napi::Value NAVStream::CopyParametersFrom(const Napi::CallbackInfo& info) {
+    auto context = NAVCodecContext::Unwrap(info[0].As<Napi::Object>());
+    int result = avcodec_parameters_from_context(GetHandle()->codecpar, context->GetHandle());
+
+    if (result < 0)
+        return nlav_throw(info.Env(), result, "avcodec_parameters_from_context");
+
+    return info.Env().Undefined();
+}
+
+Napi::Value NAVStream::GetIndex(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->index);
+}
+
+Napi::Value NAVStream::GetId(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->id);
+}
+
+void NAVStream::SetId(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    GetHandle()->id = value.As<Napi::Number>().Int32Value();
+}
+
+Napi::Value NAVStream::GetTimeBase(const Napi::CallbackInfo& info) {
+    return NRational(info.Env(), GetHandle()->time_base);
+}
+
+void NAVStream::SetTimeBase(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    GetHandle()->time_base = FromNRational(info.Env(), value);
+}
+
+Napi::Value NAVStream::GetStartTime(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->start_time);
+}
+
+Napi::Value NAVStream::GetDuration(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->duration);
+}
+
+Napi::Value NAVStream::GetFrameCount(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->nb_frames);
+}
+
+Napi::Value NAVStream::GetDisposition(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->disposition);
+}
+
+void NAVStream::SetDisposition(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    GetHandle()->disposition = value.As<Napi::Number>().Int32Value();
+}
+
+Napi::Value NAVStream::GetDiscard(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->discard);
+}
+
+void NAVStream::SetDiscard(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    GetHandle()->discard = (AVDiscard)value.As<Napi::Number>().Int32Value();
+}
+
+Napi::Value NAVStream::GetSampleAspectRatio(const Napi::CallbackInfo& info) {
+    return NRational(info.Env(), GetHandle()->sample_aspect_ratio);
+}
+
+void NAVStream::SetSampleAspectRatio(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    GetHandle()->sample_aspect_ratio = FromNRational(info.Env(), value);
+}
+
+Napi::Value NAVStream::GetAverageFrameRate(const Napi::CallbackInfo& info) {
+    return NRational(info.Env(), GetHandle()->avg_frame_rate);
+}
+
+void NAVStream::SetAverageFrameRate(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    GetHandle()->avg_frame_rate = FromNRational(info.Env(), value);
+}
+
+Napi::Value NAVStream::GetRealFrameRate(const Napi::CallbackInfo& info) {
+    return NRational(info.Env(), GetHandle()->r_frame_rate);
+}
+
+Napi::Value NAVStream::GetMetadata(const Napi::CallbackInfo& info) {
+    // A copy, as the dictionary belongs to the stream (and would otherwise be freed along with the wrapper)
+    AVDictionary *copy = nullptr;
+    av_dict_copy(&copy, GetHandle()->metadata, 0);
+
+    return NAVDictionary::FromHandleWrapped(info.Env(), copy, true);
+}
+
+Napi::Value NAVStream::GetCodecType(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->codecpar->codec_type);
+}
+
+Napi::Value NAVStream::GetCodecId(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->codecpar->codec_id);
+}
+
+Napi::Value NAVStream::GetCodecTag(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->codecpar->codec_tag);
+}
+
+void NAVStream::SetCodecTag(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    GetHandle()->codecpar->codec_tag = value.As<Napi::Number>().Uint32Value();
+}
+
+Napi::Value NAVStream::GetFormat(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->codecpar->format);
+}
+
+Napi::Value NAVStream::GetBitRate(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->codecpar->bit_rate);
+}
+
+Napi::Value NAVStream::GetWidth(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->codecpar->width);
+}
+
+Napi::Value NAVStream::GetHeight(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->codecpar->height);
+}
+
+Napi::Value NAVStream::GetSampleRate(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetHandle()->codecpar->sample_rate);
+}
@@ -0,0 +1,92 @@
+#include "../common.h"
+
+#include <napi.h>
+#include "../resource.h"
+
+extern "C" {
+    #include <libavformat/avformat.h>
+}
+
+/**
+ * A stream of an AVFormatContext. Streams are owned by their format context: the JS object keeps the
+ * format context alive, and is disposed along with it.
+ */
+class NAVStream : public NAVResource<NAVStream, AVStream> {
+    public:
+        NAVStream(const Napi::CallbackInfo& info);
+
+        inline static std::string ExportName() { return "AVStream"; }
+        inline static Napi::Function ClassDefinition(const Napi::Env &env) {
+            return DefineClass(env, "AVStream", {
+                R_METHOD("copyParametersTo", &NAVStream::CopyParametersTo),
+                R_METHOD("copyParametersFrom", &NAVStream::CopyParametersFrom),
+
+                R_GETTER("index", &NAVStream::GetIndex),
+                R_ACCESSOR("id", &NAVStream::GetId, &NAVStream::SetId),
+                R_ACCESSOR("timeBase", &NAVStream::GetTimeBase, &NAVStream::SetTimeBase),
+                R_GETTER("startTime", &NAVStream::GetStartTime),
+                R_GETTER("duration", &NAVStream::GetDuration),
+                R_GETTER("frameCount", &NAVStream::GetFrameCount),
+                R_ACCESSOR("disposition", &NAVStream::GetDisposition, &NAVStream::SetDisposition),
+                R_ACCESSOR("discard", &NAVStream::GetDiscard, &NAVStream::SetDiscard),
+                R_ACCESSOR("sampleAspectRatio", &NAVStream::GetSampleAspectRatio, &NAVStream::SetSampleAspectRatio),
+                R_ACCESSOR("averageFrameRate", &NAVStream::GetAverageFrameRate, &NAVStream::SetAverageFrameRate),
+                R_GETTER("realFrameRate", &NAVStream::GetRealFrameRate),
+                R_GETTER("metadata", &NAVStream::GetMetadata),
+
+                // From codecpar
+
+                R_GETTER("codecType", &NAVStream::GetCodecType),
+                R_GETTER("codecId", &NAVStream::GetCodecId),
+                R_ACCESSOR("codecTag", &NAVStream::GetCodecTag, &NAVStream::SetCodecTag),
+                R_GETTER("format", &NAVStream::GetFormat),
+                R_GETTER("bitRate", &NAVStream::GetBitRate),
+                R_GETTER("width", &NAVStream::GetWidth),
+                R_GETTER("height", &NAVStream::GetHeight),
+                R_GETTER("sampleRate", &NAVStream::GetSampleRate),
+            });
+        }
+
+        virtual void Free();
+
+        /**
+         * Wrap a stream of the given format context. The wrapper keeps `owner` (the format context's
+         * JS object) alive.
+         */
+        static Napi::Value FromStream(const Napi::Env &env, AVStream *stream, Napi::Object owner);
+
+    private:
+        Napi::ObjectReference owner;
+
+        Napi::Value CopyParametersTo(const Napi::CallbackInfo& info);
+        Napi::Value CopyParametersFrom(const Napi::CallbackInfo& info);
+
+        Napi::Value GetIndex(const Napi::CallbackInfo& info);
+        Napi::Value GetId(const Napi::CallbackInfo& info);
+        void SetId(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetTimeBase(const Napi::CallbackInfo& info);
+        void SetTimeBase(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetStartTime(const Napi::CallbackInfo& info);
+        Napi::Value GetDuration(const Napi::CallbackInfo& info);
+        Napi::Value GetFrameCount(const Napi::CallbackInfo& info);
+        Napi::Value GetDisposition(const Napi::CallbackInfo& info);
+        void SetDisposition(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetDiscard(const Napi::CallbackInfo& info);
+        void SetDiscard(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetSampleAspectRatio(const Napi::CallbackInfo& info);
+        void SetSampleAspectRatio(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetAverageFrameRate(const Napi::CallbackInfo& info);
+        void SetAverageFrameRate(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetRealFrameRate(const Napi::CallbackInfo& info);
+        Napi::Value GetMetadata(const Napi::CallbackInfo& info);
+
+        Napi::Value GetCodecType(const Napi::CallbackInfo& info);
+        Napi::Value GetCodecId(const Napi::CallbackInfo& info);
+        Napi::Value GetCodecTag(const Napi::CallbackInfo& info);
+        void SetCodecTag(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetFormat(const Napi::CallbackInfo& info);
+        Napi::Value GetBitRate(const Napi::CallbackInfo& info);
+        Napi::Value GetWidth(const Napi::CallbackInfo& info);
+        Napi::Value GetHeight(const Napi::CallbackInfo& info);
+        Napi::Value GetSampleRate(const Napi::CallbackInfo& info);
+};
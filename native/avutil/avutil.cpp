@@ -182,3 +182,7 @@ Napi::Value NAVUtil::GetChannelInLayoutByIndex(const Napi::CallbackInfo& callbac
         )
     );
 }
+
+Napi::Value NAVUtil::GetLiveResourceCounts(const Napi::CallbackInfo& callback) {
+    return LibAvAddon::Self(callback)->GetLiveResourceCounts(callback.Env());
+}
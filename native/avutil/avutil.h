@@ -28,7 +28,9 @@ class NAVUtil : public NAVResource<NAVUtil, void> {
                 StaticMethod("getNumberOfChannelsInLayout", &NAVUtil::GetNumberOfChannelsInLayout),
                 StaticMethod("getDefaultChannelLayout", &NAVUtil::GetDefaultChannelLayout),
                 StaticMethod("getIndexOfChannelInLayout", &NAVUtil::GetIndexOfChannelInLayout),
-                StaticMethod("getChannelInLayoutByIndex", &NAVUtil::GetChannelInLayoutByIndex)
+                StaticMethod("getChannelInLayoutByIndex", &NAVUtil::GetChannelInLayoutByIndex),
+
+                StaticMethod("getLiveResourceCounts", &NAVUtil::GetLiveResourceCounts)
             });
         }
 
@@ -59,4 +61,7 @@ class NAVUtil : public NAVResource<NAVUtil, void> {
         static Napi::Value GetDefaultChannelLayout(const Napi::CallbackInfo& callback);
         static Napi::Value GetIndexOfChannelInLayout(const Napi::CallbackInfo& callback);
         static Napi::Value GetChannelInLayoutByIndex(const Napi::CallbackInfo& callback);
+
+        // Debugging
+        static Napi::Value GetLiveResourceCounts(const Napi::CallbackInfo& callback);
 };
\ No newline at end of file
@@ -5,13 +5,29 @@ extern "C" {
 }
 
 #include "buffer.h"
+#include "shared-memory.h"
 #include "../libavaddon.h"
 #include "../helpers.h"
+#include <mutex>
+#include <unordered_set>
 
 void *GetRegisterableBufferHandle(void *bufferRef) {
     return (void*)((AVBufferRef*)bufferRef)->buffer;
 }
 
+/**
+ * Keeps the ArrayBuffer a buffer borrows its memory from alive until libav releases the buffer (see
+ * NAVBuffer::Disown()). Independent of the NAVBuffer, which may be finalized first.
+ */
+struct NAVBufferExternalData {
+    std::shared_ptr<NAVReleaseQueue> releases;
+    Napi::Reference<Napi::ArrayBuffer> *arrayBuffer;
+};
+
+// The opaques of the buffers borrowing ArrayBuffer memory (see IsBorrowedFromJavascript()), of all envs
+static std::mutex nlav_borrowed_buffers_mutex;
+static std::unordered_set<void*> nlav_borrowed_buffers;
+
 NAVBuffer::NAVBuffer(const Napi::CallbackInfo &callback):
     NAVResource(callback)
 {
@@ -27,6 +43,8 @@ NAVBuffer::NAVBuffer(const Napi::CallbackInfo &callback):
 
         return;
     }
+
+    LibAvAddon::Self(callback.Env())->FlushDeferredReleases();
     
     if (callback[0].IsNumber()) {
         auto size = callback[0].As<Napi::Number>().Int64Value();
@@ -73,15 +91,33 @@ NAVBuffer::NAVBuffer(const Napi::CallbackInfo &callback):
         if (!ownedArrayBuffer.IsEmpty())
             ownedArrayBuffer.Unref();
         ownedArrayBuffer = Napi::Reference<Napi::ArrayBuffer>::New(buffer, 1);
-        SetHandle(
-            av_buffer_create(
-                (uint8_t*)buffer.Data(), 
-                buffer.ByteLength(), 
-                &NAVBuffer::Disown, 
-                this, 
-                0
-            )
+        jsMemory = buffer.Data();
+
+        auto external = new NAVBufferExternalData();
+        external->releases = LibAvAddon::Self(callback.Env())->GetReleaseQueue();
+        external->arrayBuffer = new Napi::Reference<Napi::ArrayBuffer>(Napi::Reference<Napi::ArrayBuffer>::New(buffer, 1));
+
+        auto handle = av_buffer_create(
+            (uint8_t*)buffer.Data(), 
+            buffer.ByteLength(), 
+            &NAVBuffer::Disown, 
+            external, 
+            0
         );
+
+        if (!handle) {
+            delete external->arrayBuffer;
+            delete external;
+            Napi::Error::New(callback.Env(), "Failed to allocate buffer").ThrowAsJavaScriptException();
+            return;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(nlav_borrowed_buffers_mutex);
+            nlav_borrowed_buffers.insert(external);
+        }
+
+        SetHandle(handle);
     } else {
         Napi::TypeError::New(callback.Env(), "Invalid invocation").ThrowAsJavaScriptException();
         return;
@@ -98,12 +134,37 @@ void NAVBuffer::RefHandle() {
     SetHandle(av_buffer_ref(GetHandle()));
 }
 
+size_t NAVBuffer::GetExternalMemorySize() {
+    // Memory borrowed from a JS ArrayBuffer is already accounted for by V8
+    if (GetHandle()->data == jsMemory)
+        return 0;
+    
+    return GetHandle()->size;
+}
+
+bool NAVBuffer::IsBorrowedFromJavascript(const AVBufferRef *buffer) {
+    if (!buffer)
+        return false;
+    
+    std::unique_lock<std::mutex> lock(nlav_borrowed_buffers_mutex);
+    return nlav_borrowed_buffers.count(av_buffer_get_opaque(buffer)) > 0;
+}
+
 void NAVBuffer::Disown(void *opaque, uint8_t *data) {
-    NAVBuffer *buffer = (NAVBuffer*)opaque;
-    if (!buffer->ownedArrayBuffer.IsEmpty())
-        buffer->ownedArrayBuffer.Unref();
-    buffer->ownedArrayBuffer = Napi::Reference<Napi::ArrayBuffer>();
-    buffer->SetHandle(nullptr);
+    auto external = (NAVBufferExternalData*)opaque;
+    auto arrayBuffer = external->arrayBuffer;
+
+    {
+        std::unique_lock<std::mutex> lock(nlav_borrowed_buffers_mutex);
+        nlav_borrowed_buffers.erase(external);
+    }
+
+    // The last reference may be dropped by a codec thread, or after a worker thread's env is gone
+    external->releases->Defer([arrayBuffer]() {
+        delete arrayBuffer;
+    });
+
+    delete external;
 }
 
 Napi::Value NAVBuffer::GetRefCount(const Napi::CallbackInfo& info) {
@@ -120,6 +181,49 @@ Napi::Value NAVBuffer::GetIsWritable(const Napi::CallbackInfo& info) {
     return Napi::Boolean::New(info.Env(), av_buffer_is_writable(this->GetHandle()) == 1);
 }
 
+/**
+ * Where the data is when it is in shared memory (see allocateShared()), as { fd, offset, size }, 
+ * null otherwise.
+ */
+Napi::Value NAVBuffer::GetSharedMemory(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    size_t offset = 0;
+    int fd = nlav_shared_buffer_fd(GetHandle(), &offset);
+
+    if (fd < 0)
+        return env.Null();
+    
+    auto object = Napi::Object::New(env);
+    object.Set("fd", Napi::Number::New(env, fd));
+    object.Set("offset", Napi::Number::New(env, offset));
+    object.Set("size", Napi::Number::New(env, GetHandle()->size));
+
+    return object;
+}
+
+Napi::Value NAVBuffer::AllocateShared(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto size = info[0].IsNumber() ? info[0].As<Napi::Number>().Int64Value() : -1;
+
+    if (size <= 0) {
+        Napi::TypeError::New(env, "Size must be positive").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    if (!nlav_shared_memory_supported()) {
+        Napi::Error::New(env, "Shared memory buffers are not supported on this platform").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto buffer = nlav_shared_buffer_alloc(size);
+    if (!buffer) {
+        Napi::Error::New(env, "Failed to allocate shared memory").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return NAVBuffer::FromHandleWrapped(env, buffer, true);
+}
+
 Napi::Value NAVBuffer::MakeWritable(const Napi::CallbackInfo& info) {
     auto handle = GetHandle();
 
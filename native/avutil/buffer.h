@@ -16,10 +16,13 @@ class NAVBuffer : public NAVResource<NAVBuffer, AVBufferRef, GetRegisterableBuff
         inline static std::string ExportName() { return "AVBuffer"; }
         inline static Napi::Function ClassDefinition(const Napi::Env &env) {
             return DefineClass(env, "AVBuffer", {
+                StaticMethod("allocateShared", &NAVBuffer::AllocateShared),
+
                 R_GETTER("size", &NAVBuffer::GetSize),
                 R_GETTER("data", &NAVBuffer::GetData),
                 R_GETTER("refCount", &NAVBuffer::GetRefCount),
                 R_GETTER("writable", &NAVBuffer::GetIsWritable),
+                R_GETTER("sharedMemory", &NAVBuffer::GetSharedMemory),
                 R_METHOD("free", &NAVBuffer::Free),
                 R_METHOD("makeWritable", &NAVBuffer::MakeWritable),
                 R_METHOD("realloc", &NAVBuffer::Realloc)
@@ -28,20 +31,32 @@ class NAVBuffer : public NAVResource<NAVBuffer, AVBufferRef, GetRegisterableBuff
 
         virtual void Free();
         virtual void RefHandle();
+        virtual size_t GetExternalMemorySize();
+
+        /**
+         * Whether the data of the given buffer is the memory of a Javascript ArrayBuffer, which belongs to
+         * the env that created the buffer. Known from the buffer itself, whether or not an AVBuffer instance
+         * still wraps it. Any thread.
+         */
+        static bool IsBorrowedFromJavascript(const AVBufferRef *buffer);
 
     private:
         Napi::Reference<Napi::ArrayBuffer> ownedArrayBuffer;
+        void *jsMemory = nullptr;
         Napi::Value GetSize(const Napi::CallbackInfo& info);
         Napi::Value GetData(const Napi::CallbackInfo& info);
         Napi::Value Free(const Napi::CallbackInfo& info);
         Napi::Value GetRefCount(const Napi::CallbackInfo& info);
         Napi::Value GetIsWritable(const Napi::CallbackInfo& info);
+        Napi::Value GetSharedMemory(const Napi::CallbackInfo& info);
+        static Napi::Value AllocateShared(const Napi::CallbackInfo& info);
         Napi::Value MakeWritable(const Napi::CallbackInfo& info);
         Napi::Value Realloc(const Napi::CallbackInfo& info);
         Napi::Value Replace(const Napi::CallbackInfo& info);
 
         /**
-         * Callback for av_buffer_create to handle freeing an owned ArrayBuffer
+         * Callback for av_buffer_create to release the borrowed ArrayBuffer once libav is done with the
+         * buffer. Any thread: the release itself runs on the env's thread (see LibAvAddon::DeferRelease()).
          */
         static void Disown(void *opaque, uint8_t *data);
 };
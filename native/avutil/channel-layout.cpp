@@ -21,6 +21,11 @@ void NAVChannelLayout::RefBuffer() {
     owned = false;
 }
 
+bool NAVChannelLayout::CheckDisposable(const Napi::Env &env) {
+    // Layouts we do not own describe static data, such as those shared through AVCodec#channelLayouts
+    return owned;
+}
+
 Napi::Value NAVChannelLayout::FromMask(const Napi::CallbackInfo& info) {
     bool truncated;
     uint64_t mask = info[0].As<Napi::BigInt>().Uint64Value(&truncated);
@@ -40,6 +40,7 @@ class NAVChannelLayout : public NAVResource<NAVChannelLayout, AVChannelLayout> {
 
         virtual void Free();
         virtual void RefBuffer();
+        virtual bool CheckDisposable(const Napi::Env &env);
     private:
         bool owned = true;
 
@@ -0,0 +1,501 @@
+#include "frame-ops.h"
+#include "kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+extern "C" {
+    #include <libavutil/imgutils.h>
+    #include <libavutil/pixdesc.h>
+    #include <libavutil/samplefmt.h>
+    #include <libavutil/channel_layout.h>
+}
+
+/**
+ * Number of samples per channel converted at a time by nlav_copy_samples(), so that the intermediate 
+ * buffers stay in the cache
+ */
+#define NLAV_SAMPLE_CHUNK 1024
+
+static int nlav_frame_channels(const AVFrame *frame) {
+#ifdef FFMPEG_5_1
+    return frame->ch_layout.nb_channels;
+#else
+    return frame->channels ? frame->channels : av_get_channel_layout_nb_channels(frame->channel_layout);
+#endif
+}
+
+/**
+ * Bytes per pixel of the given plane (the largest step of its components), 0 if it has none. For planes
+ * packing subsampled components (YUYV422 and the like, see nlav_plane_is_macropixel()), the bytes per 
+ * macropixel.
+ */
+static int nlav_plane_step(const AVPixFmtDescriptor *descriptor, int plane) {
+    int step = 0;
+
+    for (int i = 0; i < descriptor->nb_components; ++i) {
+        if (descriptor->comp[i].plane == plane)
+            step = std::max(step, descriptor->comp[i].step);
+    }
+
+    return step;
+}
+
+/**
+ * Whether the components of the plane have different steps: packed subsampled formats like YUYV422, 
+ * where a macropixel holds 1 << log2_chroma_w luma samples and one of each chroma component
+ */
+static bool nlav_plane_is_macropixel(const AVPixFmtDescriptor *descriptor, int plane) {
+    int step = nlav_plane_step(descriptor, plane);
+
+    for (int i = 0; i < descriptor->nb_components; ++i) {
+        if (descriptor->comp[i].plane == plane && descriptor->comp[i].step != step)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Whether the plane is laid out in whole pixels or macropixels. Formats like UYYVYY411, whose luma 
+ * samples are not evenly spaced within a macropixel, are not.
+ */
+static bool nlav_plane_supported(const AVPixFmtDescriptor *descriptor, int plane) {
+    int step = nlav_plane_step(descriptor, plane);
+
+    for (int i = 0; i < descriptor->nb_components; ++i) {
+        auto &component = descriptor->comp[i];
+        if (component.plane != plane || component.step == step)
+            continue;
+        
+        if (component.step <= 0 || step != component.step << descriptor->log2_chroma_w)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * The span of a region along one axis in a plane subsampled by the given shift, rounding outwards
+ */
+static void nlav_plane_span(int start, int length, int shift, int &planeStart, int &planeLength) {
+    planeStart = start >> shift;
+    planeLength = -((-(start + length)) >> shift) - planeStart;
+}
+
+/**
+ * How much the plane is subsampled horizontally: chroma planes, and planes packed in macropixels
+ */
+static int nlav_plane_shift_x(const AVPixFmtDescriptor *descriptor, int plane) {
+    return plane == 1 || plane == 2 || nlav_plane_is_macropixel(descriptor, plane) ? descriptor->log2_chroma_w : 0;
+}
+
+static int nlav_plane_shift_y(const AVPixFmtDescriptor *descriptor, int plane) {
+    return plane == 1 || plane == 2 ? descriptor->log2_chroma_h : 0;
+}
+
+static std::string nlav_check_video_frame(const AVFrame *frame, const char *which) {
+    if (frame->width <= 0 || frame->height <= 0 || frame->nb_samples > 0)
+        return std::string("The ") + which + " frame is not a video frame";
+    
+    auto descriptor = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    if (!descriptor)
+        return std::string("The ") + which + " frame has no pixel format";
+    
+    if (descriptor->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL))
+        return std::string("Hardware, bitstream and paletted pixel formats are not supported (") + descriptor->name + ")";
+    
+    if (!frame->data[0])
+        return std::string("The ") + which + " frame has no buffers";
+    
+    for (int plane = 0; plane < 4; ++plane) {
+        if (!nlav_plane_supported(descriptor, plane))
+            return std::string("The pixel layout of ") + descriptor->name + " is not supported";
+    }
+
+    return "";
+}
+
+static std::string nlav_check_region(const AVFrame *frame, const AVPixFmtDescriptor *descriptor, const NAVFrameRegion &region, const char *which) {
+    if (region.x < 0 || region.y < 0 || region.width < 0 || region.height < 0)
+        return "The region cannot have negative coordinates or sizes";
+    
+    if (region.x + (int64_t)region.width > frame->width || region.y + (int64_t)region.height > frame->height)
+        return std::string("The region does not fit into the ") + which + " frame";
+    
+    int alignX = 1 << descriptor->log2_chroma_w;
+    int alignY = 1 << descriptor->log2_chroma_h;
+
+    if (region.x % alignX || region.y % alignY)
+        return "The region must start on the chroma subsampling grid (multiples of " + std::to_string(alignX) 
+            + "x" + std::to_string(alignY) + ")";
+    
+    return "";
+}
+
+std::string nlav_check_region_copy(const AVFrame *src, const AVFrame *dst, const NAVFrameRegion &region, int x, int y) {
+    std::string error;
+
+    if (!(error = nlav_check_video_frame(src, "source")).empty() || !(error = nlav_check_video_frame(dst, "destination")).empty())
+        return error;
+    
+    if (src->format != dst->format)
+        return "Both frames must have the same pixel format";
+    
+    if (!av_frame_is_writable((AVFrame*)dst))
+        return "The destination frame is not writable";
+    
+    auto descriptor = av_pix_fmt_desc_get((AVPixelFormat)src->format);
+    NAVFrameRegion target = { x, y, region.width, region.height };
+
+    if (!(error = nlav_check_region(src, descriptor, region, "source")).empty())
+        return error;
+    
+    return nlav_check_region(dst, descriptor, target, "destination");
+}
+
+/**
+ * Like av_image_copy_plane(), for a source and destination which are in the same plane and may overlap 
+ * (copyRegionTo() onto the frame itself): rows are moved in the order which reads each source row 
+ * before it is overwritten, each with memmove().
+ */
+static void nlav_move_plane(uint8_t *dst, int dstLinesize, const uint8_t *src, int srcLinesize, int bytes, int height) {
+    if (dst > src) {
+        for (int row = height - 1; row >= 0; --row)
+            memmove(dst + row * dstLinesize, src + row * srcLinesize, bytes);
+    } else if (dst < src) {
+        for (int row = 0; row < height; ++row)
+            memmove(dst + row * dstLinesize, src + row * srcLinesize, bytes);
+    }
+}
+
+void nlav_copy_region(const AVFrame *src, AVFrame *dst, const NAVFrameRegion &region, int x, int y) {
+    auto descriptor = av_pix_fmt_desc_get((AVPixelFormat)src->format);
+
+    for (int plane = 0; plane < 4 && src->data[plane]; ++plane) {
+        int step = nlav_plane_step(descriptor, plane);
+        int shiftX = nlav_plane_shift_x(descriptor, plane);
+        int shiftY = nlav_plane_shift_y(descriptor, plane);
+        int srcX, srcY, dstX, dstY, width, height;
+
+        nlav_plane_span(region.x, region.width, shiftX, srcX, width);
+        nlav_plane_span(region.y, region.height, shiftY, srcY, height);
+        nlav_plane_span(x, region.width, shiftX, dstX, width);
+        nlav_plane_span(y, region.height, shiftY, dstY, height);
+
+        uint8_t *to = dst->data[plane] + dstY * dst->linesize[plane] + dstX * step;
+        const uint8_t *from = src->data[plane] + srcY * src->linesize[plane] + srcX * step;
+
+        if (dst->data[plane] == src->data[plane]) {
+            nlav_move_plane(to, dst->linesize[plane], from, src->linesize[plane], width * step, height);
+            continue;
+        }
+
+        // Rows are copied with memcpy(), which the C library already vectorizes
+        av_image_copy_plane(to, dst->linesize[plane], from, src->linesize[plane], width * step, height);
+    }
+}
+
+/**
+ * The bytes of one pixel (or macropixel) of the given plane in the given color. False if the components 
+ * of the plane share bytes (like RGB565) or take more than 2 bytes, which we do not support.
+ */
+static bool nlav_fill_pattern(const AVPixFmtDescriptor *descriptor, int plane, const std::vector<uint32_t> &values, std::vector<uint8_t> &pattern) {
+    int step = nlav_plane_step(descriptor, plane);
+    std::vector<bool> used(step, false);
+    bool bigEndian = (descriptor->flags & AV_PIX_FMT_FLAG_BE) != 0;
+
+    pattern.assign(step, 0);
+
+    for (int i = 0; i < descriptor->nb_components; ++i) {
+        auto &component = descriptor->comp[i];
+        if (component.plane != plane)
+            continue;
+        
+        if (component.depth + component.shift > 16)
+            return false;
+
+        int bytes = component.depth + component.shift <= 8 ? 1 : 2;
+        uint32_t value = (values[i] & ((1u << component.depth) - 1)) << component.shift;
+
+        // Each sample of the component in a macropixel (the luma samples of YUYV422), a single one otherwise
+        for (int offset = component.offset; offset < step; offset += component.step) {
+            if (offset + bytes > step)
+                return false;
+            
+            for (int j = 0; j < bytes; ++j) {
+                if (used[offset + j])
+                    return false;
+                used[offset + j] = true;
+            }
+
+            if (bytes == 1) {
+                pattern[offset] = (uint8_t)value;
+            } else {
+                pattern[offset + (bigEndian ? 1 : 0)] = (uint8_t)value;
+                pattern[offset + (bigEndian ? 0 : 1)] = (uint8_t)(value >> 8);
+            }
+        }
+    }
+
+    return true;
+}
+
+std::string nlav_check_region_fill(const AVFrame *frame, const NAVFrameRegion &region, const std::vector<uint32_t> &values) {
+    std::string error;
+
+    if (!(error = nlav_check_video_frame(frame, "")).empty())
+        return error;
+    
+    if (!av_frame_is_writable((AVFrame*)frame))
+        return "The frame is not writable";
+    
+    auto descriptor = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    std::vector<uint8_t> pattern;
+
+    if (values.size() != descriptor->nb_components)
+        return "Expected " + std::to_string(descriptor->nb_components) + " values, one per component of " + descriptor->name;
+
+    // Colors are integers, and patterns hold components of up to 16 bits
+    if (descriptor->flags & AV_PIX_FMT_FLAG_FLOAT)
+        return std::string("Filling is not supported for floating point formats like ") + descriptor->name;
+    
+    for (int plane = 0; plane < 4 && frame->data[plane]; ++plane) {
+        if (!nlav_fill_pattern(descriptor, plane, values, pattern))
+            return std::string("Filling is not supported for ") + descriptor->name;
+    }
+
+    return nlav_check_region(frame, descriptor, region, "");
+}
+
+void nlav_fill_region(AVFrame *frame, const NAVFrameRegion &region, const std::vector<uint32_t> &values) {
+    auto &kernels = nlav_kernels();
+    auto descriptor = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    std::vector<uint8_t> pattern;
+
+    for (int plane = 0; plane < 4 && frame->data[plane]; ++plane) {
+        int step = nlav_plane_step(descriptor, plane);
+        int x, y, width, height;
+        uint16_t pattern16;
+        uint32_t pattern32;
+
+        nlav_fill_pattern(descriptor, plane, values, pattern);
+        nlav_plane_span(region.x, region.width, nlav_plane_shift_x(descriptor, plane), x, width);
+        nlav_plane_span(region.y, region.height, nlav_plane_shift_y(descriptor, plane), y, height);
+
+        // The patterns are the pixel's bytes in memory order, whatever the endianness
+        if (step == 2)
+            memcpy(&pattern16, pattern.data(), 2);
+        if (step == 4)
+            memcpy(&pattern32, pattern.data(), 4);
+
+        for (int row = y; row < y + height; ++row) {
+            uint8_t *start = frame->data[plane] + row * frame->linesize[plane] + x * step;
+
+            if (step == 1) {
+                memset(start, pattern[0], width);
+            } else if (step == 2) {
+                kernels.fill16((uint16_t*)start, pattern16, width);
+            } else if (step == 4) {
+                kernels.fill32((uint32_t*)start, pattern32, width);
+            } else {
+                for (int i = 0; i < width; ++i)
+                    memcpy(start + i * step, pattern.data(), step);
+            }
+        }
+    }
+}
+
+bool nlav_sample_format_supported(AVSampleFormat format) {
+    switch (av_get_packed_sample_fmt(format)) {
+        case AV_SAMPLE_FMT_S16:
+        case AV_SAMPLE_FMT_S32:
+        case AV_SAMPLE_FMT_FLT:
+        case AV_SAMPLE_FMT_DBL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::string nlav_check_sample_copy(const AVFrame *src, const AVFrame *dst) {
+    if (src->nb_samples <= 0 || dst->nb_samples <= 0 || src->width > 0 || dst->width > 0)
+        return "Both frames must be audio frames";
+    
+    if (!nlav_sample_format_supported((AVSampleFormat)src->format) || !nlav_sample_format_supported((AVSampleFormat)dst->format))
+        return "Only the s16, s32, flt and dbl sample formats (planar or not) are supported";
+    
+    if (nlav_frame_channels(src) != nlav_frame_channels(dst) || nlav_frame_channels(src) <= 0)
+        return "Both frames must have the same number of channels";
+    
+    if (dst->nb_samples < src->nb_samples)
+        return "The destination frame is too small for the samples of the source frame";
+    
+    if (!src->extended_data[0] || !dst->extended_data[0])
+        return "Both frames must have buffers";
+    
+    if (!av_frame_is_writable((AVFrame*)dst))
+        return "The destination frame is not writable";
+    
+    return "";
+}
+
+template <typename T>
+static void nlav_interleave(uint8_t *dst, uint8_t * const *channels, int count, size_t samples) {
+    T *out = (T*)dst;
+
+    for (int c = 0; c < count; ++c) {
+        const T *in = (const T*)channels[c];
+        for (size_t i = 0; i < samples; ++i)
+            out[i * count + c] = in[i];
+    }
+}
+
+template <typename T>
+static void nlav_deinterleave(uint8_t * const *channels, const uint8_t *src, int count, size_t samples) {
+    const T *in = (const T*)src;
+
+    for (int c = 0; c < count; ++c) {
+        T *out = (T*)channels[c];
+        for (size_t i = 0; i < samples; ++i)
+            out[i] = in[i * count + c];
+    }
+}
+
+static void nlav_interleave_samples(uint8_t *dst, uint8_t * const *channels, int count, int size, size_t samples) {
+    if (count == 2 && size == 4)
+        nlav_kernels().interleave2x32((uint32_t*)dst, (const uint32_t*)channels[0], (const uint32_t*)channels[1], samples);
+    else if (size == 2)
+        nlav_interleave<uint16_t>(dst, channels, count, samples);
+    else if (size == 4)
+        nlav_interleave<uint32_t>(dst, channels, count, samples);
+    else
+        nlav_interleave<uint64_t>(dst, channels, count, samples);
+}
+
+static void nlav_deinterleave_samples(uint8_t * const *channels, const uint8_t *src, int count, int size, size_t samples) {
+    if (count == 2 && size == 4)
+        nlav_kernels().deinterleave2x32((uint32_t*)channels[0], (uint32_t*)channels[1], (const uint32_t*)src, samples);
+    else if (size == 2)
+        nlav_deinterleave<uint16_t>(channels, src, count, samples);
+    else if (size == 4)
+        nlav_deinterleave<uint32_t>(channels, src, count, samples);
+    else
+        nlav_deinterleave<uint64_t>(channels, src, count, samples);
+}
+
+static double nlav_read_sample(const uint8_t *src, AVSampleFormat format, size_t i) {
+    switch (format) {
+        case AV_SAMPLE_FMT_S16: return ((const int16_t*)src)[i] / 32768.0;
+        case AV_SAMPLE_FMT_S32: return ((const int32_t*)src)[i] / 2147483648.0;
+        case AV_SAMPLE_FMT_FLT: return ((const float*)src)[i];
+        default:                return ((const double*)src)[i];
+    }
+}
+
+static void nlav_write_sample(uint8_t *dst, AVSampleFormat format, size_t i, double value) {
+    switch (format) {
+        case AV_SAMPLE_FMT_S16: 
+            ((int16_t*)dst)[i] = (int16_t)lrint(std::min(32767.0, std::max(-32768.0, value * 32768.0)));
+            break;
+        case AV_SAMPLE_FMT_S32: 
+            ((int32_t*)dst)[i] = (int32_t)llrint(std::min(2147483647.0, std::max(-2147483648.0, value * 2147483648.0)));
+            break;
+        case AV_SAMPLE_FMT_FLT: 
+            ((float*)dst)[i] = (float)value;
+            break;
+        default:
+            ((double*)dst)[i] = value;
+            break;
+    }
+}
+
+/**
+ * Convert one channel between packed sample formats, with the kernels for the common cases
+ */
+static void nlav_convert_samples(uint8_t *dst, AVSampleFormat dstFormat, const uint8_t *src, AVSampleFormat srcFormat, size_t samples, float gain) {
+    auto &kernels = nlav_kernels();
+
+    if (srcFormat == dstFormat && gain == 1.0f) {
+        memcpy(dst, src, samples * av_get_bytes_per_sample(srcFormat));
+    } else if (srcFormat == AV_SAMPLE_FMT_S16 && dstFormat == AV_SAMPLE_FMT_FLT) {
+        kernels.s16ToFloat((float*)dst, (const int16_t*)src, samples, gain / 32768.0f);
+    } else if (srcFormat == AV_SAMPLE_FMT_FLT && dstFormat == AV_SAMPLE_FMT_S16) {
+        kernels.floatToS16((int16_t*)dst, (const float*)src, samples, gain * 32768.0f);
+    } else if (srcFormat == AV_SAMPLE_FMT_FLT && dstFormat == AV_SAMPLE_FMT_FLT) {
+        kernels.scaleFloat((float*)dst, (const float*)src, samples, gain);
+    } else {
+        for (size_t i = 0; i < samples; ++i)
+            nlav_write_sample(dst, dstFormat, i, nlav_read_sample(src, srcFormat, i) * gain);
+    }
+}
+
+void nlav_copy_samples(const AVFrame *src, AVFrame *dst, float gain) {
+    auto srcFormat = (AVSampleFormat)src->format;
+    auto dstFormat = (AVSampleFormat)dst->format;
+    auto srcPacked = av_get_packed_sample_fmt(srcFormat);
+    auto dstPacked = av_get_packed_sample_fmt(dstFormat);
+    bool srcPlanar = av_sample_fmt_is_planar(srcFormat);
+    bool dstPlanar = av_sample_fmt_is_planar(dstFormat);
+    int channels = nlav_frame_channels(src);
+    int srcSize = av_get_bytes_per_sample(srcFormat);
+    int dstSize = av_get_bytes_per_sample(dstFormat);
+    size_t samples = src->nb_samples;
+
+    // Interleaved to interleaved without conversion is one copy
+    if (!srcPlanar && !dstPlanar && srcPacked == dstPacked && gain == 1.0f) {
+        memcpy(dst->extended_data[0], src->extended_data[0], samples * channels * srcSize);
+        return;
+    }
+
+    std::vector<uint8_t> deinterleaved(srcPlanar ? 0 : (size_t)channels * NLAV_SAMPLE_CHUNK * srcSize);
+    std::vector<uint8_t> converted(dstPlanar ? 0 : (size_t)channels * NLAV_SAMPLE_CHUNK * dstSize);
+    std::vector<uint8_t*> in(channels);
+    std::vector<uint8_t*> out(channels);
+
+    for (size_t offset = 0; offset < samples; offset += NLAV_SAMPLE_CHUNK) {
+        size_t count = std::min((size_t)NLAV_SAMPLE_CHUNK, samples - offset);
+
+        for (int c = 0; c < channels; ++c) {
+            in[c] = srcPlanar ? src->extended_data[c] + offset * srcSize : deinterleaved.data() + c * NLAV_SAMPLE_CHUNK * srcSize;
+            out[c] = dstPlanar ? dst->extended_data[c] + offset * dstSize : converted.data() + c * NLAV_SAMPLE_CHUNK * dstSize;
+        }
+
+        if (!srcPlanar)
+            nlav_deinterleave_samples(in.data(), src->extended_data[0] + offset * channels * srcSize, channels, srcSize, count);
+
+        for (int c = 0; c < channels; ++c)
+            nlav_convert_samples(out[c], dstPacked, in[c], srcPacked, count, gain);
+        
+        if (!dstPlanar)
+            nlav_interleave_samples(dst->extended_data[0] + offset * channels * dstSize, out.data(), channels, dstSize, count);
+    }
+}
+
+void nlav_samples_to_float(const AVFrame *src, size_t offset, size_t count, float * const *channels) {
+    auto format = (AVSampleFormat)src->format;
+    auto packed = av_get_packed_sample_fmt(format);
+    int size = av_get_bytes_per_sample(format);
+    int channelCount = nlav_frame_channels(src);
+
+    if (av_sample_fmt_is_planar(format)) {
+        for (int c = 0; c < channelCount; ++c)
+            nlav_convert_samples((uint8_t*)channels[c], AV_SAMPLE_FMT_FLT, src->extended_data[c] + offset * size, packed, count, 1.0f);
+        return;
+    }
+
+    std::vector<uint8_t> deinterleaved((size_t)channelCount * NLAV_SAMPLE_CHUNK * size);
+    std::vector<uint8_t*> in(channelCount);
+
+    for (int c = 0; c < channelCount; ++c)
+        in[c] = deinterleaved.data() + c * NLAV_SAMPLE_CHUNK * size;
+
+    for (size_t done = 0; done < count; done += NLAV_SAMPLE_CHUNK) {
+        size_t chunk = std::min((size_t)NLAV_SAMPLE_CHUNK, count - done);
+
+        nlav_deinterleave_samples(in.data(), src->extended_data[0] + (offset + done) * channelCount * size, channelCount, size, chunk);
+        for (int c = 0; c < channelCount; ++c)
+            nlav_convert_samples((uint8_t*)(channels[c] + done), AV_SAMPLE_FMT_FLT, in[c], packed, chunk, 1.0f);
+    }
+}
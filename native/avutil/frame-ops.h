@@ -0,0 +1,54 @@
+#include "../common.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+extern "C" {
+    #include <libavutil/frame.h>
+    #include <libavutil/samplefmt.h>
+}
+
+/**
+ * A rectangle of a video frame, in pixels of its first plane
+ */
+struct NAVFrameRegion {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// Plane and sample operations of AVFrame which would otherwise be per-byte loops in Javascript or a
+// round trip through libswscale/libswresample. Each has a check, which returns why the operation is not
+// possible (empty if it is) and runs on the JS thread, and the operation itself, which can run on any 
+// thread (see NAVFrame::CopyRegionToAsync() and friends). The inner loops are in kernels.h.
+
+/**
+ * Copy a region of a video frame into another frame of the same pixel format, at (x, y). The region and
+ * the position must fall on the chroma subsampling grid.
+ */
+std::string nlav_check_region_copy(const AVFrame *src, const AVFrame *dst, const NAVFrameRegion &region, int x, int y);
+void nlav_copy_region(const AVFrame *src, AVFrame *dst, const NAVFrameRegion &region, int x, int y);
+
+/**
+ * Fill a region of a video frame with a color, given as one value per component of the pixel format 
+ * (in the order of its descriptor, for instance Y, U, V or R, G, B, A).
+ */
+std::string nlav_check_region_fill(const AVFrame *frame, const NAVFrameRegion &region, const std::vector<uint32_t> &values);
+void nlav_fill_region(AVFrame *frame, const NAVFrameRegion &region, const std::vector<uint32_t> &values);
+
+/**
+ * Copy the samples of an audio frame into another with the same number of channels, converting between 
+ * planar and interleaved layouts and between the s16, s32, flt and dbl sample formats, and applying a 
+ * gain. Integer formats saturate.
+ */
+bool nlav_sample_format_supported(AVSampleFormat format);
+std::string nlav_check_sample_copy(const AVFrame *src, const AVFrame *dst);
+void nlav_copy_samples(const AVFrame *src, AVFrame *dst, float gain);
+
+/**
+ * Read count samples of each channel of an audio frame (which nlav_check_sample_copy() accepts), from 
+ * the given offset, as floats into the given per-channel arrays
+ */
+void nlav_samples_to_float(const AVFrame *src, size_t offset, size_t count, float * const *channels);
@@ -0,0 +1,373 @@
+#include "frame-stats.h"
+#include "frame-ops.h"
+#include "kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+extern "C" {
+    #include <libavutil/pixdesc.h>
+    #include <libavutil/samplefmt.h>
+    #include <libavutil/channel_layout.h>
+}
+
+/**
+ * Number of samples per channel read at a time for audio statistics
+ */
+#define NLAV_STATISTICS_CHUNK 1024
+
+static int nlav_frame_channels(const AVFrame *frame) {
+#ifdef FFMPEG_5_1
+    return frame->ch_layout.nb_channels;
+#else
+    return frame->channels ? frame->channels : av_get_channel_layout_nb_channels(frame->channel_layout);
+#endif
+}
+
+static bool nlav_is_audio(const AVFrame *frame) {
+    return frame->nb_samples > 0 && frame->width <= 0;
+}
+
+static void nlav_plane_size(const AVPixFmtDescriptor *descriptor, const AVFrame *frame, int plane, int &width, int &height) {
+    bool chroma = plane == 1 || plane == 2;
+
+    // Rounding up, as subsampled planes cover the odd pixel
+    width = chroma ? -((-frame->width) >> descriptor->log2_chroma_w) : frame->width;
+    height = chroma ? -((-frame->height) >> descriptor->log2_chroma_h) : frame->height;
+}
+
+static std::string nlav_check_video_statistics(const AVFrame *frame, const char *which) {
+    if (frame->width <= 0 || frame->height <= 0 || !frame->data[0])
+        return std::string("The ") + which + " is not a video frame with buffers";
+    
+    auto descriptor = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    if (!descriptor || (descriptor->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL)))
+        return "Statistics are only supported for planar 8 bit pixel formats";
+    
+    for (int i = 0; i < descriptor->nb_components; ++i) {
+        auto &component = descriptor->comp[i];
+        if (component.step != 1 || component.depth != 8 || component.shift != 0)
+            return std::string("Statistics are only supported for planar 8 bit pixel formats, not ") + descriptor->name;
+    }
+
+    return "";
+}
+
+static std::string nlav_check_same_layout(const AVFrame *frame, const AVFrame *other, const char *which) {
+    std::string error = nlav_check_video_statistics(other, which);
+
+    if (error.empty() && (other->format != frame->format || other->width != frame->width || other->height != frame->height))
+        return std::string("The ") + which + " must have the same pixel format and size as the frame";
+    
+    return error;
+}
+
+std::string nlav_check_statistics(const AVFrame *frame, const AVFrame *previous) {
+    if (nlav_is_audio(frame)) {
+        if (!nlav_sample_format_supported((AVSampleFormat)frame->format))
+            return "Only the s16, s32, flt and dbl sample formats (planar or not) are supported";
+        
+        if (!frame->extended_data || !frame->extended_data[0] || nlav_frame_channels(frame) <= 0)
+            return "The frame has no buffers or channels";
+        
+        if (previous)
+            return "Frozen frame detection is only available for video";
+        
+        return "";
+    }
+
+    std::string error = nlav_check_video_statistics(frame, "frame");
+
+    if (error.empty() && previous)
+        error = nlav_check_same_layout(frame, previous, "previous frame");
+    
+    return error;
+}
+
+/**
+ * The luma value at or below which a pixel counts as black, like blackdetect with its default 
+ * pixel_black_th of 0.10
+ */
+static int nlav_black_threshold(const AVFrame *frame, const NAVFrameStatisticsOptions &options) {
+    if (options.blackThreshold >= 0)
+        return std::min(options.blackThreshold, 255);
+    
+    return frame->color_range == AVCOL_RANGE_JPEG ? 25 : 16 + (235 - 16) / 10;
+}
+
+static void nlav_compute_audio_statistics(const AVFrame *frame, NAVFrameStatistics &statistics) {
+    auto &kernels = nlav_kernels();
+    int channels = nlav_frame_channels(frame);
+    size_t samples = frame->nb_samples;
+    std::vector<double> sums(channels, 0);
+    std::vector<float> peaks(channels, 0);
+
+    statistics.audio = true;
+    
+    if ((AVSampleFormat)frame->format == AV_SAMPLE_FMT_FLTP) {
+        for (int c = 0; c < channels; ++c)
+            kernels.energyFloat((const float*)frame->extended_data[c], samples, &sums[c], &peaks[c]);
+    } else {
+        std::vector<float> buffer((size_t)channels * NLAV_STATISTICS_CHUNK);
+        std::vector<float*> pointers(channels);
+
+        for (int c = 0; c < channels; ++c)
+            pointers[c] = buffer.data() + c * NLAV_STATISTICS_CHUNK;
+        
+        for (size_t offset = 0; offset < samples; offset += NLAV_STATISTICS_CHUNK) {
+            size_t count = std::min((size_t)NLAV_STATISTICS_CHUNK, samples - offset);
+
+            nlav_samples_to_float(frame, offset, count, pointers.data());
+            for (int c = 0; c < channels; ++c)
+                kernels.energyFloat(pointers[c], count, &sums[c], &peaks[c]);
+        }
+    }
+
+    statistics.channels.resize(channels);
+    for (int c = 0; c < channels; ++c) {
+        statistics.channels[c].rms = samples ? std::sqrt(sums[c] / samples) : 0;
+        statistics.channels[c].peak = peaks[c];
+    }
+}
+
+void nlav_compute_statistics(const AVFrame *frame, const AVFrame *previous, const NAVFrameStatisticsOptions &options, NAVFrameStatistics &statistics) {
+    statistics = NAVFrameStatistics();
+
+    if (nlav_is_audio(frame)) {
+        nlav_compute_audio_statistics(frame, statistics);
+        return;
+    }
+
+    auto &kernels = nlav_kernels();
+    auto descriptor = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    int planes = av_pix_fmt_count_planes((AVPixelFormat)frame->format);
+
+    for (int plane = 0; plane < planes; ++plane) {
+        int width, height;
+        uint64_t sum = 0, squares = 0;
+
+        nlav_plane_size(descriptor, frame, plane, width, height);
+        for (int y = 0; y < height; ++y) {
+            const uint8_t *row = frame->data[plane] + y * frame->linesize[plane];
+            sum += kernels.sum8(row, width);
+            squares += kernels.sumSquares8(row, width);
+        }
+
+        double pixels = (double)width * height;
+        NAVPlaneStatistics planeStatistics;
+        planeStatistics.mean = sum / pixels;
+        planeStatistics.variance = std::max(0.0, squares / pixels - planeStatistics.mean * planeStatistics.mean);
+        statistics.planes.push_back(planeStatistics);
+    }
+
+    // Black and frozen frame detection, and the histogram, look at the luma (or first) plane only
+    int threshold = nlav_black_threshold(frame, options);
+    uint64_t black = 0, difference = 0;
+    double pixels = (double)frame->width * frame->height;
+
+    if (options.histogram)
+        statistics.histogram.assign(256, 0);
+    
+    for (int y = 0; y < frame->height; ++y) {
+        const uint8_t *row = frame->data[0] + y * frame->linesize[0];
+
+        black += kernels.countAtMost8(row, frame->width, (uint8_t)threshold);
+        if (previous)
+            difference += kernels.sumAbsDiff8(row, previous->data[0] + y * previous->linesize[0], frame->width);
+        
+        if (options.histogram) {
+            for (int x = 0; x < frame->width; ++x)
+                ++statistics.histogram[row[x]];
+        }
+    }
+
+    statistics.blackRatio = black / pixels;
+    statistics.black = statistics.blackRatio >= options.blackRatio;
+
+    if (previous) {
+        statistics.hasPrevious = true;
+        statistics.difference = difference / pixels / 255.0;
+        statistics.frozen = statistics.difference < options.frozenThreshold;
+    }
+}
+
+static void nlav_set_metadata(AVFrame *frame, const char *key, double value) {
+    char string[32];
+    snprintf(string, sizeof(string), "%.9g", value);
+    av_dict_set(&frame->metadata, key, string, 0);
+}
+
+static void nlav_set_metadata(AVFrame *frame, const char *key, int index, double value) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s.%d", key, index);
+    nlav_set_metadata(frame, name, value);
+}
+
+void nlav_attach_statistics(AVFrame *frame, const NAVFrameStatistics &statistics) {
+    if (statistics.audio) {
+        for (size_t c = 0; c < statistics.channels.size(); ++c) {
+            nlav_set_metadata(frame, "nlav.stats.rms", c, statistics.channels[c].rms);
+            nlav_set_metadata(frame, "nlav.stats.peak", c, statistics.channels[c].peak);
+        }
+        return;
+    }
+
+    for (size_t plane = 0; plane < statistics.planes.size(); ++plane) {
+        nlav_set_metadata(frame, "nlav.stats.mean", plane, statistics.planes[plane].mean);
+        nlav_set_metadata(frame, "nlav.stats.variance", plane, statistics.planes[plane].variance);
+    }
+
+    nlav_set_metadata(frame, "nlav.stats.black_ratio", statistics.blackRatio);
+    nlav_set_metadata(frame, "nlav.stats.black", statistics.black);
+
+    if (statistics.hasPrevious) {
+        nlav_set_metadata(frame, "nlav.stats.difference", statistics.difference);
+        nlav_set_metadata(frame, "nlav.stats.frozen", statistics.frozen);
+    }
+
+    if (!statistics.histogram.empty()) {
+        std::string histogram;
+        for (size_t i = 0; i < statistics.histogram.size(); ++i) {
+            if (i)
+                histogram += ",";
+            histogram += std::to_string(statistics.histogram[i]);
+        }
+
+        av_dict_set(&frame->metadata, "nlav.stats.histogram", histogram.c_str(), 0);
+    }
+}
+
+std::string nlav_check_comparison(const AVFrame *frame, const AVFrame *reference) {
+    std::string error = nlav_check_video_statistics(frame, "frame");
+
+    if (error.empty())
+        error = nlav_check_same_layout(frame, reference, "reference frame");
+    
+    if (!error.empty())
+        return error;
+    
+    auto descriptor = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    int planes = av_pix_fmt_count_planes((AVPixelFormat)frame->format);
+
+    for (int plane = 0; plane < planes; ++plane) {
+        int width, height;
+
+        nlav_plane_size(descriptor, frame, plane, width, height);
+        if (width < 8 || height < 8)
+            return "Every plane must be at least 8x8 (the SSIM window)";
+    }
+
+    return "";
+}
+
+/**
+ * Sums over the 4x4 blocks of a row of blocks: of the pixels of either plane, of the squares of both, 
+ * and of their products
+ */
+static void nlav_ssim_4x4_row(const uint8_t *a, int aStride, const uint8_t *b, int bStride, int (*sums)[4], int blocks) {
+    for (int z = 0; z < blocks; ++z, a += 4, b += 4) {
+        int s1 = 0, s2 = 0, ss = 0, s12 = 0;
+
+        for (int y = 0; y < 4; ++y) {
+            for (int x = 0; x < 4; ++x) {
+                int first = a[x + y * aStride];
+                int second = b[x + y * bStride];
+
+                s1 += first;
+                s2 += second;
+                ss += first * first + second * second;
+                s12 += first * second;
+            }
+        }
+
+        sums[z][0] = s1;
+        sums[z][1] = s2;
+        sums[z][2] = ss;
+        sums[z][3] = s12;
+    }
+}
+
+static double nlav_ssim_window(int64_t s1, int64_t s2, int64_t ss, int64_t s12) {
+    static const double c1 = .01 * .01 * 255 * 255 * 64;
+    static const double c2 = .03 * .03 * 255 * 255 * 64 * 63;
+    double variances = (double)ss * 64 - (double)s1 * s1 - (double)s2 * s2;
+    double covariance = (double)s12 * 64 - (double)s1 * s2;
+
+    return (2.0 * s1 * s2 + c1) * (2 * covariance + c2) / (((double)s1 * s1 + (double)s2 * s2 + c1) * (variances + c2));
+}
+
+/**
+ * SSIM of a plane, averaged over 8x8 windows overlapping by 4 pixels (as libavfilter's ssim does)
+ */
+static double nlav_ssim_plane(const uint8_t *a, int aStride, const uint8_t *b, int bStride, int width, int height) {
+    int blocksX = width >> 2;
+    int blocksY = height >> 2;
+    std::vector<int> rows(2 * 4 * blocksX);
+    int (*sum0)[4] = (int (*)[4])rows.data();
+    int (*sum1)[4] = sum0 + blocksX;
+    double ssim = 0;
+
+    for (int y = 1, z = 0; y < blocksY; ++y) {
+        for (; z <= y; ++z) {
+            std::swap(sum0, sum1);
+            nlav_ssim_4x4_row(a + 4 * z * aStride, aStride, b + 4 * z * bStride, bStride, sum0, blocksX);
+        }
+
+        for (int x = 0; x < blocksX - 1; ++x) {
+            ssim += nlav_ssim_window(
+                sum0[x][0] + sum0[x + 1][0] + sum1[x][0] + sum1[x + 1][0],
+                sum0[x][1] + sum0[x + 1][1] + sum1[x][1] + sum1[x + 1][1],
+                sum0[x][2] + sum0[x + 1][2] + sum1[x][2] + sum1[x + 1][2],
+                sum0[x][3] + sum0[x + 1][3] + sum1[x][3] + sum1[x + 1][3]
+            );
+        }
+    }
+
+    return ssim / ((double)(blocksY - 1) * (blocksX - 1));
+}
+
+static double nlav_psnr(double mse) {
+    return mse > 0 ? 10 * std::log10(255.0 * 255.0 / mse) : INFINITY;
+}
+
+void nlav_compare_frames(const AVFrame *frame, const AVFrame *reference, NAVFrameComparison &comparison) {
+    auto &kernels = nlav_kernels();
+    auto descriptor = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    int planes = av_pix_fmt_count_planes((AVPixelFormat)frame->format);
+    double totalError = 0, totalPixels = 0, weightedSsim = 0;
+
+    comparison = NAVFrameComparison();
+
+    for (int plane = 0; plane < planes; ++plane) {
+        int width, height;
+        uint64_t error = 0;
+
+        nlav_plane_size(descriptor, frame, plane, width, height);
+        for (int y = 0; y < height; ++y) {
+            error += kernels.sumSquaredDiff8(
+                frame->data[plane] + y * frame->linesize[plane], 
+                reference->data[plane] + y * reference->linesize[plane], 
+                width
+            );
+        }
+
+        double pixels = (double)width * height;
+        NAVPlaneComparison planeComparison;
+        planeComparison.mse = error / pixels;
+        planeComparison.psnr = nlav_psnr(planeComparison.mse);
+        planeComparison.ssim = nlav_ssim_plane(
+            frame->data[plane], frame->linesize[plane], 
+            reference->data[plane], reference->linesize[plane], 
+            width, height
+        );
+
+        comparison.planes.push_back(planeComparison);
+        totalError += error;
+        totalPixels += pixels;
+        weightedSsim += planeComparison.ssim * pixels;
+    }
+
+    comparison.psnr = nlav_psnr(totalError / totalPixels);
+    comparison.ssim = weightedSsim / totalPixels;
+}
@@ -0,0 +1,88 @@
+#include "../common.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+
+// Statistics of frames for quality control, computed with the reductions of kernels.h rather than 
+// over frame.buffers in Javascript: mean/variance per plane, luma histogram, black and frozen frame 
+// detection, PSNR/SSIM against a reference, and RMS/peak per audio channel. Like frame-ops.h, the 
+// checks run on the JS thread and the computations on any thread (NAVFrame#getStatisticsAsync(), or the
+// codec thread with NAVCodecContext's frameStatistics).
+//
+// Video statistics need planar 8 bit pixel formats (yuv420p, yuvj422p, gray, gbrp, ...).
+
+struct NAVFrameStatisticsOptions {
+    bool histogram = false;
+
+    // A frame is black when at least blackRatio of its luma samples are at most blackThreshold. By 
+    // default (-1), the threshold depends on the color range, like that of the blackdetect filter.
+    int blackThreshold = -1;
+    double blackRatio = 0.98;
+
+    // A frame is frozen when the mean absolute difference of its luma with the previous frame, 
+    // relative to 255, is below frozenThreshold (the default noise level of freezedetect, -60dB)
+    double frozenThreshold = 0.001;
+};
+
+struct NAVPlaneStatistics {
+    double mean = 0;
+    double variance = 0;
+};
+
+struct NAVChannelStatistics {
+    double rms = 0;
+    double peak = 0;
+};
+
+struct NAVFrameStatistics {
+    bool audio = false;
+
+    // Video
+    std::vector<NAVPlaneStatistics> planes;
+    std::vector<uint64_t> histogram;
+    double blackRatio = 0;
+    bool black = false;
+    bool hasPrevious = false;
+    double difference = 0;
+    bool frozen = false;
+
+    // Audio, relative to full scale
+    std::vector<NAVChannelStatistics> channels;
+};
+
+struct NAVPlaneComparison {
+    double mse = 0;
+    double psnr = 0;
+    double ssim = 0;
+};
+
+struct NAVFrameComparison {
+    std::vector<NAVPlaneComparison> planes;
+    double psnr = 0;
+    double ssim = 0;
+};
+
+/**
+ * Statistics of a video or audio frame. With a previous frame (video only, of the same format and 
+ * size), the difference with it and whether the frame is frozen are computed as well.
+ */
+std::string nlav_check_statistics(const AVFrame *frame, const AVFrame *previous);
+void nlav_compute_statistics(const AVFrame *frame, const AVFrame *previous, const NAVFrameStatisticsOptions &options, NAVFrameStatistics &statistics);
+
+/**
+ * Add statistics to the metadata of a frame, the way libavfilter's analysis filters do (see 
+ * AVCodecContext#frameStatistics for the keys)
+ */
+void nlav_attach_statistics(AVFrame *frame, const NAVFrameStatistics &statistics);
+
+/**
+ * PSNR and SSIM (on 8x8 windows, as the ssim filter computes it) of a video frame against a reference
+ * frame of the same format and size, per plane and over the whole frame
+ */
+std::string nlav_check_comparison(const AVFrame *frame, const AVFrame *reference);
+void nlav_compare_frames(const AVFrame *frame, const AVFrame *reference, NAVFrameComparison &comparison);
@@ -3,12 +3,36 @@
 #include "buffer.h"
 #include "../avutil/dict.h"
 #include "../avutil/channel-layout.h"
+#include "frame-ops.h"
+#include "frame-stats.h"
+#include "kernels.h"
+
+extern "C" {
+    #include <libavutil/pixdesc.h>
+    #include <libavutil/imgutils.h>
+    #include <libavutil/samplefmt.h>
+    #include <libavutil/hwcontext.h>
+}
 
 #include <assert.h>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+/**
+ * Frames shared with share(), by token, until they are taken by an env (any env of the process, see 
+ * takeShared()) or released. These are references of their own, so the buffers stay alive meanwhile.
+ */
+static std::mutex nlav_shared_frames_mutex;
+static std::map<int64_t, AVFrame*> nlav_shared_frames;
+static int64_t nlav_next_shared_frame = 1;
 
 NAVFrame::NAVFrame(const Napi::CallbackInfo& info):
     NAVResource(info)
 {
+    memset(&cachedLayout, 0, sizeof(cachedLayout));
+
     if (ConstructFromHandle(info))
         return;
 
@@ -17,19 +41,123 @@ NAVFrame::NAVFrame(const Napi::CallbackInfo& info):
 
 void NAVFrame::Free() {
     auto handle = GetHandle();
+
+    ClearCaches();
+
+    if (pool) {
+        SetHandle(nullptr);
+        pool->Release(handle);
+        pool.reset();
+        return;
+    }
+
     av_frame_free(&handle);
     SetHandle(handle);
 }
 
+void NAVFrame::SetPool(std::shared_ptr<NAVFramePool> pool) {
+    this->pool = pool;
+}
+
+bool NAVFrame::CheckDisposable(const Napi::Env &env) {
+    if (busy == 0)
+        return true;
+
+    Napi::Error::New(env, "This AVFrame is in use by an async operation, wait for it before disposing of the frame").ThrowAsJavaScriptException();
+    return false;
+}
+
+Napi::Value NAVFrame::Release(const Napi::CallbackInfo& info) {
+    if (CheckDisposable(info.Env()))
+        Dispose(info.Env());
+    return info.Env().Undefined();
+}
+
+Napi::Value NAVFrame::GetProps(const Napi::CallbackInfo& info) {
+    static const std::vector<std::string> defaults {
+        "pts", "packetDts", "bestEffortTimestamp", "packetDuration", "timeBase",
+        "width", "height", "numberOfSamples", "sampleRate", "format", "keyFrame", "pictureType",
+        "sampleAspectRatio", "flags"
+    };
+
+    return ReadProperties(info, defaults);
+}
+
+Napi::Value NAVFrame::SetProps(const Napi::CallbackInfo& info) {
+    return ApplyProperties(info);
+}
+
+/**
+ * Number of values written by readTimings()
+ */
+#define NAV_FRAME_TIMING_FIELDS 6
+
+Napi::Value NAVFrame::ReadTimings(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto frame = GetHandle();
+
+    if (info.Length() < 1 || !info[0].IsTypedArray()) {
+        Napi::TypeError::New(env, "Expected a BigInt64Array or a Float64Array").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto array = info[0].As<Napi::TypedArray>();
+    size_t offset = info.Length() > 1 && info[1].IsNumber() ? info[1].As<Napi::Number>().Uint32Value() : 0;
+
+    if (offset + NAV_FRAME_TIMING_FIELDS > array.ElementLength()) {
+        Napi::RangeError::New(env, "Not enough room in the array for the frame timings").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    int64_t values[NAV_FRAME_TIMING_FIELDS] = {
+        frame->pts,
+        frame->pkt_dts,
+        frame->best_effort_timestamp,
+        frame->pkt_duration,
+        frame->time_base.num,
+        frame->time_base.den
+    };
+
+    if (array.TypedArrayType() == napi_bigint64_array) {
+        int64_t *target = array.As<Napi::BigInt64Array>().Data() + offset;
+        for (int i = 0; i < NAV_FRAME_TIMING_FIELDS; ++i)
+            target[i] = values[i];
+    } else if (array.TypedArrayType() == napi_float64_array) {
+        double *target = array.As<Napi::Float64Array>().Data() + offset;
+        for (int i = 0; i < NAV_FRAME_TIMING_FIELDS; ++i)
+            target[i] = (double)values[i];
+    } else {
+        Napi::TypeError::New(env, "Expected a BigInt64Array or a Float64Array").ThrowAsJavaScriptException();
+    }
+
+    return env.Undefined();
+}
+
+size_t NAVFrame::GetExternalMemorySize() {
+    auto handle = GetHandle();
+    size_t size = sizeof(AVFrame);
+
+    for (int i = 0; i < AV_NUM_DATA_POINTERS; ++i) {
+        if (handle->buf[i])
+            size += handle->buf[i]->size;
+    }
+
+    for (int i = 0; i < handle->nb_extended_buf; ++i)
+        size += handle->extended_buf[i]->size;
+
+    return size;
+}
+
 void NAVFrame::RefHandle() {
     auto newFrame = av_frame_alloc();
     assert(0 == av_frame_ref(newFrame, GetHandle()));
     SetHandle(newFrame);
+    pool.reset();
     Owned = false;
 }
 
 Napi::Value NAVFrame::ReferTo(const Napi::CallbackInfo& info) {
-    auto src = Unwrap(info[0].As<Napi::Object>());
+    auto src = UnwrapArgument(info.Env(), info[0]);
     if (!src)
         return info.Env().Undefined();
 
@@ -40,11 +168,13 @@ Napi::Value NAVFrame::ReferTo(const Napi::CallbackInfo& info) {
     if (result < 0)
         return nlav_throw(info.Env(), result, "av_frame_ref");
 
+    UpdateExternalMemory(info.Env());
     return info.Env().Undefined();
 }
 
 Napi::Value NAVFrame::Unrefer(const Napi::CallbackInfo& info) {
     av_frame_unref(GetHandle());
+    UpdateExternalMemory(info.Env());
     return info.Env().Undefined();
 }
 
@@ -52,8 +182,103 @@ Napi::Value NAVFrame::Clone(const Napi::CallbackInfo& info) {
     return NAVFrame::FromHandleWrapped(info.Env(), av_frame_clone(GetHandle()), true);
 }
 
+/**
+ * Whether any of the buffers av_frame_clone() references (planes, side data and opaque_ref) borrows the
+ * memory of a Javascript ArrayBuffer.
+ */
+static bool nlav_frame_borrows_from_javascript(const AVFrame *frame) {
+    for (int i = 0, count = AV_NUM_DATA_POINTERS + frame->nb_extended_buf; i < count; ++i) {
+        auto buffer = i < AV_NUM_DATA_POINTERS ? frame->buf[i] : frame->extended_buf[i - AV_NUM_DATA_POINTERS];
+        if (NAVBuffer::IsBorrowedFromJavascript(buffer))
+            return true;
+    }
+
+    for (int i = 0; i < frame->nb_side_data; ++i) {
+        if (frame->side_data[i] && NAVBuffer::IsBorrowedFromJavascript(frame->side_data[i]->buf))
+            return true;
+    }
+
+    return NAVBuffer::IsBorrowedFromJavascript(frame->opaque_ref);
+}
+
+/**
+ * Make a reference to this frame which another env (a worker thread) can take with takeShared(), by the
+ * returned token. Buffers are reference counted thread-safely, so both envs then share the same data 
+ * without copying it. Frames referencing a Javascript ArrayBuffer cannot be shared, as that memory 
+ * belongs to this env.
+ */
+Napi::Value NAVFrame::Share(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto handle = GetHandle();
+
+    if (nlav_frame_borrows_from_javascript(handle)) {
+        Napi::Error::New(env, "Frames whose data is a Javascript ArrayBuffer cannot be shared").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto shared = av_frame_clone(handle);
+    if (!shared)
+        return nlav_throw(env, AVERROR(ENOMEM), "av_frame_clone");
+    
+    std::unique_lock<std::mutex> lock(nlav_shared_frames_mutex);
+    int64_t token = nlav_next_shared_frame++;
+    nlav_shared_frames[token] = shared;
+
+    return Napi::Number::New(env, token);
+}
+
+/**
+ * The frame shared with the given token (see share()), in this env. A frame can only be taken once.
+ */
+Napi::Value NAVFrame::TakeShared(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    int64_t token = info[0].IsNumber() ? info[0].As<Napi::Number>().Int64Value() : 0;
+    AVFrame *frame = nullptr;
+
+    {
+        std::unique_lock<std::mutex> lock(nlav_shared_frames_mutex);
+        auto entry = nlav_shared_frames.find(token);
+        if (entry != nlav_shared_frames.end()) {
+            frame = entry->second;
+            nlav_shared_frames.erase(entry);
+        }
+    }
+
+    if (!frame) {
+        Napi::Error::New(env, "No frame is shared with this token (it may already have been taken)").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    return NAVFrame::FromHandleWrapped(env, frame, true);
+}
+
+/**
+ * Release a frame shared with share() which will not be taken
+ */
+Napi::Value NAVFrame::ReleaseShared(const Napi::CallbackInfo& info) {
+    int64_t token = info[0].IsNumber() ? info[0].As<Napi::Number>().Int64Value() : 0;
+    AVFrame *frame = nullptr;
+
+    {
+        std::unique_lock<std::mutex> lock(nlav_shared_frames_mutex);
+        auto entry = nlav_shared_frames.find(token);
+        if (entry != nlav_shared_frames.end()) {
+            frame = entry->second;
+            nlav_shared_frames.erase(entry);
+        }
+    }
+
+    bool found = frame != nullptr;
+    av_frame_free(&frame);
+
+    return Napi::Boolean::New(info.Env(), found);
+}
+
 Napi::Value NAVFrame::CopyTo(const Napi::CallbackInfo& info) {
-    auto other = NAVFrame::Unwrap(info[0].As<Napi::Object>());
+    auto other = NAVFrame::UnwrapArgument(info.Env(), info[0]);
+    if (!other)
+        return info.Env().Undefined();
+    
     auto otherHandle = other->GetHandle();
     int result = av_frame_copy(otherHandle, GetHandle());
 
@@ -63,8 +288,473 @@ Napi::Value NAVFrame::CopyTo(const Napi::CallbackInfo& info) {
     return info.Env().Undefined();
 }
 
+/**
+ * Copy the data of a hardware frame to system memory (download) or of a frame in system memory to a 
+ * hardware frame (upload, see AVHWFramesContext#getBuffer()), along with the frame's properties. When 
+ * downloading into a frame without buffers, they are allocated in the first format the device offers.
+ */
+static int nlav_transfer_frame(AVFrame *dst, AVFrame *src) {
+    int result = av_hwframe_transfer_data(dst, src, 0);
+    if (result < 0)
+        return result;
+
+    return av_frame_copy_props(dst, src);
+}
+
+Napi::Value NAVFrame::TransferData(const Napi::CallbackInfo& info) {
+    auto other = NAVFrame::UnwrapArgument(info.Env(), info[0]);
+    if (!other)
+        return info.Env().Undefined();
+    
+    int result = nlav_transfer_frame(other->GetHandle(), GetHandle());
+
+    if (result < 0)
+        return nlav_throw(info.Env(), result, "av_hwframe_transfer_data");
+
+    other->UpdateExternalMemory(info.Env());
+    return info.Env().Undefined();
+}
+
+/**
+ * Runs transferData() on a libuv worker thread, as transfers from GPU memory can take milliseconds. 
+ * Both frames are referenced and busy (they cannot be disposed of) until the transfer is done, and 
+ * must not be used meanwhile.
+ */
+class NAVFrameTransferWorker : public Napi::AsyncWorker {
+    public:
+        NAVFrameTransferWorker(Napi::Env env, NAVFrame *src, NAVFrame *dst):
+            Napi::AsyncWorker(env, "AVFrame#transferDataAsync"),
+            deferred(Napi::Promise::Deferred::New(env)),
+            src(src),
+            dst(dst)
+        {
+            srcReference = Napi::Persistent(src->Value());
+            dstReference = Napi::Persistent(dst->Value());
+            ++src->busy;
+            ++dst->busy;
+        }
+
+        Napi::Promise Promise() {
+            return deferred.Promise();
+        }
+
+    protected:
+        void Execute() {
+            result = nlav_transfer_frame(dst->GetHandle(), src->GetHandle());
+        }
+
+        void OnOK() {
+            auto env = Env();
+            --src->busy;
+            --dst->busy;
+
+            if (result < 0) {
+                auto message = "[av_hwframe_transfer_data] libav: " + nlavu_get_error_string(result);
+                deferred.Reject(Napi::Error::New(env, message).Value());
+                return;
+            }
+
+            dst->UpdateExternalMemory(env);
+            deferred.Resolve(dst->Value());
+        }
+
+    private:
+        Napi::Promise::Deferred deferred;
+        NAVFrame *src;
+        NAVFrame *dst;
+        Napi::ObjectReference srcReference;
+        Napi::ObjectReference dstReference;
+        int result = 0;
+};
+
+Napi::Value NAVFrame::TransferDataAsync(const Napi::CallbackInfo& info) {
+    auto other = NAVFrame::UnwrapArgument(info.Env(), info[0]);
+    if (!other)
+        return info.Env().Undefined();
+    
+    auto worker = new NAVFrameTransferWorker(info.Env(), this, other);
+    auto promise = worker->Promise();
+
+    // Deletes itself once done
+    worker->Queue();
+    return promise;
+}
+
+/**
+ * Runs one of the plane/sample operations (see frame-ops.h and frame-stats.h) on a libuv worker thread,
+ * for frames large enough that it would hold up the JS thread. Like NAVFrameTransferWorker, both frames
+ * are referenced and busy until the operation is done, and must not be used meanwhile. Resolves to the result of
+ * the operation if it has one, the frame it wrote to otherwise.
+ */
+class NAVFrameOperationWorker : public Napi::AsyncWorker {
+    public:
+        NAVFrameOperationWorker(Napi::Env env, const char *name, std::function<void()> operation, NAVFrameOperationResult result, NAVFrame *src, NAVFrame *dst):
+            Napi::AsyncWorker(env, name),
+            deferred(Napi::Promise::Deferred::New(env)),
+            operation(operation),
+            result(result),
+            src(src),
+            dst(dst)
+        {
+            srcReference = Napi::Persistent(src->Value());
+            dstReference = Napi::Persistent(dst->Value());
+            ++src->busy;
+            ++dst->busy;
+        }
+
+        Napi::Promise Promise() {
+            return deferred.Promise();
+        }
+
+    protected:
+        void Execute() {
+            operation();
+        }
+
+        void OnOK() {
+            --src->busy;
+            --dst->busy;
+            deferred.Resolve(result ? result(Env()) : dst->Value());
+        }
+
+    private:
+        Napi::Promise::Deferred deferred;
+        std::function<void()> operation;
+        NAVFrameOperationResult result;
+        NAVFrame *src;
+        NAVFrame *dst;
+        Napi::ObjectReference srcReference;
+        Napi::ObjectReference dstReference;
+};
+
+/**
+ * Read a region ({ x, y, width, height }) argument. Without one (null/undefined), the region is the 
+ * whole frame.
+ */
+static bool nlav_get_region(const Napi::Env &env, const Napi::Value &value, const AVFrame *frame, NAVFrameRegion &region) {
+    if (value.IsNull() || value.IsUndefined()) {
+        region = { 0, 0, frame->width, frame->height };
+        return true;
+    }
+
+    if (!value.IsObject()) {
+        Napi::TypeError::New(env, "Region must be an object like { x, y, width, height }").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    auto object = value.As<Napi::Object>();
+    const char *names[] = { "x", "y", "width", "height" };
+    int *fields[] = { &region.x, &region.y, &region.width, &region.height };
+
+    for (int i = 0; i < 4; ++i) {
+        auto field = object.Get(names[i]);
+        if (!field.IsNumber()) {
+            Napi::TypeError::New(env, std::string("Region ") + names[i] + " must be a number").ThrowAsJavaScriptException();
+            return false;
+        }
+
+        *fields[i] = field.As<Napi::Number>().Int32Value();
+    }
+
+    return true;
+}
+
+static NAVFrame *nlav_get_frame_argument(const Napi::CallbackInfo& info) {
+    return NAVFrame::UnwrapArgument(info.Env(), info[0]);
+}
+
+std::function<void()> NAVFrame::PrepareRegionCopy(const Napi::CallbackInfo& info, NAVFrame *&target) {
+    auto env = info.Env();
+    auto src = GetHandle();
+    NAVFrameRegion region;
+
+    if (!(target = nlav_get_frame_argument(info)) || !nlav_get_region(env, info[1], src, region))
+        return nullptr;
+    
+    auto dst = target->GetHandle();
+    int x = info.Length() > 2 && info[2].IsNumber() ? info[2].As<Napi::Number>().Int32Value() : 0;
+    int y = info.Length() > 3 && info[3].IsNumber() ? info[3].As<Napi::Number>().Int32Value() : 0;
+    auto error = nlav_check_region_copy(src, dst, region, x, y);
+
+    if (!error.empty()) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return nullptr;
+    }
+
+    return [src, dst, region, x, y]() { nlav_copy_region(src, dst, region, x, y); };
+}
+
+std::function<void()> NAVFrame::PrepareRegionFill(const Napi::CallbackInfo& info, NAVFrame *&target) {
+    auto env = info.Env();
+    auto frame = GetHandle();
+    NAVFrameRegion region;
+    std::vector<uint32_t> values;
+
+    target = this;
+    if (!nlav_get_region(env, info[0], frame, region))
+        return nullptr;
+    
+    if (info.Length() < 2 || !info[1].IsArray()) {
+        Napi::TypeError::New(env, "Values must be an array of numbers, one per component").ThrowAsJavaScriptException();
+        return nullptr;
+    }
+
+    auto array = info[1].As<Napi::Array>();
+    for (uint32_t i = 0, length = array.Length(); i < length; ++i)
+        values.push_back(array.Get(i).ToNumber().Uint32Value());
+    
+    auto error = nlav_check_region_fill(frame, region, values);
+
+    if (!error.empty()) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return nullptr;
+    }
+
+    return [frame, region, values]() { nlav_fill_region(frame, region, values); };
+}
+
+std::function<void()> NAVFrame::PrepareSampleCopy(const Napi::CallbackInfo& info, NAVFrame *&target) {
+    auto env = info.Env();
+    auto src = GetHandle();
+
+    if (!(target = nlav_get_frame_argument(info)))
+        return nullptr;
+    
+    auto dst = target->GetHandle();
+    float gain = info.Length() > 1 && info[1].IsNumber() ? info[1].As<Napi::Number>().FloatValue() : 1.0f;
+    auto error = nlav_check_sample_copy(src, dst);
+
+    if (!error.empty()) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return nullptr;
+    }
+
+    return [src, dst, gain]() { nlav_copy_samples(src, dst, gain); };
+}
+
+bool nlav_get_statistics_options(const Napi::Env &env, const Napi::Value &value, NAVFrameStatisticsOptions &options, NAVFrame *&previous) {
+    previous = nullptr;
+
+    if (value.IsNull() || value.IsUndefined())
+        return true;
+    
+    if (!value.IsObject()) {
+        Napi::TypeError::New(env, "Options must be an object").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    auto object = value.As<Napi::Object>();
+    auto previousValue = object.Get("previous");
+
+    if (object.Has("histogram"))
+        options.histogram = object.Get("histogram").ToBoolean();
+    if (object.Get("blackThreshold").IsNumber())
+        options.blackThreshold = object.Get("blackThreshold").As<Napi::Number>().Int32Value();
+    if (object.Get("blackRatio").IsNumber())
+        options.blackRatio = object.Get("blackRatio").As<Napi::Number>().DoubleValue();
+    if (object.Get("frozenThreshold").IsNumber())
+        options.frozenThreshold = object.Get("frozenThreshold").As<Napi::Number>().DoubleValue();
+    if (previousValue.IsObject() && !(previous = NAVFrame::UnwrapArgument(env, previousValue)))
+        return false;
+    
+    return true;
+}
+
+static Napi::Value nlav_statistics_to_object(const Napi::Env &env, const NAVFrameStatistics &statistics) {
+    auto object = Napi::Object::New(env);
+
+    if (statistics.audio) {
+        auto channels = Napi::Array::New(env, statistics.channels.size());
+
+        for (uint32_t i = 0; i < statistics.channels.size(); ++i) {
+            auto channel = Napi::Object::New(env);
+            channel.Set("rms", Napi::Number::New(env, statistics.channels[i].rms));
+            channel.Set("peak", Napi::Number::New(env, statistics.channels[i].peak));
+            channels.Set(i, channel);
+        }
+
+        object.Set("channels", channels);
+        return object;
+    }
+
+    auto planes = Napi::Array::New(env, statistics.planes.size());
+
+    for (uint32_t i = 0; i < statistics.planes.size(); ++i) {
+        auto plane = Napi::Object::New(env);
+        plane.Set("mean", Napi::Number::New(env, statistics.planes[i].mean));
+        plane.Set("variance", Napi::Number::New(env, statistics.planes[i].variance));
+        planes.Set(i, plane);
+    }
+
+    object.Set("planes", planes);
+    object.Set("blackRatio", Napi::Number::New(env, statistics.blackRatio));
+    object.Set("black", Napi::Boolean::New(env, statistics.black));
+
+    if (statistics.hasPrevious) {
+        object.Set("difference", Napi::Number::New(env, statistics.difference));
+        object.Set("frozen", Napi::Boolean::New(env, statistics.frozen));
+    }
+
+    if (!statistics.histogram.empty()) {
+        auto histogram = Napi::Array::New(env, statistics.histogram.size());
+        for (uint32_t i = 0; i < statistics.histogram.size(); ++i)
+            histogram.Set(i, Napi::Number::New(env, statistics.histogram[i]));
+        object.Set("histogram", histogram);
+    }
+
+    return object;
+}
+
+static Napi::Value nlav_comparison_to_object(const Napi::Env &env, const NAVFrameComparison &comparison) {
+    auto object = Napi::Object::New(env);
+    auto planes = Napi::Array::New(env, comparison.planes.size());
+
+    for (uint32_t i = 0; i < comparison.planes.size(); ++i) {
+        auto plane = Napi::Object::New(env);
+        plane.Set("mse", Napi::Number::New(env, comparison.planes[i].mse));
+        plane.Set("psnr", Napi::Number::New(env, comparison.planes[i].psnr));
+        plane.Set("ssim", Napi::Number::New(env, comparison.planes[i].ssim));
+        planes.Set(i, plane);
+    }
+
+    object.Set("psnr", Napi::Number::New(env, comparison.psnr));
+    object.Set("ssim", Napi::Number::New(env, comparison.ssim));
+    object.Set("planes", planes);
+    return object;
+}
+
+std::function<void()> NAVFrame::PrepareStatistics(const Napi::CallbackInfo& info, NAVFrame *&target, NAVFrameOperationResult &result) {
+    auto env = info.Env();
+    auto frame = GetHandle();
+    NAVFrameStatisticsOptions options;
+    NAVFrame *previous;
+
+    if (!nlav_get_statistics_options(env, info[0], options, previous))
+        return nullptr;
+    
+    auto previousFrame = previous ? previous->GetHandle() : nullptr;
+    auto error = nlav_check_statistics(frame, previousFrame);
+
+    if (!error.empty()) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return nullptr;
+    }
+
+    auto statistics = std::make_shared<NAVFrameStatistics>();
+
+    target = previous ? previous : this;
+    result = [statistics](const Napi::Env &env) { return nlav_statistics_to_object(env, *statistics); };
+    return [frame, previousFrame, options, statistics]() { nlav_compute_statistics(frame, previousFrame, options, *statistics); };
+}
+
+std::function<void()> NAVFrame::PrepareComparison(const Napi::CallbackInfo& info, NAVFrame *&target, NAVFrameOperationResult &result) {
+    auto env = info.Env();
+    auto frame = GetHandle();
+
+    if (!(target = nlav_get_frame_argument(info)))
+        return nullptr;
+    
+    auto reference = target->GetHandle();
+    auto error = nlav_check_comparison(frame, reference);
+
+    if (!error.empty()) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return nullptr;
+    }
+
+    auto comparison = std::make_shared<NAVFrameComparison>();
+
+    result = [comparison](const Napi::Env &env) { return nlav_comparison_to_object(env, *comparison); };
+    return [frame, reference, comparison]() { nlav_compare_frames(frame, reference, *comparison); };
+}
+
+Napi::Value NAVFrame::RunOperation(const Napi::Env &env, std::function<void()> operation, NAVFrame *target, NAVFrameOperationResult result) {
+    if (!operation)
+        return env.Undefined();
+    
+    operation();
+    return result ? result(env) : target->Value();
+}
+
+Napi::Value NAVFrame::QueueOperation(const Napi::Env &env, const char *name, std::function<void()> operation, NAVFrame *target, NAVFrameOperationResult result) {
+    if (!operation)
+        return env.Undefined();
+    
+    auto worker = new NAVFrameOperationWorker(env, name, operation, result, this, target);
+    auto promise = worker->Promise();
+
+    // Deletes itself once done
+    worker->Queue();
+    return promise;
+}
+
+Napi::Value NAVFrame::CopyRegionTo(const Napi::CallbackInfo& info) {
+    NAVFrame *target = nullptr;
+    return RunOperation(info.Env(), PrepareRegionCopy(info, target), target);
+}
+
+Napi::Value NAVFrame::CopyRegionToAsync(const Napi::CallbackInfo& info) {
+    NAVFrame *target = nullptr;
+    return QueueOperation(info.Env(), "AVFrame#copyRegionToAsync", PrepareRegionCopy(info, target), target);
+}
+
+Napi::Value NAVFrame::FillRegion(const Napi::CallbackInfo& info) {
+    NAVFrame *target = nullptr;
+    return RunOperation(info.Env(), PrepareRegionFill(info, target), target);
+}
+
+Napi::Value NAVFrame::FillRegionAsync(const Napi::CallbackInfo& info) {
+    NAVFrame *target = nullptr;
+    return QueueOperation(info.Env(), "AVFrame#fillRegionAsync", PrepareRegionFill(info, target), target);
+}
+
+Napi::Value NAVFrame::CopySamplesTo(const Napi::CallbackInfo& info) {
+    NAVFrame *target = nullptr;
+    return RunOperation(info.Env(), PrepareSampleCopy(info, target), target);
+}
+
+Napi::Value NAVFrame::CopySamplesToAsync(const Napi::CallbackInfo& info) {
+    NAVFrame *target = nullptr;
+    return QueueOperation(info.Env(), "AVFrame#copySamplesToAsync", PrepareSampleCopy(info, target), target);
+}
+
+Napi::Value NAVFrame::GetStatistics(const Napi::CallbackInfo& info) {
+    NAVFrame *target = nullptr;
+    NAVFrameOperationResult result;
+    auto operation = PrepareStatistics(info, target, result);
+    return RunOperation(info.Env(), operation, target, result);
+}
+
+Napi::Value NAVFrame::GetStatisticsAsync(const Napi::CallbackInfo& info) {
+    NAVFrame *target = nullptr;
+    NAVFrameOperationResult result;
+    auto operation = PrepareStatistics(info, target, result);
+    return QueueOperation(info.Env(), "AVFrame#getStatisticsAsync", operation, target, result);
+}
+
+Napi::Value NAVFrame::Compare(const Napi::CallbackInfo& info) {
+    NAVFrame *target = nullptr;
+    NAVFrameOperationResult result;
+    auto operation = PrepareComparison(info, target, result);
+    return RunOperation(info.Env(), operation, target, result);
+}
+
+Napi::Value NAVFrame::CompareAsync(const Napi::CallbackInfo& info) {
+    NAVFrame *target = nullptr;
+    NAVFrameOperationResult result;
+    auto operation = PrepareComparison(info, target, result);
+    return QueueOperation(info.Env(), "AVFrame#compareAsync", operation, target, result);
+}
+
+Napi::Value NAVFrame::GetKernelSet(const Napi::CallbackInfo& info) {
+    return Napi::String::New(info.Env(), nlav_kernels().name);
+}
+
 Napi::Value NAVFrame::CopyPropertiesTo(const Napi::CallbackInfo& info) {
-    auto other = NAVFrame::Unwrap(info[0].As<Napi::Object>());
+    auto other = NAVFrame::UnwrapArgument(info.Env(), info[0]);
+    if (!other)
+        return info.Env().Undefined();
+    
     int result = av_frame_copy_props(other->GetHandle(), GetHandle());
 
     if (result < 0)
@@ -112,6 +802,48 @@ Napi::Value NAVFrame::GetSideData(const Napi::CallbackInfo& info) {
     return NAVFrameSideData::FromHandleWrapped(info.Env(), av_frame_get_side_data(GetHandle(), type), false);
 }
 
+static void ReleasePlaneBuffer(Napi::Env env, void *data, AVBufferRef *buffer) {
+    av_buffer_unref(&buffer);
+}
+
+/**
+ * The side data of the given type as a plain Uint8Array, without an AVFrameSideData instance. The view
+ * holds a reference to the side data's buffer, so it stays valid after the frame is unreferenced.
+ */
+Napi::Value NAVFrame::GetSideDataRaw(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto type = (AVFrameSideDataType)info[0].As<Napi::Number>().Int32Value();
+    auto sideData = av_frame_get_side_data(GetHandle(), type);
+
+    if (!sideData)
+        return env.Null();
+
+    Napi::ArrayBuffer arrayBuffer;
+
+    if (sideData->buf) {
+        arrayBuffer = Napi::ArrayBuffer::New(env, sideData->data, sideData->size, &ReleasePlaneBuffer, av_buffer_ref(sideData->buf));
+    } else {
+        arrayBuffer = Napi::ArrayBuffer::New(env, sideData->size);
+        memcpy(arrayBuffer.Data(), sideData->data, sideData->size);
+    }
+
+    return Napi::Uint8Array::New(env, sideData->size, arrayBuffer, 0);
+}
+
+/**
+ * The metadata of the frame as a plain object, without AVDictionary/AVDictionaryEntry instances
+ */
+Napi::Value NAVFrame::GetMetadataRaw(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto object = Napi::Object::New(env);
+    AVDictionaryEntry *entry = nullptr;
+
+    while ((entry = av_dict_get(GetHandle()->metadata, "", entry, AV_DICT_IGNORE_SUFFIX)))
+        object.Set(entry->key, entry->value);
+
+    return object;
+}
+
 Napi::Value NAVFrame::RemoveSideData(const Napi::CallbackInfo& info) {
     auto type = (AVFrameSideDataType)info[0].As<Napi::Number>().Int32Value();
     av_frame_remove_side_data(GetHandle(), type);
@@ -136,12 +868,14 @@ Napi::Value NAVFrame::GetSideDataName(const Napi::CallbackInfo& info) {
 }
 
 Napi::Value NAVFrame::MoveReferenceFrom(const Napi::CallbackInfo& info) {
-    auto src = Unwrap(info[0].As<Napi::Object>());
+    auto src = UnwrapArgument(info.Env(), info[0]);
     if (!src)
         return info.Env().Undefined();
 
     // TODO: are all the memory implications OK here?
     av_frame_move_ref(GetHandle(), src->GetHandle());
+    UpdateExternalMemory(info.Env());
+    src->UpdateExternalMemory(info.Env());
     return info.Env().Undefined();
 }
 
@@ -154,6 +888,7 @@ Napi::Value NAVFrame::AllocateBuffer(const Napi::CallbackInfo& info) {
     if (result < 0)
         return nlav_throw(info.Env(), result, "av_frame_get_buffer");
 
+    UpdateExternalMemory(info.Env());
     return info.Env().Undefined();
 }
 
@@ -164,18 +899,27 @@ Napi::Value NAVFrame::IsWritable(const Napi::CallbackInfo& info) {
 // Properties //////////////////////////////////////////////////////////////////////////
 
 Napi::Value NAVFrame::GetLineSize(const Napi::CallbackInfo& info) {
-    std::vector<int> vec;
-    
-    for (int i = 0, max = AV_NUM_DATA_POINTERS; i < max; ++i)
-        vec.push_back(GetHandle()->linesize[i]);
-    
-    return VectorToArray(
-        info.Env(),
-        Transform<int, Napi::Value>(
-            vec,
-            WrapNumbers<int>(info.Env())
-        )
-    );
+    ValidateCaches();
+
+    if (cachedLineSizes.IsEmpty()) {
+        std::vector<int> vec;
+        
+        for (int i = 0, max = AV_NUM_DATA_POINTERS; i < max; ++i)
+            vec.push_back(GetHandle()->linesize[i]);
+        
+        auto array = VectorToArray(
+            info.Env(),
+            Transform<int, Napi::Value>(
+                vec,
+                WrapNumbers<int>(info.Env())
+            )
+        );
+
+        array.Freeze();
+        cachedLineSizes = Napi::Persistent((Napi::Object)array);
+    }
+
+    return cachedLineSizes.Value();
 }
 
 void NAVFrame::SetLineSize(const Napi::CallbackInfo& info, const Napi::Value& value) {
@@ -350,39 +1094,165 @@ void NAVFrame::SetSampleRate(const Napi::CallbackInfo& info, const Napi::Value&
 }
 
 Napi::Value NAVFrame::GetBuffers(const Napi::CallbackInfo& info) {
-    std::vector<AVBufferRef*> bufs;
-    auto handle = GetHandle();
+    ValidateCaches();
+
+    if (cachedBuffers.IsEmpty()) {
+        std::vector<AVBufferRef*> bufs;
+        auto handle = GetHandle();
 
-    for (int i = 0, max = AV_NUM_DATA_POINTERS; i < max; ++i) {
-        if (!handle->buf[i])
-            break;
-        bufs.push_back(handle->buf[i]);
+        for (int i = 0, max = AV_NUM_DATA_POINTERS; i < max; ++i) {
+            if (!handle->buf[i])
+                break;
+            bufs.push_back(handle->buf[i]);
+        }
+
+        auto array = VectorToArray(
+            info.Env(),
+            Transform<AVBufferRef*, Napi::Value>(bufs, [&](AVBufferRef *buf) {
+                return NAVBuffer::FromHandleWrapped(info.Env(), buf, false);
+            })
+        );
+
+        array.Freeze();
+        cachedBuffers = Napi::Persistent((Napi::Object)array);
     }
 
-    return VectorToArray(
-        info.Env(),
-        Transform<AVBufferRef*, Napi::Value>(bufs, [&](AVBufferRef *buf) {
-            return NAVBuffer::FromHandleWrapped(info.Env(), buf, false);
-        })
-    );
+    return cachedBuffers.Value();
 }
 
 Napi::Value NAVFrame::GetExtendedBuffers(const Napi::CallbackInfo& info) {
-    std::vector<AVBufferRef*> bufs;
+    ValidateCaches();
+
+    if (cachedExtendedBuffers.IsEmpty()) {
+        std::vector<AVBufferRef*> bufs;
+        auto handle = GetHandle();
+
+        for (int i = 0, max = handle->nb_extended_buf; i < max; ++i) {
+            if (!handle->extended_buf[i])
+                break;
+            bufs.push_back(handle->extended_buf[i]);
+        }
+
+        auto array = VectorToArray(
+            info.Env(),
+            Transform<AVBufferRef*, Napi::Value>(bufs, [&](AVBufferRef *buf) {
+                return NAVBuffer::FromHandleWrapped(info.Env(), buf, false);
+            })
+        );
+
+        array.Freeze();
+        cachedExtendedBuffers = Napi::Persistent((Napi::Object)array);
+    }
+
+    return cachedExtendedBuffers.Value();
+}
+
+Napi::Value NAVFrame::GetPlanes(const Napi::CallbackInfo& info) {
+    ValidateCaches();
+
+    if (cachedPlanes.IsEmpty())
+        cachedPlanes = Napi::Persistent(BuildPlanes(info.Env()).As<Napi::Object>());
+
+    return cachedPlanes.Value();
+}
+
+/**
+ * Drop the cached arrays if the frame's layout has changed since they were built.
+ */
+void NAVFrame::ValidateCaches() {
     auto handle = GetHandle();
+    NAVFrameLayout layout;
+
+    memset(&layout, 0, sizeof(layout));
+    memcpy(layout.data, handle->data, sizeof(layout.data));
+    memcpy(layout.linesize, handle->linesize, sizeof(layout.linesize));
+    memcpy(layout.buf, handle->buf, sizeof(layout.buf));
+    layout.extended_buf = handle->extended_buf;
+    layout.nb_extended_buf = handle->nb_extended_buf;
+    layout.width = handle->width;
+    layout.height = handle->height;
+    layout.nb_samples = handle->nb_samples;
+    layout.format = handle->format;
+
+    if (memcmp(&layout, &cachedLayout, sizeof(layout)) == 0)
+        return;
+    
+    ClearCaches();
+    cachedLayout = layout;
+}
+
+void NAVFrame::ClearCaches() {
+    cachedLineSizes.Reset();
+    cachedBuffers.Reset();
+    cachedExtendedBuffers.Reset();
+    cachedPlanes.Reset();
+}
+
+/**
+ * Build an array of Uint8Array views over each plane of the frame's data. Each view holds a reference
+ * to the AVBuffer the plane lives in, so it stays valid even after the frame is unreferenced or freed.
+ * Planes without a reference-counted buffer are null.
+ */
+Napi::Value NAVFrame::BuildPlanes(const Napi::Env &env) {
+    auto handle = GetHandle();
+    std::vector<size_t> sizes;
+
+    if (handle->nb_samples > 0 && handle->width == 0) {
+        auto format = (AVSampleFormat)handle->format;
+#ifdef FFMPEG_5_1
+        int channels = handle->ch_layout.nb_channels;
+#else
+        int channels = handle->channels;
+#endif
+        size_t sampleSize = av_get_bytes_per_sample(format);
+        
+        if (av_sample_fmt_is_planar(format)) {
+            for (int i = 0; i < channels; ++i)
+                sizes.push_back(handle->nb_samples * sampleSize);
+        } else if (channels > 0) {
+            sizes.push_back(handle->nb_samples * sampleSize * channels);
+        }
+    } else if (handle->width > 0 && handle->height > 0) {
+        auto format = (AVPixelFormat)handle->format;
+        auto descriptor = av_pix_fmt_desc_get(format);
+
+        // Hardware frames do not carry their pixels in data[]
+        if (descriptor && !(descriptor->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+            size_t planeSizes[4];
+            ptrdiff_t linesizes[4];
+
+            for (int i = 0; i < 4; ++i)
+                linesizes[i] = std::abs(handle->linesize[i]);
+
+            if (av_image_fill_plane_sizes(planeSizes, format, handle->height, linesizes) >= 0) {
+                for (int i = 0; i < 4 && handle->data[i]; ++i)
+                    sizes.push_back(planeSizes[i]);
+            }
+        }
+    }
+
+    auto planes = Napi::Array::New(env, sizes.size());
+
+    for (uint32_t i = 0, max = sizes.size(); i < max; ++i) {
+        AVBufferRef *buffer = av_frame_get_plane_buffer(handle, i);
+        uint8_t *data = handle->extended_data[i];
+
+        if (!buffer || !data) {
+            planes.Set(i, env.Null());
+            continue;
+        }
 
-    for (int i = 0, max = handle->nb_extended_buf; i < max; ++i) {
-        if (!handle->extended_buf[i])
-            break;
-        bufs.push_back(handle->extended_buf[i]);
+        // For bottom-up images, data points to the last line
+        int linesize = i < AV_NUM_DATA_POINTERS ? handle->linesize[i] : 0;
+        if (linesize < 0)
+            data -= sizes[i] + linesize;
+
+        auto arrayBuffer = Napi::ArrayBuffer::New(env, data, sizes[i], &ReleasePlaneBuffer, av_buffer_ref(buffer));
+        planes.Set(i, Napi::Uint8Array::New(env, sizes[i], arrayBuffer, 0));
     }
 
-    return VectorToArray(
-        info.Env(),
-        Transform<AVBufferRef*, Napi::Value>(bufs, [&](AVBufferRef *buf) {
-            return NAVBuffer::FromHandleWrapped(info.Env(), buf, false);
-        })
-    );
+    planes.Freeze();
+    return planes;
 }
 
 Napi::Value NAVFrame::GetSideDatas(const Napi::CallbackInfo& info) {
@@ -397,6 +1267,24 @@ Napi::Value NAVFrame::GetSideDatas(const Napi::CallbackInfo& info) {
     return VectorToArray(info.Env(), vec);
 }
 
+Napi::Value NAVFrame::GetSideDataTypes(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto handle = GetHandle();
+    auto types = Napi::Array::New(env);
+
+    for (int i = 0, max = handle->nb_side_data; i < max; ++i) {
+        if (!handle->side_data[i])
+            continue;
+
+        auto entry = Napi::Object::New(env);
+        entry.Set("type", Napi::Number::New(env, handle->side_data[i]->type));
+        entry.Set("size", Napi::Number::New(env, (double)handle->side_data[i]->size));
+        types.Set(types.Length(), entry);
+    }
+
+    return types;
+}
+
 Napi::Value NAVFrame::GetFlags(const Napi::CallbackInfo& info) {
     return Napi::Number::New(info.Env(), GetHandle()->flags);
 }
@@ -557,7 +1445,7 @@ void NAVFrame::SetChannelLayout(const Napi::CallbackInfo& info, const Napi::Valu
     auto layout = NAVChannelLayout::Unwrap(value.As<Napi::Object>());
     GetHandle()->ch_layout = *layout->GetHandle();
 #else
-    auto layout = info[0].As<Napi::Number>().Int64Value();
+    auto layout = value.As<Napi::Number>().Int64Value();
     GetHandle()->channel_layout = (uint64_t)layout;
 #endif
 }
@@ -2,11 +2,43 @@
 
 #include "../common.h"
 #include "../resource.h"
+#include "../handle-pool.h"
+#include <functional>
+#include <memory>
 
 extern "C" {
     #include <libavutil/frame.h>
 }
 
+/**
+ * The parts of an AVFrame that the cached arrays of NAVFrame are derived from. When any of these
+ * change (av_frame_unref, av_frame_get_buffer, decoding into the frame, ...) the caches are rebuilt.
+ */
+struct NAVFrameLayout {
+    uint8_t *data[AV_NUM_DATA_POINTERS];
+    int linesize[AV_NUM_DATA_POINTERS];
+    AVBufferRef *buf[AV_NUM_DATA_POINTERS];
+    AVBufferRef **extended_buf;
+    int nb_extended_buf;
+    int width;
+    int height;
+    int nb_samples;
+    int format;
+};
+
+/**
+ * Builds the value an operation of NAVFrame resolves to, on the JS thread once the operation is done
+ */
+typedef std::function<Napi::Value(const Napi::Env &env)> NAVFrameOperationResult;
+
+class NAVFrame;
+struct NAVFrameStatisticsOptions;
+
+/**
+ * Read the options of getStatistics() (see frame-stats.h), also those of AVCodecContext#frameStatistics
+ */
+bool nlav_get_statistics_options(const Napi::Env &env, const Napi::Value &value, NAVFrameStatisticsOptions &options, NAVFrame *&previous);
+
 class NAVFrame : public NAVResource<NAVFrame, AVFrame> {
     public:
         NAVFrame(const Napi::CallbackInfo& info);
@@ -17,21 +49,43 @@ class NAVFrame : public NAVResource<NAVFrame, AVFrame> {
                 
                 // Static Methods
                 StaticMethod("getSideDataName", &NAVFrame::GetSideDataName),
+                StaticMethod("takeShared", &NAVFrame::TakeShared),
+                StaticMethod("releaseShared", &NAVFrame::ReleaseShared),
+                StaticMethod("getKernelSet", &NAVFrame::GetKernelSet),
 
                 // Methods
 
                 R_METHOD("referTo", &NAVFrame::ReferTo),
                 R_METHOD("unrefer", &NAVFrame::Unrefer),
                 R_METHOD("clone", &NAVFrame::Clone),
+                R_METHOD("share", &NAVFrame::Share),
                 R_METHOD("copyTo", &NAVFrame::CopyTo),
                 R_METHOD("copyPropertiesTo", &NAVFrame::CopyPropertiesTo),
+                R_METHOD("transferData", &NAVFrame::TransferData),
+                R_METHOD("transferDataAsync", &NAVFrame::TransferDataAsync),
+                R_METHOD("copyRegionTo", &NAVFrame::CopyRegionTo),
+                R_METHOD("copyRegionToAsync", &NAVFrame::CopyRegionToAsync),
+                R_METHOD("fillRegion", &NAVFrame::FillRegion),
+                R_METHOD("fillRegionAsync", &NAVFrame::FillRegionAsync),
+                R_METHOD("copySamplesTo", &NAVFrame::CopySamplesTo),
+                R_METHOD("copySamplesToAsync", &NAVFrame::CopySamplesToAsync),
+                R_METHOD("getStatistics", &NAVFrame::GetStatistics),
+                R_METHOD("getStatisticsAsync", &NAVFrame::GetStatisticsAsync),
+                R_METHOD("compare", &NAVFrame::Compare),
+                R_METHOD("compareAsync", &NAVFrame::CompareAsync),
                 R_METHOD("getPlaneBuffer", &NAVFrame::GetPlaneBuffer),
                 R_METHOD("addSideData", &NAVFrame::AddSideData),
                 R_METHOD("getSideData", &NAVFrame::GetSideData),
+                R_METHOD("getSideDataRaw", &NAVFrame::GetSideDataRaw),
+                R_METHOD("getMetadataRaw", &NAVFrame::GetMetadataRaw),
                 R_METHOD("removeSideData", &NAVFrame::RemoveSideData),
                 R_METHOD("applyCropping", &NAVFrame::ApplyCropping),
                 R_METHOD("moveReferenceFrom", &NAVFrame::MoveReferenceFrom),
                 R_METHOD("allocateBuffer", &NAVFrame::AllocateBuffer),
+                R_METHOD("release", &NAVFrame::Release),
+                R_METHOD("getProps", &NAVFrame::GetProps),
+                R_METHOD("setProps", &NAVFrame::SetProps),
+                R_METHOD("readTimings", &NAVFrame::ReadTimings),
 
                 R_ACCESSOR("writable", &NAVFrame::IsWritable, nullptr),
                 R_ACCESSOR("lineSizes", &NAVFrame::GetLineSize, &NAVFrame::SetLineSize),
@@ -55,8 +109,10 @@ class NAVFrame : public NAVResource<NAVFrame, AVFrame> {
                 R_ACCESSOR("reorderedOpaque", &NAVFrame::GetReorderedOpaque, &NAVFrame::SetReorderedOpaque),
                 R_ACCESSOR("sampleRate", &NAVFrame::GetSampleRate, &NAVFrame::SetSampleRate),
                 R_ACCESSOR("buffers", &NAVFrame::GetBuffers, nullptr),
+                R_GETTER("planes", &NAVFrame::GetPlanes),
                 R_ACCESSOR("extendedBuffers", &NAVFrame::GetExtendedBuffers, nullptr),
                 R_ACCESSOR("sideData", &NAVFrame::GetSideDatas, nullptr),
+                R_GETTER("sideDataTypes", &NAVFrame::GetSideDataTypes),
                 R_ACCESSOR("flags", &NAVFrame::GetFlags, &NAVFrame::SetFlags),
                 R_ACCESSOR("colorRange", &NAVFrame::GetColorRange, &NAVFrame::SetColorRange),
                 R_ACCESSOR("colorPrimaries", &NAVFrame::GetColorPrimaries, &NAVFrame::SetColorPrimaries),
@@ -81,28 +137,88 @@ class NAVFrame : public NAVResource<NAVFrame, AVFrame> {
 
         virtual void Free();
         virtual void RefHandle();
+        virtual size_t GetExternalMemorySize();
+        virtual bool CheckDisposable(const Napi::Env &env);
+
+        /**
+         * Number of async operations (transferDataAsync() and the like) using the frame. It cannot be 
+         * disposed of meanwhile. JS thread only.
+         */
+        int busy = 0;
+
+        /**
+         * Return the handle to the given pool (instead of freeing it) once this frame is finalized 
+         * or released.
+         */
+        void SetPool(std::shared_ptr<NAVFramePool> pool);
 
     private:
         bool Owned = true;
+        std::shared_ptr<NAVFramePool> pool;
+
+        // Caches for the array-valued properties, valid as long as the frame's layout matches cachedLayout
+
+        NAVFrameLayout cachedLayout;
+        Napi::ObjectReference cachedLineSizes;
+        Napi::ObjectReference cachedBuffers;
+        Napi::ObjectReference cachedExtendedBuffers;
+        Napi::ObjectReference cachedPlanes;
+
+        void ValidateCaches();
+        void ClearCaches();
+        Napi::Value BuildPlanes(const Napi::Env &env);
+
+        // Plane and sample operations (see frame-ops.h). These validate the arguments and return the 
+        // operation, which runs right away or on a worker thread, and the frame it writes to.
+
+        std::function<void()> PrepareRegionCopy(const Napi::CallbackInfo& info, NAVFrame *&target);
+        std::function<void()> PrepareRegionFill(const Napi::CallbackInfo& info, NAVFrame *&target);
+        std::function<void()> PrepareSampleCopy(const Napi::CallbackInfo& info, NAVFrame *&target);
+        std::function<void()> PrepareStatistics(const Napi::CallbackInfo& info, NAVFrame *&target, NAVFrameOperationResult &result);
+        std::function<void()> PrepareComparison(const Napi::CallbackInfo& info, NAVFrame *&target, NAVFrameOperationResult &result);
+        Napi::Value RunOperation(const Napi::Env &env, std::function<void()> operation, NAVFrame *target, NAVFrameOperationResult result = nullptr);
+        Napi::Value QueueOperation(const Napi::Env &env, const char *name, std::function<void()> operation, NAVFrame *target, NAVFrameOperationResult result = nullptr);
 
         // Static methods
 
         static Napi::Value GetSideDataName(const Napi::CallbackInfo& info);
+        static Napi::Value TakeShared(const Napi::CallbackInfo& info);
+        static Napi::Value ReleaseShared(const Napi::CallbackInfo& info);
+        static Napi::Value GetKernelSet(const Napi::CallbackInfo& info);
 
         // Methods
 
         Napi::Value ReferTo(const Napi::CallbackInfo& info);
         Napi::Value Unrefer(const Napi::CallbackInfo& info);
+        Napi::Value Share(const Napi::CallbackInfo& info);
         Napi::Value Clone(const Napi::CallbackInfo& info);
         Napi::Value CopyTo(const Napi::CallbackInfo& info);
+        Napi::Value TransferData(const Napi::CallbackInfo& info);
+        Napi::Value TransferDataAsync(const Napi::CallbackInfo& info);
+        Napi::Value CopyRegionTo(const Napi::CallbackInfo& info);
+        Napi::Value CopyRegionToAsync(const Napi::CallbackInfo& info);
+        Napi::Value FillRegion(const Napi::CallbackInfo& info);
+        Napi::Value FillRegionAsync(const Napi::CallbackInfo& info);
+        Napi::Value CopySamplesTo(const Napi::CallbackInfo& info);
+        Napi::Value CopySamplesToAsync(const Napi::CallbackInfo& info);
+        Napi::Value GetStatistics(const Napi::CallbackInfo& info);
+        Napi::Value GetStatisticsAsync(const Napi::CallbackInfo& info);
+        Napi::Value Compare(const Napi::CallbackInfo& info);
+        Napi::Value CompareAsync(const Napi::CallbackInfo& info);
         Napi::Value CopyPropertiesTo(const Napi::CallbackInfo& info);
         Napi::Value GetPlaneBuffer(const Napi::CallbackInfo& info);
         Napi::Value AddSideData(const Napi::CallbackInfo& info);
         Napi::Value GetSideData(const Napi::CallbackInfo& info);
+        Napi::Value GetSideDataRaw(const Napi::CallbackInfo& info);
+        Napi::Value GetMetadataRaw(const Napi::CallbackInfo& info);
         Napi::Value RemoveSideData(const Napi::CallbackInfo& info);
         Napi::Value ApplyCropping(const Napi::CallbackInfo& info);
         Napi::Value MoveReferenceFrom(const Napi::CallbackInfo& info);
         Napi::Value AllocateBuffer(const Napi::CallbackInfo& info);
+        Napi::Value Release(const Napi::CallbackInfo& info);
+        Napi::Value GetProps(const Napi::CallbackInfo& info);
+        Napi::Value SetProps(const Napi::CallbackInfo& info);
+        Napi::Value ReadTimings(const Napi::CallbackInfo& info);
         Napi::Value IsWritable(const Napi::CallbackInfo& info);
 
         // Properties
@@ -151,7 +267,9 @@ class NAVFrame : public NAVResource<NAVFrame, AVFrame> {
         void SetSampleRate(const Napi::CallbackInfo& info, const Napi::Value& value);
         Napi::Value GetBuffers(const Napi::CallbackInfo& info);
         Napi::Value GetExtendedBuffers(const Napi::CallbackInfo& info);
+        Napi::Value GetPlanes(const Napi::CallbackInfo& info);
         Napi::Value GetSideDatas(const Napi::CallbackInfo& info);
+        Napi::Value GetSideDataTypes(const Napi::CallbackInfo& info);
         Napi::Value GetFlags(const Napi::CallbackInfo& info);
         void SetFlags(const Napi::CallbackInfo& info, const Napi::Value& value);
         Napi::Value GetColorRange(const Napi::CallbackInfo& info);
@@ -0,0 +1,262 @@
+#include "hwcontext.h"
+#include "dict.h"
+#include "frame.h"
+#include "../libavaddon.h"
+
+void *GetRegisterableHWContextHandle(void *ref) {
+    return (void*)((AVBufferRef*)ref)->data;
+}
+
+// AVHWDeviceContext ///////////////////////////////////////////////////////////////////
+
+NAVHWDeviceContext::NAVHWDeviceContext(const Napi::CallbackInfo& info):
+    NAVResource(info)
+{
+    if (ConstructFromHandle(info))
+        return;
+
+    auto env = info.Env();
+    AVHWDeviceType type;
+
+    if (info[0].IsString())
+        type = av_hwdevice_find_type_by_name(info[0].As<Napi::String>().Utf8Value().c_str());
+    else
+        type = (AVHWDeviceType)info[0].As<Napi::Number>().Int32Value();
+
+    if (type == AV_HWDEVICE_TYPE_NONE) {
+        Napi::RangeError::New(env, "Unknown hardware device type").ThrowAsJavaScriptException();
+        return;
+    }
+
+    std::string device;
+    if (info.Length() > 1 && info[1].IsString())
+        device = info[1].As<Napi::String>().Utf8Value();
+
+    AVDictionary *options = nullptr;
+    if (info.Length() > 2 && info[2].IsObject())
+        options = NAVDictionary::Unwrap(info[2].As<Napi::Object>())->GetHandle();
+
+    AVBufferRef *ref = nullptr;
+    int result = av_hwdevice_ctx_create(&ref, type, device.empty() ? nullptr : device.c_str(), options, 0);
+
+    if (result < 0) {
+        nlav_throw(env, result, "av_hwdevice_ctx_create");
+        return;
+    }
+
+    SetHandle(ref);
+}
+
+void NAVHWDeviceContext::Free() {
+    auto handle = GetHandle();
+    av_buffer_unref(&handle);
+    SetHandle(handle);
+}
+
+void NAVHWDeviceContext::RefHandle() {
+    SetHandle(av_buffer_ref(GetHandle()));
+}
+
+Napi::Value NAVHWDeviceContext::FindTypeByName(const Napi::CallbackInfo& info) {
+    auto name = info[0].As<Napi::String>().Utf8Value();
+    return Napi::Number::New(info.Env(), av_hwdevice_find_type_by_name(name.c_str()));
+}
+
+Napi::Value NAVHWDeviceContext::GetTypeName(const Napi::CallbackInfo& info) {
+    auto name = av_hwdevice_get_type_name((AVHWDeviceType)info[0].As<Napi::Number>().Int32Value());
+    if (!name)
+        return info.Env().Null();
+
+    return Napi::String::New(info.Env(), name);
+}
+
+/**
+ * The device types libavutil was built with. Whether a device of the type can actually be created depends
+ * on the hardware and drivers present.
+ */
+Napi::Value NAVHWDeviceContext::AvailableTypes(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    std::vector<Napi::Value> types;
+    AVHWDeviceType type = AV_HWDEVICE_TYPE_NONE;
+
+    while ((type = av_hwdevice_iterate_types(type)) != AV_HWDEVICE_TYPE_NONE)
+        types.push_back(Napi::Number::New(env, type));
+
+    auto array = Napi::Array::New(env, types.size());
+    for (uint32_t i = 0, max = types.size(); i < max; ++i)
+        array.Set(i, types[i]);
+
+    return array;
+}
+
+/**
+ * Shorthand for new AVHWFramesContext(device), configure(properties) and init().
+ */
+Napi::Value NAVHWDeviceContext::CreateFramesContext(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto frames = LibAvAddon::ConstructWrapped(env, NAVHWFramesContext::ExportName(), { Value() });
+
+    if (env.IsExceptionPending())
+        return env.Undefined();
+
+    if (info.Length() > 0 && info[0].IsObject()) {
+        frames.Get("configure").As<Napi::Function>().Call(frames, { info[0] });
+        if (env.IsExceptionPending())
+            return env.Undefined();
+    }
+
+    frames.Get("init").As<Napi::Function>().Call(frames, {});
+    if (env.IsExceptionPending())
+        return env.Undefined();
+
+    return frames;
+}
+
+Napi::Value NAVHWDeviceContext::GetType(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetDeviceContext()->type);
+}
+
+// AVHWFramesContext ///////////////////////////////////////////////////////////////////
+
+NAVHWFramesContext::NAVHWFramesContext(const Napi::CallbackInfo& info):
+    NAVResource(info)
+{
+    // Frames contexts we did not create (such as the one a decoder allocated) are in use already
+    if (ConstructFromHandle(info)) {
+        initialized = true;
+        return;
+    }
+
+    auto env = info.Env();
+
+    if (!info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected an AVHWDeviceContext").ThrowAsJavaScriptException();
+        return;
+    }
+
+    auto device = NAVHWDeviceContext::Unwrap(info[0].As<Napi::Object>());
+    auto ref = av_hwframe_ctx_alloc(device->GetHandle());
+
+    if (!ref) {
+        Napi::Error::New(env, "Failed to allocate the hardware frames context").ThrowAsJavaScriptException();
+        return;
+    }
+
+    SetHandle(ref);
+}
+
+void NAVHWFramesContext::Free() {
+    auto handle = GetHandle();
+    av_buffer_unref(&handle);
+    SetHandle(handle);
+}
+
+void NAVHWFramesContext::RefHandle() {
+    SetHandle(av_buffer_ref(GetHandle()));
+}
+
+bool NAVHWFramesContext::CheckNotInitialized(const Napi::Env &env) {
+    if (!initialized)
+        return true;
+
+    Napi::Error::New(env, "The hardware frames context is already initialized").ThrowAsJavaScriptException();
+    return false;
+}
+
+Napi::Value NAVHWFramesContext::Init(const Napi::CallbackInfo& info) {
+    if (!CheckNotInitialized(info.Env()))
+        return info.Env().Undefined();
+
+    int result = av_hwframe_ctx_init(GetHandle());
+    if (result < 0)
+        return nlav_throw(info.Env(), result, "av_hwframe_ctx_init");
+
+    initialized = true;
+    return info.Env().Undefined();
+}
+
+Napi::Value NAVHWFramesContext::Configure(const Napi::CallbackInfo& info) {
+    return ApplyProperties(info);
+}
+
+/**
+ * Allocate a frame from the pool (into the given frame, or a new one), for instance to upload to with
+ * AVFrame#transferData().
+ */
+Napi::Value NAVHWFramesContext::GetBuffer(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+
+    if (!initialized) {
+        Napi::Error::New(env, "The hardware frames context must be initialized first, see init()").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    NAVFrame *frame;
+    if (info.Length() > 0 && info[0].IsObject())
+        frame = NAVFrame::UnwrapArgument(env, info[0]);
+    else
+        frame = LibAvAddon::Construct<NAVFrame>(env);
+    
+    if (!frame)
+        return env.Undefined();
+
+    int result = av_hwframe_get_buffer(GetHandle(), frame->GetHandle(), 0);
+    if (result < 0)
+        return nlav_throw(env, result, "av_hwframe_get_buffer");
+
+    frame->UpdateExternalMemory(env);
+    return frame->Value();
+}
+
+Napi::Value NAVHWFramesContext::GetInitialized(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), initialized);
+}
+
+Napi::Value NAVHWFramesContext::GetDeviceContext(const Napi::CallbackInfo& info) {
+    return NAVHWDeviceContext::FromHandleWrapped(info.Env(), GetFramesContext()->device_ref, false);
+}
+
+Napi::Value NAVHWFramesContext::GetFormat(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetFramesContext()->format);
+}
+
+void NAVHWFramesContext::SetFormat(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    if (CheckNotInitialized(info.Env()))
+        GetFramesContext()->format = (AVPixelFormat)value.As<Napi::Number>().Int32Value();
+}
+
+Napi::Value NAVHWFramesContext::GetSwFormat(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetFramesContext()->sw_format);
+}
+
+void NAVHWFramesContext::SetSwFormat(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    if (CheckNotInitialized(info.Env()))
+        GetFramesContext()->sw_format = (AVPixelFormat)value.As<Napi::Number>().Int32Value();
+}
+
+Napi::Value NAVHWFramesContext::GetWidth(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetFramesContext()->width);
+}
+
+void NAVHWFramesContext::SetWidth(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    if (CheckNotInitialized(info.Env()))
+        GetFramesContext()->width = value.As<Napi::Number>().Int32Value();
+}
+
+Napi::Value NAVHWFramesContext::GetHeight(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetFramesContext()->height);
+}
+
+void NAVHWFramesContext::SetHeight(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    if (CheckNotInitialized(info.Env()))
+        GetFramesContext()->height = value.As<Napi::Number>().Int32Value();
+}
+
+Napi::Value NAVHWFramesContext::GetInitialPoolSize(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), GetFramesContext()->initial_pool_size);
+}
+
+void NAVHWFramesContext::SetInitialPoolSize(const Napi::CallbackInfo& info, const Napi::Value& value) {
+    if (CheckNotInitialized(info.Env()))
+        GetFramesContext()->initial_pool_size = value.As<Napi::Number>().Int32Value();
+}
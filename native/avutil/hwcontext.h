@@ -0,0 +1,101 @@
+#include <napi.h>
+
+#include "../common.h"
+#include "../resource.h"
+
+extern "C" {
+    #include <libavutil/hwcontext.h>
+}
+
+/**
+ * Hardware contexts are handled as AVBufferRefs (see av_hwdevice_ctx_create()), but are registered by the
+ * context they refer to, so that they do not collide with an AVBuffer wrapping the same buffer.
+ */
+void *GetRegisterableHWContextHandle(void *ref);
+
+class NAVHWDeviceContext : public NAVResource<NAVHWDeviceContext, AVBufferRef, GetRegisterableHWContextHandle> {
+    public:
+        NAVHWDeviceContext(const Napi::CallbackInfo& info);
+
+        inline static std::string ExportName() { return "AVHWDeviceContext"; }
+        inline static Napi::Function ClassDefinition(const Napi::Env &env) {
+            return DefineClass(env, "AVHWDeviceContext", {
+                StaticMethod("findTypeByName", &NAVHWDeviceContext::FindTypeByName),
+                StaticMethod("getTypeName", &NAVHWDeviceContext::GetTypeName),
+                StaticMethod("availableTypes", &NAVHWDeviceContext::AvailableTypes),
+
+                R_METHOD("createFramesContext", &NAVHWDeviceContext::CreateFramesContext),
+                R_GETTER("type", &NAVHWDeviceContext::GetType)
+            });
+        }
+
+        virtual void Free();
+        virtual void RefHandle();
+
+        AVHWDeviceContext *GetDeviceContext() {
+            return (AVHWDeviceContext*)GetHandle()->data;
+        }
+
+    private:
+        static Napi::Value FindTypeByName(const Napi::CallbackInfo& info);
+        static Napi::Value GetTypeName(const Napi::CallbackInfo& info);
+        static Napi::Value AvailableTypes(const Napi::CallbackInfo& info);
+
+        Napi::Value CreateFramesContext(const Napi::CallbackInfo& info);
+        Napi::Value GetType(const Napi::CallbackInfo& info);
+};
+
+/**
+ * A pool of frames on a hardware device. Constructed uninitialized: set format, swFormat, width and height,
+ * then call init().
+ */
+class NAVHWFramesContext : public NAVResource<NAVHWFramesContext, AVBufferRef, GetRegisterableHWContextHandle> {
+    public:
+        NAVHWFramesContext(const Napi::CallbackInfo& info);
+
+        inline static std::string ExportName() { return "AVHWFramesContext"; }
+        inline static Napi::Function ClassDefinition(const Napi::Env &env) {
+            return DefineClass(env, "AVHWFramesContext", {
+                R_METHOD("init", &NAVHWFramesContext::Init),
+                R_METHOD("configure", &NAVHWFramesContext::Configure),
+                R_METHOD("getBuffer", &NAVHWFramesContext::GetBuffer),
+
+                R_GETTER("initialized", &NAVHWFramesContext::GetInitialized),
+                R_GETTER("deviceContext", &NAVHWFramesContext::GetDeviceContext),
+                R_ACCESSOR("format", &NAVHWFramesContext::GetFormat, &NAVHWFramesContext::SetFormat),
+                R_ACCESSOR("swFormat", &NAVHWFramesContext::GetSwFormat, &NAVHWFramesContext::SetSwFormat),
+                R_ACCESSOR("width", &NAVHWFramesContext::GetWidth, &NAVHWFramesContext::SetWidth),
+                R_ACCESSOR("height", &NAVHWFramesContext::GetHeight, &NAVHWFramesContext::SetHeight),
+                R_ACCESSOR("initialPoolSize", &NAVHWFramesContext::GetInitialPoolSize, &NAVHWFramesContext::SetInitialPoolSize)
+            });
+        }
+
+        virtual void Free();
+        virtual void RefHandle();
+
+        AVHWFramesContext *GetFramesContext() {
+            return (AVHWFramesContext*)GetHandle()->data;
+        }
+
+    private:
+        bool initialized = false;
+
+        bool CheckNotInitialized(const Napi::Env &env);
+
+        Napi::Value Init(const Napi::CallbackInfo& info);
+        Napi::Value Configure(const Napi::CallbackInfo& info);
+        Napi::Value GetBuffer(const Napi::CallbackInfo& info);
+
+        Napi::Value GetInitialized(const Napi::CallbackInfo& info);
+        Napi::Value GetDeviceContext(const Napi::CallbackInfo& info);
+        Napi::Value GetFormat(const Napi::CallbackInfo& info);
+        void SetFormat(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetSwFormat(const Napi::CallbackInfo& info);
+        void SetSwFormat(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetWidth(const Napi::CallbackInfo& info);
+        void SetWidth(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetHeight(const Napi::CallbackInfo& info);
+        void SetHeight(const Napi::CallbackInfo& info, const Napi::Value& value);
+        Napi::Value GetInitialPoolSize(const Napi::CallbackInfo& info);
+        void SetInitialPoolSize(const Napi::CallbackInfo& info, const Napi::Value& value);
+};
@@ -5,6 +5,7 @@
 #include "frame.h"
 #include "class.h"
 #include "channel-layout.h"
+#include "hwcontext.h"
 
 void nlavu_init(Napi::Env env, Napi::Object exports) {    
     NAVUtil::Register(env, exports);
@@ -15,6 +16,8 @@ void nlavu_init(Napi::Env env, Napi::Object exports) {
     NAVFrame::Register(env, exports);
     NAVFrameSideData::Register(env, exports);
     NAVClass::Register(env, exports);
+    NAVHWDeviceContext::Register(env, exports);
+    NAVHWFramesContext::Register(env, exports);
 
 #ifdef FFMPEG_5_1
     NAVChannelLayout::Register(env, exports);
@@ -0,0 +1,772 @@
+#include "kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+extern "C" {
+    #include <libavutil/cpu.h>
+}
+
+// x86-64 only: SSE2 is not a given on 32-bit x86 (compilers need -msse2 for it), and the sums use
+// _mm_cvtsi128_si64()
+#if defined(__x86_64__) || defined(_M_X64)
+#   define NLAV_KERNELS_X86 1
+#   include <emmintrin.h>
+#   include <immintrin.h>
+#   if defined(__GNUC__)
+#       define NLAV_TARGET_AVX2 __attribute__((target("avx2")))
+#   else
+#       define NLAV_TARGET_AVX2
+#   endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#   define NLAV_KERNELS_NEON 1
+#   include <arm_neon.h>
+#endif
+
+// C ////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void nlav_fill16_c(uint16_t *dst, uint16_t value, size_t count) {
+    std::fill(dst, dst + count, value);
+}
+
+static void nlav_fill32_c(uint32_t *dst, uint32_t value, size_t count) {
+    std::fill(dst, dst + count, value);
+}
+
+static void nlav_interleave2x32_c(uint32_t *dst, const uint32_t *left, const uint32_t *right, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[2 * i] = left[i];
+        dst[2 * i + 1] = right[i];
+    }
+}
+
+static void nlav_deinterleave2x32_c(uint32_t *left, uint32_t *right, const uint32_t *src, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        left[i] = src[2 * i];
+        right[i] = src[2 * i + 1];
+    }
+}
+
+static void nlav_s16_to_float_c(float *dst, const int16_t *src, size_t count, float scale) {
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = src[i] * scale;
+}
+
+static inline int16_t nlav_float_to_s16(float value) {
+    return (int16_t)lrintf(std::min(32767.0f, std::max(-32768.0f, value)));
+}
+
+static void nlav_float_to_s16_c(int16_t *dst, const float *src, size_t count, float scale) {
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = nlav_float_to_s16(src[i] * scale);
+}
+
+static void nlav_scale_float_c(float *dst, const float *src, size_t count, float scale) {
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = src[i] * scale;
+}
+
+static uint64_t nlav_sum8_c(const uint8_t *src, size_t count) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i)
+        sum += src[i];
+    return sum;
+}
+
+static uint64_t nlav_sum_squares8_c(const uint8_t *src, size_t count) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i)
+        sum += src[i] * src[i];
+    return sum;
+}
+
+static uint64_t nlav_count_at_most8_c(const uint8_t *src, size_t count, uint8_t threshold) {
+    uint64_t matching = 0;
+    for (size_t i = 0; i < count; ++i)
+        matching += src[i] <= threshold;
+    return matching;
+}
+
+static uint64_t nlav_sum_abs_diff8_c(const uint8_t *a, const uint8_t *b, size_t count) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i)
+        sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    return sum;
+}
+
+static uint64_t nlav_sum_squared_diff8_c(const uint8_t *a, const uint8_t *b, size_t count) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        int difference = a[i] - b[i];
+        sum += difference * difference;
+    }
+    return sum;
+}
+
+static void nlav_energy_float_c(const float *src, size_t count, double *sumSquares, float *peak) {
+    double sum = 0;
+    float max = *peak;
+
+    for (size_t i = 0; i < count; ++i) {
+        sum += (double)src[i] * src[i];
+        max = std::max(max, std::fabs(src[i]));
+    }
+
+    *sumSquares += sum;
+    *peak = max;
+}
+
+#ifdef NLAV_KERNELS_X86
+
+// SSE2 /////////////////////////////////////////////////////////////////////////////////////////////
+
+static void nlav_fill16_sse2(uint16_t *dst, uint16_t value, size_t count) {
+    __m128i vector = _mm_set1_epi16((short)value);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+        _mm_storeu_si128((__m128i*)(dst + i), vector);
+    
+    nlav_fill16_c(dst + i, value, count - i);
+}
+
+static void nlav_fill32_sse2(uint32_t *dst, uint32_t value, size_t count) {
+    __m128i vector = _mm_set1_epi32((int)value);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128((__m128i*)(dst + i), vector);
+    
+    nlav_fill32_c(dst + i, value, count - i);
+}
+
+static void nlav_interleave2x32_sse2(uint32_t *dst, const uint32_t *left, const uint32_t *right, size_t count) {
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 l = _mm_loadu_ps((const float*)(left + i));
+        __m128 r = _mm_loadu_ps((const float*)(right + i));
+        _mm_storeu_ps((float*)(dst + 2 * i), _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps((float*)(dst + 2 * i + 4), _mm_unpackhi_ps(l, r));
+    }
+
+    nlav_interleave2x32_c(dst + 2 * i, left + i, right + i, count - i);
+}
+
+static void nlav_deinterleave2x32_sse2(uint32_t *left, uint32_t *right, const uint32_t *src, size_t count) {
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 a = _mm_loadu_ps((const float*)(src + 2 * i));
+        __m128 b = _mm_loadu_ps((const float*)(src + 2 * i + 4));
+        _mm_storeu_ps((float*)(left + i), _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps((float*)(right + i), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+
+    nlav_deinterleave2x32_c(left + i, right + i, src + 2 * i, count - i);
+}
+
+static void nlav_s16_to_float_sse2(float *dst, const int16_t *src, size_t count, float scale) {
+    __m128 factor = _mm_set1_ps(scale);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i samples = _mm_loadu_si128((const __m128i*)(src + i));
+
+        // Sign extension: the sample in the upper half of each 32 bit lane, shifted back down
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(low), factor));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), factor));
+    }
+
+    nlav_s16_to_float_c(dst + i, src + i, count - i, scale);
+}
+
+static void nlav_float_to_s16_sse2(int16_t *dst, const float *src, size_t count, float scale) {
+    __m128 factor = _mm_set1_ps(scale);
+    __m128 min = _mm_set1_ps(-32768.0f);
+    __m128 max = _mm_set1_ps(32767.0f);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128 low = _mm_min_ps(max, _mm_max_ps(min, _mm_mul_ps(_mm_loadu_ps(src + i), factor)));
+        __m128 high = _mm_min_ps(max, _mm_max_ps(min, _mm_mul_ps(_mm_loadu_ps(src + i + 4), factor)));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high)));
+    }
+
+    nlav_float_to_s16_c(dst + i, src + i, count - i, scale);
+}
+
+static void nlav_scale_float_sse2(float *dst, const float *src, size_t count, float scale) {
+    __m128 factor = _mm_set1_ps(scale);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), factor));
+    
+    nlav_scale_float_c(dst + i, src + i, count - i, scale);
+}
+
+/**
+ * Number of 16 byte steps after which the 32 bit lanes of the sums of squares are flushed into 64 bit 
+ * ones, long before they could overflow (each lane gains at most 2 * 255^2 per step)
+ */
+#define NLAV_SQUARES_FLUSH 1024
+
+static inline uint64_t nlav_horizontal_sum_epi64(__m128i vector) {
+    return (uint64_t)_mm_cvtsi128_si64(vector) + (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(vector, vector));
+}
+
+static inline __m128i nlav_widen_add_epi32(__m128i sum64, __m128i sum32) {
+    __m128i zero = _mm_setzero_si128();
+    return _mm_add_epi64(sum64, _mm_add_epi64(_mm_unpacklo_epi32(sum32, zero), _mm_unpackhi_epi32(sum32, zero)));
+}
+
+static uint64_t nlav_sum8_sse2(const uint8_t *src, size_t count) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(src + i)), zero));
+    
+    return nlav_horizontal_sum_epi64(sum) + nlav_sum8_c(src + i, count - i);
+}
+
+static uint64_t nlav_sum_squares8_sse2(const uint8_t *src, size_t count) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i sum64 = zero;
+    size_t i = 0;
+
+    while (i + 16 <= count) {
+        __m128i sum32 = zero;
+
+        for (int step = 0; step < NLAV_SQUARES_FLUSH && i + 16 <= count; ++step, i += 16) {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128i low = _mm_unpacklo_epi8(pixels, zero);
+            __m128i high = _mm_unpackhi_epi8(pixels, zero);
+            sum32 = _mm_add_epi32(sum32, _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high)));
+        }
+
+        sum64 = nlav_widen_add_epi32(sum64, sum32);
+    }
+
+    return nlav_horizontal_sum_epi64(sum64) + nlav_sum_squares8_c(src + i, count - i);
+}
+
+static uint64_t nlav_count_at_most8_sse2(const uint8_t *src, size_t count, uint8_t threshold) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i limit = _mm_set1_epi8((char)threshold);
+    __m128i one = _mm_set1_epi8(1);
+    __m128i sum = zero;
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        // Saturating subtraction leaves 0 exactly where the pixel is at most the threshold
+        __m128i excess = _mm_subs_epu8(_mm_loadu_si128((const __m128i*)(src + i)), limit);
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_and_si128(_mm_cmpeq_epi8(excess, zero), one), zero));
+    }
+
+    return nlav_horizontal_sum_epi64(sum) + nlav_count_at_most8_c(src + i, count - i, threshold);
+}
+
+static uint64_t nlav_sum_abs_diff8_sse2(const uint8_t *a, const uint8_t *b, size_t count) {
+    __m128i sum = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i))));
+    
+    return nlav_horizontal_sum_epi64(sum) + nlav_sum_abs_diff8_c(a + i, b + i, count - i);
+}
+
+static uint64_t nlav_sum_squared_diff8_sse2(const uint8_t *a, const uint8_t *b, size_t count) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i sum64 = zero;
+    size_t i = 0;
+
+    while (i + 16 <= count) {
+        __m128i sum32 = zero;
+
+        for (int step = 0; step < NLAV_SQUARES_FLUSH && i + 16 <= count; ++step, i += 16) {
+            __m128i first = _mm_loadu_si128((const __m128i*)(a + i));
+            __m128i second = _mm_loadu_si128((const __m128i*)(b + i));
+            __m128i low = _mm_sub_epi16(_mm_unpacklo_epi8(first, zero), _mm_unpacklo_epi8(second, zero));
+            __m128i high = _mm_sub_epi16(_mm_unpackhi_epi8(first, zero), _mm_unpackhi_epi8(second, zero));
+            sum32 = _mm_add_epi32(sum32, _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high)));
+        }
+
+        sum64 = nlav_widen_add_epi32(sum64, sum32);
+    }
+
+    return nlav_horizontal_sum_epi64(sum64) + nlav_sum_squared_diff8_c(a + i, b + i, count - i);
+}
+
+static void nlav_energy_float_sse2(const float *src, size_t count, double *sumSquares, float *peak) {
+    __m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128d sum = _mm_setzero_pd();
+    __m128 max = _mm_set1_ps(*peak);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 samples = _mm_loadu_ps(src + i);
+        __m128 squares = _mm_mul_ps(samples, samples);
+
+        // Summed as doubles, a second of audio in floats would lose the quiet parts
+        sum = _mm_add_pd(sum, _mm_add_pd(_mm_cvtps_pd(squares), _mm_cvtps_pd(_mm_movehl_ps(squares, squares))));
+        max = _mm_max_ps(max, _mm_and_ps(samples, magnitude));
+    }
+
+    double sums[2];
+    float maxima[4];
+    _mm_storeu_pd(sums, sum);
+    _mm_storeu_ps(maxima, max);
+
+    *sumSquares += sums[0] + sums[1];
+    *peak = std::max(std::max(maxima[0], maxima[1]), std::max(maxima[2], maxima[3]));
+    nlav_energy_float_c(src + i, count - i, sumSquares, peak);
+}
+
+// AVX2 /////////////////////////////////////////////////////////////////////////////////////////////
+
+NLAV_TARGET_AVX2
+static void nlav_fill16_avx2(uint16_t *dst, uint16_t value, size_t count) {
+    __m256i vector = _mm256_set1_epi16((short)value);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+        _mm256_storeu_si256((__m256i*)(dst + i), vector);
+    
+    nlav_fill16_c(dst + i, value, count - i);
+}
+
+NLAV_TARGET_AVX2
+static void nlav_fill32_avx2(uint32_t *dst, uint32_t value, size_t count) {
+    __m256i vector = _mm256_set1_epi32((int)value);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_si256((__m256i*)(dst + i), vector);
+    
+    nlav_fill32_c(dst + i, value, count - i);
+}
+
+NLAV_TARGET_AVX2
+static void nlav_s16_to_float_avx2(float *dst, const int16_t *src, size_t count, float scale) {
+    __m256 factor = _mm256_set1_ps(scale);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i samples = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), factor));
+    }
+
+    nlav_s16_to_float_c(dst + i, src + i, count - i, scale);
+}
+
+NLAV_TARGET_AVX2
+static void nlav_float_to_s16_avx2(int16_t *dst, const float *src, size_t count, float scale) {
+    __m256 factor = _mm256_set1_ps(scale);
+    __m256 min = _mm256_set1_ps(-32768.0f);
+    __m256 max = _mm256_set1_ps(32767.0f);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m256 low = _mm256_min_ps(max, _mm256_max_ps(min, _mm256_mul_ps(_mm256_loadu_ps(src + i), factor)));
+        __m256 high = _mm256_min_ps(max, _mm256_max_ps(min, _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), factor)));
+
+        // packs works within 128 bit lanes, the permutation puts the quarters back in order
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(low), _mm256_cvtps_epi32(high));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+
+    nlav_float_to_s16_sse2(dst + i, src + i, count - i, scale);
+}
+
+NLAV_TARGET_AVX2
+static void nlav_scale_float_avx2(float *dst, const float *src, size_t count, float scale) {
+    __m256 factor = _mm256_set1_ps(scale);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), factor));
+    
+    nlav_scale_float_c(dst + i, src + i, count - i, scale);
+}
+
+NLAV_TARGET_AVX2
+static inline uint64_t nlav_horizontal_sum_epi64_avx2(__m256i vector) {
+    return nlav_horizontal_sum_epi64(_mm_add_epi64(_mm256_castsi256_si128(vector), _mm256_extracti128_si256(vector, 1)));
+}
+
+NLAV_TARGET_AVX2
+static uint64_t nlav_sum8_avx2(const uint8_t *src, size_t count) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i sum = zero;
+    size_t i = 0;
+
+    for (; i + 32 <= count; i += 32)
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)(src + i)), zero));
+    
+    return nlav_horizontal_sum_epi64_avx2(sum) + nlav_sum8_sse2(src + i, count - i);
+}
+
+NLAV_TARGET_AVX2
+static uint64_t nlav_sum_squares8_avx2(const uint8_t *src, size_t count) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i sum64 = zero;
+    size_t i = 0;
+
+    while (i + 16 <= count) {
+        __m256i sum32 = zero;
+
+        for (int step = 0; step < NLAV_SQUARES_FLUSH && i + 16 <= count; ++step, i += 16) {
+            __m256i pixels = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(src + i)));
+            sum32 = _mm256_add_epi32(sum32, _mm256_madd_epi16(pixels, pixels));
+        }
+
+        sum64 = _mm256_add_epi64(sum64, _mm256_add_epi64(_mm256_unpacklo_epi32(sum32, zero), _mm256_unpackhi_epi32(sum32, zero)));
+    }
+
+    return nlav_horizontal_sum_epi64_avx2(sum64) + nlav_sum_squares8_c(src + i, count - i);
+}
+
+NLAV_TARGET_AVX2
+static uint64_t nlav_count_at_most8_avx2(const uint8_t *src, size_t count, uint8_t threshold) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i limit = _mm256_set1_epi8((char)threshold);
+    __m256i one = _mm256_set1_epi8(1);
+    __m256i sum = zero;
+    size_t i = 0;
+
+    for (; i + 32 <= count; i += 32) {
+        __m256i excess = _mm256_subs_epu8(_mm256_loadu_si256((const __m256i*)(src + i)), limit);
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_and_si256(_mm256_cmpeq_epi8(excess, zero), one), zero));
+    }
+
+    return nlav_horizontal_sum_epi64_avx2(sum) + nlav_count_at_most8_sse2(src + i, count - i, threshold);
+}
+
+NLAV_TARGET_AVX2
+static uint64_t nlav_sum_abs_diff8_avx2(const uint8_t *a, const uint8_t *b, size_t count) {
+    __m256i sum = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 32 <= count; i += 32)
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i))));
+    
+    return nlav_horizontal_sum_epi64_avx2(sum) + nlav_sum_abs_diff8_sse2(a + i, b + i, count - i);
+}
+
+NLAV_TARGET_AVX2
+static uint64_t nlav_sum_squared_diff8_avx2(const uint8_t *a, const uint8_t *b, size_t count) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i sum64 = zero;
+    size_t i = 0;
+
+    while (i + 16 <= count) {
+        __m256i sum32 = zero;
+
+        for (int step = 0; step < NLAV_SQUARES_FLUSH && i + 16 <= count; ++step, i += 16) {
+            __m256i first = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + i)));
+            __m256i second = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(b + i)));
+            __m256i difference = _mm256_sub_epi16(first, second);
+            sum32 = _mm256_add_epi32(sum32, _mm256_madd_epi16(difference, difference));
+        }
+
+        sum64 = _mm256_add_epi64(sum64, _mm256_add_epi64(_mm256_unpacklo_epi32(sum32, zero), _mm256_unpackhi_epi32(sum32, zero)));
+    }
+
+    return nlav_horizontal_sum_epi64_avx2(sum64) + nlav_sum_squared_diff8_c(a + i, b + i, count - i);
+}
+
+NLAV_TARGET_AVX2
+static void nlav_energy_float_avx2(const float *src, size_t count, double *sumSquares, float *peak) {
+    __m256 magnitude = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256d sum = _mm256_setzero_pd();
+    __m256 max = _mm256_set1_ps(*peak);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 samples = _mm256_loadu_ps(src + i);
+        __m256 squares = _mm256_mul_ps(samples, samples);
+
+        sum = _mm256_add_pd(sum, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(squares)), _mm256_cvtps_pd(_mm256_extractf128_ps(squares, 1))));
+        max = _mm256_max_ps(max, _mm256_and_ps(samples, magnitude));
+    }
+
+    double sums[4];
+    float maxima[8];
+    _mm256_storeu_pd(sums, sum);
+    _mm256_storeu_ps(maxima, max);
+
+    *sumSquares += sums[0] + sums[1] + sums[2] + sums[3];
+    *peak = *std::max_element(maxima, maxima + 8);
+    nlav_energy_float_c(src + i, count - i, sumSquares, peak);
+}
+
+#endif // #ifdef NLAV_KERNELS_X86
+
+#ifdef NLAV_KERNELS_NEON
+
+// NEON /////////////////////////////////////////////////////////////////////////////////////////////
+
+static void nlav_fill16_neon(uint16_t *dst, uint16_t value, size_t count) {
+    uint16x8_t vector = vdupq_n_u16(value);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+        vst1q_u16(dst + i, vector);
+    
+    nlav_fill16_c(dst + i, value, count - i);
+}
+
+static void nlav_fill32_neon(uint32_t *dst, uint32_t value, size_t count) {
+    uint32x4_t vector = vdupq_n_u32(value);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+        vst1q_u32(dst + i, vector);
+    
+    nlav_fill32_c(dst + i, value, count - i);
+}
+
+static void nlav_interleave2x32_neon(uint32_t *dst, const uint32_t *left, const uint32_t *right, size_t count) {
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        uint32x4x2_t pair = { { vld1q_u32(left + i), vld1q_u32(right + i) } };
+        vst2q_u32(dst + 2 * i, pair);
+    }
+
+    nlav_interleave2x32_c(dst + 2 * i, left + i, right + i, count - i);
+}
+
+static void nlav_deinterleave2x32_neon(uint32_t *left, uint32_t *right, const uint32_t *src, size_t count) {
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        uint32x4x2_t pair = vld2q_u32(src + 2 * i);
+        vst1q_u32(left + i, pair.val[0]);
+        vst1q_u32(right + i, pair.val[1]);
+    }
+
+    nlav_deinterleave2x32_c(left + i, right + i, src + 2 * i, count - i);
+}
+
+static void nlav_s16_to_float_neon(float *dst, const int16_t *src, size_t count, float scale) {
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t samples = vld1q_s16(src + i);
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))), scale));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))), scale));
+    }
+
+    nlav_s16_to_float_c(dst + i, src + i, count - i, scale);
+}
+
+static void nlav_float_to_s16_neon(int16_t *dst, const float *src, size_t count, float scale) {
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        // Rounding to nearest, then narrowing with saturation
+        int32x4_t low = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i), scale));
+        int32x4_t high = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(src + i + 4), scale));
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+    }
+
+    nlav_float_to_s16_c(dst + i, src + i, count - i, scale);
+}
+
+static void nlav_scale_float_neon(float *dst, const float *src, size_t count, float scale) {
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(dst + i, vmulq_n_f32(vld1q_f32(src + i), scale));
+    
+    nlav_scale_float_c(dst + i, src + i, count - i, scale);
+}
+
+static inline uint64_t nlav_horizontal_sum_u64(uint64x2_t vector) {
+    return vgetq_lane_u64(vector, 0) + vgetq_lane_u64(vector, 1);
+}
+
+static uint64_t nlav_sum8_neon(const uint8_t *src, size_t count) {
+    uint64x2_t sum = vdupq_n_u64(0);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+        sum = vpadalq_u32(sum, vpaddlq_u16(vpaddlq_u8(vld1q_u8(src + i))));
+    
+    return nlav_horizontal_sum_u64(sum) + nlav_sum8_c(src + i, count - i);
+}
+
+/**
+ * Sums of the squares of 8 bit values, see NLAV_SQUARES_FLUSH on x86
+ */
+static inline uint32x4_t nlav_add_squares_u8(uint32x4_t sum, uint8x16_t values) {
+    sum = vpadalq_u16(sum, vmull_u8(vget_low_u8(values), vget_low_u8(values)));
+    return vpadalq_u16(sum, vmull_u8(vget_high_u8(values), vget_high_u8(values)));
+}
+
+static uint64_t nlav_sum_squares8_neon(const uint8_t *src, size_t count) {
+    uint64x2_t sum64 = vdupq_n_u64(0);
+    size_t i = 0;
+
+    while (i + 16 <= count) {
+        uint32x4_t sum32 = vdupq_n_u32(0);
+
+        for (int step = 0; step < 1024 && i + 16 <= count; ++step, i += 16)
+            sum32 = nlav_add_squares_u8(sum32, vld1q_u8(src + i));
+        
+        sum64 = vpadalq_u32(sum64, sum32);
+    }
+
+    return nlav_horizontal_sum_u64(sum64) + nlav_sum_squares8_c(src + i, count - i);
+}
+
+static uint64_t nlav_count_at_most8_neon(const uint8_t *src, size_t count, uint8_t threshold) {
+    uint8x16_t limit = vdupq_n_u8(threshold);
+    uint64x2_t sum = vdupq_n_u64(0);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t matching = vshrq_n_u8(vcleq_u8(vld1q_u8(src + i), limit), 7);
+        sum = vpadalq_u32(sum, vpaddlq_u16(vpaddlq_u8(matching)));
+    }
+
+    return nlav_horizontal_sum_u64(sum) + nlav_count_at_most8_c(src + i, count - i, threshold);
+}
+
+static uint64_t nlav_sum_abs_diff8_neon(const uint8_t *a, const uint8_t *b, size_t count) {
+    uint64x2_t sum = vdupq_n_u64(0);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+        sum = vpadalq_u32(sum, vpaddlq_u16(vpaddlq_u8(vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)))));
+    
+    return nlav_horizontal_sum_u64(sum) + nlav_sum_abs_diff8_c(a + i, b + i, count - i);
+}
+
+static uint64_t nlav_sum_squared_diff8_neon(const uint8_t *a, const uint8_t *b, size_t count) {
+    uint64x2_t sum64 = vdupq_n_u64(0);
+    size_t i = 0;
+
+    while (i + 16 <= count) {
+        uint32x4_t sum32 = vdupq_n_u32(0);
+
+        for (int step = 0; step < 1024 && i + 16 <= count; ++step, i += 16)
+            sum32 = nlav_add_squares_u8(sum32, vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+        
+        sum64 = vpadalq_u32(sum64, sum32);
+    }
+
+    return nlav_horizontal_sum_u64(sum64) + nlav_sum_squared_diff8_c(a + i, b + i, count - i);
+}
+
+static void nlav_energy_float_neon(const float *src, size_t count, double *sumSquares, float *peak) {
+    float64x2_t sum = vdupq_n_f64(0);
+    float32x4_t max = vdupq_n_f32(*peak);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t samples = vld1q_f32(src + i);
+        float32x4_t squares = vmulq_f32(samples, samples);
+
+        sum = vaddq_f64(sum, vaddq_f64(vcvt_f64_f32(vget_low_f32(squares)), vcvt_high_f64_f32(squares)));
+        max = vmaxq_f32(max, vabsq_f32(samples));
+    }
+
+    *sumSquares += vaddvq_f64(sum);
+    *peak = vmaxvq_f32(max);
+    nlav_energy_float_c(src + i, count - i, sumSquares, peak);
+}
+
+#endif // #ifdef NLAV_KERNELS_NEON
+
+static NAVKernels nlav_select_kernels() {
+    NAVKernels kernels = {
+        "c",
+        nlav_fill16_c,
+        nlav_fill32_c,
+        nlav_interleave2x32_c,
+        nlav_deinterleave2x32_c,
+        nlav_s16_to_float_c,
+        nlav_float_to_s16_c,
+        nlav_scale_float_c,
+        nlav_sum8_c,
+        nlav_sum_squares8_c,
+        nlav_count_at_most8_c,
+        nlav_sum_abs_diff8_c,
+        nlav_sum_squared_diff8_c,
+        nlav_energy_float_c
+    };
+
+    int flags = av_get_cpu_flags();
+    (void)flags;
+
+#ifdef NLAV_KERNELS_X86
+    if (flags & AV_CPU_FLAG_SSE2) {
+        kernels.name = "sse2";
+        kernels.fill16 = nlav_fill16_sse2;
+        kernels.fill32 = nlav_fill32_sse2;
+        kernels.interleave2x32 = nlav_interleave2x32_sse2;
+        kernels.deinterleave2x32 = nlav_deinterleave2x32_sse2;
+        kernels.s16ToFloat = nlav_s16_to_float_sse2;
+        kernels.floatToS16 = nlav_float_to_s16_sse2;
+        kernels.scaleFloat = nlav_scale_float_sse2;
+        kernels.sum8 = nlav_sum8_sse2;
+        kernels.sumSquares8 = nlav_sum_squares8_sse2;
+        kernels.countAtMost8 = nlav_count_at_most8_sse2;
+        kernels.sumAbsDiff8 = nlav_sum_abs_diff8_sse2;
+        kernels.sumSquaredDiff8 = nlav_sum_squared_diff8_sse2;
+        kernels.energyFloat = nlav_energy_float_sse2;
+    }
+
+    // Interleaving is bound by memory bandwidth, SSE2 is as fast there
+    if ((flags & AV_CPU_FLAG_SSE2) && (flags & AV_CPU_FLAG_AVX2)) {
+        kernels.name = "avx2";
+        kernels.fill16 = nlav_fill16_avx2;
+        kernels.fill32 = nlav_fill32_avx2;
+        kernels.s16ToFloat = nlav_s16_to_float_avx2;
+        kernels.floatToS16 = nlav_float_to_s16_avx2;
+        kernels.scaleFloat = nlav_scale_float_avx2;
+        kernels.sum8 = nlav_sum8_avx2;
+        kernels.sumSquares8 = nlav_sum_squares8_avx2;
+        kernels.countAtMost8 = nlav_count_at_most8_avx2;
+        kernels.sumAbsDiff8 = nlav_sum_abs_diff8_avx2;
+        kernels.sumSquaredDiff8 = nlav_sum_squared_diff8_avx2;
+        kernels.energyFloat = nlav_energy_float_avx2;
+    }
+#endif
+
+#ifdef NLAV_KERNELS_NEON
+    if (flags & AV_CPU_FLAG_NEON) {
+        kernels.name = "neon";
+        kernels.fill16 = nlav_fill16_neon;
+        kernels.fill32 = nlav_fill32_neon;
+        kernels.interleave2x32 = nlav_interleave2x32_neon;
+        kernels.deinterleave2x32 = nlav_deinterleave2x32_neon;
+        kernels.s16ToFloat = nlav_s16_to_float_neon;
+        kernels.floatToS16 = nlav_float_to_s16_neon;
+        kernels.scaleFloat = nlav_scale_float_neon;
+        kernels.sum8 = nlav_sum8_neon;
+        kernels.sumSquares8 = nlav_sum_squares8_neon;
+        kernels.countAtMost8 = nlav_count_at_most8_neon;
+        kernels.sumAbsDiff8 = nlav_sum_abs_diff8_neon;
+        kernels.sumSquaredDiff8 = nlav_sum_squared_diff8_neon;
+        kernels.energyFloat = nlav_energy_float_neon;
+    }
+#endif
+
+    return kernels;
+}
+
+const NAVKernels &nlav_kernels() {
+    static const NAVKernels kernels = nlav_select_kernels();
+    return kernels;
+}
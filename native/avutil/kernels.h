@@ -0,0 +1,44 @@
+#ifndef __NLAV_KERNELS_H__
+#   define __NLAV_KERNELS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Inner loops of the plane and sample operations of AVFrame (see frame-ops.h and frame-stats.h), in 
+ * the best variant for the CPU we run on: AVX2 or SSE2 on x86-64, NEON on 64-bit ARM, plain C otherwise. 
+ * The variant is picked once, from av_get_cpu_flags(), so it honors av_force_cpu_flags() when called 
+ * before the first use.
+ *
+ * Pointers need no particular alignment. Conversions from float saturate to the range of the integer
+ * type and round to the nearest integer.
+ */
+struct NAVKernels {
+    const char *name;
+
+    void (*fill16)(uint16_t *dst, uint16_t value, size_t count);
+    void (*fill32)(uint32_t *dst, uint32_t value, size_t count);
+
+    // Two channels of 32 bit samples (float or int32) to/from interleaved
+    void (*interleave2x32)(uint32_t *dst, const uint32_t *left, const uint32_t *right, size_t count);
+    void (*deinterleave2x32)(uint32_t *left, uint32_t *right, const uint32_t *src, size_t count);
+
+    // dst = src * scale
+    void (*s16ToFloat)(float *dst, const int16_t *src, size_t count, float scale);
+    void (*floatToS16)(int16_t *dst, const float *src, size_t count, float scale);
+    void (*scaleFloat)(float *dst, const float *src, size_t count, float scale);
+
+    // Reductions over rows of 8 bit samples, for the statistics of frames
+    uint64_t (*sum8)(const uint8_t *src, size_t count);
+    uint64_t (*sumSquares8)(const uint8_t *src, size_t count);
+    uint64_t (*countAtMost8)(const uint8_t *src, size_t count, uint8_t threshold);
+    uint64_t (*sumAbsDiff8)(const uint8_t *a, const uint8_t *b, size_t count);
+    uint64_t (*sumSquaredDiff8)(const uint8_t *a, const uint8_t *b, size_t count);
+
+    // Adds the squares of the samples to sumSquares, and raises peak to the largest absolute value
+    void (*energyFloat)(const float *src, size_t count, double *sumSquares, float *peak);
+};
+
+const NAVKernels &nlav_kernels();
+
+#endif // #ifndef __NLAV_KERNELS_H__
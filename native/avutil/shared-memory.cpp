@@ -0,0 +1,128 @@
+#include "shared-memory.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#   define NLAV_SHARED_MEMORY 1
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <unistd.h>
+#endif
+
+/**
+ * A mapping backing a shared buffer (the opaque of its AVBuffer)
+ */
+struct NAVSharedMemory {
+    int fd;
+    size_t size;
+};
+
+/**
+ * The live mappings, by address. Buffers are looked up by their data rather than their opaque, as an 
+ * AVBufferPool wraps the buffers it hands out in buffers of its own.
+ */
+static std::mutex nlav_shared_memory_mutex;
+static std::map<const uint8_t*, NAVSharedMemory*> nlav_shared_memory_mappings;
+
+bool nlav_shared_memory_supported() {
+#ifdef NLAV_SHARED_MEMORY
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef NLAV_SHARED_MEMORY
+
+static int nlav_shared_memory_open() {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    return memfd_create("nlav", MFD_CLOEXEC);
+#else
+    static std::atomic<unsigned> counter(0);
+
+    // Named only until it is unlinked, right away
+    std::string name = "/nlav-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    
+    if (fd >= 0)
+        shm_unlink(name.c_str());
+    
+    return fd;
+#endif
+}
+
+static void nlav_shared_buffer_free(void *opaque, uint8_t *data) {
+    auto memory = (NAVSharedMemory*)opaque;
+
+    {
+        std::unique_lock<std::mutex> lock(nlav_shared_memory_mutex);
+        nlav_shared_memory_mappings.erase(data);
+    }
+
+    munmap(data, memory->size);
+    close(memory->fd);
+    delete memory;
+}
+
+AVBufferRef *nlav_shared_buffer_alloc(size_t size) {
+    int fd = nlav_shared_memory_open();
+    if (fd < 0)
+        return nullptr;
+    
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    auto data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+
+    auto memory = new NAVSharedMemory { fd, size };
+    auto buffer = av_buffer_create((uint8_t*)data, size, nlav_shared_buffer_free, memory, 0);
+    
+    if (!buffer) {
+        munmap(data, size);
+        close(fd);
+        delete memory;
+        return nullptr;
+    }
+
+    std::unique_lock<std::mutex> lock(nlav_shared_memory_mutex);
+    nlav_shared_memory_mappings[(uint8_t*)data] = memory;
+
+    return buffer;
+}
+
+#else
+
+AVBufferRef *nlav_shared_buffer_alloc(size_t size) {
+    return nullptr;
+}
+
+#endif
+
+int nlav_shared_buffer_fd(const AVBufferRef *buffer, size_t *offset) {
+    if (!buffer)
+        return -1;
+    
+    std::unique_lock<std::mutex> lock(nlav_shared_memory_mutex);
+    auto mapping = nlav_shared_memory_mappings.upper_bound(buffer->data);
+
+    if (mapping == nlav_shared_memory_mappings.begin())
+        return -1;
+    
+    --mapping;
+    if (buffer->data >= mapping->first + mapping->second->size)
+        return -1;
+    
+    if (offset)
+        *offset = buffer->data - mapping->first;
+    
+    return mapping->second->fd;
+}
@@ -0,0 +1,26 @@
+#include "../common.h"
+
+#include <stddef.h>
+
+extern "C" {
+    #include <libavutil/buffer.h>
+}
+
+/**
+ * Whether this platform can allocate buffers in shared memory (see nlav_shared_buffer_alloc()).
+ */
+bool nlav_shared_memory_supported();
+
+/**
+ * Allocate a buffer in shared memory: an anonymous memfd on Linux, an unlinked POSIX shared memory 
+ * object elsewhere. Other processes can map it from its file descriptor (see nlav_shared_buffer_fd()),
+ * which is closed along with the mapping once the last reference is gone. Null if the platform does not 
+ * support it or the allocation failed. Any thread.
+ */
+AVBufferRef *nlav_shared_buffer_alloc(size_t size);
+
+/**
+ * The file descriptor of the shared memory (from nlav_shared_buffer_alloc()) the data of the given buffer
+ * is in, and where in it through offset. -1 for any other buffer. Any thread.
+ */
+int nlav_shared_buffer_fd(const AVBufferRef *buffer, size_t *offset = nullptr);
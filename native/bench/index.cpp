@@ -0,0 +1,172 @@
+#include "index.h"
+#include "../libavaddon.h"
+#include "../handle-pool.h"
+#include "../spsc-queue.h"
+#include "../latency-histogram.h"
+#include "../avutil/frame.h"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+/**
+ * Micro-benchmarks of the native building blocks, which cannot be measured from Javascript without
+ * measuring the crossing as well. Only built into the nlav_bench target (see binding.gyp), and run by
+ * dist/bench.js. Each returns { iterations, ns, nsPerOp }.
+ */
+
+static uint64_t nlbench_iterations(const Napi::CallbackInfo& info, uint64_t fallback) {
+    if (info.Length() > 0 && info[0].IsNumber())
+        return std::max<int64_t>(1, info[0].As<Napi::Number>().Int64Value());
+
+    return fallback;
+}
+
+static Napi::Object nlbench_result(const Napi::Env &env, uint64_t iterations, std::chrono::steady_clock::duration elapsed) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    auto result = Napi::Object::New(env);
+
+    result.Set("iterations", Napi::Number::New(env, iterations));
+    result.Set("ns", Napi::Number::New(env, ns));
+    result.Set("nsPerOp", Napi::Number::New(env, (double)ns / iterations));
+
+    return result;
+}
+
+/**
+ * Acquire and release a frame from a warm NAVFramePool, as the codec threads do for each output.
+ */
+static Napi::Value nlbench_frame_pool(const Napi::CallbackInfo& info) {
+    uint64_t iterations = nlbench_iterations(info, 1000000);
+    NAVFramePool pool;
+
+    pool.Release(pool.Acquire());
+
+    auto started = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+        pool.Release(pool.Acquire());
+
+    return nlbench_result(info.Env(), iterations, std::chrono::steady_clock::now() - started);
+}
+
+/**
+ * Look up the instance wrapping a handle which already has one, the common case of FromHandle().
+ */
+static Napi::Value nlbench_resource_lookup(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    uint64_t iterations = nlbench_iterations(info, 1000000);
+    auto frame = av_frame_alloc();
+    auto instance = NAVFrame::FromHandle(env, frame, true);
+    auto reference = Napi::Persistent(instance->Value());
+    bool found = true;
+
+    auto started = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+        found &= NAVFrame::FromHandle(env, frame, true) == instance;
+    auto elapsed = std::chrono::steady_clock::now() - started;
+
+    if (!found) {
+        Napi::Error::New(env, "FromHandle() returned another instance").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    instance->Dispose(env);
+    return nlbench_result(env, iterations, elapsed);
+}
+
+/**
+ * Move items from one thread to another through an SPSCQueue, like the work queue of a codec context.
+ */
+static Napi::Value nlbench_spsc_queue(const Napi::CallbackInfo& info) {
+    uint64_t iterations = nlbench_iterations(info, 1000000);
+    SPSCQueue<uint64_t> queue(1024);
+
+    auto started = std::chrono::steady_clock::now();
+
+    std::thread consumer([&queue, iterations]() {
+        for (uint64_t received = 0; received < iterations; ) {
+            if (!queue.Peek()) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            queue.Pop();
+            ++received;
+        }
+    });
+
+    for (uint64_t i = 0; i < iterations; ) {
+        if (queue.Push(i))
+            ++i;
+        else
+            std::this_thread::yield();
+    }
+
+    consumer.join();
+    return nlbench_result(info.Env(), iterations, std::chrono::steady_clock::now() - started);
+}
+
+/**
+ * Record a sample in a NAVLatencyHistogram, done a few times per frame/packet (see getStats()).
+ */
+static Napi::Value nlbench_histogram(const Napi::CallbackInfo& info) {
+    uint64_t iterations = nlbench_iterations(info, 1000000);
+    NAVLatencyHistogram histogram;
+
+    auto started = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+        histogram.Record(i & 0xffff);
+
+    return nlbench_result(info.Env(), iterations, std::chrono::steady_clock::now() - started);
+}
+
+struct NLBenchCalls {
+    NLBenchCalls(const Napi::Env &env, uint64_t iterations):
+        deferred(Napi::Promise::Deferred::New(env)),
+        iterations(iterations),
+        started(std::chrono::steady_clock::now())
+    {
+    }
+
+    Napi::Promise::Deferred deferred;
+    uint64_t iterations;
+    uint64_t called = 0;
+    std::chrono::steady_clock::time_point started;
+};
+
+/**
+ * Post calls to the JS thread from another thread, the way output is delivered to onFrame/onPacket.
+ * Resolves once the last call has run on the JS thread.
+ */
+static Napi::Value nlbench_thread_safe_function(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    uint64_t iterations = nlbench_iterations(info, 100000);
+    auto calls = std::make_shared<NLBenchCalls>(env, iterations);
+    auto noop = Napi::Function::New(env, [](const Napi::CallbackInfo&) { });
+    auto tsfn = Napi::ThreadSafeFunction::New(env, noop, "bench#threadSafeFunction", 0, 1);
+
+    std::thread([tsfn, calls]() mutable {
+        for (uint64_t i = 0; i < calls->iterations; ++i) {
+            tsfn.BlockingCall([calls](Napi::Env env, Napi::Function) {
+                if (++calls->called == calls->iterations)
+                    calls->deferred.Resolve(nlbench_result(env, calls->iterations, std::chrono::steady_clock::now() - calls->started));
+            });
+        }
+
+        tsfn.Release();
+    }).detach();
+
+    return calls->deferred.Promise();
+}
+
+void nlbench_init(Napi::Env env, Napi::Object exports) {
+    auto bench = Napi::Object::New(env);
+
+    bench.Set("framePool", Napi::Function::New(env, nlbench_frame_pool, "framePool"));
+    bench.Set("resourceLookup", Napi::Function::New(env, nlbench_resource_lookup, "resourceLookup"));
+    bench.Set("spscQueue", Napi::Function::New(env, nlbench_spsc_queue, "spscQueue"));
+    bench.Set("histogram", Napi::Function::New(env, nlbench_histogram, "histogram"));
+    bench.Set("threadSafeFunction", Napi::Function::New(env, nlbench_thread_safe_function, "threadSafeFunction"));
+
+    exports.Set("bench", bench);
+}
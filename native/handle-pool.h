@@ -0,0 +1,104 @@
+#ifndef __NLAV_HANDLE_POOL_H__
+#   define __NLAV_HANDLE_POOL_H__
+
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+
+extern "C" {
+    #include <libavutil/frame.h>
+    #include <libavcodec/packet.h>
+}
+
+/**
+ * Number of idle handles a HandlePool keeps beyond the number of handles currently in use.
+ */
+#define NLAV_HANDLE_POOL_SLACK 4
+
+/**
+ * Thread-safe pool of reusable libav handles (AVFrame, AVPacket) which are allocated with Alloc(),
+ * reset with Unref() and destroyed with Free(), for example av_frame_alloc/av_frame_unref/av_frame_free.
+ *
+ * Acquire() and Release() may be called from any thread. Handles may be released after the owner of
+ * the pool has gone away (for instance a frame that is finalized after its codec context), so pools
+ * are shared via std::shared_ptr by everything that holds a handle from it.
+ */
+template <typename T, T *(*Alloc)(), void (*Unref)(T*), void (*Free)(T**)>
+class HandlePool {
+    public:
+        HandlePool():
+            outstanding(0),
+            hits(0),
+            misses(0)
+        {
+        }
+
+        ~HandlePool() {
+            for (auto handle : idle)
+                Free(&handle);
+        }
+
+        /**
+         * Take a handle from the pool, allocating a new one only if no idle handle is available.
+         */
+        T *Acquire() {
+            std::unique_lock<std::mutex> lock(mutex);
+            outstanding += 1;
+
+            if (idle.empty()) {
+                lock.unlock();
+                misses += 1;
+                return Alloc();
+            }
+
+            auto handle = idle.back();
+            idle.pop_back();
+            hits += 1;
+
+            return handle;
+        }
+
+        /**
+         * Unreference the given handle and return it to the pool. If the pool already holds more idle
+         * handles than it is likely to need, the handle is freed instead.
+         */
+        void Release(T *handle) {
+            if (!handle)
+                return;
+
+            Unref(handle);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            if (outstanding > 0)
+                outstanding -= 1;
+
+            if (idle.size() >= outstanding + NLAV_HANDLE_POOL_SLACK) {
+                lock.unlock();
+                Free(&handle);
+                return;
+            }
+
+            idle.push_back(handle);
+        }
+
+        uint64_t Hits() const { return hits.load(); }
+        uint64_t Misses() const { return misses.load(); }
+
+        size_t Idle() {
+            std::unique_lock<std::mutex> lock(mutex);
+            return idle.size();
+        }
+
+    private:
+        std::mutex mutex;
+        std::vector<T*> idle;
+        size_t outstanding;
+        std::atomic<uint64_t> hits;
+        std::atomic<uint64_t> misses;
+};
+
+typedef HandlePool<AVFrame, av_frame_alloc, av_frame_unref, av_frame_free> NAVFramePool;
+typedef HandlePool<AVPacket, av_packet_alloc, av_packet_unref, av_packet_free> NAVPacketPool;
+
+#endif // #ifndef __NLAV_HANDLE_POOL_H__
@@ -84,7 +84,7 @@ static inline T *assert_valid(T *ptr) {
 
 template <typename T>
 std::function<Napi::Number(T)> WrapNumbers(Napi::Env env) {
-    return [&](T t) { return Napi::Number::New(env, t); };
+    return [=](T t) { return Napi::Number::New(env, t); };
 }
 
 #endif // #ifndef __HELPERS_H__
\ No newline at end of file
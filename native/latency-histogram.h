@@ -0,0 +1,114 @@
+#ifndef __NLAV_LATENCY_HISTOGRAM_H__
+#   define __NLAV_LATENCY_HISTOGRAM_H__
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+/**
+ * Number of buckets of a NAVLatencyHistogram: 4 per power of two, up to 2^40 microseconds.
+ */
+#define NLAV_HISTOGRAM_BUCKETS 160
+
+/**
+ * Fixed-size histogram of durations in microseconds, for percentiles without keeping the samples.
+ * Buckets are a quarter of a power of two wide, so percentiles are at most 25% above the actual value.
+ *
+ * Record() is lock-free and may be called from any thread. The readers may run concurrently with it,
+ * in which case they see most (but maybe not all) of the samples being recorded meanwhile.
+ */
+class NAVLatencyHistogram {
+    public:
+        NAVLatencyHistogram():
+            count(0),
+            sum(0),
+            max(0)
+        {
+            for (auto &bucket : buckets)
+                bucket.store(0, std::memory_order_relaxed);
+        }
+
+        void Record(uint64_t us) {
+            buckets[Bucket(us)].fetch_add(1, std::memory_order_relaxed);
+            count.fetch_add(1, std::memory_order_relaxed);
+            sum.fetch_add(us, std::memory_order_relaxed);
+
+            uint64_t current = max.load(std::memory_order_relaxed);
+            while (us > current && !max.compare_exchange_weak(current, us, std::memory_order_relaxed));
+        }
+
+        /**
+         * Record the time since the given point.
+         */
+        void RecordSince(std::chrono::steady_clock::time_point start) {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            Record(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        }
+
+        uint64_t Count() const { return count.load(std::memory_order_relaxed); }
+        uint64_t Max() const { return max.load(std::memory_order_relaxed); }
+
+        double Mean() const {
+            uint64_t samples = Count();
+            return samples ? (double)sum.load(std::memory_order_relaxed) / samples : 0;
+        }
+
+        /**
+         * The duration which the given fraction (0 to 1) of the samples did not exceed, 0 without samples.
+         */
+        uint64_t Percentile(double fraction) const {
+            uint64_t counts[NLAV_HISTOGRAM_BUCKETS];
+            uint64_t total = 0;
+
+            for (int i = 0; i < NLAV_HISTOGRAM_BUCKETS; ++i)
+                total += (counts[i] = buckets[i].load(std::memory_order_relaxed));
+
+            if (total == 0)
+                return 0;
+
+            uint64_t rank = (uint64_t)(fraction * total + 0.5);
+            if (rank < 1)
+                rank = 1;
+
+            uint64_t seen = 0;
+            for (int i = 0; i < NLAV_HISTOGRAM_BUCKETS; ++i) {
+                seen += counts[i];
+                if (seen >= rank) {
+                    // The last bucket also holds everything beyond it
+                    uint64_t upper = i < NLAV_HISTOGRAM_BUCKETS - 1 ? UpperBound(i) : Max();
+                    return upper < Max() ? upper : Max();
+                }
+            }
+
+            return Max();
+        }
+
+    private:
+        static int Bucket(uint64_t us) {
+            if (us < 4)
+                return (int)us;
+
+            int log2 = 2;
+            while (log2 < 63 && (us >> (log2 + 1)))
+                ++log2;
+
+            int bucket = 4 * (log2 - 1) + (int)((us >> (log2 - 2)) & 3);
+
+            return bucket < NLAV_HISTOGRAM_BUCKETS ? bucket : NLAV_HISTOGRAM_BUCKETS - 1;
+        }
+
+        static uint64_t UpperBound(int bucket) {
+            if (bucket < 4)
+                return bucket;
+
+            int log2 = bucket / 4 + 1;
+            return ((uint64_t)(5 + bucket % 4) << (log2 - 2)) - 1;
+        }
+
+        std::atomic<uint64_t> buckets[NLAV_HISTOGRAM_BUCKETS];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+};
+
+#endif // #ifndef __NLAV_LATENCY_HISTOGRAM_H__
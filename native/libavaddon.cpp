@@ -1,19 +1,65 @@
 #include "libavaddon.h"
 #include "avutil/index.h"
 #include "avcodec/index.h"
+#include "avfilter/index.h"
+#include "avformat/index.h"
+#include "swresample/index.h"
+#include "swscale/index.h"
 
-LibAvAddon::LibAvAddon(Napi::Env env, Napi::Object exports) {
+#ifdef NLAV_BENCH
+#include "bench/index.h"
+#endif
+
+#include <atomic>
+
+uint32_t nlav_allocate_resource_type() {
+    static std::atomic<uint32_t> next(0);
+    return next++;
+}
+
+LibAvAddon::LibAvAddon(Napi::Env env, Napi::Object exports):
+    releaseQueue(std::make_shared<NAVReleaseQueue>(std::this_thread::get_id()))
+{
 
     // This will be done later for us, but we want to access it during initialization phase.
     env.SetInstanceData<LibAvAddon>(this);
 
+    // Drains the release queue as soon as another thread has pushed onto it, without keeping the event
+    // loop alive. Node closes the function as the env is torn down, which clears the wake.
+    auto queue = releaseQueue;
+    auto noop = Napi::Function::New(env, [](const Napi::CallbackInfo&) { });
+    auto releaseTSFN = Napi::ThreadSafeFunction::New(env, noop, "LibAvAddon#releases", 0, 1, [queue](Napi::Env) {
+        queue->SetWake(nullptr);
+    });
+    releaseTSFN.Unref(env);
+
+    releaseQueue->SetWake([queue, releaseTSFN]() {
+        releaseTSFN.NonBlockingCall([queue](Napi::Env, Napi::Function) {
+            queue->Drain();
+        });
+    });
+
     // Modules
     nlavu_init(env, exports);
     nlavc_init(env, exports);
+    nlavf_init(env, exports);
+    nlavfi_init(env, exports);
+    nlswr_init(env, exports);
+    nlsws_init(env, exports);
+
+    // Only in the nlav_bench target (see binding.gyp)
+#ifdef NLAV_BENCH
+    nlbench_init(env, exports);
+#endif
 
     DefineAddon(exports, {});
 }
 
+LibAvAddon::~LibAvAddon() {
+    // Operations still on their way from other threads would release references of this env
+    releaseQueue->Close();
+}
+
 LibAvAddon *LibAvAddon::Self(const Napi::Env &env) {
     return ((Napi::Env &)env).GetInstanceData<LibAvAddon>();
 }
@@ -22,4 +68,38 @@ LibAvAddon *LibAvAddon::Self(const Napi::CallbackInfo &call) {
     return Self(call.Env());
 }
 
+void LibAvAddon::DeferRelease(std::function<void()> release) {
+    releaseQueue->Defer(release);
+}
+
+void LibAvAddon::FlushDeferredReleases() {
+    if (releaseQueue->Pending())
+        releaseQueue->Drain();
+}
+
+Napi::Value LibAvAddon::GetCached(const void *handle, const char *key, const std::function<Napi::Value()> &build) {
+    auto id = std::make_pair(handle, std::string(key));
+    auto iter = cache.find(id);
+
+    if (iter != cache.end())
+        return iter->second.Value();
+    
+    auto value = build();
+    if (value.IsObject())
+        cache[id] = Napi::Persistent(value.As<Napi::Object>());
+    
+    return value;
+}
+
+Napi::Object LibAvAddon::GetLiveResourceCounts(const Napi::Env &env) {
+    auto counts = Napi::Object::New(env);
+
+    for (auto &type : resourceTypes) {
+        if (!type.name.empty())
+            counts.Set(type.name, Napi::Number::New(env, type.live));
+    }
+
+    return counts;
+}
+
 NODE_API_ADDON(LibAvAddon)
\ No newline at end of file
@@ -5,12 +5,27 @@
 #include "helpers.h"
 #include <napi.h>
 #include <map>
+#include <vector>
+#include <string>
 #include <assert.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <functional>
+#include <utility>
+#include "resource-map.h"
+#include "release-queue.h"
+
+/**
+ * Returns a new, process-wide unique index for a resource type. See LibAvAddon::ResourceType().
+ */
+uint32_t nlav_allocate_resource_type();
 
 class LibAvAddon : public Napi::Addon<LibAvAddon>
 {
 public:
     LibAvAddon(Napi::Env env, Napi::Object exports);
+    ~LibAvAddon();
     static LibAvAddon *Self(const Napi::Env &env);
     static LibAvAddon *Self(const Napi::CallbackInfo &call);
 
@@ -20,23 +35,63 @@ public:
 
     template <class ResourceT, class HandleT>
     ResourceT *GetResource(const HandleT *handle) {
-         auto iter = resourceMap.find((void*)handle);
-         if (iter == resourceMap.end())
+        auto entry = resourceMap.Find(handle);
+        if (!entry)
             return nullptr;
         
-        return (ResourceT*) (*iter).second;
+        return (ResourceT*) entry->value;
     }
 
     template <class ResourceT, class HandleT>
     void RegisterResource(const HandleT *handle, const ResourceT *resource) {
-        resourceMap[(void*)handle] = (void*)resource;
+        ResourceMap::Entry replaced;
+        uint32_t type = ResourceType<ResourceT>();
+
+        if (resourceMap.Insert(handle, (void*)resource, type, &replaced))
+            resourceTypes[replaced.type].live -= 1;
+        resourceTypes[type].live += 1;
     }
 
     template <class HandleT>
     void UnregisterResource(const HandleT *handle) {
-        resourceMap.erase((void*)handle);
+        ResourceMap::Entry removed;
+        if (resourceMap.Erase(handle, &removed))
+            resourceTypes[removed.type].live -= 1;
     }
 
+    /**
+     * Number of live (registered) resources of each type, keyed by export name. Useful for finding leaks.
+     */
+    Napi::Object GetLiveResourceCounts(const Napi::Env &env);
+
+    /**
+     * Run the given release operation (typically deleting a reference to a JS value) on this env's 
+     * thread. libav may drop the last reference to a buffer from any thread (codec threads in particular),
+     * but JS references may only be touched on the thread that owns them. When called from the env's 
+     * thread, the operation runs immediately, otherwise it runs once the env's thread gets to it (or at
+     * the next FlushDeferredReleases(), if that comes first).
+     * May be called from any thread.
+     */
+    void DeferRelease(std::function<void()> release);
+
+    /**
+     * The queue behind DeferRelease(), for callbacks which may run after this env is gone (see 
+     * NAVReleaseQueue). Any thread.
+     */
+    inline std::shared_ptr<NAVReleaseQueue> GetReleaseQueue() { return releaseQueue; }
+
+    /**
+     * Run all release operations queued by DeferRelease() from other threads. JS thread only.
+     */
+    void FlushDeferredReleases();
+
+    /**
+     * A value built once per env from data libav never changes (codecs and their format/profile lists),
+     * so that looking it up again does not build it again. Keyed by the handle it describes and what it
+     * is about. Only objects are kept, anything else is built every time. JS thread only.
+     */
+    Napi::Value GetCached(const void *handle, const char *key, const std::function<Napi::Value()> &build);
+
     inline Napi::FunctionReference *GetConstructor(std::string name) {
         auto iter = constructorMap.find(name);
         if (iter == constructorMap.end())
@@ -86,8 +141,29 @@ public:
     }
     
 private: 
-    std::map<void*, void*> resourceMap;
+    struct ResourceTypeInfo {
+        std::string name;
+        int64_t live;
+    };
+
+    ResourceMap resourceMap;
+    std::vector<ResourceTypeInfo> resourceTypes;
     std::map<std::string, Napi::FunctionReference*> constructorMap;
+    std::map<std::pair<const void*, std::string>, Napi::ObjectReference> cache;
+
+    std::shared_ptr<NAVReleaseQueue> releaseQueue;
+
+    template <class ResourceT>
+    uint32_t ResourceType() {
+        static const uint32_t index = nlav_allocate_resource_type();
+
+        if (index >= resourceTypes.size())
+            resourceTypes.resize(index + 1, ResourceTypeInfo { "", 0 });
+        if (resourceTypes[index].name.empty())
+            resourceTypes[index].name = ResourceT::ExportName();
+        
+        return index;
+    }
 };
 
 #endif // __NLAV_LIBAV_H
\ No newline at end of file
@@ -0,0 +1,133 @@
+#ifndef __NLAV_RELEASE_QUEUE_H__
+#   define __NLAV_RELEASE_QUEUE_H__
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * Lock-free multiple-producer/single-consumer queue of release operations for an env (see 
+ * LibAvAddon::DeferRelease()). Any thread may Defer()/Push(), only the env's thread may Drain().
+ *
+ * Producers push onto an intrusive stack with a compare-and-swap. The consumer takes the whole stack at 
+ * once with an exchange (so there is no ABA problem) and runs it in the order it was pushed.
+ *
+ * libav callbacks may run after the env they came from is gone (a worker thread which exited while a 
+ * codec thread still held a buffer), so the queue is shared by std::shared_ptr with everything that 
+ * pushes onto it. Once the env is gone, Close() drops what is queued and anything pushed afterwards: the
+ * references those operations would release died with the env.
+ *
+ * A push onto an empty queue calls the wake function (see SetWake()), which has the env's thread drain
+ * it. Pushes onto a non-empty queue do not, the drain that is already coming takes them along.
+ */
+class NAVReleaseQueue {
+    public:
+        NAVReleaseQueue(std::thread::id owner):
+            owner(owner),
+            head(nullptr),
+            closed(false)
+        {
+        }
+
+        ~NAVReleaseQueue() {
+            Discard(head.exchange(nullptr));
+        }
+
+        /**
+         * Run the given operation right away on the env's thread, queue it on any other.
+         */
+        void Defer(std::function<void()> release) {
+            if (std::this_thread::get_id() == owner && !closed.load(std::memory_order_relaxed))
+                release();
+            else
+                Push(release);
+        }
+
+        void Push(std::function<void()> release) {
+            if (closed.load(std::memory_order_acquire))
+                return;
+            
+            auto node = new Node { release, head.load(std::memory_order_relaxed) };
+            while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
+
+            if (!node->next)
+                Wake();
+        }
+
+        /**
+         * Set the function which gets the queue drained on the env's thread, or none. The function is
+         * called under a lock, so it is not running anymore once this returns. Env thread only.
+         */
+        void SetWake(std::function<void()> wake) {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            this->wake = wake;
+        }
+
+        /**
+         * Whether there are operations to run. A snapshot when called concurrently with Push().
+         */
+        bool Pending() {
+            return head.load(std::memory_order_relaxed) != nullptr;
+        }
+
+        /**
+         * Run the queued operations, oldest first. Env thread only.
+         */
+        void Drain() {
+            Node *node = head.exchange(nullptr, std::memory_order_acquire);
+            Node *reversed = nullptr;
+
+            while (node) {
+                Node *next = node->next;
+                node->next = reversed;
+                reversed = node;
+                node = next;
+            }
+
+            while (reversed) {
+                Node *next = reversed->next;
+                reversed->release();
+                delete reversed;
+                reversed = next;
+            }
+        }
+
+        /**
+         * Drop the queued operations without running them, and refuse new ones. Env thread only, as it is
+         * torn down.
+         */
+        void Close() {
+            closed.store(true, std::memory_order_release);
+            SetWake(nullptr);
+            Discard(head.exchange(nullptr, std::memory_order_acquire));
+        }
+
+    private:
+        struct Node {
+            std::function<void()> release;
+            Node *next;
+        };
+
+        void Wake() {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            if (wake)
+                wake();
+        }
+
+        static void Discard(Node *node) {
+            while (node) {
+                Node *next = node->next;
+                delete node;
+                node = next;
+            }
+        }
+
+        std::thread::id owner;
+        std::atomic<Node*> head;
+        std::atomic<bool> closed;
+        std::mutex wakeMutex;
+        std::function<void()> wake;
+};
+
+#endif // #ifndef __NLAV_RELEASE_QUEUE_H__
@@ -0,0 +1,165 @@
+#ifndef __NLAV_RESOURCE_MAP_H__
+#   define __NLAV_RESOURCE_MAP_H__
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Initial number of slots in a ResourceMap. The map only allocates when it grows beyond half of its
+ * capacity, so this should comfortably cover the live resources of a typical process.
+ */
+#define NLAV_RESOURCE_MAP_INITIAL_CAPACITY 4096
+
+/**
+ * Open-addressing (linear probing) hash table mapping native handles to the resource instances which
+ * wrap them. Used by LibAvAddon as the resource registry.
+ *
+ * Inserting and removing entries never allocates unless the table needs to grow, and removal uses
+ * backward-shift deletion so that no tombstones accumulate. Each entry also records the index of the
+ * resource's type (see LibAvAddon::RegisterResource) so that live resources can be counted by type.
+ *
+ * Not thread-safe: a ResourceMap belongs to a single env.
+ */
+class ResourceMap {
+    public:
+        struct Entry {
+            const void *key;
+            void *value;
+            uint32_t type;
+        };
+
+        ResourceMap(size_t capacity = NLAV_RESOURCE_MAP_INITIAL_CAPACITY):
+            count(0)
+        {
+            size_t size = 16;
+            while (size < capacity)
+                size <<= 1;
+
+            slots = std::vector<Entry>(size, Entry { nullptr, nullptr, 0 });
+            mask = size - 1;
+        }
+
+        /**
+         * Find the entry for the given key, or nullptr if there is none.
+         */
+        Entry *Find(const void *key) {
+            if (!key)
+                return nullptr;
+
+            for (size_t index = IndexOf(key); ; index = (index + 1) & mask) {
+                Entry &entry = slots[index];
+                if (entry.key == key)
+                    return &entry;
+                if (!entry.key)
+                    return nullptr;
+            }
+        }
+
+        /**
+         * Associate the given key with the given value, replacing any existing association. Returns
+         * the entry which was replaced (its previous contents) through `replaced`, if any.
+         */
+        bool Insert(const void *key, void *value, uint32_t type, Entry *replaced = nullptr) {
+            if (!key)
+                return false;
+
+            if ((count + 1) * 2 > slots.size())
+                Grow();
+
+            for (size_t index = IndexOf(key); ; index = (index + 1) & mask) {
+                Entry &entry = slots[index];
+
+                if (entry.key == key) {
+                    if (replaced)
+                        *replaced = entry;
+                    entry.value = value;
+                    entry.type = type;
+                    return true;
+                }
+
+                if (!entry.key) {
+                    entry = Entry { key, value, type };
+                    count += 1;
+                    return false;
+                }
+            }
+        }
+
+        /**
+         * Remove the entry for the given key. Returns false if there was none, otherwise the removed
+         * entry is provided through `removed`.
+         */
+        bool Erase(const void *key, Entry *removed = nullptr) {
+            Entry *entry = Find(key);
+            if (!entry)
+                return false;
+
+            if (removed)
+                *removed = *entry;
+
+            // Backward-shift deletion: move later members of the probe sequence into the hole for as
+            // long as that brings them closer to their home slot.
+
+            size_t hole = entry - &slots[0];
+            size_t index = hole;
+
+            while (true) {
+                index = (index + 1) & mask;
+                Entry &candidate = slots[index];
+
+                if (!candidate.key)
+                    break;
+
+                size_t home = IndexOf(candidate.key);
+                bool movable = hole <= index
+                    ? (home <= hole || home > index)
+                    : (home <= hole && home > index);
+
+                if (movable) {
+                    slots[hole] = candidate;
+                    hole = index;
+                }
+            }
+
+            slots[hole] = Entry { nullptr, nullptr, 0 };
+            count -= 1;
+            return true;
+        }
+
+        size_t Size() const {
+            return count;
+        }
+
+        size_t Capacity() const {
+            return slots.size();
+        }
+
+    private:
+        std::vector<Entry> slots;
+        size_t mask;
+        size_t count;
+
+        size_t IndexOf(const void *key) const {
+            // Handles are heap pointers, so the low bits carry little information. Fibonacci hashing
+            // spreads the remaining bits over the table.
+            uint64_t hash = ((uint64_t)(uintptr_t)key >> 4) * 11400714819323198485ull;
+            return (size_t)(hash >> 32) & mask;
+        }
+
+        void Grow() {
+            std::vector<Entry> old;
+            old.swap(slots);
+
+            slots = std::vector<Entry>(old.size() * 2, Entry { nullptr, nullptr, 0 });
+            mask = slots.size() - 1;
+            count = 0;
+
+            for (auto &entry : old) {
+                if (entry.key)
+                    Insert(entry.key, entry.value, entry.type);
+            }
+        }
+};
+
+#endif // #ifndef __NLAV_RESOURCE_MAP_H__
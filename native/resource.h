@@ -2,12 +2,23 @@
 #   define __RESOURCE_H__
 
 #include <napi.h>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
 #include "libavaddon.h"
 
-#define R_GETTER(name, getter) InstanceAccessor((name), (getter), nullptr)
-#define R_SETTER(name, setter) InstanceAccessor((name), nullptr, (setter))
-#define R_ACCESSOR(name, getter, setter) InstanceAccessor((name), (getter), (setter))
-#define R_METHOD(name, impl) InstanceMethod<impl>((name))
+/**
+ * Property/method definitions for use in ClassDefinition(). These are routed through NAVResource's 
+ * guards so that they throw (instead of touching a freed handle) once the resource has been disposed.
+ * Properties are also recorded in the class's property table, which backs ApplyProperties() and 
+ * ReadProperties().
+ */
+#define R_GETTER(name, getter) DefineProperty((name), GuardGetter<getter>(), nullptr, getter, nullptr)
+#define R_SETTER(name, setter) DefineProperty((name), nullptr, GuardSetter<setter>(), nullptr, setter)
+#define R_ACCESSOR(name, getter, setter) DefineProperty((name), GuardGetter<getter>(), GuardSetter<setter>(), getter, setter)
+#define R_METHOD(name, impl) InstanceMethod((name), GuardGetter<impl>())
 
 /**
  * The default implementation of GetRegisterableHandle when a more specific one is not provided.
@@ -36,6 +47,9 @@ template<class SelfT, class HandleT, void *(*GetRegisterableHandle)(void *) = De
 class NAVResource : public Napi::ObjectWrap<SelfT> {
 
     public:
+        typedef Napi::Value (SelfT::*GetterCallback)(const Napi::CallbackInfo&);
+        typedef void (SelfT::*SetterCallback)(const Napi::CallbackInfo&, const Napi::Value&);
+
         NAVResource(const Napi::CallbackInfo& info):
             Napi::ObjectWrap<SelfT>(info)
         {
@@ -55,6 +69,7 @@ class NAVResource : public Napi::ObjectWrap<SelfT> {
 
                 if (handle) {
                     RegisterResource(info.Env());
+                    UpdateExternalMemory(info.Env());
                 }
 
                 return true;
@@ -64,12 +79,52 @@ class NAVResource : public Napi::ObjectWrap<SelfT> {
         }
 
         static void Register(Napi::Env env, Napi::Object exports) {
-            Napi::Function ctor = SelfT::ClassDefinition(env);
+            Napi::Function ctor = DefineClassOnce(env);
             std::string exportName = SelfT::ExportName();
 
             LibAvAddon::Self(env)->RegisterConstructor(exportName, ctor);
             exports.Set(exportName, ctor);
+
+            // dispose() is common to all resources, so it is defined here instead of in each ClassDefinition()
+
+            auto prototype = ctor.Get("prototype").As<Napi::Object>();
+            auto dispose = Napi::Function::New(env, &NAVResource::DisposeMethod, "dispose");
+            auto disposeSymbol = env.Global().Get("Symbol").As<Napi::Object>().Get("dispose");
+
+            prototype.Set("dispose", dispose);
+            if (disposeSymbol.IsSymbol())
+                prototype.Set(disposeSymbol, dispose);
+        }
+
+        /**
+         * Release the handle now instead of waiting for the garbage collector. The handle is disassociated 
+         * from the resource map and Free() is called, after which all properties and methods of the instance 
+         * throw. Disposing more than once has no effect.
+         */
+        void Dispose(const Napi::Env &env) {
+            if (disposed)
+                return;
             
+            disposed = true;
+            if (this->handle) {
+                LibAvAddon::Self(env)->UnregisterResource(GetRegisterableHandle((void*)handle));
+                Free();
+            }
+
+            ReleaseExternalMemory(env);
+        }
+
+        bool IsDisposed() {
+            return disposed;
+        }
+
+        /**
+         * Throw (and return false) if the resource cannot be disposed of right now, such as while a worker 
+         * thread is using its handle. Checked by dispose(). Resources describing static libav data (which 
+         * are shared through LibAvAddon::GetCached()) return false without throwing, making dispose() a no-op.
+         */
+        virtual bool CheckDisposable(const Napi::Env &env) {
+            return true;
         }
 
         /**
@@ -79,10 +134,15 @@ class NAVResource : public Napi::ObjectWrap<SelfT> {
          * subclass represents)
          */
         virtual void Finalize(Napi::Env env) {
+            if (disposed)
+                return;
+            
             if (this->handle) {
                 LibAvAddon::Self(env)->UnregisterResource(GetRegisterableHandle((void*)handle));
                 Free();
             }
+
+            ReleaseExternalMemory(env);
         }
 
         /**
@@ -109,6 +169,29 @@ class NAVResource : public Napi::ObjectWrap<SelfT> {
             // Do nothing by default.
         }
 
+        /**
+         * The number of bytes of native memory kept alive by the current handle, reported to V8 so that 
+         * garbage collection pressure reflects the real cost of the instance (a 4K frame is tiny in JS terms,
+         * but holds megabytes of pixel data). Zero by default.
+         */
+        virtual size_t GetExternalMemorySize() {
+            return 0;
+        }
+
+        /**
+         * Report any change in GetExternalMemorySize() to V8. This happens whenever the handle changes; 
+         * subclasses must also call it after operations which change the memory held by the same handle
+         * (for instance allocating the buffers of a frame).
+         */
+        void UpdateExternalMemory(const Napi::Env &env) {
+            int64_t size = (handle && !disposed) ? (int64_t)GetExternalMemorySize() : 0;
+
+            if (size != externalMemory) {
+                Napi::MemoryManagement::AdjustExternalMemory(env, size - externalMemory);
+                externalMemory = size;
+            }
+        }
+
         /**
          * Acquire an instance of the subclass given a specific native handle that it should hold.
          * If an existing instance exists in the addon's resource map, it will be returned. If 
@@ -164,6 +247,28 @@ class NAVResource : public Napi::ObjectWrap<SelfT> {
             return array;
         }
 
+        /**
+         * Unwrap a value passed as an argument, which must be an instance of this class. Throws (and returns 
+         * nullptr) if it is not one, or if it has been disposed: the guards only cover the instance's own 
+         * properties and methods, not its use as an argument of another's.
+         */
+        static SelfT *UnwrapArgument(const Napi::Env &env, const Napi::Value &value) {
+            auto ctor = LibAvAddon::Self(env)->GetConstructor(SelfT::ExportName())->Value();
+
+            if (!value.IsObject() || !value.As<Napi::Object>().InstanceOf(ctor)) {
+                Napi::TypeError::New(env, "Expected an instance of " + SelfT::ExportName()).ThrowAsJavaScriptException();
+                return nullptr;
+            }
+
+            auto instance = SelfT::Unwrap(value.As<Napi::Object>());
+            if (!instance || instance->IsDisposed() || !instance->GetHandle()) {
+                Napi::Error::New(env, "The given " + SelfT::ExportName() + " has been disposed").ThrowAsJavaScriptException();
+                return nullptr;
+            }
+
+            return instance;
+        }
+
         HandleT *GetHandle() {
             return handle;
         }
@@ -181,10 +286,235 @@ class NAVResource : public Napi::ObjectWrap<SelfT> {
             UnregisterResource(this->Env());
             this->handle = handle;
             RegisterResource(this->Env());
+            UpdateExternalMemory(this->Env());
+        }
+
+    protected:
+        /**
+         * Apply every own enumerable property of the given object (info[0]) using the setters defined in
+         * ClassDefinition(), in a single call from Javascript. All names are checked before any setter runs,
+         * so an unknown or read-only property leaves the instance untouched. Returns undefined.
+         */
+        Napi::Value ApplyProperties(const Napi::CallbackInfo &info) {
+            auto env = info.Env();
+
+            if (info.Length() < 1 || !info[0].IsObject()) {
+                Napi::TypeError::New(env, "Expected an object of properties").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+
+            auto object = info[0].As<Napi::Object>();
+            auto names = object.GetPropertyNames();
+            std::vector<std::string> keys;
+            std::vector<SetterCallback> setters;
+
+            keys.reserve(names.Length());
+            for (uint32_t i = 0, max = names.Length(); i < max; ++i)
+                keys.push_back(names.Get(i).ToString().Utf8Value());
+
+            if (FindSetters(env, keys, setters))
+                ApplySetters(info, object, keys, setters);
+
+            return env.Undefined();
+        }
+
+    public:
+        /**
+         * Look up the setters of the named properties (see ApplyProperties()), throwing if one is unknown or
+         * read-only. Returns false in that case. Lets a set of properties be checked once, then applied to 
+         * many instances with ApplySetters() (see AVCodecContextTemplate).
+         */
+        static bool FindSetters(const Napi::Env &env, const std::vector<std::string> &names, std::vector<SetterCallback> &setters) {
+            auto &table = PropertyTable();
+
+            setters.clear();
+            setters.reserve(names.size());
+            for (auto &name : names) {
+                auto entry = table.find(name);
+
+                if (entry == table.end()) {
+                    Napi::TypeError::New(env, "Unknown property '" + name + "' of " + SelfT::ExportName()).ThrowAsJavaScriptException();
+                    return false;
+                }
+
+                if (!entry->second.setter) {
+                    Napi::TypeError::New(env, "Property '" + name + "' of " + SelfT::ExportName() + " is read-only").ThrowAsJavaScriptException();
+                    return false;
+                }
+
+                setters.push_back(entry->second.setter);
+            }
+
+            return true;
+        }
+
+        /**
+         * Set the named properties to their values in object, with the setters FindSetters() found for them.
+         * Stops at the first setter which throws.
+         */
+        void ApplySetters(
+            const Napi::CallbackInfo &info, const Napi::Object &object, 
+            const std::vector<std::string> &names, const std::vector<SetterCallback> &setters
+        ) {
+            auto env = info.Env();
+
+            for (size_t i = 0, max = names.size(); i < max; ++i) {
+                (static_cast<SelfT*>(this)->*setters[i])(info, object.Get(names[i]));
+                if (env.IsExceptionPending())
+                    break;
+            }
+        }
+
+    protected:
+        /**
+         * Read the named properties (the array in info[0], or the given defaults when it is omitted) 
+         * using the getters defined in ClassDefinition(), and return them as a single object. 
+         */
+        Napi::Value ReadProperties(const Napi::CallbackInfo &info, const std::vector<std::string> &defaults) {
+            auto env = info.Env();
+            auto &table = PropertyTable();
+            auto result = Napi::Object::New(env);
+            std::vector<std::string> names;
+
+            if (info.Length() >= 1 && info[0].IsArray()) {
+                auto array = info[0].As<Napi::Array>();
+                for (uint32_t i = 0, max = array.Length(); i < max; ++i)
+                    names.push_back(array.Get(i).ToString().Utf8Value());
+            } else if (info.Length() >= 1 && !info[0].IsUndefined()) {
+                Napi::TypeError::New(env, "Expected an array of property names").ThrowAsJavaScriptException();
+                return env.Undefined();
+            } else {
+                names = defaults;
+            }
+
+            for (auto &name : names) {
+                auto entry = table.find(name);
+
+                if (entry == table.end() || !entry->second.getter) {
+                    Napi::TypeError::New(env, "Unknown property '" + name + "' of " + SelfT::ExportName()).ThrowAsJavaScriptException();
+                    return env.Undefined();
+                }
+
+                auto value = (static_cast<SelfT*>(this)->*entry->second.getter)(info);
+                if (env.IsExceptionPending())
+                    return env.Undefined();
+                
+                result.Set(name, value);
+            }
+
+            return result;
+        }
+
+        /**
+         * Define an instance accessor (see R_ACCESSOR) and record its unguarded getter and setter in the 
+         * property table when the class is defined for the first time.
+         */
+        static typename Napi::ObjectWrap<SelfT>::PropertyDescriptor DefineProperty(
+            const char *name, 
+            GetterCallback guardedGetter, SetterCallback guardedSetter,
+            GetterCallback getter, SetterCallback setter
+        ) {
+            if (!PropertyTableReady().load(std::memory_order_relaxed))
+                PropertyTable()[name] = PropertyAccessors { getter, setter };
+            
+            return NAVResource::InstanceAccessor(name, guardedGetter, guardedSetter);
+        }
+
+        template <GetterCallback Method>
+        static GetterCallback GuardGetter() {
+            return static_cast<GetterCallback>(&NAVResource::GuardedGetter<Method>);
+        }
+
+        template <SetterCallback Method>
+        static SetterCallback GuardSetter() {
+            if (!Method)
+                return nullptr;
+            
+            return static_cast<SetterCallback>(&NAVResource::GuardedSetter<Method>);
         }
 
     private:
         HandleT *handle = nullptr;
+        bool disposed = false;
+        int64_t externalMemory = 0;
+
+        struct PropertyAccessors {
+            GetterCallback getter;
+            SetterCallback setter;
+        };
+
+        /**
+         * The getters and setters of the class by property name. Filled in by DefineProperty() while the 
+         * class is defined for the first env and never modified afterwards, so it may be read without locking
+         * once the class has been registered.
+         */
+        static std::map<std::string, PropertyAccessors> &PropertyTable() {
+            static std::map<std::string, PropertyAccessors> table;
+            return table;
+        }
+
+        static std::atomic<bool> &PropertyTableReady() {
+            static std::atomic<bool> ready(false);
+            return ready;
+        }
+
+        /**
+         * Call ClassDefinition(), serializing the first definition of the class (which fills in the property
+         * table) with any other env (worker thread) registering the addon at the same time.
+         */
+        static Napi::Function DefineClassOnce(const Napi::Env &env) {
+            if (PropertyTableReady().load(std::memory_order_acquire))
+                return SelfT::ClassDefinition(env);
+            
+            static std::mutex mutex;
+            std::unique_lock<std::mutex> lock(mutex);
+            Napi::Function ctor = SelfT::ClassDefinition(env);
+            PropertyTableReady().store(true, std::memory_order_release);
+
+            return ctor;
+        }
+
+        /**
+         * Throw if this instance has been disposed. Returns false in that case.
+         */
+        bool CheckNotDisposed(const Napi::Env &env) {
+            if (!disposed)
+                return true;
+            
+            Napi::Error::New(env, "This " + SelfT::ExportName() + " has been disposed").ThrowAsJavaScriptException();
+            return false;
+        }
+
+        template <GetterCallback Method>
+        Napi::Value GuardedGetter(const Napi::CallbackInfo &info) {
+            if (!CheckNotDisposed(info.Env()))
+                return info.Env().Undefined();
+            
+            return (static_cast<SelfT*>(this)->*Method)(info);
+        }
+
+        template <SetterCallback Method>
+        void GuardedSetter(const Napi::CallbackInfo &info, const Napi::Value &value) {
+            if (!CheckNotDisposed(info.Env()))
+                return;
+            
+            (static_cast<SelfT*>(this)->*Method)(info, value);
+        }
+
+        static Napi::Value DisposeMethod(const Napi::CallbackInfo &info) {
+            auto self = SelfT::Unwrap(info.This().As<Napi::Object>());
+            if (self && self->CheckDisposable(info.Env()))
+                self->Dispose(info.Env());
+            
+            return info.Env().Undefined();
+        }
+
+        void ReleaseExternalMemory(const Napi::Env &env) {
+            if (externalMemory != 0) {
+                Napi::MemoryManagement::AdjustExternalMemory(env, -externalMemory);
+                externalMemory = 0;
+            }
+        }
 
         /**
          * Register this instance and its handle into the addon's resource map as the 
@@ -196,7 +526,7 @@ class NAVResource : public Napi::ObjectWrap<SelfT> {
             
             LibAvAddon::Self(env)->RegisterResource(
                 GetRegisterableHandle((void*)handle), 
-                this
+                static_cast<SelfT*>(this)
             );
         }
 
@@ -0,0 +1,319 @@
+#include "scheduler.h"
+#include <algorithm>
+
+enum {
+    NLAV_TASK_IDLE = 0,
+    NLAV_TASK_QUEUED,
+    NLAV_TASK_RUNNING,
+    NLAV_TASK_RERUN,
+    NLAV_TASK_REMOVED
+};
+
+static std::mutex sharedMutex;
+static NAVScheduler *sharedScheduler = nullptr;
+static size_t configuredThreads = 0;
+
+// Index of the worker running on this thread, if any
+static thread_local int currentWorker = -1;
+
+NAVScheduler *NAVScheduler::Shared() {
+    std::unique_lock<std::mutex> lock(sharedMutex);
+
+    // Never destroyed: workers may be running tasks until the process exits
+    if (!sharedScheduler)
+        sharedScheduler = new NAVScheduler(configuredThreads);
+
+    return sharedScheduler;
+}
+
+bool NAVScheduler::Configure(size_t threads) {
+    std::unique_lock<std::mutex> lock(sharedMutex);
+
+    if (sharedScheduler)
+        return false;
+
+    configuredThreads = threads;
+    return true;
+}
+
+size_t NAVScheduler::ConfiguredThreads() {
+    std::unique_lock<std::mutex> lock(sharedMutex);
+
+    if (sharedScheduler)
+        return sharedScheduler->workers.size();
+
+    if (configuredThreads > 0)
+        return configuredThreads;
+
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+bool NAVScheduler::Started() {
+    std::unique_lock<std::mutex> lock(sharedMutex);
+    return sharedScheduler != nullptr;
+}
+
+NAVScheduler::NAVScheduler(size_t threads):
+    nextWorker(0),
+    queued(0),
+    started(std::chrono::steady_clock::now()),
+    removers(0)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t i = 0; i < threads; ++i)
+        workers.push_back(new Worker());
+
+    for (size_t i = 0; i < threads; ++i)
+        std::thread([this, i]() { WorkerMain(i); }).detach();
+}
+
+void NAVScheduler::Schedule(NAVScheduledTask *task) {
+    if (MarkScheduled(task))
+        Enqueue(task);
+}
+
+/**
+ * Returns true if the task has become QUEUED, in which case the caller must Enqueue() it.
+ */
+bool NAVScheduler::MarkScheduled(NAVScheduledTask *task) {
+    int state = task->scheduleState.load();
+
+    while (true) {
+        if (state == NLAV_TASK_IDLE) {
+            if (task->scheduleState.compare_exchange_weak(state, NLAV_TASK_QUEUED))
+                return true;
+        } else if (state == NLAV_TASK_RUNNING) {
+            if (task->scheduleState.compare_exchange_weak(state, NLAV_TASK_RERUN))
+                return false;
+        } else {
+            // Already queued, already due to run again, or removed
+            return false;
+        }
+    }
+}
+
+void NAVScheduler::ScheduleAt(NAVScheduledTask *task, std::chrono::steady_clock::time_point when) {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    timers.insert(std::make_pair(when, task));
+    wake.notify_one();
+}
+
+/**
+ * Put a task (which has just become QUEUED) on a deque: the current worker's when called from a
+ * worker, so that follow-up work stays on the same core, otherwise the next one in turn.
+ */
+void NAVScheduler::Enqueue(NAVScheduledTask *task) {
+    size_t index = currentWorker >= 0 ? (size_t)currentWorker : nextWorker++ % workers.size();
+    auto worker = workers[index];
+
+    {
+        std::unique_lock<std::mutex> lock(worker->mutex);
+        worker->tasks.push_back(task);
+    }
+
+    ++queued;
+
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wake.notify_one();
+}
+
+/**
+ * Take the next task for the given worker: from the front of its own deque, or else from the back
+ * of another worker's deque. The task becomes RUNNING while the deque is locked, so that Remove()
+ * either finds it in a deque or sees it running.
+ */
+NAVScheduledTask *NAVScheduler::Take(size_t index) {
+    auto own = workers[index];
+
+    {
+        std::unique_lock<std::mutex> lock(own->mutex);
+        if (!own->tasks.empty()) {
+            auto task = own->tasks.front();
+            own->tasks.pop_front();
+            task->scheduleState = NLAV_TASK_RUNNING;
+            --queued;
+            return task;
+        }
+    }
+
+    for (size_t i = 1, count = workers.size(); i < count; ++i) {
+        auto victim = workers[(index + i) % count];
+        std::unique_lock<std::mutex> lock(victim->mutex);
+
+        if (!victim->tasks.empty()) {
+            auto task = victim->tasks.back();
+            victim->tasks.pop_back();
+            task->scheduleState = NLAV_TASK_RUNNING;
+            --queued;
+            ++own->steals;
+            return task;
+        }
+    }
+
+    return nullptr;
+}
+
+void NAVScheduler::WorkerMain(size_t index) {
+    auto self = workers[index];
+    currentWorker = (int)index;
+
+    while (true) {
+        FireTimers();
+
+        auto task = Take(index);
+
+        if (!task) {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+
+            if (queued.load() > 0)
+                continue;
+
+            if (timers.empty())
+                wake.wait(lock);
+            else
+                wake.wait_until(lock, timers.begin()->first);
+
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bool more = task->RunScheduled();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        self->busyUs += std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        ++self->tasksRun;
+
+        Finish(task, more);
+    }
+}
+
+/**
+ * Worker thread only. Return a task which has just run to IDLE, or queue it again if it has more to
+ * do or was scheduled while running.
+ */
+void NAVScheduler::Finish(NAVScheduledTask *task, bool more) {
+    int state = task->scheduleState.load();
+
+    while (true) {
+        if (state == NLAV_TASK_RUNNING && !more) {
+            if (task->scheduleState.compare_exchange_weak(state, NLAV_TASK_IDLE))
+                break;
+        } else if (task->scheduleState.compare_exchange_weak(state, NLAV_TASK_QUEUED)) {
+            Enqueue(task);
+            break;
+        }
+    }
+
+    if (removers.load() > 0) {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        stateChanged.notify_all();
+    }
+}
+
+/**
+ * Schedule the tasks whose time has come. Tasks are only touched while wakeMutex is held (which
+ * Remove() takes before returning), or once they are QUEUED (which Remove() waits out).
+ */
+void NAVScheduler::FireTimers() {
+    std::vector<NAVScheduledTask*> due;
+
+    {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        auto now = std::chrono::steady_clock::now();
+
+        while (!timers.empty() && timers.begin()->first <= now) {
+            if (MarkScheduled(timers.begin()->second))
+                due.push_back(timers.begin()->second);
+            timers.erase(timers.begin());
+        }
+    }
+
+    for (auto task : due)
+        Enqueue(task);
+}
+
+void NAVScheduler::Remove(NAVScheduledTask *task) {
+    ++removers;
+
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+
+        while (true) {
+            int state = task->scheduleState.load();
+
+            if (state == NLAV_TASK_REMOVED)
+                break;
+
+            if (state == NLAV_TASK_RUNNING || state == NLAV_TASK_RERUN) {
+                stateChanged.wait(lock);
+                continue;
+            }
+
+            if (state == NLAV_TASK_IDLE) {
+                if (task->scheduleState.compare_exchange_strong(state, NLAV_TASK_REMOVED))
+                    break;
+                continue;
+            }
+
+            // Queued: either in a deque already, or just about to be
+            if (EraseQueued(task))
+                break;
+
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
+        }
+    }
+
+    --removers;
+
+    // Only now can no more timers be added for the task
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    for (auto it = timers.begin(); it != timers.end();) {
+        if (it->second == task)
+            it = timers.erase(it);
+        else
+            ++it;
+    }
+}
+
+bool NAVScheduler::EraseQueued(NAVScheduledTask *task) {
+    for (auto worker : workers) {
+        std::unique_lock<std::mutex> lock(worker->mutex);
+        auto &tasks = worker->tasks;
+        auto it = std::find(tasks.begin(), tasks.end(), task);
+
+        if (it != tasks.end()) {
+            tasks.erase(it);
+            task->scheduleState = NLAV_TASK_REMOVED;
+            --queued;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+NAVSchedulerStats NAVScheduler::GetStats() {
+    NAVSchedulerStats stats;
+
+    stats.threads = workers.size();
+    stats.queued = queued.load();
+    stats.tasksRun = 0;
+    stats.steals = 0;
+    stats.busyUs = 0;
+
+    for (auto worker : workers) {
+        stats.tasksRun += worker->tasksRun.load();
+        stats.steals += worker->steals.load();
+        stats.busyUs += worker->busyUs.load();
+    }
+
+    stats.uptimeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started
+    ).count();
+
+    return stats;
+}
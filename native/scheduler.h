@@ -0,0 +1,119 @@
+#ifndef __NLAV_SCHEDULER_H__
+#   define __NLAV_SCHEDULER_H__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * Something which NAVScheduler runs on its worker threads, such as a codec context. A task is never
+ * run by two workers at once, so the work of a single task happens in order.
+ */
+class NAVScheduledTask {
+    public:
+        NAVScheduledTask(): scheduleState(0) { }
+        virtual ~NAVScheduledTask() { }
+
+        /**
+         * Worker thread only. Do a bounded amount of work. Returns true if there is more to do right
+         * away, in which case the task is queued again (behind the other queued tasks).
+         */
+        virtual bool RunScheduled() = 0;
+
+    private:
+        friend class NAVScheduler;
+        std::atomic<int> scheduleState;
+};
+
+struct NAVSchedulerStats {
+    size_t threads;
+    size_t queued;
+    uint64_t tasksRun;
+    uint64_t steals;
+    uint64_t busyUs;
+    uint64_t uptimeUs;
+};
+
+/**
+ * Fixed-size pool of worker threads with a task deque per worker. Workers run their own tasks first
+ * and steal from the back of the other workers' deques when they run out.
+ */
+class NAVScheduler {
+    public:
+        /**
+         * The process-wide pool. It is started on first use with ConfiguredThreads() workers, and
+         * lives until the process exits.
+         */
+        static NAVScheduler *Shared();
+
+        /**
+         * Set the number of workers of the shared pool. Returns false if the pool has already been
+         * started. 0 means one worker per core.
+         */
+        static bool Configure(size_t threads);
+        static size_t ConfiguredThreads();
+        static bool Started();
+
+        /**
+         * Queue the task unless it is already queued. If it is running, it runs again once done, so
+         * work which arrives meanwhile is not missed. Any thread.
+         */
+        void Schedule(NAVScheduledTask *task);
+
+        /**
+         * Schedule the task once the given time has come. Any thread.
+         */
+        void ScheduleAt(NAVScheduledTask *task, std::chrono::steady_clock::time_point when);
+
+        /**
+         * Take the task out of the pool for good, waiting for it to finish if it is running. Must not
+         * be called from the task itself.
+         */
+        void Remove(NAVScheduledTask *task);
+
+        NAVSchedulerStats GetStats();
+
+    private:
+        NAVScheduler(size_t threads);
+
+        struct Worker {
+            std::mutex mutex;
+            std::deque<NAVScheduledTask*> tasks;
+            std::atomic<uint64_t> busyUs;
+            std::atomic<uint64_t> tasksRun;
+            std::atomic<uint64_t> steals;
+
+            Worker(): busyUs(0), tasksRun(0), steals(0) { }
+        };
+
+        void WorkerMain(size_t index);
+        bool MarkScheduled(NAVScheduledTask *task);
+        void Enqueue(NAVScheduledTask *task);
+        bool EraseQueued(NAVScheduledTask *task);
+        NAVScheduledTask *Take(size_t index);
+        void Finish(NAVScheduledTask *task, bool more);
+        void FireTimers();
+
+        std::vector<Worker*> workers;
+        std::atomic<size_t> nextWorker;
+        std::atomic<size_t> queued;
+        std::chrono::steady_clock::time_point started;
+
+        // Guards sleeping workers and timers
+        std::mutex wakeMutex;
+        std::condition_variable wake;
+        std::multimap<std::chrono::steady_clock::time_point, NAVScheduledTask*> timers;
+
+        // Lets Remove() wait for a running task
+        std::mutex stateMutex;
+        std::condition_variable stateChanged;
+        std::atomic<int> removers;
+};
+
+#endif // #ifndef __NLAV_SCHEDULER_H__
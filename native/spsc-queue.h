@@ -0,0 +1,134 @@
+#ifndef __NLAV_SPSC_QUEUE_H__
+#   define __NLAV_SPSC_QUEUE_H__
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+
+#define NLAV_CACHE_LINE_SIZE 64
+
+/**
+ * Bounded, lock-free single-producer/single-consumer ring buffer.
+ *
+ * Exactly one thread may call Push() (the producer) and exactly one thread may call Peek()/Pop()
+ * (the consumer). Size(), HighWaterMark() and Capacity() may be called from either thread, but
+ * Size() is only a snapshot when called concurrently with the other side.
+ *
+ * The consumer inspects the front item with Peek() and only removes it with Pop(), so an item which
+ * could not be processed yet (for instance because libavcodec returned EAGAIN) simply stays where it is.
+ *
+ * The capacity is rounded up to the next power of two.
+ */
+template <typename T>
+class SPSCQueue {
+    public:
+        SPSCQueue(size_t capacity) {
+            Reset(capacity);
+        }
+
+        /**
+         * Discard the contents of the queue and change its capacity. This must only be called while neither
+         * the producer nor the consumer are active.
+         */
+        void Reset(size_t capacity) {
+            size_t size = 1;
+            while (size < capacity)
+                size <<= 1;
+
+            slots = std::vector<T>(size);
+            mask = size - 1;
+            head.store(0, std::memory_order_relaxed);
+            tail.store(0, std::memory_order_relaxed);
+            cachedHead = 0;
+            cachedTail = 0;
+            highWaterMark.store(0, std::memory_order_relaxed);
+        }
+
+        /**
+         * Producer only. Append an item to the back of the queue. Returns false if the queue is full,
+         * in which case the item is not enqueued.
+         */
+        bool Push(const T &item) {
+            size_t currentTail = tail.load(std::memory_order_relaxed);
+
+            if (currentTail - cachedHead > mask) {
+                cachedHead = head.load(std::memory_order_acquire);
+                if (currentTail - cachedHead > mask)
+                    return false;
+            }
+
+            slots[currentTail & mask] = item;
+            tail.store(currentTail + 1, std::memory_order_release);
+
+            size_t depth = currentTail + 1 - cachedHead;
+            if (depth > highWaterMark.load(std::memory_order_relaxed))
+                highWaterMark.store(depth, std::memory_order_relaxed);
+
+            return true;
+        }
+
+        /**
+         * Consumer only. Retrieve the item at the front of the queue without removing it, or nullptr if
+         * the queue is empty. The returned pointer remains valid until Pop() is called.
+         */
+        T *Peek() {
+            size_t currentHead = head.load(std::memory_order_relaxed);
+
+            if (currentHead == cachedTail) {
+                cachedTail = tail.load(std::memory_order_acquire);
+                if (currentHead == cachedTail)
+                    return nullptr;
+            }
+
+            return &slots[currentHead & mask];
+        }
+
+        /**
+         * Consumer only. Remove the item at the front of the queue. Must only be called after Peek()
+         * returned an item.
+         */
+        void Pop() {
+            size_t currentHead = head.load(std::memory_order_relaxed);
+            slots[currentHead & mask] = T();
+            head.store(currentHead + 1, std::memory_order_release);
+        }
+
+        bool Empty() const {
+            return Size() == 0;
+        }
+
+        size_t Size() const {
+            size_t currentHead = head.load(std::memory_order_acquire);
+            size_t currentTail = tail.load(std::memory_order_acquire);
+
+            return currentTail - currentHead;
+        }
+
+        size_t Capacity() const {
+            return mask + 1;
+        }
+
+        /**
+         * The largest number of items that have been queued at once since the last Reset().
+         */
+        size_t HighWaterMark() const {
+            return highWaterMark.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::vector<T> slots;
+        size_t mask;
+
+        // Consumer-owned
+        std::atomic<size_t> head;
+        size_t cachedTail;
+        char headPadding[NLAV_CACHE_LINE_SIZE];
+
+        // Producer-owned
+        std::atomic<size_t> tail;
+        size_t cachedHead;
+        std::atomic<size_t> highWaterMark;
+        char tailPadding[NLAV_CACHE_LINE_SIZE];
+};
+
+#endif // #ifndef __NLAV_SPSC_QUEUE_H__
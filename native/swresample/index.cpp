@@ -0,0 +1,6 @@
+#include "index.h"
+#include "resampler.h"
+
+void nlswr_init(Napi::Env env, Napi::Object exports) {
+    NAVResampler::Register(env, exports);
+}
@@ -0,0 +1,480 @@
+#include "resampler.h"
+#include "../avutil/frame.h"
+#include "../avutil/channel-layout.h"
+#include "../libavaddon.h"
+
+extern "C" {
+    #include <libavutil/samplefmt.h>
+    #include <libavutil/mathematics.h>
+}
+
+static int nlswr_channels(const AVFrame *frame) {
+#ifdef FFMPEG_5_1
+    return frame->ch_layout.nb_channels;
+#else
+    return frame->channels ? frame->channels : av_get_channel_layout_nb_channels(frame->channel_layout);
+#endif
+}
+
+static void nlswr_copy_format(AVFrame *dst, const AVFrame *src) {
+    dst->format = src->format;
+    dst->sample_rate = src->sample_rate;
+#ifdef FFMPEG_5_1
+    av_channel_layout_uninit(&dst->ch_layout);
+    av_channel_layout_copy(&dst->ch_layout, &src->ch_layout);
+#else
+    dst->channel_layout = src->channel_layout;
+    dst->channels = src->channels;
+#endif
+}
+
+// NAVResamplerState ///////////////////////////////////////////////////////////////////
+
+NAVResamplerState::NAVResamplerState():
+    context(swr_alloc()),
+    framePool(std::make_shared<NAVFramePool>()),
+    inputFormat(av_frame_alloc()),
+    outputFormat(av_frame_alloc())
+{
+#ifdef FFMPEG_5_1
+    outputChannelLayout = AVChannelLayout();
+#endif
+}
+
+NAVResamplerState::~NAVResamplerState() {
+    swr_free(&context);
+    av_frame_free(&inputFormat);
+    av_frame_free(&outputFormat);
+
+    // Buffers still in use by frames keep the pool alive until they are released
+    av_buffer_pool_uninit(&bufferPool);
+
+#ifdef FFMPEG_5_1
+    av_channel_layout_uninit(&outputChannelLayout);
+#endif
+}
+
+bool NAVResamplerState::InputChanged(const AVFrame *input) {
+    if (input->format != inputFormat->format || input->sample_rate != inputFormat->sample_rate)
+        return true;
+
+#ifdef FFMPEG_5_1
+    return av_channel_layout_compare(&input->ch_layout, &inputFormat->ch_layout) != 0;
+#else
+    return input->channel_layout != inputFormat->channel_layout || input->channels != inputFormat->channels;
+#endif
+}
+
+/**
+ * Set the context up for the given input and the output configuration. Samples still delayed in the
+ * context are dropped. The mutex must be held.
+ */
+int NAVResamplerState::Configure(const AVFrame *input) {
+    nlswr_copy_format(inputFormat, input);
+    nlswr_copy_format(outputFormat, input);
+
+    if (outputSampleFormat >= 0)
+        outputFormat->format = outputSampleFormat;
+    if (outputSampleRate > 0)
+        outputFormat->sample_rate = outputSampleRate;
+
+#ifdef FFMPEG_5_1
+    if (outputChannelLayout.nb_channels > 0) {
+        av_channel_layout_uninit(&outputFormat->ch_layout);
+        av_channel_layout_copy(&outputFormat->ch_layout, &outputChannelLayout);
+    }
+#else
+    if (outputChannelLayout) {
+        outputFormat->channel_layout = outputChannelLayout;
+        outputFormat->channels = av_get_channel_layout_nb_channels(outputChannelLayout);
+    }
+#endif
+
+    reconfigure = false;
+    timestamped = false;
+
+    // Resets the context (swr_close()) before applying the new configuration
+    int result = swr_config_frame(context, outputFormat, inputFormat);
+    if (result < 0)
+        return result;
+
+    return swr_init(context);
+}
+
+/**
+ * Give an output frame room for the given number of samples from our buffer pool. The mutex must be held.
+ */
+int NAVResamplerState::AllocateOutput(AVFrame *output, int samples) {
+    auto format = (AVSampleFormat)output->format;
+    int channels = nlswr_channels(output);
+
+    output->nb_samples = samples;
+
+    // Too many planes for AVFrame.data/buf, let libavutil set up extended_data/extended_buf
+    if (av_sample_fmt_is_planar(format) && channels > AV_NUM_DATA_POINTERS)
+        return av_frame_get_buffer(output, 0);
+
+    int size = av_samples_get_buffer_size(nullptr, channels, samples, format, NLAV_RESAMPLER_ALIGN);
+    if (size < 0)
+        return size;
+
+    // Output sizes vary by a few samples with the resampling delay, leave some room for that
+    if (!bufferPool || size > bufferSize) {
+        av_buffer_pool_uninit(&bufferPool);
+        bufferSize = size + size / 4;
+        bufferPool = av_buffer_pool_init(bufferSize, av_buffer_alloc);
+    }
+
+    auto buffer = bufferPool ? av_buffer_pool_get(bufferPool) : nullptr;
+    if (!buffer)
+        return AVERROR(ENOMEM);
+
+    int result = av_samples_fill_arrays(output->data, output->linesize, buffer->data, channels, samples, format, NLAV_RESAMPLER_ALIGN);
+    if (result < 0) {
+        av_buffer_unref(&buffer);
+        return result;
+    }
+
+    output->extended_data = output->data;
+    output->buf[0] = buffer;
+    return 0;
+}
+
+int NAVResamplerState::Convert(const AVFrame *input, AVFrame *output) {
+    std::unique_lock<std::mutex> lock(mutex);
+    int result;
+
+    output->nb_samples = 0;
+
+    if (!input && !swr_is_initialized(context))
+        return 0;
+
+    if (input && (reconfigure || !swr_is_initialized(context) || InputChanged(input))) {
+        if ((result = Configure(input)) < 0)
+            return result;
+    }
+
+    nlswr_copy_format(output, outputFormat);
+
+    int samples = swr_get_out_samples(context, input ? input->nb_samples : 0);
+    if (samples < 0 || (samples == 0 && !input))
+        return samples;
+
+    // The input has to go into the context even if none of it can come out yet
+    if (samples == 0)
+        samples = 1;
+
+    if ((result = AllocateOutput(output, samples)) < 0)
+        return result;
+
+    // Like the aresample filter: the context keeps track of timestamps in units of 1/(in rate * out rate)
+    int inputRate = inputFormat->sample_rate;
+    int outputRate = outputFormat->sample_rate;
+    int64_t pts = AV_NOPTS_VALUE;
+
+    if (input && input->pts != AV_NOPTS_VALUE) {
+        AVRational timeBase = input->time_base.num ? input->time_base : AVRational{ 1, inputRate };
+        pts = swr_next_pts(context, av_rescale(input->pts, (int64_t)timeBase.num * outputRate * inputRate, timeBase.den));
+        timestamped = true;
+    } else if (!input && timestamped) {
+        pts = swr_next_pts(context, INT64_MIN);
+    }
+
+    if ((result = swr_convert_frame(context, output, input)) < 0)
+        return result;
+
+    if (input && (result = av_frame_copy_props(output, input)) < 0)
+        return result;
+
+    if (pts != AV_NOPTS_VALUE) {
+        output->pts = (pts >= 0 ? pts + inputRate / 2 : pts - inputRate / 2) / inputRate;
+        output->time_base = AVRational{ 1, outputRate };
+    }
+
+    return 0;
+}
+
+/**
+ * Number of samples (at the output rate) held by the context, which come out with later conversions or
+ * a flush.
+ */
+int64_t NAVResamplerState::Delay() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (!swr_is_initialized(context))
+        return 0;
+
+    return swr_get_delay(context, outputFormat->sample_rate);
+}
+
+uint64_t NAVResamplerState::TakeTicket() {
+    std::unique_lock<std::mutex> lock(ticketMutex);
+    return nextTicket++;
+}
+
+void NAVResamplerState::WaitForTicket(uint64_t ticket) {
+    std::unique_lock<std::mutex> lock(ticketMutex);
+    ticketServed.wait(lock, [this, ticket] { return servingTicket == ticket; });
+}
+
+void NAVResamplerState::FinishTicket() {
+    std::unique_lock<std::mutex> lock(ticketMutex);
+    ++servingTicket;
+    ticketServed.notify_all();
+}
+
+// Async conversions ///////////////////////////////////////////////////////////////////
+
+/**
+ * Runs a conversion (or flush, without input) on a libuv worker thread, after the ones queued before it.
+ * The input frame is referenced and busy (it cannot be disposed of) until the conversion is done, and must
+ * not be changed meanwhile.
+ */
+class NAVResampleWorker : public Napi::AsyncWorker {
+    public:
+        NAVResampleWorker(Napi::Env env, std::shared_ptr<NAVResamplerState> state, NAVFrame *input):
+            Napi::AsyncWorker(env, "SwrContext#convertAsync"),
+            deferred(Napi::Promise::Deferred::New(env)),
+            state(state),
+            input(input),
+            ticket(state->TakeTicket())
+        {
+            if (input) {
+                inputReference = Napi::Persistent(input->Value());
+                ++input->busy;
+            }
+
+            ++state->pendingAsync;
+        }
+
+        Napi::Promise Promise() {
+            return deferred.Promise();
+        }
+
+    protected:
+        void Execute() {
+            output = state->framePool->Acquire();
+
+            state->WaitForTicket(ticket);
+            result = state->Convert(input ? input->GetHandle() : nullptr, output);
+            state->FinishTicket();
+        }
+
+        void OnOK() {
+            auto env = Env();
+            --state->pendingAsync;
+            if (input)
+                --input->busy;
+
+            if (result < 0 || output->nb_samples == 0) {
+                state->framePool->Release(output);
+
+                if (result < 0)
+                    deferred.Reject(Napi::Error::New(env, "[swr_convert_frame] libav: " + nlavu_get_error_string(result)).Value());
+                else
+                    deferred.Resolve(env.Null());
+                return;
+            }
+
+            deferred.Resolve(NAVResampler::WrapPoolFrame(env, state->framePool, output));
+        }
+
+    private:
+        Napi::Promise::Deferred deferred;
+        std::shared_ptr<NAVResamplerState> state;
+        NAVFrame *input;
+        Napi::ObjectReference inputReference;
+        uint64_t ticket;
+        AVFrame *output = nullptr;
+        int result = 0;
+};
+
+// NAVResampler ////////////////////////////////////////////////////////////////////////
+
+NAVResampler::NAVResampler(const Napi::CallbackInfo& info):
+    NAVResource(info),
+    state(std::make_shared<NAVResamplerState>())
+{
+    SetHandle(state.get());
+
+    if (info.Length() > 0 && info[0].IsObject())
+        ApplyProperties(info);
+}
+
+void NAVResampler::Free() {
+    // Async conversions in flight and codec contexts hold on to the state until they are done with it
+    state.reset();
+    SetHandle(nullptr);
+}
+
+/**
+ * Wrap an output frame. The frame returns to the pool (rather than being freed) once JS is done with it.
+ * JS thread only.
+ */
+Napi::Value NAVResampler::WrapPoolFrame(const Napi::Env &env, std::shared_ptr<NAVFramePool> pool, AVFrame *frame) {
+    LibAvAddon::Self(env)->FlushDeferredReleases();
+
+    auto instance = NAVFrame::FromHandle(env, frame, true);
+    instance->SetPool(pool);
+    return instance->Value();
+}
+
+NAVFrame *NAVResampler::GetInput(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto frameClass = LibAvAddon::Self(env)->GetConstructor(NAVFrame::ExportName())->Value();
+
+    if (!info[0].IsObject() || !info[0].As<Napi::Object>().InstanceOf(frameClass)) {
+        Napi::TypeError::New(env, "Expected an AVFrame to convert").ThrowAsJavaScriptException();
+        return nullptr;
+    }
+
+    auto input = NAVFrame::Unwrap(info[0].As<Napi::Object>());
+    auto frame = input->GetHandle();
+
+    if (!frame) {
+        Napi::Error::New(env, "The frame has been disposed").ThrowAsJavaScriptException();
+        return nullptr;
+    }
+
+    if (frame->nb_samples <= 0 || frame->sample_rate <= 0 || nlswr_channels(frame) <= 0) {
+        Napi::RangeError::New(env, "The frame must have samples, a sample rate and channels").ThrowAsJavaScriptException();
+        return nullptr;
+    }
+
+    return input;
+}
+
+/**
+ * Convert (or flush, without input) on the JS thread. Waiting for async conversions queued before
+ * would block the event loop, so that is an error instead.
+ */
+Napi::Value NAVResampler::Run(const Napi::Env &env, NAVFrame *input) {
+    if (state->pendingAsync > 0) {
+        Napi::Error::New(env, "Async conversions are pending, wait for them (or use convertAsync() / flushAsync())").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto output = state->framePool->Acquire();
+
+    state->WaitForTicket(state->TakeTicket());
+    int result = state->Convert(input ? input->GetHandle() : nullptr, output);
+    state->FinishTicket();
+
+    if (result < 0 || output->nb_samples == 0) {
+        state->framePool->Release(output);
+
+        if (result < 0)
+            return nlav_throw(env, result, "swr_convert_frame");
+        return env.Null();
+    }
+
+    return WrapPoolFrame(env, state->framePool, output);
+}
+
+Napi::Value NAVResampler::RunAsync(const Napi::Env &env, NAVFrame *input) {
+    auto worker = new NAVResampleWorker(env, state, input);
+    auto promise = worker->Promise();
+
+    // Deletes itself once done
+    worker->Queue();
+    return promise;
+}
+
+Napi::Value NAVResampler::Convert(const Napi::CallbackInfo& info) {
+    auto input = GetInput(info);
+    if (!input)
+        return info.Env().Undefined();
+
+    return Run(info.Env(), input);
+}
+
+Napi::Value NAVResampler::ConvertAsync(const Napi::CallbackInfo& info) {
+    auto input = GetInput(info);
+    if (!input)
+        return info.Env().Undefined();
+
+    return RunAsync(info.Env(), input);
+}
+
+Napi::Value NAVResampler::Flush(const Napi::CallbackInfo& info) {
+    return Run(info.Env(), nullptr);
+}
+
+Napi::Value NAVResampler::FlushAsync(const Napi::CallbackInfo& info) {
+    return RunAsync(info.Env(), nullptr);
+}
+
+Napi::Value NAVResampler::Configure(const Napi::CallbackInfo& info) {
+    return ApplyProperties(info);
+}
+
+Napi::Value NAVResampler::GetOutputSampleFormat(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), state->outputSampleFormat);
+}
+
+void NAVResampler::SetOutputSampleFormat(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->outputSampleFormat = value.As<Napi::Number>().Int32Value();
+    state->reconfigure = true;
+}
+
+Napi::Value NAVResampler::GetOutputSampleRate(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), state->outputSampleRate);
+}
+
+void NAVResampler::SetOutputSampleRate(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    int rate = value.As<Napi::Number>().Int32Value();
+
+    if (rate < 0) {
+        Napi::RangeError::New(info.Env(), "outputSampleRate cannot be negative").ThrowAsJavaScriptException();
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->outputSampleRate = rate;
+    state->reconfigure = true;
+}
+
+Napi::Value NAVResampler::GetOutputChannelLayout(const Napi::CallbackInfo& info) {
+#ifdef FFMPEG_5_1
+    if (state->outputChannelLayout.nb_channels == 0)
+        return info.Env().Null();
+
+    return NAVChannelLayout::FromHandleWrapped(info.Env(), &state->outputChannelLayout, false);
+#else
+    return Napi::Number::New(info.Env(), state->outputChannelLayout);
+#endif
+}
+
+void NAVResampler::SetOutputChannelLayout(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+
+#ifdef FFMPEG_5_1
+    av_channel_layout_uninit(&state->outputChannelLayout);
+
+    if (value.IsObject()) {
+        auto layout = NAVChannelLayout::Unwrap(value.As<Napi::Object>());
+        av_channel_layout_copy(&state->outputChannelLayout, layout->GetHandle());
+    }
+#else
+    state->outputChannelLayout = value.IsNumber() ? (uint64_t)value.As<Napi::Number>().Int64Value() : 0;
+#endif
+
+    state->reconfigure = true;
+}
+
+Napi::Value NAVResampler::GetDelay(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), state->Delay());
+}
+
+Napi::Value NAVResampler::GetPoolStats(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto stats = Napi::Object::New(env);
+    auto pool = state->framePool;
+
+    stats.Set("hits", Napi::Number::New(env, pool->Hits()));
+    stats.Set("misses", Napi::Number::New(env, pool->Misses()));
+    stats.Set("idle", Napi::Number::New(env, pool->Idle()));
+
+    return stats;
+}
@@ -0,0 +1,146 @@
+#include "../common.h"
+
+#include <napi.h>
+#include "../resource.h"
+#include "../handle-pool.h"
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+extern "C" {
+    #include <libswresample/swresample.h>
+    #include <libavutil/channel_layout.h>
+    #include <libavutil/frame.h>
+}
+
+class NAVFrame;
+
+/**
+ * Alignment of the sample buffers of the output frames allocated by a resampler.
+ */
+#define NLAV_RESAMPLER_ALIGN 32
+
+/**
+ * The state of a resampler, shared with the async conversions in flight and with the codec contexts it
+ * is a stage of (see NAVCodecContext's resampler), any of which may outlive the resampler.
+ *
+ * A SwrContext holds on to the samples it has not been able to output yet (see swr_get_delay()), so
+ * conversions have to happen one at a time and in order: the mutex serializes them, and the tickets
+ * make async conversions run in the order they were queued.
+ */
+struct NAVResamplerState {
+    NAVResamplerState();
+    ~NAVResamplerState();
+
+    /**
+     * Convert the samples of input into output, an AVFrame without buffers, which receives the
+     * samples the SwrContext can output so far. Without input, the delayed samples are flushed instead.
+     * output has no samples when there is nothing to output yet. Any thread.
+     */
+    int Convert(const AVFrame *input, AVFrame *output);
+
+    int64_t Delay();
+
+    /**
+     * Take a ticket on the JS thread, then wait for it on the worker thread (see Convert()), so that
+     * queued conversions run in order. Every ticket taken must be waited for.
+     */
+    uint64_t TakeTicket();
+    void WaitForTicket(uint64_t ticket);
+    void FinishTicket();
+
+    // Async conversions whose promise has not settled yet. JS thread only.
+    int pendingAsync = 0;
+
+    std::mutex mutex;
+    SwrContext *context = nullptr;
+
+    // Output configuration. Unset (-1/0/no channels) means the same as the input.
+    int outputSampleFormat = -1;
+    int outputSampleRate = 0;
+#ifdef FFMPEG_5_1
+    AVChannelLayout outputChannelLayout;
+#else
+    uint64_t outputChannelLayout = 0;
+#endif
+
+    // Set when the output configuration changes, so that the next conversion sets the context up again
+    bool reconfigure = false;
+
+    // Picture memory of output frames, see AllocateOutput()
+    AVBufferPool *bufferPool = nullptr;
+    int bufferSize = 0;
+
+    // Shared with the NAVFrame instances we hand out, which may outlive us
+    std::shared_ptr<NAVFramePool> framePool;
+
+    private:
+        int Configure(const AVFrame *input);
+        bool InputChanged(const AVFrame *input);
+        int AllocateOutput(AVFrame *output, int samples);
+
+        // Frames without data holding the formats the context is set up for
+        AVFrame *inputFormat;
+        AVFrame *outputFormat;
+        bool timestamped = false;
+
+        std::mutex ticketMutex;
+        std::condition_variable ticketServed;
+        uint64_t nextTicket = 0;
+        uint64_t servingTicket = 0;
+};
+
+/**
+ * Audio sample format, sample rate and channel layout conversion with libswresample, from frame to
+ * pooled frame, on the JS thread or a libuv worker thread.
+ */
+class NAVResampler : public NAVResource<NAVResampler, NAVResamplerState> {
+    public:
+        NAVResampler(const Napi::CallbackInfo& info);
+
+        inline static std::string ExportName() { return "SwrContext"; }
+        inline static Napi::Function ClassDefinition(const Napi::Env &env) {
+            return DefineClass(env, "SwrContext", {
+                R_METHOD("convert", &NAVResampler::Convert),
+                R_METHOD("convertAsync", &NAVResampler::ConvertAsync),
+                R_METHOD("flush", &NAVResampler::Flush),
+                R_METHOD("flushAsync", &NAVResampler::FlushAsync),
+                R_METHOD("configure", &NAVResampler::Configure),
+
+                R_ACCESSOR("outputSampleFormat", &NAVResampler::GetOutputSampleFormat, &NAVResampler::SetOutputSampleFormat),
+                R_ACCESSOR("outputSampleRate", &NAVResampler::GetOutputSampleRate, &NAVResampler::SetOutputSampleRate),
+                R_ACCESSOR("outputChannelLayout", &NAVResampler::GetOutputChannelLayout, &NAVResampler::SetOutputChannelLayout),
+                R_GETTER("delay", &NAVResampler::GetDelay),
+                R_GETTER("poolStats", &NAVResampler::GetPoolStats)
+            });
+        }
+
+        virtual void Free();
+        virtual bool IsResourceMappingEnabled() { return false; }
+
+        std::shared_ptr<NAVResamplerState> GetState() { return state; }
+
+        static Napi::Value WrapPoolFrame(const Napi::Env &env, std::shared_ptr<NAVFramePool> pool, AVFrame *frame);
+
+    private:
+        std::shared_ptr<NAVResamplerState> state;
+
+        NAVFrame *GetInput(const Napi::CallbackInfo& info);
+        Napi::Value Run(const Napi::Env &env, NAVFrame *input);
+        Napi::Value RunAsync(const Napi::Env &env, NAVFrame *input);
+
+        Napi::Value Convert(const Napi::CallbackInfo& info);
+        Napi::Value ConvertAsync(const Napi::CallbackInfo& info);
+        Napi::Value Flush(const Napi::CallbackInfo& info);
+        Napi::Value FlushAsync(const Napi::CallbackInfo& info);
+        Napi::Value Configure(const Napi::CallbackInfo& info);
+
+        Napi::Value GetOutputSampleFormat(const Napi::CallbackInfo& info);
+        void SetOutputSampleFormat(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetOutputSampleRate(const Napi::CallbackInfo& info);
+        void SetOutputSampleRate(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetOutputChannelLayout(const Napi::CallbackInfo& info);
+        void SetOutputChannelLayout(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetDelay(const Napi::CallbackInfo& info);
+        Napi::Value GetPoolStats(const Napi::CallbackInfo& info);
+};
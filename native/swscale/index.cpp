@@ -0,0 +1,6 @@
+#include "index.h"
+#include "scaler.h"
+
+void nlsws_init(Napi::Env env, Napi::Object exports) {
+    NAVScaler::Register(env, exports);
+}
@@ -0,0 +1,3 @@
+#include <napi.h>
+
+void nlsws_init(Napi::Env env, Napi::Object exports);
\ No newline at end of file
@@ -0,0 +1,449 @@
+#include "scaler.h"
+#include "../avutil/frame.h"
+#include "../libavaddon.h"
+
+#include <thread>
+#include <algorithm>
+
+extern "C" {
+    #include <libavutil/imgutils.h>
+    #include <libavutil/opt.h>
+}
+
+bool NAVScaleKey::operator<(const NAVScaleKey &other) const {
+    const int a[] = { srcWidth, srcHeight, srcFormat, dstWidth, dstHeight, dstFormat, flags, threads };
+    const int b[] = { other.srcWidth, other.srcHeight, other.srcFormat, other.dstWidth, other.dstHeight, other.dstFormat, other.flags, other.threads };
+
+    return std::lexicographical_compare(a, a + 8, b, b + 8);
+}
+
+// NAVScalerState //////////////////////////////////////////////////////////////////////
+
+NAVScalerState::NAVScalerState():
+    contextsCreated(0),
+    framePool(std::make_shared<NAVFramePool>())
+{
+}
+
+NAVScalerState::~NAVScalerState() {
+    for (auto &entry : contexts)
+        sws_freeContext(entry.second.first);
+
+    // Buffers still in use by frames keep the pool alive until they are released
+    av_buffer_pool_uninit(&bufferPool);
+}
+
+/**
+ * Take the cached context for the given conversion, or set up a new one. Any thread.
+ */
+SwsContext *NAVScalerState::TakeContext(const NAVScaleKey &key) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto entry = contexts.find(key);
+
+        if (entry != contexts.end()) {
+            auto context = entry->second.first;
+            contexts.erase(entry);
+            return context;
+        }
+    }
+
+    auto context = sws_alloc_context();
+    if (!context)
+        return nullptr;
+
+    av_opt_set_int(context, "srcw", key.srcWidth, 0);
+    av_opt_set_int(context, "srch", key.srcHeight, 0);
+    av_opt_set_int(context, "src_format", key.srcFormat, 0);
+    av_opt_set_int(context, "dstw", key.dstWidth, 0);
+    av_opt_set_int(context, "dsth", key.dstHeight, 0);
+    av_opt_set_int(context, "dst_format", key.dstFormat, 0);
+    av_opt_set_int(context, "sws_flags", key.flags, 0);
+    av_opt_set_int(context, "threads", key.threads, 0);
+
+    if (sws_init_context(context, nullptr, nullptr) < 0) {
+        sws_freeContext(context);
+        return nullptr;
+    }
+
+    ++contextsCreated;
+    return context;
+}
+
+/**
+ * Put a context back into the cache once done with it, evicting the least recently used one when the
+ * cache is full. Any thread.
+ */
+void NAVScalerState::ReturnContext(const NAVScaleKey &key, SwsContext *context) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Another scale of the same conversion returned its context first
+    if (contexts.count(key)) {
+        lock.unlock();
+        sws_freeContext(context);
+        return;
+    }
+
+    contexts[key] = std::make_pair(context, ++clock);
+
+    if (contexts.size() > NLAV_SCALER_CACHE_SIZE) {
+        auto oldest = contexts.begin();
+        for (auto it = contexts.begin(); it != contexts.end(); ++it) {
+            if (it->second.second < oldest->second.second)
+                oldest = it;
+        }
+
+        sws_freeContext(oldest->second.first);
+        contexts.erase(oldest);
+    }
+}
+
+/**
+ * Give a frame without buffers picture memory from our buffer pool, according to its width, height and
+ * format. Any thread.
+ */
+int NAVScalerState::AllocateOutput(AVFrame *frame) {
+    auto format = (AVPixelFormat)frame->format;
+    int size = av_image_get_buffer_size(format, frame->width, frame->height, NLAV_SCALER_ALIGN);
+
+    if (size < 0)
+        return size;
+
+    AVBufferRef *buffer;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if (!bufferPool || bufferSize != size) {
+            av_buffer_pool_uninit(&bufferPool);
+            bufferPool = av_buffer_pool_init(size, av_buffer_alloc);
+            bufferSize = size;
+        }
+
+        buffer = bufferPool ? av_buffer_pool_get(bufferPool) : nullptr;
+    }
+
+    if (!buffer)
+        return AVERROR(ENOMEM);
+
+    int result = av_image_fill_arrays(frame->data, frame->linesize, buffer->data, format, frame->width, frame->height, NLAV_SCALER_ALIGN);
+    if (result < 0) {
+        av_buffer_unref(&buffer);
+        return result;
+    }
+
+    frame->buf[0] = buffer;
+    return 0;
+}
+
+/**
+ * Convert src into dst, which receives src's properties (timestamps and such). Any thread.
+ */
+int NAVScalerState::Scale(const NAVScaleKey &key, AVFrame *dst, const AVFrame *src) {
+    int result;
+
+    if (!dst->buf[0] && !dst->data[0] && (result = AllocateOutput(dst)) < 0)
+        return result;
+
+    auto context = TakeContext(key);
+    if (!context)
+        return AVERROR(EINVAL);
+
+    result = sws_scale_frame(context, dst, src);
+    ReturnContext(key, context);
+
+    if (result < 0)
+        return result;
+
+    return av_frame_copy_props(dst, src);
+}
+
+size_t NAVScalerState::CachedContexts() {
+    std::unique_lock<std::mutex> lock(mutex);
+    return contexts.size();
+}
+
+// Async scaling ///////////////////////////////////////////////////////////////////////
+
+/**
+ * Runs a scale on a libuv worker thread. The frames are referenced and busy (they cannot be disposed of)
+ * until the scale is done, and must not be used meanwhile.
+ */
+class NAVScaleWorker : public Napi::AsyncWorker {
+    public:
+        NAVScaleWorker(Napi::Env env, std::shared_ptr<NAVScalerState> state, NAVScaleKey key, NAVFrame *src, NAVFrame *dst, AVFrame *pooled):
+            Napi::AsyncWorker(env, "SwsContext#scaleAsync"),
+            deferred(Napi::Promise::Deferred::New(env)),
+            state(state),
+            key(key),
+            src(src),
+            dst(dst),
+            pooled(pooled)
+        {
+            srcReference = Napi::Persistent(src->Value());
+            ++src->busy;
+
+            if (dst) {
+                dstReference = Napi::Persistent(dst->Value());
+                ++dst->busy;
+            }
+        }
+
+        Napi::Promise Promise() {
+            return deferred.Promise();
+        }
+
+    protected:
+        void Execute() {
+            result = state->Scale(key, dst ? dst->GetHandle() : pooled, src->GetHandle());
+        }
+
+        void OnOK() {
+            auto env = Env();
+
+            --src->busy;
+            if (dst)
+                --dst->busy;
+
+            if (result < 0) {
+                state->framePool->Release(pooled);
+                deferred.Reject(Napi::Error::New(env, "[sws_scale_frame] libav: " + nlavu_get_error_string(result)).Value());
+                return;
+            }
+
+            if (dst) {
+                dst->UpdateExternalMemory(env);
+                deferred.Resolve(dst->Value());
+            } else {
+                deferred.Resolve(NAVScaler::WrapPoolFrame(env, state->framePool, pooled));
+            }
+        }
+
+    private:
+        Napi::Promise::Deferred deferred;
+        std::shared_ptr<NAVScalerState> state;
+        NAVScaleKey key;
+        NAVFrame *src;
+        NAVFrame *dst;
+        AVFrame *pooled;
+        Napi::ObjectReference srcReference;
+        Napi::ObjectReference dstReference;
+        int result = 0;
+};
+
+// NAVScaler ///////////////////////////////////////////////////////////////////////////
+
+NAVScaler::NAVScaler(const Napi::CallbackInfo& info):
+    NAVResource(info),
+    state(std::make_shared<NAVScalerState>())
+{
+    SetHandle(state.get());
+
+    if (info.Length() > 0 && info[0].IsObject())
+        ApplyProperties(info);
+}
+
+void NAVScaler::Free() {
+    // Async scales in flight hold on to the state until they are done
+    state.reset();
+    SetHandle(nullptr);
+}
+
+/**
+ * Wrap an output frame. The frame returns to the pool (rather than being freed) once JS is done with it.
+ * JS thread only.
+ */
+Napi::Value NAVScaler::WrapPoolFrame(const Napi::Env &env, std::shared_ptr<NAVFramePool> pool, AVFrame *frame) {
+    LibAvAddon::Self(env)->FlushDeferredReleases();
+
+    auto instance = NAVFrame::FromHandle(env, frame, true);
+    instance->SetPool(pool);
+    return instance->Value();
+}
+
+/**
+ * Work out the conversion for scale(src, output), where output is either a frame to scale into (its
+ * width, height and format default to those of src) or an object with width, height and pixelFormat
+ * describing a frame to take from the pool. JS thread only.
+ */
+bool NAVScaler::PrepareScale(const Napi::CallbackInfo& info, NAVScaleKey &key, NAVFrame *&src, NAVFrame *&dst, AVFrame *&pooled) {
+    auto env = info.Env();
+    auto frameClass = LibAvAddon::Self(env)->GetConstructor(NAVFrame::ExportName())->Value();
+
+    if (!info[0].IsObject() || !info[0].As<Napi::Object>().InstanceOf(frameClass)) {
+        Napi::TypeError::New(env, "Expected an AVFrame to scale").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    if (!info[1].IsObject()) {
+        Napi::TypeError::New(env, "Expected an AVFrame or { width, height, pixelFormat } to scale into").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    src = NAVFrame::Unwrap(info[0].As<Napi::Object>());
+    dst = nullptr;
+    pooled = nullptr;
+
+    auto srcFrame = src->GetHandle();
+    auto output = info[1].As<Napi::Object>();
+    int width, height, format;
+
+    if (!srcFrame) {
+        Napi::Error::New(env, "The frame has been disposed").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    if (output.InstanceOf(frameClass)) {
+        dst = NAVFrame::Unwrap(output);
+
+        auto dstFrame = dst->GetHandle();
+        if (!dstFrame) {
+            Napi::Error::New(env, "The frame has been disposed").ThrowAsJavaScriptException();
+            return false;
+        }
+
+        if (dstFrame == srcFrame) {
+            Napi::Error::New(env, "Cannot scale a frame into itself").ThrowAsJavaScriptException();
+            return false;
+        }
+
+        if (dstFrame->width <= 0)
+            dstFrame->width = srcFrame->width;
+        if (dstFrame->height <= 0)
+            dstFrame->height = srcFrame->height;
+        if (dstFrame->format < 0)
+            dstFrame->format = srcFrame->format;
+
+        width = dstFrame->width;
+        height = dstFrame->height;
+        format = dstFrame->format;
+    } else {
+        width = output.Has("width") ? output.Get("width").As<Napi::Number>().Int32Value() : srcFrame->width;
+        height = output.Has("height") ? output.Get("height").As<Napi::Number>().Int32Value() : srcFrame->height;
+        format = output.Has("pixelFormat") ? output.Get("pixelFormat").As<Napi::Number>().Int32Value() : srcFrame->format;
+    }
+
+    if (srcFrame->width <= 0 || srcFrame->height <= 0 || width <= 0 || height <= 0) {
+        Napi::RangeError::New(env, "The frames must have a width and height").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    if (!sws_isSupportedInput((AVPixelFormat)srcFrame->format)) {
+        Napi::RangeError::New(env, "Unsupported input pixel format").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    if (!sws_isSupportedOutput((AVPixelFormat)format)) {
+        Napi::RangeError::New(env, "Unsupported output pixel format").ThrowAsJavaScriptException();
+        return false;
+    }
+
+    key.srcWidth = srcFrame->width;
+    key.srcHeight = srcFrame->height;
+    key.srcFormat = srcFrame->format;
+    key.dstWidth = width;
+    key.dstHeight = height;
+    key.dstFormat = format;
+    key.flags = flags;
+    key.threads = threads;
+
+    if (threads == 0) {
+        int64_t pixels = std::max((int64_t)width * height, (int64_t)srcFrame->width * srcFrame->height);
+        key.threads = pixels >= NLAV_SCALER_THREADED_PIXELS ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    }
+
+    if (!dst) {
+        pooled = state->framePool->Acquire();
+        pooled->width = width;
+        pooled->height = height;
+        pooled->format = format;
+    }
+
+    return true;
+}
+
+Napi::Value NAVScaler::Scale(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    NAVScaleKey key;
+    NAVFrame *src, *dst;
+    AVFrame *pooled;
+
+    if (!PrepareScale(info, key, src, dst, pooled))
+        return env.Undefined();
+
+    int result = state->Scale(key, dst ? dst->GetHandle() : pooled, src->GetHandle());
+
+    if (result < 0) {
+        state->framePool->Release(pooled);
+        return nlav_throw(env, result, "sws_scale_frame");
+    }
+
+    if (!dst)
+        return WrapPoolFrame(env, state->framePool, pooled);
+
+    dst->UpdateExternalMemory(env);
+    return dst->Value();
+}
+
+Napi::Value NAVScaler::ScaleAsync(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    NAVScaleKey key;
+    NAVFrame *src, *dst;
+    AVFrame *pooled;
+
+    if (!PrepareScale(info, key, src, dst, pooled))
+        return env.Undefined();
+
+    auto worker = new NAVScaleWorker(env, state, key, src, dst, pooled);
+    auto promise = worker->Promise();
+
+    // Deletes itself once done
+    worker->Queue();
+    return promise;
+}
+
+Napi::Value NAVScaler::Configure(const Napi::CallbackInfo& info) {
+    return ApplyProperties(info);
+}
+
+Napi::Value NAVScaler::GetFlags(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), flags);
+}
+
+void NAVScaler::SetFlags(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    flags = value.As<Napi::Number>().Int32Value();
+}
+
+Napi::Value NAVScaler::GetThreads(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), threads);
+}
+
+void NAVScaler::SetThreads(const Napi::CallbackInfo& info, const Napi::Value &value) {
+    int count = value.As<Napi::Number>().Int32Value();
+
+    if (count < 0) {
+        Napi::RangeError::New(info.Env(), "threads cannot be negative").ThrowAsJavaScriptException();
+        return;
+    }
+
+    threads = count;
+}
+
+Napi::Value NAVScaler::GetCachedContexts(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), state->CachedContexts());
+}
+
+Napi::Value NAVScaler::GetContextsCreated(const Napi::CallbackInfo& info) {
+    return Napi::Number::New(info.Env(), state->contextsCreated.load());
+}
+
+Napi::Value NAVScaler::GetPoolStats(const Napi::CallbackInfo& info) {
+    auto env = info.Env();
+    auto stats = Napi::Object::New(env);
+    auto pool = state->framePool;
+
+    stats.Set("hits", Napi::Number::New(env, pool->Hits()));
+    stats.Set("misses", Napi::Number::New(env, pool->Misses()));
+    stats.Set("idle", Napi::Number::New(env, pool->Idle()));
+
+    return stats;
+}
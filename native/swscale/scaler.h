@@ -0,0 +1,120 @@
+#include "../common.h"
+
+#include <napi.h>
+#include "../resource.h"
+#include "../handle-pool.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+extern "C" {
+    #include <libswscale/swscale.h>
+    #include <libavutil/frame.h>
+}
+
+class NAVFrame;
+
+/**
+ * Number of idle SwsContexts a scaler keeps, one per distinct conversion (see NAVScaleKey).
+ */
+#define NLAV_SCALER_CACHE_SIZE 8
+
+/**
+ * With threads = 0 (auto), conversions of at least this many pixels (4K UHD) are sliced across one
+ * thread per core.
+ */
+#define NLAV_SCALER_THREADED_PIXELS (3840 * 2160)
+
+/**
+ * Line alignment of the output frames allocated by a scaler.
+ */
+#define NLAV_SCALER_ALIGN 32
+
+/**
+ * Everything a SwsContext is set up for. Contexts are only reused for the exact same conversion.
+ */
+struct NAVScaleKey {
+    int srcWidth, srcHeight, srcFormat;
+    int dstWidth, dstHeight, dstFormat;
+    int flags;
+    int threads;
+
+    bool operator<(const NAVScaleKey &other) const;
+};
+
+/**
+ * The state of a scaler, shared with the async scale workers in flight, which may outlive the scaler.
+ * A SwsContext cannot be used by two threads at once, so contexts are taken out of the cache while in
+ * use, and concurrent scales of the same conversion get a context each.
+ */
+struct NAVScalerState {
+    NAVScalerState();
+    ~NAVScalerState();
+
+    SwsContext *TakeContext(const NAVScaleKey &key);
+    void ReturnContext(const NAVScaleKey &key, SwsContext *context);
+    int AllocateOutput(AVFrame *frame);
+    int Scale(const NAVScaleKey &key, AVFrame *dst, const AVFrame *src);
+    size_t CachedContexts();
+
+    std::mutex mutex;
+    std::map<NAVScaleKey, std::pair<SwsContext*, uint64_t>> contexts;
+    uint64_t clock = 0;
+    std::atomic<uint64_t> contextsCreated;
+
+    // Picture memory of output frames, reused while the output size stays the same
+    AVBufferPool *bufferPool = nullptr;
+    int bufferSize = 0;
+
+    // Shared with the NAVFrame instances we hand out, which may outlive us
+    std::shared_ptr<NAVFramePool> framePool;
+};
+
+/**
+ * Pixel format conversion and scaling with libswscale, from a frame into a given frame or a pooled one,
+ * on the JS thread or a libuv worker thread.
+ */
+class NAVScaler : public NAVResource<NAVScaler, NAVScalerState> {
+    public:
+        NAVScaler(const Napi::CallbackInfo& info);
+
+        inline static std::string ExportName() { return "SwsContext"; }
+        inline static Napi::Function ClassDefinition(const Napi::Env &env) {
+            return DefineClass(env, "SwsContext", {
+                R_METHOD("scale", &NAVScaler::Scale),
+                R_METHOD("scaleAsync", &NAVScaler::ScaleAsync),
+                R_METHOD("configure", &NAVScaler::Configure),
+
+                R_ACCESSOR("flags", &NAVScaler::GetFlags, &NAVScaler::SetFlags),
+                R_ACCESSOR("threads", &NAVScaler::GetThreads, &NAVScaler::SetThreads),
+                R_GETTER("cachedContexts", &NAVScaler::GetCachedContexts),
+                R_GETTER("contextsCreated", &NAVScaler::GetContextsCreated),
+                R_GETTER("poolStats", &NAVScaler::GetPoolStats)
+            });
+        }
+
+        virtual void Free();
+        virtual bool IsResourceMappingEnabled() { return false; }
+
+        static Napi::Value WrapPoolFrame(const Napi::Env &env, std::shared_ptr<NAVFramePool> pool, AVFrame *frame);
+
+    private:
+        std::shared_ptr<NAVScalerState> state;
+        int flags = SWS_BICUBIC;
+        int threads = 0;
+
+        bool PrepareScale(const Napi::CallbackInfo& info, NAVScaleKey &key, NAVFrame *&src, NAVFrame *&dst, AVFrame *&pooled);
+
+        Napi::Value Scale(const Napi::CallbackInfo& info);
+        Napi::Value ScaleAsync(const Napi::CallbackInfo& info);
+        Napi::Value Configure(const Napi::CallbackInfo& info);
+
+        Napi::Value GetFlags(const Napi::CallbackInfo& info);
+        void SetFlags(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetThreads(const Napi::CallbackInfo& info);
+        void SetThreads(const Napi::CallbackInfo& info, const Napi::Value &value);
+        Napi::Value GetCachedContexts(const Napi::CallbackInfo& info);
+        Napi::Value GetContextsCreated(const Napi::CallbackInfo& info);
+        Napi::Value GetPoolStats(const Napi::CallbackInfo& info);
+};
@@ -18,7 +18,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
-import { AVBuffer, AVChromaLocation, AVClass, AVColorPrimaries, AVColorRange, AVColorSpace, AVColorTransferCharacteristic, AVDictionary, AVFrame, AVMediaType, AVRational, AVSampleFormat } from "../avutil";
+import { AVBuffer, AVChromaLocation, AVClass, AVColorPrimaries, AVColorRange, AVColorSpace, AVColorTransferCharacteristic, AVDictionary, AVFrame, AVFrameStatisticsOptions, AVHWDeviceContext, AVHWFramesContext, AVMediaType, AVRational, AVSampleFormat } from "../avutil";
 import { AVPixelFormat } from "../avutil";
 import { NotImplemented, OpaquePtr, Out, Ref } from "../helpers";
 import { AVCodec } from "./codec";
@@ -27,6 +27,8 @@ import { AVCodecParameters, AVFieldOrder } from "./codec-par";
 import { AVCodecID } from "./codec_id";
 import { AVAudioServiceType, AVDiscard } from "./defs";
 import { AVPacket, AVPacketSideData } from "./packet";
+import { AVFormatContext } from "../avformat";
+import { SwrContext } from "../swresample";
 
 /**
  * @file
@@ -626,6 +628,108 @@ export interface AVCodecContextError {
     message: string;
 }
 
+export interface AVCodecContextPoolCounters {
+    /** Number of times a pooled frame/packet was reused */
+    hits: number;
+    /** Number of times a new frame/packet had to be allocated */
+    misses: number;
+    /** Number of frames/packets currently waiting in the pool */
+    idle: number;
+}
+
+/**
+ * Counters of the plane buffer pools of a decoder (see AVCodecContext#bufferPoolSize)
+ */
+export interface AVCodecContextBufferPoolCounters {
+    /** Number of frames whose planes came from the pools */
+    frames: number;
+    /** Number of plane buffers the pools allocated, including the ones allocated to warm them up */
+    allocations: number;
+    /** Number of frames allocated without the pools, as they were at their cap */
+    overflows: number;
+    /** Number of (format, width, height) layouts pools were created for */
+    layouts: number;
+}
+
+export interface AVCodecContextPoolStats {
+    frames: AVCodecContextPoolCounters;
+    packets: AVCodecContextPoolCounters;
+    /** Only for decoders opened with a bufferPoolSize */
+    buffers?: AVCodecContextBufferPoolCounters;
+}
+
+/**
+ * Distribution of a duration measured by a codec context (see AVCodecContext#getStats()). Percentiles 
+ * come from a fixed-size histogram, and are at most 25% above the actual value.
+ */
+export interface AVCodecContextLatencyStats {
+    /** Number of samples */
+    count: number;
+    meanUs: number;
+    p50Us: number;
+    p90Us: number;
+    p99Us: number;
+    maxUs: number;
+}
+
+export interface AVCodecContextStats {
+    /** From entering the queue (sendFrame()/sendPacket() or a route) to having been sent to the codec */
+    queueWait: AVCodecContextLatencyStats;
+    /** avcodec_send_frame()/avcodec_send_packet() calls which took a frame/packet */
+    send: AVCodecContextLatencyStats;
+    /** avcodec_receive_frame()/avcodec_receive_packet() calls which gave a frame/packet */
+    receive: AVCodecContextLatencyStats;
+    /** From the worker thread posting output to onFrame/onPacket being called */
+    delivery: AVCodecContextLatencyStats;
+    /** Number of times the codec refused input until it has given back output (EAGAIN) */
+    sendEagain: number;
+    /** Number of times the codec had no output until it gets more input (EAGAIN) */
+    receiveEagain: number;
+    /** Number of errors on the worker thread, whether or not onError was set */
+    errors: number;
+    queueDepth: number;
+    queueHighWaterMark: number;
+    pools: AVCodecContextPoolStats;
+}
+
+/**
+ * Statistics for the shared thread pool (see AVCodecContext#useThreadPool)
+ */
+export interface AVCodecContextThreadPoolStats {
+    /**
+     * Whether the pool has been started (by the first context opened with useThreadPool)
+     */
+    started: boolean;
+
+    /**
+     * Number of worker threads (or the number the pool will start with)
+     */
+    threads: number;
+
+    /**
+     * Contexts waiting for a worker
+     */
+    queued: number;
+
+    /**
+     * Number of times a context was run by a worker
+     */
+    tasksRun: number;
+
+    /**
+     * Number of times a worker ran a context queued on another worker
+     */
+    steals: number;
+
+    busyUs: number;
+    uptimeUs: number;
+
+    /**
+     * busyUs / (threads * uptimeUs), between 0 and 1
+     */
+    utilization: number;
+}
+
 /**
  * main external API structure.
  * New fields can be added to the end with minor version bumps.
@@ -643,14 +747,163 @@ export declare class AVCodecContext {
     constructor(codec: AVCodec);
 
     /**
-     * Callback called when a new frame arrives from the decoder.
+     * Set the number of worker threads of the shared thread pool (see useThreadPool). 0 (the default)
+     * means one per core. Throws once the pool has been started.
+     */
+    static configureThreadPool(threads: number): void;
+
+    static threadPoolStats(): AVCodecContextThreadPoolStats;
+
+    /**
+     * Set the number of contexts with fairThreadCount expected to run at the same time, so that each 
+     * gets the same share of the cores whatever the order they are opened in. 0 (the default) divides 
+     * the cores among the contexts open at the time, so that the first ones get more. More contexts 
+     * than expected are still taken into account. Applies to contexts opened afterwards.
+     */
+    static configureFairThreads(contexts: number): void;
+
+    /**
+     * Run this context on the shared, fixed-size thread pool instead of a thread of its own. Worth it 
+     * with many contexts: they share one thread per core, each context's items are still processed in 
+     * order. Only possible before open().
+     */
+    useThreadPool: boolean;
+
+    /**
+     * Unless threadCount is set, give the codec its share of the cores rather than a thread per core: 
+     * the cores are divided among the contexts open with fairThreadCount (at the time they are opened,
+     * so the share depends on the open order unless configureFairThreads() was called), so that many 
+     * contexts, on the shared pool or not, do not oversubscribe the machine. Only possible before open().
+     */
+    fairThreadCount: boolean;
+
+    /**
+     * Decoders: take the planes of decoded video frames from pools of at most this many frames per
+     * (format, width, height) instead of letting libavcodec allocate them, so that the memory used for 
+     * frames is bounded and allocated up front (see bufferPoolPrewarm). Frames beyond the cap, and 
+     * formats which cannot be pooled (palettes, hardware surfaces), are allocated by libavcodec as usual.
+     * Ignored by codecs without direct rendering (AV_CODEC_CAP_DR1). 0 (the default) disables the pools. 
+     * Only possible before open().
+     */
+    bufferPoolSize: number;
+
+    /**
+     * Number of frames allocated when the decoder is opened, for the layout it was opened with (width, 
+     * height and pixelFormat must be set), and when a new layout shows up. Defaults to bufferPoolSize.
+     * Only possible before open().
+     */
+    bufferPoolPrewarm: number;
+
+    /**
+     * Allocate the buffers of the pools (see bufferPoolSize) in shared memory, so that decoded frames can 
+     * be handed to other processes by file descriptor (see AVBuffer#sharedMemory on the frame's plane 
+     * buffers). Throws on platforms without shared memory support. Only possible before open().
+     */
+    bufferPoolSharedMemory: boolean;
+
+    /**
+     * Decode/encode on a hardware device. Decoders must support the device type, and then decode into GPU 
+     * memory (in hwPixelFormat), falling back to software for streams the device cannot handle. Use 
+     * AVFrame#transferData() to download frames. Only possible before open().
+     */
+    hwDeviceContext: AVHWDeviceContext;
+
+    /**
+     * Encoders: the frames context input frames come from, which also sets pixelFormat. Set it to the 
+     * frames context of a hardware decoder to keep frames on the GPU from end to end (see routeFrames()).
+     * Decoders: the frames context to decode into, if set before open(); otherwise the one libavcodec 
+     * allocated, once the first frame has been decoded.
+     */
+    hwFramesContext: AVHWFramesContext;
+
+    /**
+     * The pixel format of hardware frames for hwDeviceContext (AV_PIX_FMT_NONE without a device).
+     */
+    readonly hwPixelFormat: AVPixelFormat;
+
+    /**
+     * Audio decoders only. Convert every decoded frame with the given resampler on this context's worker
+     * thread, before it goes to onFrame and along routes. Only possible before open().
+     */
+    resampler: SwrContext;
+
+    /**
+     * Decoders only. Compute the statistics of every decoded frame (see AVFrame#getStatistics()) on this
+     * context's worker thread, and add them to the frame's metadata before it goes to onFrame and along 
+     * routes, the way libavfilter's analysis filters do. Video frames are compared with the frame decoded
+     * before them for frozen frame detection (previous is ignored). The keys are:
+     * - nlav.stats.mean.N and nlav.stats.variance.N for each plane N
+     * - nlav.stats.black_ratio and nlav.stats.black (0 or 1)
+     * - nlav.stats.difference and nlav.stats.frozen (0 or 1), from the second frame on
+     * - nlav.stats.histogram, the 256 counts separated by commas, with the histogram option
+     * - nlav.stats.rms.N and nlav.stats.peak.N for each audio channel N
+     * 
+     * True uses the default options. Frames in formats without statistics go without. Keeping the 
+     * previous video frame means one more frame buffer is in use. Only possible before open().
+     */
+    frameStatistics: AVFrameStatisticsOptions | boolean | null;
+
+    /**
+     * Encoders only. Instead of delivering each packet to onPacket as an AVPacket, the worker thread 
+     * copies it into this ring buffer, so that high packet rates do not mean as many Javascript objects. 
+     * Use a view over a SharedArrayBuffer to read it from a worker; it must not be transferred or detached
+     * while the context uses it. onPacket is then called with the write offset whenever records have 
+     * been written, once for a burst of them.
+     * 
+     * The memory starts with control words (Uint32Array indices, native byte order):
+     * - 0: the write offset, where the next record goes, written by the encoder
+     * - 1: the read offset, where the oldest unread record is, written by the reader once it is done
+     * - 2: the number of packets written
+     * - 3: the number of packets dropped, for a lack of room between the write and read offsets
+     * 
+     * Offsets are from byte 64, where the ring starts. The ring is the rest of the memory, rounded down to
+     * a multiple of 8 bytes. Each record is an int32 size, int32 flags, int32 
+     * stream index, 4 reserved bytes, int64 pts, dts and duration, then the size bytes of the packet. The
+     * next record starts at the next multiple of 8, or at offset 0 if that is the end of the ring. A size 
+     * of -1 means the next record is at offset 0. Records are read until the read offset reaches the write 
+     * offset (Atomics.load()), and are free to be overwritten once the read offset is stored past them
+     * (Atomics.store()). Only possible before open().
+     */
+    packetArena: Uint8Array | null;
+
+    /**
+     * Callback called when a new frame arrives from the decoder. When batchSize is greater than 1, 
+     * this is called with an array of frames instead.
      */
-    onFrame: (frame: AVFrame) => void;
+    onFrame: (frame: AVFrame | AVFrame[]) => void;
 
     /**
-     * Callback called when a new packet arrives from the encoder.
+     * Callback called when a new packet arrives from the encoder. When batchSize is greater than 1, 
+     * this is called with an array of packets instead. With a packetArena, this is called with the write 
+     * offset of the arena instead.
      */
-    onPacket: (frame: AVPacket) => void;
+    onPacket: (frame: AVPacket | AVPacket[] | number) => void;
+
+    /**
+     * Number of frames/packets the worker thread collects before delivering them to onFrame/onPacket 
+     * with a single call. Defaults to 1 (each frame/packet is delivered individually).
+     */
+    batchSize: number;
+
+    /**
+     * When batching, the longest time (in microseconds) a partial batch is held back waiting for more 
+     * output. With 0 (the default), a partial batch is delivered as soon as the codec needs more input.
+     */
+    maxBatchLatencyUs: number;
+
+    /**
+     * Statistics for the pools of frames/packets used to receive output from the codec. Frames/packets 
+     * return to the pool once they are released (or garbage collected), so in steady state nearly every 
+     * acquisition should be a hit.
+     */
+    readonly poolStats: AVCodecContextPoolStats;
+
+    /**
+     * Measurements of the worker thread's hot path since the context was created, to locate latency in
+     * the queue, in the codec or on the way back to Javascript. They are always collected, at the cost 
+     * of a few clock reads per frame/packet.
+     */
+    getStats(): AVCodecContextStats;
 
     /**
      * Callback called when an error occurs within the encoder/decoder
@@ -658,9 +911,125 @@ export declare class AVCodecContext {
      */
     onError: (err: AVCodecContextError) => void;
 
+    /**
+     * Callback called once the queue has drained to queueLowWaterMark after sendFrame()/sendPacket() 
+     * refused an item because the queue was full.
+     */
+    onDrain: () => void;
+
+    /**
+     * Callback called once an end of stream has made it through the codec (see flush()), after the last 
+     * of its output went to onFrame/onPacket. Routed contexts end this way when their input ends.
+     */
+    onEnd: () => void;
+
     open(options?: AVDictionary);
-    sendFrame(frame: AVFrame);
-    sendPacket(frame: AVPacket);
+
+    /**
+     * Open the context like open(), but run avcodec_open2() (and start the worker thread) on a libuv 
+     * worker thread, as opening some encoders takes long enough to stall the event loop. Properties 
+     * which must be set before opening cannot be changed once this is called. Frames/packets may already
+     * be sent, they go to the codec once it is open.
+     * @returns a promise which resolves once the context is open
+     */
+    openAsync(options?: AVDictionary): Promise<void>;
+
+    /**
+     * Signal the end of the stream. The worker thread drains the codec (and the resampler), so that the 
+     * frames/packets it was holding on to are delivered, passes the end along routeFrames() routes, and 
+     * then calls onEnd. Afterwards the codec can take a new stream (for encoders, only those with 
+     * AV_CODEC_CAP_ENCODER_FLUSH). Not possible while fed natively (see AVFormatContext#routeStream()), 
+     * which ends the stream by itself.
+     * @returns a promise which resolves once the last of the output has been delivered
+     */
+    flush(): Promise<void>;
+
+    /**
+     * Set many properties at once, for example `ctx.configure({ width: 1920, height: 1080, bitRate: 4_000_000 })`.
+     * Equivalent to assigning each property in turn, but crosses into native code only once. Throws 
+     * (without changing anything) if the object contains an unknown or read-only property.
+     */
+    configure(properties: Partial<AVCodecContext>): void;
+
+    /**
+     * Free the codec context and stop its worker thread now instead of waiting for the garbage 
+     * collector. Accessing the object afterwards throws. Pending sendFrameAsync()/sendPacketAsync() 
+     * calls are rejected. Throws while openAsync() is in progress. Also available as [Symbol.dispose] 
+     * where the runtime supports it.
+     */
+    dispose(): void;
+
+    /**
+     * Queue a frame to be sent to the encoder by the context's worker thread.
+     * @returns false if the queue is full (see maxQueuedItems), in which case the frame was not queued.
+     *          onDrain will be called once there is room again.
+     */
+    sendFrame(frame: AVFrame): boolean;
+
+    /**
+     * Queue a frame to be sent to the encoder by the context's worker thread. If the queue is full, the 
+     * frame is held until the worker thread has drained the queue to queueLowWaterMark.
+     * @returns a promise which resolves once the frame has been queued
+     */
+    sendFrameAsync(frame: AVFrame): Promise<void>;
+
+    /**
+     * Decoders only. Send every decoded frame straight to the given encoder from this context's worker 
+     * thread, in addition to onFrame (which becomes optional, a tap). Frames are shared by reference, 
+     * so routing to several encoders does not copy any data. Timestamps are converted from the 
+     * decoder's packet time base (see AVStream#copyParametersTo()) to the encoder's time base.
+     * The encoder's sendFrame() methods throw once it is routed to. Only possible before open().
+     */
+    routeFrames(encoder: AVCodecContext): void;
+
+    /**
+     * Encoders only. Send every encoded packet straight to the given stream of an output format context
+     * (see AVFormatContext#openOutput()), in addition to onPacket (which becomes optional, a tap).
+     * Timestamps are converted to the stream's time base when written. Only possible before open().
+     */
+    routePackets(formatContext: AVFormatContext, streamIndex: number): void;
+
+    /**
+     * Number of frames/packets sent along routes (see routeFrames()/routePackets()).
+     */
+    readonly routedItems: number;
+
+    /**
+     * Queue a packet to be sent to the decoder by the context's worker thread. Errors are reported 
+     * via onError.
+     * @returns false if the queue is full (see maxQueuedItems), in which case the packet was not queued.
+     *          onDrain will be called once there is room again.
+     */
+    sendPacket(packet: AVPacket): boolean;
+
+    /**
+     * Queue a packet to be sent to the decoder by the context's worker thread. If the queue is full, the 
+     * packet is held until the worker thread has drained the queue to queueLowWaterMark.
+     * @returns a promise which resolves once the packet has been queued
+     */
+    sendPacketAsync(packet: AVPacket): Promise<void>;
+
+    /**
+     * Number of frames/packets currently waiting to be sent to the codec by the worker thread.
+     */
+    readonly queueDepth: number;
+
+    /**
+     * The largest number of frames/packets that have been waiting in the queue at once.
+     */
+    readonly queueHighWaterMark: number;
+
+    /**
+     * The maximum number of frames/packets which can be waiting in the queue. Defaults to 128. 
+     * Once the context is opened, this can only be lowered.
+     */
+    maxQueuedItems: number;
+
+    /**
+     * Pending sendFrameAsync()/sendPacketAsync() calls and onDrain are serviced once the queue has 
+     * drained to this depth. Defaults to half of maxQueuedItems, set to null to restore the default.
+     */
+    queueLowWaterMark: number;
     
     /**
      * information on struct for av_log
@@ -1508,8 +1877,10 @@ export declare class AVCodecContext {
      * is used to decide how many independent tasks should be passed to execute()
      * - encoding: Set by user.
      * - decoding: Set by user.
+     * 0 (the default) lets libavcodec pick one per core (see also fairThreadCount). Only possible 
+     * before open().
      */
-    thread_count: number;
+    threadCount: number;
 
     /**
      * Which multithreading methods to use.
@@ -1518,6 +1889,8 @@ export declare class AVCodecContext {
      *
      * - encoding: Set by user, otherwise the default is used.
      * - decoding: Set by user, otherwise the default is used.
+     * FF_THREAD_SLICE keeps latency down, FF_THREAD_FRAME gets the most throughput. Only possible 
+     * before open().
      */
     threadType: number;
 
@@ -1526,7 +1899,7 @@ export declare class AVCodecContext {
      * - encoding: Set by libavcodec.
      * - decoding: Set by libavcodec.
      */
-    activeThreadType: number;
+    readonly activeThreadType: number;
 
 
     /**
@@ -1974,6 +2347,36 @@ export declare class AVCodecContext {
     channelLayout: number;
 }
 
+/**
+ * Properties and open() options to create many codec contexts with, for example
+ * `new AVCodecContextTemplate(codec, { width: 1280, height: 720 }, { preset: 'veryfast' })`. The property
+ * names are looked up and the options are checked once, when the template is created, which throws for
+ * unknown or read-only properties, unknown options and values the options do not accept.
+ */
+export declare class AVCodecContextTemplate {
+    constructor(codec: AVCodec, properties?: Partial<AVCodecContext>, options?: AVDictionary | { [key: string]: string | number });
+
+    readonly codec: AVCodec;
+
+    /**
+     * A frozen copy of the properties the template was created with, null without any.
+     */
+    readonly properties: Readonly<Partial<AVCodecContext>> | null;
+
+    /**
+     * A copy of the options the template was created with.
+     */
+    readonly options: { [key: string]: string };
+
+    /**
+     * Create a context for the codec with the properties and then the options applied, in a single call.
+     * The options are set on the context directly, so they need not be passed to open().
+     */
+    newContext(): AVCodecContext;
+
+    dispose(): void;
+}
+
 /**
  * @defgroup lavc_hwaccel AVHWAccel
  *
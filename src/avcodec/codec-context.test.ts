@@ -1,6 +1,6 @@
 import { delay, describe } from "razmin";
-import { AVCodecContext as AVCodecContextType, AVCodecContextError } from "./avcodec";
-import { AVCodecContext as AVCodecContextImpl } from "../../binding";
+import { AVCodecContext as AVCodecContextType, AVCodecContextError, AVCodecContextTemplate as AVCodecContextTemplateType, FF_THREAD_SLICE } from "./avcodec";
+import { AVCodecContext as AVCodecContextImpl, AVCodecContextTemplate as AVCodecContextTemplateImpl } from "../../binding";
 import { AVCodec as AVCodecType } from "./codec";
 import { AVCodec as AVCodecImpl } from "../../binding";
 import { AVFrame as AVFrameType, AVPixelFormat } from "../avutil";
@@ -8,9 +8,12 @@ import { AVFrame as AVFrameImpl } from "../../binding";
 import { AVPacket as AVPacketType } from "./packet";
 import { AVPacket as AVPacketImpl } from "../../binding";
 import { expect } from "chai";
+import { Worker } from "worker_threads";
+import * as path from "path";
 
 const AVCodecContext = <typeof AVCodecContextType>AVCodecContextImpl;
 const AVCodec = <typeof AVCodecType>AVCodecImpl;
+const AVCodecContextTemplate = <typeof AVCodecContextTemplateType>AVCodecContextTemplateImpl;
 const AVFrame = <typeof AVFrameType>AVFrameImpl;
 const AVPacket = <typeof AVPacketType>AVPacketImpl;
 
@@ -104,6 +107,201 @@ describe("AVCodecContext", it => {
         await delay(250);
         expect(count).to.equal(3);
     });
+    it('should report queue statistics', async () => {
+        await delay(250);
+
+        let context = createEncoderContext('rawvideo');
+
+        expect(context.maxQueuedItems).to.be.at.least(1);
+        expect(context.queueDepth).to.equal(0);
+        expect(context.queueHighWaterMark).to.equal(0);
+
+        context.open();
+        expect(context.sendFrame(createTestFrame(context))).to.be.true;
+        expect(context.sendFrame(createTestFrame(context))).to.be.true;
+        expect(context.sendFrame(createTestFrame(context))).to.be.true;
+        await delay(250);
+
+        // Nobody is consuming packets, so the encoder cannot accept all of them
+        expect(context.queueDepth).to.be.at.least(1);
+        expect(context.queueHighWaterMark).to.be.at.least(context.queueDepth);
+
+        let count = 0;
+        context.onPacket = () => count += 1;
+        await delay(250);
+
+        expect(count).to.equal(3);
+        expect(context.queueDepth).to.equal(0);
+    });
+    it('should apply backpressure once maxQueuedItems is reached', async () => {
+        await delay(250);
+
+        let context = createEncoderContext('rawvideo');
+
+        context.maxQueuedItems = 2;
+        context.queueLowWaterMark = 0;
+        expect(context.maxQueuedItems).to.equal(2);
+        expect(context.queueLowWaterMark).to.equal(0);
+
+        let drained = 0;
+        context.onDrain = () => drained += 1;
+
+        // Not opened yet, so nothing leaves the queue
+        expect(context.sendFrame(createTestFrame(context))).to.be.true;
+        expect(context.sendFrame(createTestFrame(context))).to.be.true;
+        expect(context.sendFrame(createTestFrame(context))).to.be.false;
+
+        let resolved = false;
+        let sent = context.sendFrameAsync(createTestFrame(context)).then(() => resolved = true);
+        await delay(50);
+        expect(resolved).to.be.false;
+
+        let count = 0;
+        context.onPacket = () => count += 1;
+        context.open();
+        await sent;
+        await delay(250);
+
+        expect(drained).to.equal(1);
+        expect(count).to.equal(3);
+    });
+    it('should deliver packets in batches', async () => {
+        await delay(250);
+
+        let context = createEncoderContext('rawvideo');
+        let batches: AVPacketType[][] = [];
+
+        context.batchSize = 2;
+        context.maxBatchLatencyUs = 50000;
+        context.onPacket = (packets: AVPacketType[]) => batches.push(packets);
+        context.open();
+
+        context.sendFrame(createTestFrame(context));
+        context.sendFrame(createTestFrame(context));
+        context.sendFrame(createTestFrame(context));
+        await delay(250);
+
+        expect(batches.map(b => b.length)).to.eql([ 2, 1 ]);
+    });
+    it('writes packets into a packetArena', async () => {
+        await delay(250);
+
+        let context = createEncoderContext('rawvideo');
+        // A SharedArrayBuffer would let a worker read it, here the encoder is done by the time we read
+        let arena = new Uint8Array(64 + 4 * 160000);
+        let control = new Uint32Array(arena.buffer, 0, 4);
+        let records = new DataView(arena.buffer, 64);
+        let signals: number[] = [];
+
+        context.packetArena = arena;
+        context.onPacket = (writeOffset: number) => signals.push(writeOffset);
+        context.open();
+
+        for (let pts = 0; pts < 3; ++pts) {
+            let frame = createTestFrame(context);
+            frame.pts = pts;
+            context.sendFrame(frame);
+        }
+        await delay(250);
+
+        let read = control[1];
+        let write = control[0];
+        let timestamps: number[] = [];
+
+        while (read !== write) {
+            let size = records.getInt32(read, true);
+            expect(size).to.equal(352 * 288 * 3 / 2);
+            timestamps.push(records.getUint32(read + 16, true));
+            read += (40 + size + 7) & ~7;
+        }
+        control[1] = read;
+
+        expect(timestamps).to.eql([ 0, 1, 2 ]);
+        expect(control[2]).to.equal(3);
+        expect(control[3]).to.equal(0);
+        expect(signals[signals.length - 1]).to.equal(write);
+    });
+    it('wraps and drops packets in a small packetArena', async () => {
+        const record = 40 + 352 * 288 * 3 / 2;
+
+        async function until(condition: () => boolean) {
+            let deadline = Date.now() + 5000;
+            while (!condition()) {
+                expect(Date.now()).to.be.below(deadline);
+                await new Promise(resolve => setTimeout(resolve, 1));
+            }
+        }
+
+        async function createArenaContext(ringSize: number) {
+            let context = createEncoderContext('rawvideo');
+            let arena = new Uint8Array(64 + ringSize);
+            let control = new Uint32Array(arena.buffer, 0, 4);
+            let records = new DataView(arena.buffer, 64);
+
+            context.packetArena = arena;
+            context.onPacket = () => {};
+            context.open();
+
+            let send = async (pts: number, expectWritten: number, expectDropped: number) => {
+                let frame = createTestFrame(context);
+                frame.pts = pts;
+                context.sendFrame(frame);
+                await until(() => control[2] === expectWritten && control[3] === expectDropped);
+            };
+
+            return { context, control, records, send };
+        }
+
+        // Room for 3 records and a bit: the 4th needs the start of the ring, where the reader still is
+        let marked = await createArenaContext(3 * record + 104);
+        for (let pts = 0; pts < 3; ++pts)
+            await marked.send(pts, pts + 1, 0);
+        expect(Array.from(marked.control)).to.eql([ 3 * record, 0, 3, 0 ]);
+
+        await marked.send(3, 3, 1);
+        expect(Array.from(marked.control)).to.eql([ 3 * record, 0, 3, 1 ]);
+
+        // Once the reader is past the first two, the next record goes to the start after a -1 marker
+        marked.control[1] = 2 * record;
+        await marked.send(4, 4, 1);
+        expect(Array.from(marked.control)).to.eql([ record, 2 * record, 4, 1 ]);
+        expect(marked.records.getInt32(3 * record, true)).to.equal(-1);
+        expect(marked.records.getInt32(0, true)).to.equal(record - 40);
+        expect(marked.records.getUint32(16, true)).to.equal(4);
+        marked.context.dispose();
+
+        // Room for exactly 3 records: the 3rd would end the ring with the write offset back on the reader
+        let exact = await createArenaContext(3 * record);
+        await exact.send(0, 1, 0);
+        await exact.send(1, 2, 0);
+        await exact.send(2, 2, 1);
+        expect(Array.from(exact.control)).to.eql([ 2 * record, 0, 2, 1 ]);
+
+        // Once the reader has moved on, it fits, and the write offset wraps to 0 without a marker
+        exact.control[1] = record;
+        await exact.send(3, 3, 1);
+        expect(Array.from(exact.control)).to.eql([ 0, record, 3, 1 ]);
+        expect(exact.records.getUint32(2 * record + 16, true)).to.equal(3);
+        exact.context.dispose();
+    });
+    it('should reuse released packets', async () => {
+        await delay(250);
+
+        let context = createEncoderContext('rawvideo');
+        let count = 0;
+
+        context.onPacket = (packet: AVPacketType) => (count += 1, packet.release());
+        context.open();
+
+        for (let i = 0; i < 5; ++i) {
+            context.sendFrame(createTestFrame(context));
+            await delay(50);
+        }
+
+        expect(count).to.equal(5);
+        expect(context.poolStats.packets.misses).to.be.at.most(2);
+        expect(context.poolStats.packets.hits).to.be.at.least(3);
+    });
     it('should convey errors via onError', async () => {
         await delay(250);
 
@@ -123,4 +321,345 @@ describe("AVCodecContext", it => {
         expect(error.code).to.equal(`averror:-22`);
         expect(error.message.includes("during avcodec_send")).to.be.true;
     });
-});
\ No newline at end of file
+
+    it('can be configured in one call', () => {
+        let context = AVCodec.findEncoder('rawvideo').newContext();
+        context.configure({ width: 352, height: 288, gopSize: 10, timeBase: { num: 1, den: 25 } });
+
+        expect(context.width).to.equal(352);
+        expect(context.height).to.equal(288);
+        expect(context.gopSize).to.equal(10);
+        expect(context.timeBase).to.eql({ num: 1, den: 25 });
+    });
+
+    it('rejects unknown properties in configure() without applying any', () => {
+        let context = AVCodec.findEncoder('rawvideo').newContext();
+        let original = context.width;
+
+        expect(() => context.configure(<any>{ width: 100, notAProperty: 1 })).to.throw();
+        expect(context.width).to.equal(original);
+    });
+
+    it('can be created from a template', () => {
+        let codec = AVCodec.findEncoder('rawvideo');
+        let template = new AVCodecContextTemplate(codec, { width: 352, height: 288 }, { g: 10 });
+        let contexts = [ template.newContext(), template.newContext() ];
+
+        for (let context of contexts) {
+            expect(context.width).to.equal(352);
+            expect(context.height).to.equal(288);
+            expect(context.gopSize).to.equal(10);
+        }
+
+        expect(Object.isFrozen(template.properties)).to.be.true;
+        expect(template.options).to.eql({ g: '10' });
+        expect(() => new AVCodecContextTemplate(codec, <any>{ nope: 1 })).to.throw();
+        expect(() => new AVCodecContextTemplate(codec, {}, { nope: 1 })).to.throw(/nope/);
+        expect(() => new AVCodecContextTemplate(codec, {}, { g: 'ten' })).to.throw();
+    });
+    it('can read frame properties and timings in one call', () => {
+        let frame = new AVFrame();
+        frame.setProps({ width: 64, height: 32, pts: 1234, timeBase: { num: 1, den: 90000 } });
+
+        let props = frame.getProps();
+        expect(props.width).to.equal(64);
+        expect(props.height).to.equal(32);
+        expect(props.pts).to.equal(1234);
+        expect(props.timeBase).to.eql({ num: 1, den: 90000 });
+
+        let timings = new Float64Array(6);
+        frame.readTimings(timings);
+        expect(timings[0]).to.equal(1234);
+        expect(timings[4]).to.equal(1);
+        expect(timings[5]).to.equal(90000);
+    });
+
+    it('routes decoded frames natively to several encoders', async () => {
+        await delay(250);
+
+        let decoder = AVCodec.findDecoder('rawvideo').newContext();
+        decoder.configure({ width: 352, height: 288, pixelFormat: AVPixelFormat.AV_PIX_FMT_YUV420P });
+
+        let encoders = [ createEncoderContext('rawvideo'), createEncoderContext('rawvideo') ];
+        let counts = [ 0, 0 ];
+
+        encoders.forEach((encoder, i) => {
+            decoder.routeFrames(encoder);
+            encoder.onPacket = () => counts[i] += 1;
+            encoder.open();
+        });
+
+        expect(() => encoders[0].sendFrame(createTestFrame(encoders[0]))).to.throw();
+        decoder.open();
+        expect(() => decoder.routeFrames(encoders[0])).to.throw();
+
+        for (let i = 0; i < 3; ++i)
+            decoder.sendPacket(new AVPacket(new Uint8Array(352 * 288 * 3 / 2)));
+        
+        await delay(500);
+
+        expect(counts).to.eql([ 3, 3 ]);
+        expect(decoder.routedItems).to.equal(6);
+    });
+
+    it('lets the caller reuse a packet as soon as it has been sent', async () => {
+        await delay(250);
+
+        let decoder = AVCodec.findDecoder('rawvideo').newContext();
+        decoder.configure({ width: 352, height: 288, pixelFormat: AVPixelFormat.AV_PIX_FMT_YUV420P });
+
+        let timestamps: number[] = [];
+        decoder.onFrame = (frame: AVFrameType) => timestamps.push(frame.pts);
+        decoder.open();
+
+        let packet = new AVPacket(new Uint8Array(352 * 288 * 3 / 2));
+        for (let pts = 0; pts < 3; ++pts) {
+            packet.pts = pts;
+            decoder.sendPacket(packet);
+        }
+        packet.dispose();
+
+        await delay(250);
+        expect(timestamps).to.eql([ 0, 1, 2 ]);
+    });
+
+    it('can run on the shared thread pool', async () => {
+        await delay(250);
+
+        let contexts = [ createEncoderContext('rawvideo'), createEncoderContext('rawvideo'), createEncoderContext('rawvideo') ];
+        let counts = [ 0, 0, 0 ];
+
+        contexts.forEach((context, i) => {
+            context.useThreadPool = true;
+            context.onPacket = () => counts[i] += 1;
+            context.open();
+            expect(() => context.useThreadPool = false).to.throw();
+
+            for (let j = 0; j < 3; ++j) {
+                let frame = createTestFrame(context);
+                frame.pts = j;
+                context.sendFrame(frame);
+            }
+        });
+
+        await delay(500);
+
+        expect(counts).to.eql([ 3, 3, 3 ]);
+        expect(() => AVCodecContext.configureThreadPool(2)).to.throw();
+
+        let stats = AVCodecContext.threadPoolStats();
+        expect(stats.started).to.be.true;
+        expect(stats.threads).to.be.at.least(1);
+        expect(stats.tasksRun).to.be.at.least(3);
+    });
+
+    it('can be opened asynchronously, then flushed', async () => {
+        await delay(250);
+
+        let context = createEncoderContext('rawvideo');
+        let events: string[] = [];
+
+        context.onPacket = () => events.push('packet');
+        context.onEnd = () => events.push('end');
+
+        let opening = context.openAsync();
+        expect(() => context.useThreadPool = true).to.throw();
+        expect(() => context.dispose()).to.throw();
+        await opening;
+
+        for (let i = 0; i < 3; ++i) {
+            let frame = createTestFrame(context);
+            frame.pts = i;
+            context.sendFrame(frame);
+        }
+
+        await context.flush();
+
+        expect(events).to.eql([ 'packet', 'packet', 'packet', 'end' ]);
+    });
+
+    it('measures its hot path', async () => {
+        await delay(250);
+
+        let context = createEncoderContext('rawvideo');
+        let count = 0;
+
+        context.onPacket = () => count += 1;
+        context.open();
+
+        for (let i = 0; i < 3; ++i) {
+            let frame = createTestFrame(context);
+            frame.pts = i;
+            context.sendFrame(frame);
+        }
+
+        await delay(250);
+
+        let stats = context.getStats();
+        expect(count).to.equal(3);
+        expect(stats.queueWait.count).to.equal(3);
+        expect(stats.send.count).to.equal(3);
+        expect(stats.receive.count).to.equal(3);
+        expect(stats.delivery.count).to.equal(3);
+        expect(stats.delivery.p99Us).to.be.at.least(stats.delivery.p50Us);
+        expect(stats.delivery.maxUs).to.be.at.least(stats.delivery.p99Us);
+        expect(stats.errors).to.equal(0);
+        expect(stats.queueDepth).to.equal(0);
+        expect(stats.pools.packets.misses).to.be.at.least(1);
+    });
+
+    it('shares the cores among contexts with fairThreadCount', async () => {
+        let contexts = [ createEncoderContext('rawvideo'), createEncoderContext('rawvideo') ];
+        let custom = createEncoderContext('rawvideo');
+
+        contexts.forEach(context => (context.fairThreadCount = true, context.open()));
+        custom.fairThreadCount = true;
+        custom.threadCount = 1;
+        custom.open();
+
+        expect(contexts[0].threadCount).to.be.at.least(contexts[1].threadCount);
+        expect(contexts[1].threadCount).to.be.at.least(1);
+        expect(custom.threadCount).to.equal(1);
+        expect(() => custom.threadType = FF_THREAD_SLICE).to.throw();
+        contexts.concat([ custom ]).forEach(context => context.dispose());
+    });
+
+    it('gives every context the same share with configureFairThreads()', async () => {
+        let contexts = [ createEncoderContext('rawvideo'), createEncoderContext('rawvideo') ];
+
+        AVCodecContext.configureFairThreads(2);
+        try {
+            contexts.forEach(context => (context.fairThreadCount = true, context.open()));
+            expect(contexts[0].threadCount).to.equal(contexts[1].threadCount);
+            expect(() => AVCodecContext.configureFairThreads(-1)).to.throw();
+        } finally {
+            AVCodecContext.configureFairThreads(0);
+            contexts.forEach(context => context.dispose());
+        }
+    });
+
+    it('decodes into pooled buffers with bufferPoolSize', async () => {
+        let encoder = AVCodec.findEncoder('mpeg2video').newContext();
+        let decoder = AVCodec.findDecoder('mpeg2video').newContext();
+        let frames = 0;
+
+        encoder.bitRate = 400000;
+        encoder.width = decoder.width = 352;
+        encoder.height = decoder.height = 288;
+        encoder.timeBase = { num: 1, den: 25 };
+        encoder.pixelFormat = decoder.pixelFormat = AVPixelFormat.AV_PIX_FMT_YUV420P;
+        decoder.bufferPoolSize = 8;
+        decoder.bufferPoolPrewarm = 2;
+        expect(decoder.bufferPoolPrewarm).to.equal(2);
+
+        encoder.onPacket = packet => decoder.sendPacket(<AVPacketType>packet);
+        decoder.onFrame = frame => (frames += 1, (<AVFrameType>frame).dispose());
+        encoder.open();
+        decoder.open();
+        expect(() => decoder.bufferPoolSize = 4).to.throw();
+
+        // Warmed up at open: 2 frames of 3 planes
+        expect(decoder.poolStats.buffers.allocations).to.equal(6);
+
+        for (let i = 0; i < 3; ++i) {
+            let frame = createTestFrame(encoder);
+            frame.pts = i;
+            encoder.sendFrame(frame);
+        }
+
+        await encoder.flush();
+        await decoder.flush();
+
+        let buffers = decoder.poolStats.buffers;
+        expect(frames).to.equal(3);
+        expect(buffers.frames + buffers.overflows).to.be.at.least(3);
+        expect(buffers.allocations).to.be.at.most(8 * 3 * buffers.layouts);
+
+        encoder.dispose();
+        decoder.dispose();
+    });
+
+    it('attaches frame statistics to decoded frames', async () => {
+        let encoder = AVCodec.findEncoder('mpeg2video').newContext();
+        let decoder = AVCodec.findDecoder('mpeg2video').newContext();
+        let statistics: { mean: number, histogram: string, frozen: string }[] = [];
+
+        encoder.bitRate = 400000;
+        encoder.width = 352;
+        encoder.height = 288;
+        encoder.timeBase = { num: 1, den: 25 };
+        encoder.pixelFormat = AVPixelFormat.AV_PIX_FMT_YUV420P;
+        decoder.frameStatistics = { histogram: true };
+        expect((<any>decoder.frameStatistics).histogram).to.be.true;
+
+        encoder.onPacket = packet => decoder.sendPacket(<AVPacketType>packet);
+        decoder.onFrame = frame => {
+            let metadata = (<AVFrameType>frame).metadata;
+            let frozen = metadata.get('nlav.stats.frozen');
+
+            statistics.push({
+                mean: Number(metadata.get('nlav.stats.mean.0').value),
+                histogram: metadata.get('nlav.stats.histogram').value,
+                frozen: frozen ? frozen.value : undefined
+            });
+            (<AVFrameType>frame).dispose();
+        };
+
+        encoder.open();
+        decoder.open();
+        expect(() => decoder.frameStatistics = null).to.throw();
+
+        for (let i = 0; i < 2; ++i) {
+            let frame = createTestFrame(encoder);
+            frame.pts = i;
+            encoder.sendFrame(frame);
+        }
+
+        await encoder.flush();
+        await decoder.flush();
+
+        expect(statistics.length).to.equal(2);
+        expect(statistics[0].mean).to.be.within(0, 255);
+        expect(statistics[0].histogram.split(',').length).to.equal(256);
+        expect(statistics[0].frozen).to.be.undefined;
+        expect(statistics[1].frozen).to.be.oneOf(['0', '1']);
+
+        encoder.dispose();
+        decoder.dispose();
+    });
+
+    it('can be used from several worker threads at once', async () => {
+        // Zero-copy packets: the codec threads drop the last reference to memory owned by each worker's env
+        let code = `
+            const { parentPort, workerData } = require('worker_threads');
+            const { AVCodec, AVPacket } = require(workerData.binding);
+
+            (async () => {
+                const decoder = AVCodec.findDecoder('rawvideo').newContext();
+                const size = 352 * 288 * 3 / 2;
+                let frames = 0;
+
+                decoder.width = 352;
+                decoder.height = 288;
+                decoder.pixelFormat = 0; // AV_PIX_FMT_YUV420P
+                decoder.onFrame = () => frames += 1;
+                decoder.open();
+
+                for (let i = 0; i < 50; ++i)
+                    await decoder.sendPacketAsync(new AVPacket(new Uint8Array(size + 64), true));
+                
+                await decoder.flush();
+                parentPort.postMessage(frames);
+            })();
+        `;
+
+        let workers = [ 0, 1, 2, 3 ].map(() => new Worker(code, { eval: true, workerData: { binding: path.resolve(__dirname, '../../binding') } }));
+        let results = await Promise.all(workers.map(worker => new Promise<number>((resolve, reject) => {
+            worker.once('message', resolve);
+            worker.once('error', reject);
+        })));
+
+        await Promise.all(workers.map(worker => worker.terminate()));
+        expect(results).to.eql([ 50, 50, 50, 50 ]);
+    });
+});
@@ -21,4 +21,21 @@ describe('AVCodec', it => {
         expect(AVCodec.findDecoder("apng")).to.exist;
         expect(AVCodec.findDecoder("apng").id).to.equal(AVCodecID.AV_CODEC_ID_APNG);
     });
+    it("returns the same frozen arrays on each call", () => {
+        let codec = AVCodec.findEncoder("rawvideo");
+
+        expect(AVCodec.all()).to.equal(AVCodec.all());
+        expect(Object.isFrozen(AVCodec.all())).to.be.true;
+        expect(AVCodec.findEncoder("rawvideo")).to.equal(codec);
+        expect(AVCodec.findDecoder("no-such-codec")).to.be.null;
+        expect(codec.pixelFormats).to.equal(codec.pixelFormats);
+        expect(codec.sampleFormats).to.eql([]);
+    });
+    it("keeps cached codecs usable after dispose()", () => {
+        AVCodec.findEncoder("rawvideo").dispose();
+        AVCodec.all()[0].dispose();
+
+        expect(AVCodec.findEncoder("rawvideo").name).to.equal("rawvideo");
+        expect(AVCodec.all()[0].name).to.be.a('string');
+    });
 });
\ No newline at end of file
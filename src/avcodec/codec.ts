@@ -181,6 +181,11 @@ export const AV_CODEC_CAP_ENCODER_FLUSH =   (1 << 21);
 export declare class AVProfile {
     readonly profile: number;
     readonly name: string; ///< short name for the profile
+
+    /**
+     * Does nothing, profiles describe static data shared with every other caller of AVCodec#profiles.
+     */
+    dispose(): void;
 }
 
 /**
@@ -191,7 +196,13 @@ export declare class AVCodec {
     static readonly configuration: string;
     static readonly license: string;
 
+    /**
+     * The codecs, and the lists describing each of them (pixelFormats, sampleFormats, profiles and so 
+     * on), never change, so they are built once per thread and the same frozen array is returned on each 
+     * call. findDecoder()/findEncoder() remember the codecs they found by name and by ID.
+     */
     static all(): AVCodec[];
+
     static findDecoder(name: string): AVCodec;
     static findDecoder(id: AVCodecID): AVCodec;
     static findEncoder(name: string): AVCodec;
@@ -249,6 +260,12 @@ export declare class AVCodec {
     readonly isDecoder: boolean;
 
     getProfile(profile: number): AVProfile;
+
+    /**
+     * Does nothing, codecs describe static data shared with every other caller of all() / findDecoder() 
+     * and so on.
+     */
+    dispose(): void;
 }
 
 /**
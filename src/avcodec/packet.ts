@@ -344,8 +344,13 @@ export declare class AVPacket {
     /**
      * Create a new AVPacket, optionally initializing it with the given data.
      * @param initialData 
+     * @param zeroCopy When true, the packet refers to initialData's memory directly instead of copying it,
+     *                 so initialData must not be modified while the packet (or a decoder) still uses it.
+     *                 libavcodec requires AV_INPUT_BUFFER_PADDING_SIZE (64) zeroed bytes after the packet 
+     *                 data, which must be the last 64 bytes of initialData: the packet data is the rest. If 
+     *                 they are not all zero, the data is copied as usual.
      */
-    constructor(initialData?: Uint8Array);
+    constructor(initialData?: Uint8Array, zeroCopy?: boolean);
 
     /**
      * A reference to the reference-counted buffer where the packet data is
@@ -386,6 +391,18 @@ export declare class AVPacket {
     readonly sideData: AVPacketSideData[];
     readonly sideDataCount: number;
 
+    /**
+     * The type and size of each side data of this packet, in order. Unlike sideData, no objects are
+     * created for the side data themselves.
+     */
+    readonly sideDataTypes: { type: AVPacketSideDataType, size: number }[];
+
+    /**
+     * Retrieve a copy of the payload of the side data with the given type, without creating an
+     * AVPacketSideData object for it. Null if the packet has no side data of this type.
+     */
+    getSideDataRaw(type: AVPacketSideDataType): Uint8Array;
+
     /**
      * Duration of this packet in AVStream->time_base units, 0 if unknown.
      * Equals next_pts - this_pts in presentation order.
@@ -413,6 +430,18 @@ export declare class AVPacket {
      * or muxers.
      */
     timeBase: AVRational;
+
+    /**
+     * Free the packet now instead of waiting for the garbage collector. Packets received from a codec 
+     * context are returned to the context's pool for reuse. The packet must not be used afterwards.
+     */
+    release(): void;
+
+    /**
+     * Release the underlying packet now instead of waiting for the garbage collector. Accessing 
+     * the object afterwards throws. Also available as [Symbol.dispose] where the runtime supports it.
+     */
+    dispose(): void;
 }
 
 /**
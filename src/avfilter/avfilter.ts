@@ -0,0 +1,123 @@
+import { AVFrame, AVMediaType, AVPixelFormat, AVRational, AVSampleFormat } from "../avutil";
+import { AVCodecContextError } from "../avcodec";
+
+/**
+ * The frames an input of a filter graph receives. Video inputs need width, height, pixelFormat and
+ * timeBase, audio inputs sampleRate, sampleFormat and channelLayout (timeBase defaults to 1/sampleRate).
+ */
+export interface AVFilterGraphInput {
+    /**
+     * Label of the input in the graph description. Defaults to "in", "in1", "in2", ...
+     */
+    name?: string;
+    timeBase?: AVRational;
+
+    width?: number;
+    height?: number;
+    pixelFormat?: AVPixelFormat;
+    sampleAspectRatio?: AVRational;
+    frameRate?: AVRational;
+
+    sampleRate?: number;
+    sampleFormat?: AVSampleFormat;
+    channelLayout?: number;
+}
+
+export interface AVFilterGraphOutput {
+    /**
+     * Label of the output in the graph description. Defaults to "out", "out1", "out2", ...
+     */
+    name?: string;
+
+    /**
+     * AVMEDIA_TYPE_VIDEO (the default) or AVMEDIA_TYPE_AUDIO
+     */
+    mediaType?: AVMediaType;
+}
+
+/**
+ * A libavfilter graph, such as "yadif", "fps=30" or "[in][in1]overlay=10:10[out]". Filtering happens on a
+ * thread of its own (or on the shared thread pool, see useThreadPool): frames go in with sendFrame() and
+ * come out through onFrame, like decoded frames of an AVCodecContext.
+ * 
+ * Add the inputs and outputs, then open() the graph with a description. Labeled pads of the description
+ * connect to the input/output of the same name, unlabeled ones to the inputs/outputs in order.
+ */
+export declare class AVFilterGraph {
+    constructor();
+
+    /**
+     * Called with each filtered frame, and the index of the output it came from. Frames are not filtered
+     * while this is not set.
+     */
+    onFrame: (frame: AVFrame, output: number) => void;
+    onError: (error: AVCodecContextError) => void;
+
+    /**
+     * Called once every output has ended, see flush()
+     */
+    onEnd: () => void;
+
+    readonly opened: boolean;
+    readonly inputs: number;
+    readonly outputs: number;
+
+    /**
+     * Number of frames waiting for the filter thread
+     */
+    readonly queueDepth: number;
+
+    /**
+     * Number of frames which can be queued before sendFrame() refuses more. Defaults to 128.
+     */
+    maxQueuedItems: number;
+
+    /**
+     * Threads used by filters which support slice threading (0, the default, for automatic). Only 
+     * possible before open().
+     */
+    threads: number;
+
+    /**
+     * Run on the shared thread pool (see AVCodecContext.configureThreadPool()) instead of a thread of
+     * its own. Only possible before open().
+     */
+    useThreadPool: boolean;
+
+    /**
+     * @returns the index of the input
+     */
+    addInput(input: AVFilterGraphInput): number;
+
+    /**
+     * @returns the index of the output
+     */
+    addOutput(output?: AVFilterGraphOutput): number;
+
+    open(description: string): void;
+    configure(properties: Partial<AVFilterGraph>): void;
+
+    /**
+     * Queue a frame for the given input (0 by default). The graph takes a reference to the frame's data,
+     * so the frame can be reused right away.
+     * @returns false if the queue is full, in which case the frame is not taken
+     */
+    sendFrame(frame: AVFrame, input?: number): boolean;
+
+    /**
+     * Like sendFrame(), waiting for room in the queue if necessary.
+     * @returns a promise which resolves once the frame has been queued
+     */
+    sendFrameAsync(frame: AVFrame, input?: number): Promise<void>;
+
+    /**
+     * End all inputs, so that the filters output the frames they are holding back. onEnd is called once 
+     * all outputs are done.
+     */
+    flush(): Promise<void>;
+
+    /**
+     * A human-readable description of the configured graph
+     */
+    dump(): string;
+}
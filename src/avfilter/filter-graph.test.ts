@@ -0,0 +1,93 @@
+import { describe } from "razmin";
+import { AVFilterGraph as AVFilterGraphType } from "./avfilter";
+import { AVFilterGraph as AVFilterGraphImpl } from "../../binding";
+import { AVFrame as AVFrameType, AVPixelFormat } from "../avutil";
+import { AVFrame as AVFrameImpl } from "../../binding";
+import { expect } from "chai";
+
+const AVFilterGraph = <typeof AVFilterGraphType>AVFilterGraphImpl;
+const AVFrame = <typeof AVFrameType>AVFrameImpl;
+
+describe("AVFilterGraph", it => {
+    function createTestFrame(pts: number) {
+        let frame = new AVFrame();
+        frame.format = AVPixelFormat.AV_PIX_FMT_YUV420P;
+        frame.width = 64;
+        frame.height = 48;
+        frame.allocateBuffer();
+        frame.pts = pts;
+
+        return frame;
+    }
+
+    function createGraph() {
+        let graph = new AVFilterGraph();
+        graph.addInput({ width: 64, height: 48, pixelFormat: AVPixelFormat.AV_PIX_FMT_YUV420P, timeBase: { num: 1, den: 25 } });
+        graph.addOutput();
+
+        return graph;
+    }
+
+    it('filters frames off the main thread', async () => {
+        let graph = createGraph();
+        let frames: AVFrameType[] = [];
+        let ended = new Promise<void>(resolve => graph.onEnd = resolve);
+
+        graph.onFrame = frame => frames.push(frame);
+        graph.open('scale=32:24');
+
+        for (let i = 0; i < 5; ++i)
+            await graph.sendFrameAsync(createTestFrame(i));
+
+        await graph.flush();
+        await ended;
+
+        expect(frames.length).to.equal(5);
+        expect(frames[0].width).to.equal(32);
+        expect(frames[4].pts).to.equal(4);
+    });
+
+    it('delivers every frame while holding the graph back', async () => {
+        let graph = createGraph();
+        let pts: number[] = [];
+        let ended = new Promise<void>(resolve => graph.onEnd = resolve);
+
+        graph.onFrame = frame => (pts.push(frame.pts), frame.release());
+        graph.open('null');
+
+        // More frames than the filter thread posts ahead of us
+        for (let i = 0; i < 32; ++i)
+            graph.sendFrame(createTestFrame(i));
+
+        await graph.flush();
+        await ended;
+
+        expect(pts).to.eql(Array.from({ length: 32 }, (_, i) => i));
+    });
+
+    it('rejects anything but a frame', () => {
+        let graph = createGraph();
+        graph.open('null');
+
+        expect(() => graph.sendFrame(<any>{})).to.throw(TypeError);
+        expect(() => graph.sendFrame(undefined)).to.throw(TypeError);
+    });
+
+    it('connects labeled inputs', () => {
+        let graph = new AVFilterGraph();
+        graph.addInput({ name: 'main', width: 64, height: 48, pixelFormat: AVPixelFormat.AV_PIX_FMT_YUV420P, timeBase: { num: 1, den: 25 } });
+        graph.addInput({ name: 'logo', width: 16, height: 16, pixelFormat: AVPixelFormat.AV_PIX_FMT_YUV420P, timeBase: { num: 1, den: 25 } });
+        graph.addOutput();
+        graph.open('[main][logo]overlay=4:4');
+
+        expect(graph.inputs).to.equal(2);
+        expect(graph.dump()).to.contain('overlay');
+    });
+
+    it('rejects descriptions which leave inputs unused', () => {
+        let graph = createGraph();
+        graph.addInput({ name: 'extra', width: 64, height: 48, pixelFormat: AVPixelFormat.AV_PIX_FMT_YUV420P, timeBase: { num: 1, den: 25 } });
+
+        expect(() => graph.open('null')).to.throw();
+    });
+});
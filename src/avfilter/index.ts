@@ -0,0 +1 @@
+export * from './avfilter';
\ No newline at end of file
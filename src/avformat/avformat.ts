@@ -18,7 +18,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
-import { AVCodec, AVCodecID, AVCodecParameters, AVCodecParserContext, AVDiscard, AVPacket, AVPacketSideData, AVPacketSideDataType } from "../avcodec";
+import { AVCodec, AVCodecContext, AVCodecID, AVCodecParameters, AVCodecParserContext, AVDiscard, AVPacket, AVPacketSideData, AVPacketSideDataType } from "../avcodec";
 import { AVDeviceInfoList } from "../avdevice";
 import { AVClass, AVDictionary, AVFrame, AVMediaType, AVRational } from "../avutil";
 import { FILE, OpaquePtr, Out, Ref } from "../helpers";
@@ -1020,15 +1020,23 @@ export const AVSTREAM_EVENT_FLAG_NEW_PACKETS = (1 << 1);
  * version bump.
  * sizeof(AVStream) must not be used outside libav*.
  */
-export interface AVStream {
+export declare class AVStream {
     /**
-     * A class for @ref avoptions. Set on stream creation.
-     * @if FF_API_AVSTREAM_CLASS
+     * Copy the codec parameters of this stream into the given codec context (avcodec_parameters_to_context),
+     * for instance to set up a decoder for it. Also sets the context's packet time base.
      */
-    av_class: AVClass;
- 
-    /**< stream index in AVFormatContext */
-    index: number;
+    copyParametersTo(context: AVCodecContext): void;
+
+    /**
+     * Copy the codec parameters of the given (opened) codec context into this stream 
+     * (avcodec_parameters_from_context), for instance to describe an encoder's output when muxing.
+     */
+    copyParametersFrom(context: AVCodecContext): void;
+
+    /**
+     * stream index in AVFormatContext
+     */
+    readonly index: number;
 
     /**
      * Format-specific stream ID.
@@ -1036,9 +1044,7 @@ export interface AVStream {
      * encoding: set by the user, replaced by libavformat if left unset
      */
     id: number;
- 
-    priv_data: Buffer;
- 
+
     /**
      * This is the fundamental unit of time (in seconds) in terms
      * of which frame timestamps are represented.
@@ -1051,31 +1057,28 @@ export interface AVStream {
      *           written into the file (which may or may not be related to the
      *           user-provided one, depending on the format).
      */
-    time_base: AVRational;
- 
+    timeBase: AVRational;
+
     /**
      * Decoding: pts of the first frame of the stream in presentation order, in stream time base.
      * Only set this if you are absolutely 100% sure that the value you set
      * it to really is the pts of the first frame.
      * This may be undefined (AV_NOPTS_VALUE).
-     * @note The ASF header does NOT contain a correct start_time the ASF
-     * demuxer must NOT set this.
      */
-    start_time: number;
- 
+    readonly startTime: number;
+
     /**
      * Decoding: duration of the stream, in stream time base.
      * If a source file does not specify a duration, but does specify
      * a bitrate, this value will be estimated from bitrate and file size.
-     *
-     * Encoding: May be set by the caller before avformat_write_header() to
-     * provide a hint to the muxer about the estimated duration.
      */
-    duration: number;
- 
-    ///< number of frames in this stream if known or 0
-    nb_frames: number;
- 
+    readonly duration: number;
+
+    /**
+     * number of frames in this stream if known or 0
+     */
+    readonly frameCount: number;
+
     /**
      * Stream disposition - a combination of AV_DISPOSITION_* flags.
      * - demuxing: set by libavformat when creating the stream or in
@@ -1083,19 +1086,19 @@ export interface AVStream {
      * - muxing: may be set by the caller before avformat_write_header().
      */
     disposition: number;
- 
-    ///< Selects which packets can be discarded at will and do not need to be demuxed.
+
+    /**
+     * Selects which packets can be discarded at will and do not need to be demuxed.
+     */
     discard: AVDiscard;
- 
+
     /**
      * sample aspect ratio (0 if unknown)
      * - encoding: Set by user.
      * - decoding: Set by libavformat.
      */
-    sample_aspect_ratio: AVRational;
- 
-    metadata: AVDictionary;
- 
+    sampleAspectRatio: AVRational;
+
     /**
      * Average framerate
      *
@@ -1103,83 +1106,62 @@ export interface AVStream {
      *             avformat_find_stream_info().
      * - muxing: May be set by the caller before avformat_write_header().
      */
-    avg_frame_rate: AVRational;
- 
+    averageFrameRate: AVRational;
+
     /**
-     * For streams with AV_DISPOSITION_ATTACHED_PIC disposition, this packet
-     * will contain the attached picture.
-     *
-     * decoding: set by libavformat, must not be modified by the caller.
-     * encoding: unused
+     * Real base framerate of the stream.
+     * This is the lowest framerate with which all timestamps can be
+     * represented accurately (it is the least common multiple of all
+     * framerates in the stream). Note, this value is just a guess!
      */
-    attached_pic: AVPacket;
- 
+    readonly realFrameRate: AVRational;
+
     /**
-     * An array of side data that applies to the whole stream (i.e. the
-     * container does not allow it to change between packets).
-     *
-     * There may be no overlap between the side data in this array and side data
-     * in the packets. I.e. a given side data is either exported by the muxer
-     * (demuxing) / set by the caller (muxing) in this array, then it never
-     * appears in the packets, or the side data is exported / sent through
-     * the packets (always in the first packet where the value becomes known or
-     * changes), then it does not appear in this array.
-     *
-     * - demuxing: Set by libavformat when the stream is created.
-     * - muxing: May be set by the caller before avformat_write_header().
-     *
-     * Freed by libavformat in avformat_free_context().
-     *
-     * @see av_format_inject_global_side_data()
+     * A copy of the stream's metadata.
      */
-    side_data: AVPacketSideData;
+    readonly metadata: AVDictionary;
+
     /**
-     * The number of elements in the AVStream.side_data array.
+     * General type of the encoded data (from the codec parameters).
      */
-    nb_side_data: number;
- 
+    readonly codecType: AVMediaType;
+
     /**
-     * Flags indicating events happening on the stream, a combination of
-     * AVSTREAM_EVENT_FLAG_*.
-     *
-     * - demuxing: may be set by the demuxer in avformat_open_input(),
-     *   avformat_find_stream_info() and av_read_frame(). Flags must be cleared
-     *   by the user once the event has been handled.
-     * - muxing: may be set by the user after avformat_write_header(). to
-     *   indicate a user-triggered event.  The muxer will clear the flags for
-     *   events it has handled in av_[interleaved]_write_frame().
+     * Specific type of the encoded data (the codec used, from the codec parameters).
      */
-    event_flags: number;
+    readonly codecId: AVCodecID;
 
     /**
-     * Real base framerate of the stream.
-     * This is the lowest framerate with which all timestamps can be
-     * represented accurately (it is the least common multiple of all
-     * framerates in the stream). Note, this value is just a guess!
-     * For example, if the time base is 1/90000 and all frames have either
-     * approximately 3600 or 1800 timer ticks, then r_frame_rate will be 50/1.
+     * Additional information about the codec (corresponds to the AVI FOURCC).
      */
-    r_frame_rate: AVRational;
- 
+    codecTag: number;
+
     /**
-     * Codec parameters associated with this stream. Allocated and freed by
-     * libavformat in avformat_new_stream() and avformat_free_context()
-     * respectively.
-     *
-     * - demuxing: filled by libavformat on stream creation or in
-     *             avformat_find_stream_info()
-     * - muxing: filled by the caller before avformat_write_header()
+     * The pixel format (video) or sample format (audio) of the stream, from the codec parameters.
      */
-    codecpar: AVCodecParameters;
- 
+    readonly format: number;
+
     /**
-     * Number of bits in timestamps. Used for wrapping control.
-     *
-     * - demuxing: set by libavformat
-     * - muxing: set by libavformat
-     *
+     * The average bitrate of the encoded data (in bits per second).
+     */
+    readonly bitRate: number;
+
+    /**
+     * The dimensions of the video frame in pixels.
+     */
+    readonly width: number;
+    readonly height: number;
+
+    /**
+     * Audio only. The number of audio samples per second.
+     */
+    readonly sampleRate: number;
+
+    /**
+     * Stop using this stream object now instead of waiting for the garbage collector. Streams 
+     * belong to their format context and are disposed along with it.
      */
-    pts_wrap_bits: number;
+    dispose(): void;
 }
  
 export function av_stream_get_parser(s: AVStream): AVCodecParserContext { throw new Error('NotImplemented'); }
@@ -1358,6 +1340,11 @@ export const AVFMT_AVOID_NEG_TS_MAKE_NON_NEGATIVE = 1;
 export const AVFMT_AVOID_NEG_TS_MAKE_ZERO =         2;
 
 
+export interface AVFormatContextError {
+    code: string;
+    message: string;
+}
+
 /**
  * Format I/O context.
  * New fields can be added to the end with minor version bumps.
@@ -1372,577 +1359,279 @@ export const AVFMT_AVOID_NEG_TS_MAKE_ZERO =         2;
  * The AVOption/command line parameter names differ in some cases from the C
  * structure field names for historic reasons or brevity.
  */
-export interface AVFormatContext {
-    /**
-     * A class for logging and @ref avoptions. Set by avformat_alloc_context().
-     * Exports (de)muxer private options if they exist.
-     */
-    av_class: AVClass;
- 
-    /**
-     * The input container format.
-     *
-     * Demuxing only, set by avformat_open_input().
-     */
-    iformat: AVInputFormat;
- 
-    /**
-     * The output container format.
-     *
-     * Muxing only, must be set by the caller before avformat_write_header().
-     */
-    oformat: AVOutputFormat;
- 
-    /**
-     * Format private data. This is an AVOptions-enabled struct
-     * if and only if iformat/oformat.priv_class is not NULL.
-     *
-     * - muxing: set by avformat_write_header()
-     * - demuxing: set by avformat_open_input()
-     */
-    priv_data: Buffer;
- 
-    /**
-     * I/O context.
-     *
-     * - demuxing: either set by the user before avformat_open_input() (then
-     *             the user must close it manually) or set by avformat_open_input().
-     * - muxing: set by the user before avformat_write_header(). The caller must
-     *           take care of closing / freeing the IO context.
-     *
-     * Do NOT set this field if AVFMT_NOFILE flag is set in
-     * iformat/oformat.flags. In such a case, the (de)muxer will handle
-     * I/O in some other way and this field will be NULL.
-     */
-    pb: AVIOContext;
- 
-    /* stream info */
-    /**
-     * Flags signalling stream properties. A combination of AVFMTCTX_*.
-     * Set by libavformat.
-     */
-    ctx_flags: number;
- 
-    /**
-     * Number of elements in AVFormatContext.streams.
-     *
-     * Set by avformat_new_stream(), must not be modified by any other code.
-     */
-    nb_streams: number;
-    /**
-     * A list of all streams in the file. New streams are created with
-     * avformat_new_stream().
-     *
-     * - demuxing: streams are created by libavformat in avformat_open_input().
-     *             If AVFMTCTX_NOHEADER is set in ctx_flags, then new streams may also
-     *             appear in av_read_frame().
-     * - muxing: streams are created by the user before avformat_write_header().
-     *
-     * Freed by libavformat in avformat_free_context().
-     */
-    streams: AVStream[];
- 
-    /**
-     * input or output URL. Unlike the old filename field, this field has no
-     * length restriction.
-     *
-     * - demuxing: set by avformat_open_input(), initialized to an empty
-     *             string if url parameter was NULL in avformat_open_input().
-     * - muxing: may be set by the caller before calling avformat_write_header()
-     *           (or avformat_init_output() if that is called first) to a string
-     *           which is freeable by av_free(). Set to an empty string if it
-     *           was NULL in avformat_init_output().
-     *
-     * Freed by libavformat in avformat_free_context().
-     */
-    url: string;
- 
+export declare class AVFormatContext {
+    constructor();
+
     /**
-     * Position of the first frame of the component, in
-     * AV_TIME_BASE fractional seconds. NEVER set this value directly:
-     * It is deduced from the AVStream values.
-     *
-     * Demuxing only, set by libavformat.
+     * Callback called with each packet read by the read thread (see startReading()). When batchSize 
+     * is greater than 1, this is called with an array of packets instead. Packets of routed streams 
+     * (see routeStream()) are not delivered here.
      */
-    start_time: number;
- 
+    onPacket: (packet: AVPacket | AVPacket[]) => void;
+
     /**
-     * Duration of the stream, in AV_TIME_BASE fractional
-     * seconds. Only set this value if you know none of the individual stream
-     * durations and also do not set any of them. This is deduced from the
-     * AVStream values if not set.
-     *
-     * Demuxing only, set by libavformat.
+     * Callback called when the read thread stops because of an error.
      */
-    duration: number;
- 
-    /**
-     * Total stream bitrate in bit/s, 0 if not
-     * available. Never set it directly if the file_size and the
-     * duration are known as FFmpeg can compute it automatically.
-     */
-    bit_rate: number;
- 
-    packet_size: number;
-    max_delay: number;
- 
+    onError: (error: AVFormatContextError) => void;
+
     /**
-     * Flags modifying the (de)muxer behaviour. A combination of AVFMT_FLAG_*.
-     * Set by the user before avformat_open_input() / avformat_write_header().
+     * Callback called when the read thread has reached the end of the input.
      */
-    flags: number;
- 
+    onEnd: () => void;
+
     /**
-     * Maximum number of bytes read from input in order to determine stream
-     * properties. Used when reading the global header and in
-     * avformat_find_stream_info().
-     *
-     * Demuxing only, set by the caller before avformat_open_input().
+     * Open an input stream and read the header. The codecs are not opened.
      *
-     * @note this is \e not  used for determining the \ref AVInputFormat
-     *       "input format"
-     * @sa format_probesize
-     */
-    probesize: number;
- 
-    /**
-     * Maximum duration (in AV_TIME_BASE units) of the data read
-     * from input in avformat_find_stream_info().
-     * Demuxing only, set by the caller before avformat_find_stream_info().
-     * Can be set to 0 to let avformat choose using a heuristic.
-     */
-    max_analyze_duration: number;
- 
-    key: Buffer;
-    keylen: number;
- 
-    nb_programs: number;
-    programs: AVProgram[];
- 
-    /**
-     * Forced video codec_id.
-     * Demuxing: Set by user.
-     */
-    video_codec_id: AVCodecID;
- 
-    /**
-     * Forced audio codec_id.
-     * Demuxing: Set by user.
-     */
-    audio_codec_id: AVCodecID;
- 
-    /**
-     * Forced subtitle codec_id.
-     * Demuxing: Set by user.
+     * @param url URL of the stream to open.
+     * @param format If given, this forces a specific input format (by short name).
+     *               Otherwise the format is autodetected.
+     * @param options A dictionary filled with AVFormatContext and demuxer-private options.
+     *                On return it is replaced with a dictionary containing the options which were 
+     *                not found.
      */
-    subtitle_codec_id: AVCodecID;
- 
+    openInput(url: string, format?: string, options?: AVDictionary): void;
+
     /**
-     * Maximum amount of memory in bytes to use for the index of each stream.
-     * If the index exceeds this size, entries will be discarded as
-     * needed to maintain a smaller size. This can lead to slower or less
-     * accurate seeking (depends on demuxer).
-     * Demuxers for which a full in-memory index is mandatory will ignore
-     * this.
-     * - muxing: unused
-     * - demuxing: set by user
+     * Read packets of a media file to get stream information. This
+     * is useful for file formats with no headers such as MPEG. This
+     * function also computes the real framerate in case of MPEG-2 repeat
+     * frame mode.
+     * The logical file position is not changed by this function;
+     * examined packets may be buffered for later processing.
      */
-    max_index_size: number;
- 
+    findStreamInfo(): void;
+
     /**
-     * Maximum amount of memory in bytes to use for buffering frames
-     * obtained from realtime capture devices.
+     * Like openInput(), but the header is read on a worker thread. Use this with a custom I/O context
+     * whose input is still being written: reads on the Javascript thread cannot wait for more input, 
+     * and fail with EAGAIN instead. Nothing else can be done with the format context until the 
+     * returned promise settles.
      */
-    max_picture_buffer: number;
- 
+    openInputAsync(url: string, format?: string, options?: AVDictionary): Promise<void>;
+
     /**
-     * Number of chapters in AVChapter array.
-     * When muxing, chapters are normally written in the file header,
-     * so nb_chapters should normally be initialized before write_header
-     * is called. Some muxers (e.g. mov and mkv) can also write chapters
-     * in the trailer.  To write chapters in the trailer, nb_chapters
-     * must be zero when write_header is called and non-zero when
-     * write_trailer is called.
-     * - muxing: set by user
-     * - demuxing: set by libavformat
+     * Like findStreamInfo(), but the packets are read on a worker thread (see openInputAsync()).
      */
-    nb_chapters: number;
-    chapters: AVChapter[];
- 
-    /**
-     * Metadata that applies to the whole file.
-     *
-     * - demuxing: set by libavformat in avformat_open_input()
-     * - muxing: may be set by the caller before avformat_write_header()
-     *
-     * Freed by libavformat in avformat_free_context().
-     */
-    metadata: AVDictionary;
- 
+    findStreamInfoAsync(): Promise<void>;
+
     /**
-     * Start time of the stream in real world time, in microseconds
-     * since the Unix epoch (00:00 1st January 1970). That is, pts=0 in the
-     * stream was captured at this real world time.
-     * - muxing: Set by the caller before avformat_write_header(). If set to
-     *           either 0 or AV_NOPTS_VALUE, then the current wall-time will
-     *           be used.
-     * - demuxing: Set by libavformat. AV_NOPTS_VALUE if unknown. Note that
-     *             the value may become known after some number of frames
-     *             have been received.
+     * Return the next packet of the input, or null at the end of the input. When a packet is given, 
+     * it is reused. Not available while the read thread is running.
      */
-    start_time_realtime: number;
- 
+    readFrame(packet?: AVPacket): AVPacket | null;
+
     /**
-     * The number of frames used for determining the framerate in
-     * avformat_find_stream_info().
-     * Demuxing only, set by the caller before avformat_find_stream_info().
+     * Start reading the input on a separate thread. Packets are delivered to onPacket (or to the codec 
+     * context their stream is routed to), onEnd is called at the end of the input. The thread reads at 
+     * most readAheadPackets ahead of onPacket.
      */
-    fps_probe_size: number;
- 
+    startReading(): void;
+
     /**
-     * Error recognition; higher values will detect more errors but may
-     * misdetect some more or less valid parts as errors.
-     * Demuxing only, set by the caller before avformat_open_input().
+     * Stop the read thread.
+     * @returns a promise which resolves once all packets read by the thread have been delivered
      */
-    error_recognition: number;
- 
+    stopReading(): Promise<void>;
+
     /**
-     * Custom interrupt callbacks for the I/O layer.
-     *
-     * demuxing: set by the user before avformat_open_input().
-     * muxing: set by the user before avformat_write_header()
-     * (mainly useful for AVFMT_NOFILE formats). The callback
-     * should also be passed to avio_open2() if it's used to
-     * open the file.
+     * Send the packets of the given stream straight to the given codec context from the read thread, 
+     * without creating AVPacket objects. The read thread waits when the codec context's queue is full. 
+     * While routed, the codec context's sendPacket() methods throw. At the end of the input, the codec 
+     * context is flushed (see AVCodecContext#onEnd). Routes can only be changed while the read thread 
+     * is not running.
      */
-    interrupt_callback: AVIOInterruptCB;
- 
+    routeStream(streamIndex: number, context: AVCodecContext): void;
+
     /**
-     * Flags to enable debugging.
+     * Deliver the packets of the given stream to onPacket again.
      */
-    debug: number;
- 
+    unrouteStream(streamIndex: number): void;
+
     /**
-     * Maximum buffering duration for interleaving.
-     *
-     * To ensure all the streams are interleaved correctly,
-     * av_interleaved_write_frame() will wait until it has at least one packet
-     * for each stream before actually writing any packets to the output file.
-     * When some streams are "sparse" (i.e. there are large gaps between
-     * successive packets), this can result in excessive buffering.
-     *
-     * This field specifies the maximum difference between the timestamps of the
-     * first and the last packet in the muxing queue, above which libavformat
-     * will output a packet regardless of whether it has queued a packet for all
-     * the streams.
-     *
-     * Muxing only, set by the caller before avformat_write_header().
+     * Set this format context up for output to the given URL. The output format is guessed from the URL 
+     * unless one is given (by short name). The URL itself is opened by writeHeader(), unless the format 
+     * needs no file or ioContext is set.
      */
-    max_interleave_delta: number;
- 
+    openOutput(url: string, format?: string): void;
+
     /**
-     * Allow non-standard and experimental extension
-     * @see AVCodecContext.strict_std_compliance
+     * Add a new stream to the output. When given an (opened) encoder context, the stream's codec 
+     * parameters and time base are copied from it. Only possible before writeHeader().
      */
-    strict_std_compliance: number;
- 
+    newStream(context?: AVCodecContext): AVStream;
+
     /**
-     * Flags indicating events happening on the file, a combination of
-     * AVFMT_EVENT_FLAG_*.
+     * Start the write thread, which opens the output and writes the stream header before anything else,
+     * so that connecting to a network output does not block the event loop. Packets may be written right 
+     * away, they are queued until the header is written. Once the returned promise resolves, the streams' 
+     * time bases are the ones the muxer will use, and packets without a time base must be given in those.
+     * If the header cannot be written, the promise rejects and queued packets are dropped.
      *
-     * - demuxing: may be set by the demuxer in avformat_open_input(),
-     *   avformat_find_stream_info() and av_read_frame(). Flags must be cleared
-     *   by the user once the event has been handled.
-     * - muxing: may be set by the user after avformat_write_header() to
-     *   indicate a user-triggered event.  The muxer will clear the flags for
-     *   events it has handled in av_[interleaved]_write_frame().
-     */
-    event_flags: number;
- 
-    /**
-     * Maximum number of packets to read while waiting for the first timestamp.
-     * Decoding only.
+     * @param options A dictionary filled with AVFormatContext and muxer-private options, which must not 
+     *                be used until the promise settles. It is then replaced with a dictionary containing 
+     *                the options which were not found.
      */
-    max_ts_probe: number;
- 
+    writeHeader(options?: AVDictionary): Promise<void>;
+
     /**
-     * Avoid negative timestamps during muxing.
-     * Any value of the AVFMT_AVOID_NEG_TS_* constants.
-     * Note, this works better when using av_interleaved_write_frame().
-     * - muxing: Set by user
-     * - demuxing: unused
+     * Queue a packet for the write thread, which hands it to av_interleaved_write_frame(). The packet 
+     * data is referenced rather than copied, and the packet can be reused right away. Write errors are 
+     * reported to onError.
+     * If the packet has a time base (AVPacket#timeBase), its timestamps are converted to the stream's 
+     * time base.
      */
-    avoid_negative_ts: number;
- 
+    writePacket(packet: AVPacket): void;
+
     /**
-     * Transport stream id.
-     * This will be moved into demuxer private options. Thus no API/ABI compatibility
+     * Write the packets queued so far and flush the muxer and the I/O context.
+     * @returns a promise which resolves once done
      */
-    ts_id: number;
- 
+    flush(): Promise<void>;
+
     /**
-     * Audio preload in microseconds.
-     * Note, not all formats support this and unpredictable things may happen if it is used when not supported.
-     * - encoding: Set by user
-     * - decoding: unused
+     * Write the queued packets and the trailer, then close the output and stop the write thread.
+     * @returns a promise which resolves once the output is complete or rejects on a write error
      */
-    audio_preload: number;
- 
+    writeTrailer(): Promise<void>;
+
     /**
-     * Max chunk time in microseconds.
-     * Note, not all formats support this and unpredictable things may happen if it is used when not supported.
-     * - encoding: Set by user
-     * - decoding: unused
+     * Whether the read thread is running (from startReading() until it has stopped).
      */
-    max_chunk_duration: number;
- 
+    readonly reading: boolean;
+
     /**
-     * Max chunk size in bytes
-     * Note, not all formats support this and unpredictable things may happen if it is used when not supported.
-     * - encoding: Set by user
-     * - decoding: unused
+     * Number of packets the read thread may deliver to onPacket ahead of their handling. Defaults to 64.
      */
-    max_chunk_size: number;
- 
+    readAheadPackets: number;
+
     /**
-     * forces the use of wallclock timestamps as pts/dts of packets
-     * This has undefined results in the presence of B frames.
-     * - encoding: unused
-     * - decoding: Set by user
+     * Number of packets the read thread collects before delivering them to onPacket with a single call.
+     * Defaults to 1 (each packet is delivered individually).
      */
-    use_wallclock_as_timestamps: number;
- 
+    batchSize: number;
+
     /**
-     * avio flags, used to force AVIO_FLAG_DIRECT.
-     * - encoding: unused
-     * - decoding: Set by user
+     * When batching, the longest time (in microseconds) a partial batch is held back waiting for more 
+     * packets. This is checked after each packet is read.
      */
-    avio_flags: number;
- 
+    maxBatchLatencyUs: number;
+
     /**
-     * The duration field can be estimated through various ways, and this field can be used
-     * to know how the duration was estimated.
-     * - encoding: unused
-     * - decoding: Read by user
+     * Whether the write thread is running (from writeHeader() until the trailer has been written).
      */
-    duration_estimation_method: AVDurationEstimationMethod;
- 
+    readonly writing: boolean;
+
     /**
-     * Skip initial bytes when opening stream
-     * - encoding: unused
-     * - decoding: Set by user
+     * Number of packets waiting for the write thread.
      */
-    skip_initial_bytes: number;
- 
+    readonly queuedPackets: number;
+
     /**
-     * Correct single timestamp overflows
-     * - encoding: unused
-     * - decoding: Set by user
+     * Number of queued packets which wake the write thread. Defaults to 1. Together with 
+     * maxWriteLatencyUs, this allows fewer, larger writes for file output.
      */
-    correct_ts_overflow: number;
- 
+    writeBatchSize: number;
+
     /**
-     * Force seeking to any (also non key) frames.
-     * - encoding: unused
-     * - decoding: Set by user
+     * The longest time (in microseconds) a partial batch of queued packets waits before it is written.
      */
-    seek2any: number;
- 
+    maxWriteLatencyUs: number;
+
     /**
-     * Flush the I/O context after each packet.
-     * - encoding: Set by user
-     * - decoding: unused
+     * Flush the muxer and the I/O context after each batch of packets. Enable this for live output 
+     * (MPEG-TS, fragmented MP4) where latency matters more than the number of writes. Defaults to 
+     * false. See also the AVFMT_FLAG_FLUSH_PACKETS flag, which flushes after every packet.
      */
-    flush_packets: number;
- 
+    flushAfterBatch: boolean;
+
     /**
-     * format probing score.
-     * The maximal score is AVPROBE_SCORE_MAX, its set when the demuxer probes
-     * the format.
-     * - encoding: unused
-     * - decoding: set by avformat, read by user
+     * Free the format context and stop its read thread now instead of waiting for the garbage 
+     * collector. Its streams are disposed as well. Also available as [Symbol.dispose] where the runtime 
+     * supports it.
      */
-    probe_score: number;
- 
+    dispose(): void;
+
     /**
-     * Maximum number of bytes read from input in order to identify the
-     * \ref AVInputFormat "input format". Only used when the format is not set
-     * explicitly by the caller.
+     * The streams of the file.
      *
-     * Demuxing only, set by the caller before avformat_open_input().
+     * - demuxing: streams are created by libavformat in openInput(). If AVFMTCTX_NOHEADER is set in 
+     *   ctx_flags, then new streams may also appear in readFrame().
      *
-     * @sa probesize
-     */
-    format_probesize: number;
- 
-    /**
-     * ',' separated list of allowed decoders.
-     * If NULL then all are allowed
-     * - encoding: unused
-     * - decoding: set by user
-     */
-    codec_whitelist: string;
- 
-    /**
-     * ',' separated list of allowed demuxers.
-     * If NULL then all are allowed
-     * - encoding: unused
-     * - decoding: set by user
-     */
-    format_whitelist: string;
- 
-    /**
-     * IO repositioned flag.
-     * This is set by avformat when the underlaying IO context read pointer
-     * is repositioned, for example when doing byte based seeking.
-     * Demuxers can use the flag to detect such changes.
-     */
-    io_repositioned: number;
- 
-    /**
-     * Forced video codec.
-     * This allows forcing a specific decoder, even when there are multiple with
-     * the same codec_id.
-     * Demuxing: Set by user
+     * Throws during openInputAsync() / findStreamInfoAsync(), and for formats without a header (which 
+     * add streams as they go) while the read thread is running.
      */
-    video_codec: AVCodec;
- 
-    /**
-     * Forced audio codec.
-     * This allows forcing a specific decoder, even when there are multiple with
-     * the same codec_id.
-     * Demuxing: Set by user
-     */
-    audio_codec: AVCodec;
- 
-    /**
-     * Forced subtitle codec.
-     * This allows forcing a specific decoder, even when there are multiple with
-     * the same codec_id.
-     * Demuxing: Set by user
-     */
-    subtitle_codec: AVCodec;
- 
-    /**
-     * Forced data codec.
-     * This allows forcing a specific decoder, even when there are multiple with
-     * the same codec_id.
-     * Demuxing: Set by user
-     */
-    data_codec: AVCodec;
- 
-    /**
-     * Number of bytes to be written as padding in a metadata header.
-     * Demuxing: Unused.
-     * Muxing: Set by user via av_format_set_metadata_header_padding.
-     */
-    metadata_header_padding: number;
- 
-    /**
-     * User data.
-     * This is a place for some private data of the user.
-     */
-    opaque: Buffer;
- 
-    /**
-     * Callback used by devices to communicate with application.
-     */
-    control_message_cb: av_format_control_message;
- 
+    readonly streams: AVStream[];
+
     /**
-     * Output timestamp offset, in microseconds.
-     * Muxing: set by user
+     * Short name of the input or output format, or null before openInput() / openOutput().
      */
-    output_ts_offset: number;
- 
+    readonly formatName: string;
+
     /**
-     * dump format separator.
-     * can be ", " or "\n      " or anything else
-     * - muxing: Set by user.
-     * - demuxing: Set by user.
+     * input or output URL.
      */
-    dump_separator: string;
- 
+    readonly url: string;
+
     /**
-     * Forced Data codec_id.
-     * Demuxing: Set by user.
+     * Position of the first frame of the component, in
+     * AV_TIME_BASE fractional seconds. NEVER set this value directly:
+     * It is deduced from the AVStream values. Throws during openInputAsync() / findStreamInfoAsync().
      */
-    data_codec_id: AVCodecID;
- 
+    readonly startTime: number;
+
     /**
-     * ',' separated list of allowed protocols.
-     * - encoding: unused
-     * - decoding: set by user
+     * Duration of the stream, in AV_TIME_BASE fractional
+     * seconds. Only set this value if you know none of the individual stream
+     * durations and also do not set any of them. This is deduced from the
+     * AVStream values if not set. Throws during openInputAsync() / findStreamInfoAsync().
      */
-    protocol_whitelist: string;
- 
+    readonly duration: number;
+
     /**
-     * A callback for opening new IO streams.
-     *
-     * Whenever a muxer or a demuxer needs to open an IO stream (typically from
-     * avformat_open_input() for demuxers, but for certain formats can happen at
-     * other times as well), it will call this callback to obtain an IO context.
-     *
-     * @param s the format context
-     * @param pb on success, the newly opened IO context should be returned here
-     * @param url the url to open
-     * @param flags a combination of AVIO_FLAG_*
-     * @param options a dictionary of additional options, with the same
-     *                semantics as in avio_open2()
-     * @return 0 on success, a negative AVERROR code on failure
-     *
-     * @note Certain muxers and demuxers do nesting, i.e. they open one or more
-     * additional internal format contexts. Thus the AVFormatContext pointer
-     * passed to this callback may be different from the one facing the caller.
-     * It will, however, have the same 'opaque' field.
+     * Total stream bitrate in bit/s, 0 if not
+     * available. Never set it directly if the file_size and the
+     * duration are known as FFmpeg can compute it automatically. Throws during openInputAsync() / 
+     * findStreamInfoAsync().
      */
-    io_open: (s: AVFormatContext, pb: AVIOContext, url: string, flags: number, options: AVDictionary) => number;
- 
+    readonly bitRate: number;
+
     /**
-     * A callback for closing the streams opened with AVFormatContext.io_open().
+     * A copy of the metadata that applies to the whole file. Throws while the input is being read 
+     * (asynchronously or by the read thread), as demuxers may update it meanwhile.
      */
-    io_close: (s: AVFormatContext, pb: AVIOContext) => void;
- 
+    readonly metadata: AVDictionary;
+
     /**
-     * ',' separated list of disallowed protocols.
-     * - encoding: unused
-     * - decoding: set by user
+     * Flags modifying the (de)muxer behaviour. A combination of AVFMT_FLAG_*.
+     * Set by the user before openInput() / writeHeader(). Cannot be changed while reading or writing.
      */
-    protocol_blacklist: string;
- 
+    flags: number;
+
     /**
-     * The maximum number of streams.
-     * - encoding: unused
-     * - decoding: set by user
+     * Maximum number of bytes read from input in order to determine stream
+     * properties. Used when reading the global header and in findStreamInfo(). Cannot be changed 
+     * while reading.
      */
-    max_streams: number;
- 
+    probeSize: number;
+
     /**
-     * Skip duration calcuation in estimate_timings_from_pts.
-     * - encoding: unused
-     * - decoding: set by user
+     * Maximum duration (in AV_TIME_BASE units) of the data read
+     * from input in findStreamInfo(). Cannot be changed while reading.
      */
-    skip_estimate_duration_from_pts: number;
- 
+    maxAnalyzeDuration: number;
+
     /**
-     * Maximum number of packets that can be probed
-     * - encoding: unused
-     * - decoding: set by user
+     * Maximum buffering duration for interleaving, in AV_TIME_BASE units. Lower values reduce
+     * latency (and memory use) when a stream has no packets for a while, at the cost of interleaving.
+     * 0 means no limit. Cannot be changed while reading or writing.
      */
-    max_probe_packets: number;
- 
+    maxInterleaveDelta: number;
+
     /**
-     * A callback for closing the streams opened with AVFormatContext.io_open().
-     *
-     * Using this is preferred over io_close, because this can return an error.
-     * Therefore this callback is used instead of io_close by the generic
-     * libavformat code if io_close is NULL or the default.
-     *
-     * @param s the format context
-     * @param pb IO context to be closed and freed
-     * @return 0 on success, a negative AVERROR code on failure
+     * Custom I/O to read from / write to instead of the URL given to openInput() / openOutput() 
+     * (the URL is still used to guess the format). Must be set before opening.
      */
-    io_close2: (s: AVFormatContext, pb: AVIOContext) => number;
+    ioContext: AVIOContext;
 }
  
 /**
@@ -142,194 +142,84 @@ export enum AVIODataMarkerType {
 };
  
 /**
- * Bytestream IO Context.
- * New public fields can be added with minor version bumps.
- * Removal, reordering and changes to existing public fields require
- * a major version bump.
- * sizeof(AVIOContext) must not be used outside libav*.
- *
- * @note None of the function pointers in AVIOContext should be called
- *       directly, they should only be set by the client application
- *       when implementing custom I/O. Normally these are set to the
- *       function pointers specified in avio_alloc_context()
- */
-export interface AVIOContext {
+ * Bytestream IO Context backed by Javascript, for use as AVFormatContext#ioContext.
+ *
+ * An input context is fed with write() (for instance from a socket's data events). libavformat reads
+ * straight out of the written chunks, so a chunk must not be modified after it has been written.
+ * An output context passes everything the muxer writes to onData.
+ */
+export declare class AVIOContext {
     /**
-     * A class for private options.
-     *
-     * If this AVIOContext is created by avio_open2(), av_class is set and
-     * passes the options down to protocols.
-     *
-     * If this AVIOContext is manually allocated, then av_class may be set by
-     * the caller.
-     *
-     * warning -- this field can be NULL, be sure to not pass this AVIOContext
-     * to any av_opt_* functions in that case.
-     */
-    av_class: AVClass;
- 
-    /*
-     * The following shows the relationship between buffer, buf_ptr,
-     * buf_ptr_max, buf_end, buf_size, and pos, when reading and when writing
-     * (since AVIOContext is used for both):
-     *
-     **********************************************************************************
-     *                                   READING
-     **********************************************************************************
-     *
-     *                            |              buffer_size              |
-     *                            |---------------------------------------|
-     *                            |                                       |
-     *
-     *                         buffer          buf_ptr       buf_end
-     *                            +---------------+-----------------------+
-     *                            |/ / / / / / / /|/ / / / / / /|         |
-     *  read buffer:              |/ / consumed / | to be read /|         |
-     *                            |/ / / / / / / /|/ / / / / / /|         |
-     *                            +---------------+-----------------------+
-     *
-     *                                                         pos
-     *              +-------------------------------------------+-----------------+
-     *  input file: |                                           |                 |
-     *              +-------------------------------------------+-----------------+
-     *
-     *
-     **********************************************************************************
-     *                                   WRITING
-     **********************************************************************************
-     *
-     *                             |          buffer_size                 |
-     *                             |--------------------------------------|
-     *                             |                                      |
-     *
-     *                                                buf_ptr_max
-     *                          buffer                 (buf_ptr)       buf_end
-     *                             +-----------------------+--------------+
-     *                             |/ / / / / / / / / / / /|              |
-     *  write buffer:              | / / to be flushed / / |              |
-     *                             |/ / / / / / / / / / / /|              |
-     *                             +-----------------------+--------------+
-     *                               buf_ptr can be in this
-     *                               due to a backward seek
-     *
-     *                            pos
-     *               +-------------+----------------------------------------------+
-     *  output file: |             |                                              |
-     *               +-------------+----------------------------------------------+
-     *
+     * @param writable Whether this context is for output (muxing) rather than input
+     * @param bufferSize Size of the buffer libavformat reads into / writes from. Defaults to 32768.
      */
-    buffer: Buffer;  /**< Start of the buffer. */
-    buffer_size: number;        /**< Maximum buffer size */
-    buf_ptr: Buffer; /**< Current position in the buffer */
-    buf_end: OpaquePtr; /**< End of the data, may be less than
-                                 buffer+buffer_size if the read function returned
-                                 less data than requested, e.g. for streams where
-                                 no more data has been received yet. */
-    opaque: OpaquePtr;           /**< A private pointer, passed to the read/write/seek/...
-                                 functions. */
-
-    read_packet: (opaque: OpaquePtr, buf: Buffer, buf_size: number) => number;
-    write_packet: (opaque: OpaquePtr, buf: Buffer, buf_size: number) => number;
-    seek: (opaque: OpaquePtr, offset: number, whence: number) => number;
-
-    /**< position in the file of the current buffer */
-    pos: number;
-
-    /**< true if was unable to read due to error or eof */
-    eof_reached: number;
-
-    /**< contains the error code or 0 if no error happened */
-    error: number;
-
-    /**< true if open for writing */
-    write_flag: number;
-
-    max_packet_size: number;
-
-    /**< Try to buffer at least this amount of data
-                                 before flushing it. */
-    min_packet_size: number;
-
-    checksum: number;
+    constructor(writable?: boolean, bufferSize?: number);
 
     /**
-     * @nodeTODO unsigned int*
+     * Input only. Add a chunk of input. The chunk is referenced rather than copied until it has been 
+     * read.
+     * @returns false once bufferedBytes reaches highWaterMark, in which case the source should pause 
+     *          until onDrain
      */
-    checksum_ptr: OpaquePtr;
-
-    update_checksum: (checksum: number, buf: Buffer, size: number) => number;
+    write(chunk: Uint8Array): boolean;
 
     /**
-     * Pause or resume playback for network streaming protocols - e.g. MMS.
+     * Input only. Signal the end of the input: reads return AVERROR_EOF once the written data has 
+     * been read.
      */
-    read_pause: (opaque: OpaquePtr, pause: number) => number;
+    end(): void;
 
     /**
-     * Seek to a given timestamp in stream with the specified stream_index.
-     * Needed for some network streaming protocols which don't support seeking
-     * to byte position.
+     * Input only. Called when writing can continue after write() returned false.
      */
-    read_seek: (opaque: OpaquePtr, stream_index: number, timestamp: number, flags: number) => number;
+    onDrain: () => void;
 
     /**
-     * A combination of AVIO_SEEKABLE_ flags or 0 when the stream is not seekable.
-     */
-    seekable: number;
- 
-    /**
-     * avio_read and avio_write should if possible be satisfied directly
-     * instead of going through a buffer, and avio_seek will always
-     * call the underlying seek function directly.
+     * Output only. Called with the data written by the muxer.
      */
-    direct: number;
- 
-    /**
-     * ',' separated list of allowed protocols.
-     */
-    protocol_whitelist: string;
- 
+    onData: (chunk: Buffer) => void;
+
     /**
-     * ',' separated list of disallowed protocols.
+     * Whether this context is for output.
      */
-    protocol_blacklist: string;
- 
+    readonly writable: boolean;
+
     /**
-     * A callback that is used instead of write_packet.
+     * Whether end() has been called.
      */
-    write_data_type: (opaque: OpaquePtr, buf: Buffer, buf_size: number, type: AVIODataMarkerType, time: number) => number;
+    readonly ended: boolean;
 
     /**
-     * If set, don't call write_data_type separately for AVIO_DATA_MARKER_BOUNDARY_POINT,
-     * but ignore them and treat them as AVIO_DATA_MARKER_UNKNOWN (to avoid needlessly
-     * small chunks of data returned from the callback).
+     * Number of input bytes written but not read yet.
      */
-    ignore_boundary_point: number;
- 
+    readonly bufferedBytes: number;
+
     /**
-     * @deprecated field utilized privately by libavformat. For a public
-     *             statistic of how many bytes were written out, see
-     *             AVIOContext::bytes_written.
-     * @if FF_API_AVIOCONTEXT_WRITTEN
-     * @attribute_deprecated
+     * Number of buffered input bytes at which write() returns false. Defaults to 1 MiB.
      */
-    written: number;
- 
+    highWaterMark: number;
+
     /**
-     * Maximum reached position before a backward seek in the write buffer,
-     * used keeping track of already written data for a later flush.
-     * @nodeTODO unsigned char *
+     * The total size of the input in bytes, if known, or -1. Used by demuxers which need the size.
+     * Seeking is not supported.
      */
-    buf_ptr_max: OpaquePtr;
- 
+    totalSize: number;
+
     /**
      * Read-only statistic of bytes read for this AVIOContext.
      */
-    bytes_read: number;
- 
+    readonly bytesRead: number;
+
     /**
      * Read-only statistic of bytes written for this AVIOContext.
      */
-    bytes_written: number;
+    readonly bytesWritten: number;
+
+    /**
+     * Free the I/O context now instead of waiting for the garbage collector. Throws while a format
+     * context is reading or writing through it (see AVFormatContext#stopReading()).
+     */
+    dispose(): void;
 }
  
 /**
@@ -0,0 +1,244 @@
+import { expect } from "chai";
+import { describe } from "razmin";
+import { AVFormatContext as AVFormatContextImpl, AVIOContext as AVIOContextImpl } from "../../binding";
+import { AVFormatContext as AVFormatContextType } from "./avformat";
+import { AVIOContext as AVIOContextType } from "./avio";
+import { AVCodec as AVCodecImpl, AVPacket as AVPacketImpl } from "../../binding";
+import { AVCodec as AVCodecType, AVPacket as AVPacketType } from "../avcodec";
+import { AVFrame, AVPixelFormat } from "../avutil";
+import * as fs from "fs";
+import * as os from "os";
+import * as path from "path";
+
+const AVFormatContext = <typeof AVFormatContextType>AVFormatContextImpl;
+const AVCodec = <typeof AVCodecType>AVCodecImpl;
+const AVPacket = <typeof AVPacketType>AVPacketImpl;
+const AVIOContext = <typeof AVIOContextType>AVIOContextImpl;
+
+describe('AVFormatContext', it => {
+    /**
+     * Mux the given number of gray frames of the given size into a NUT file in memory
+     */
+    async function muxToChunks(packetCount: number, size = 16) {
+        let encoder = AVCodec.findEncoder('rawvideo').newContext();
+        encoder.width = size;
+        encoder.height = size;
+        encoder.timeBase = { num: 1, den: 25 };
+        encoder.pixelFormat = AVPixelFormat.AV_PIX_FMT_GRAY8;
+        encoder.open();
+
+        let chunks: Buffer[] = [];
+        let output = new AVIOContext(true);
+        output.onData = chunk => chunks.push(chunk);
+
+        let context = new AVFormatContext();
+        context.ioContext = output;
+        context.openOutput('output.nut');
+        let stream = context.newStream(encoder);
+        await context.writeHeader();
+
+        for (let i = 0; i < packetCount; ++i) {
+            let packet = new AVPacket(new Uint8Array(size * size));
+            packet.streamIndex = stream.index;
+            packet.pts = packet.dts = i;
+            packet.duration = 1;
+            context.writePacket(packet);
+        }
+
+        await context.writeTrailer();
+        context.dispose();
+        encoder.dispose();
+
+        return chunks;
+    }
+
+    /**
+     * Open a format context on the given muxed chunks, all of which are written up front
+     */
+    function openChunks(chunks: Buffer[]) {
+        let input = new AVIOContext();
+        input.highWaterMark = chunks.reduce((size, chunk) => size + chunk.length, 0);
+        chunks.forEach(chunk => input.write(chunk));
+        input.end();
+
+        let context = new AVFormatContext();
+        context.ioContext = input;
+        context.openInput('', 'nut');
+
+        return { context, input };
+    }
+
+    function packetsOf(delivered: AVPacketType | AVPacketType[]) {
+        return Array.isArray(delivered) ? delivered : [ delivered ];
+    }
+
+    it("should not be reading or have streams before openInput()", () => {
+        let context = new AVFormatContext();
+        expect(context.reading).to.be.false;
+        expect(context.streams.length).to.equal(0);
+        expect(context.readAheadPackets).to.equal(64);
+        context.dispose();
+    });
+    it("should reject an invalid readAheadPackets", () => {
+        let context = new AVFormatContext();
+        expect(() => context.readAheadPackets = 0).to.throw();
+        context.dispose();
+    });
+    it("should throw when opening a missing input", () => {
+        let context = new AVFormatContext();
+        expect(() => context.openInput('/nonexistent/input.mp4')).to.throw();
+        expect(context.streams.length).to.equal(0);
+        context.dispose();
+    });
+    it("should open the output on the write thread, rejecting writeHeader() when it fails", async () => {
+        let encoder = AVCodec.findEncoder('rawvideo').newContext();
+        encoder.width = 16;
+        encoder.height = 16;
+        encoder.timeBase = { num: 1, den: 25 };
+        encoder.pixelFormat = AVPixelFormat.AV_PIX_FMT_GRAY8;
+        encoder.open();
+
+        let context = new AVFormatContext();
+        context.openOutput('/nonexistent/output.nut');
+        context.newStream(encoder);
+
+        let error: Error;
+        await context.writeHeader().catch(e => error = e);
+        expect(error).to.exist;
+        expect(error.message).to.contain('avio_open2');
+
+        context.dispose();
+        encoder.dispose();
+    });
+    it("should write packets and a trailer on the write thread", async () => {
+        let encoder = AVCodec.findEncoder('rawvideo').newContext();
+        encoder.width = 16;
+        encoder.height = 16;
+        encoder.timeBase = { num: 1, den: 25 };
+        encoder.pixelFormat = AVPixelFormat.AV_PIX_FMT_GRAY8;
+        encoder.open();
+
+        let file = path.join(os.tmpdir(), `nlav-mux-${process.pid}.nut`);
+        let context = new AVFormatContext();
+        context.writeBatchSize = 4;
+        context.openOutput(file);
+        let stream = context.newStream(encoder);
+        let header = context.writeHeader();
+        expect(context.writing).to.be.true;
+
+        // Queued until the write thread has written the header
+        for (let i = 0; i < 10; ++i) {
+            let packet = new AVPacket(new Uint8Array(16 * 16));
+            packet.streamIndex = stream.index;
+            packet.pts = packet.dts = i;
+            packet.duration = 1;
+            context.writePacket(packet);
+        }
+
+        await header;
+
+        await context.flush();
+        await context.writeTrailer();
+        expect(context.writing).to.be.false;
+        expect(fs.statSync(file).size).to.be.greaterThan(16 * 16 * 10);
+
+        context.dispose();
+        fs.unlinkSync(file);
+    });
+    it("should deliver the packets read by the read thread to onPacket", async () => {
+        let { context } = openChunks(await muxToChunks(10));
+        let timestamps: number[] = [];
+        let ended = new Promise<void>(resolve => context.onEnd = resolve);
+
+        context.onPacket = delivered => packetsOf(delivered).forEach(packet => timestamps.push(packet.pts));
+        context.startReading();
+        expect(context.reading).to.be.true;
+        expect(() => context.readFrame()).to.throw();
+
+        await ended;
+        expect(context.reading).to.be.false;
+        expect(timestamps).to.eql([ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 ]);
+        context.dispose();
+    });
+    it("should read at most readAheadPackets ahead of onPacket", async () => {
+        // Packets larger than the I/O buffer, so that what was read shows in bytesRead
+        let size = 256;
+        let { context, input } = openChunks(await muxToChunks(20, size));
+        let count = 0;
+        let bytesReadWhileBusy = 0;
+        let ended = new Promise<void>(resolve => context.onEnd = resolve);
+
+        context.readAheadPackets = 2;
+        context.onPacket = delivered => {
+            if (count++ > 0)
+                return;
+
+            // Give the read thread time to run ahead, were it not held back
+            let busyUntil = Date.now() + 100;
+            while (Date.now() < busyUntil);
+            bytesReadWhileBusy = input.bytesRead;
+        };
+
+        context.startReading();
+        await ended;
+
+        expect(count).to.equal(20);
+        expect(bytesReadWhileBusy).to.be.lessThan(8 * size * size);
+        expect(input.bytesRead).to.be.greaterThan(20 * size * size);
+        context.dispose();
+    });
+    it("should stop reading, and pick up where it stopped when restarted", async () => {
+        let { context } = openChunks(await muxToChunks(10));
+        let timestamps: number[] = [];
+        let stopping: Promise<void> = null;
+
+        context.readAheadPackets = 1;
+        context.onPacket = delivered => {
+            packetsOf(delivered).forEach(packet => timestamps.push(packet.pts));
+            if (timestamps.length >= 3 && !stopping)
+                stopping = context.stopReading();
+        };
+
+        let ended = new Promise<void>(resolve => context.onEnd = resolve);
+        context.startReading();
+
+        while (!stopping)
+            await new Promise(resolve => setImmediate(resolve));
+        await stopping;
+
+        expect(context.reading).to.be.false;
+        let stoppedAt = timestamps.length;
+        expect(stoppedAt).to.be.lessThan(10);
+
+        context.onPacket = delivered => packetsOf(delivered).forEach(packet => timestamps.push(packet.pts));
+        context.startReading();
+        await ended;
+
+        expect(timestamps).to.eql([ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 ]);
+        context.dispose();
+    });
+    it("should send the packets of a routed stream to its codec context", async () => {
+        let { context } = openChunks(await muxToChunks(5));
+        let decoder = AVCodec.findDecoder('rawvideo').newContext();
+        decoder.configure({ width: 16, height: 16, pixelFormat: AVPixelFormat.AV_PIX_FMT_GRAY8 });
+
+        let timestamps: number[] = [];
+        let delivered = 0;
+        let decoded = new Promise<void>(resolve => decoder.onEnd = resolve);
+
+        decoder.onFrame = (frame: AVFrame) => timestamps.push(frame.pts);
+        decoder.open();
+        context.onPacket = () => ++delivered;
+        context.routeStream(0, decoder);
+        expect(() => context.routeStream(1, decoder)).to.throw();
+
+        context.startReading();
+        expect(() => context.unrouteStream(0)).to.throw();
+        await decoded;
+
+        expect(timestamps).to.eql([ 0, 1, 2, 3, 4 ]);
+        expect(delivered).to.equal(0);
+        context.dispose();
+        decoder.dispose();
+    });
+});
@@ -0,0 +1,126 @@
+import { expect } from "chai";
+import { describe } from "razmin";
+import { AVCodec as AVCodecImpl, AVFormatContext as AVFormatContextImpl, AVIOContext as AVIOContextImpl, AVPacket as AVPacketImpl } from "../../binding";
+import { AVCodec as AVCodecType, AVPacket as AVPacketType } from "../avcodec";
+import { AVPixelFormat } from "../avutil";
+import { AVFormatContext as AVFormatContextType } from "./avformat";
+import { AVIOContext as AVIOContextType } from "./avio";
+
+const AVCodec = <typeof AVCodecType>AVCodecImpl;
+const AVFormatContext = <typeof AVFormatContextType>AVFormatContextImpl;
+const AVIOContext = <typeof AVIOContextType>AVIOContextImpl;
+const AVPacket = <typeof AVPacketType>AVPacketImpl;
+
+describe('AVIOContext', it => {
+    async function muxToChunks(packetCount: number) {
+        let encoder = AVCodec.findEncoder('rawvideo').newContext();
+        encoder.width = 16;
+        encoder.height = 16;
+        encoder.timeBase = { num: 1, den: 25 };
+        encoder.pixelFormat = AVPixelFormat.AV_PIX_FMT_GRAY8;
+        encoder.open();
+
+        let chunks: Buffer[] = [];
+        let output = new AVIOContext(true);
+        output.onData = chunk => chunks.push(chunk);
+
+        let context = new AVFormatContext();
+        context.ioContext = output;
+        context.openOutput('output.nut');
+        let stream = context.newStream(encoder);
+        await context.writeHeader();
+
+        for (let i = 0; i < packetCount; ++i) {
+            let packet = new AVPacket(new Uint8Array(16 * 16));
+            packet.streamIndex = stream.index;
+            packet.pts = packet.dts = i;
+            packet.duration = 1;
+            context.writePacket(packet);
+        }
+
+        await context.writeTrailer();
+        expect(output.bytesWritten).to.equal(chunks.reduce((size, chunk) => size + chunk.length, 0));
+        context.dispose();
+
+        return chunks;
+    }
+
+    it("should only accept chunks on an input context", () => {
+        let output = new AVIOContext(true);
+        expect(() => output.write(new Uint8Array(4))).to.throw();
+        expect(new AVIOContext().write(new Uint8Array(4))).to.be.true;
+    });
+    it("should signal backpressure at the high water mark", () => {
+        let input = new AVIOContext();
+        input.highWaterMark = 8;
+        expect(input.write(new Uint8Array(4))).to.be.true;
+        expect(input.write(new Uint8Array(4))).to.be.false;
+        expect(input.bufferedBytes).to.equal(8);
+    });
+    it("should demux what was muxed through custom I/O", async () => {
+        let chunks = await muxToChunks(5);
+        let input = new AVIOContext();
+        chunks.forEach(chunk => input.write(chunk));
+        input.end();
+
+        let context = new AVFormatContext();
+        context.ioContext = input;
+        context.openInput('', 'nut');
+        expect(context.streams.length).to.equal(1);
+
+        let count = 0;
+        while (context.readFrame())
+            ++count;
+
+        expect(count).to.equal(5);
+        context.dispose();
+    });
+    it("should open an input which is written after openInputAsync() has started", async () => {
+        let chunks = await muxToChunks(5);
+        let input = new AVIOContext();
+
+        let context = new AVFormatContext();
+        context.ioContext = input;
+        let opened = context.openInputAsync('', 'nut');
+        expect(() => context.readFrame()).to.throw();
+        expect(() => context.streams).to.throw();
+        expect(() => context.probeSize = 1 << 20).to.throw();
+
+        chunks.forEach(chunk => input.write(chunk));
+        input.end();
+        await opened;
+        expect(context.streams.length).to.equal(1);
+
+        await context.findStreamInfoAsync();
+
+        let count = 0;
+        while (context.readFrame())
+            ++count;
+
+        expect(count).to.equal(5);
+        context.dispose();
+    });
+    it("should refuse to be disposed of while a format context reads from it", async () => {
+        let chunks = await muxToChunks(5);
+        let input = new AVIOContext();
+
+        let context = new AVFormatContext();
+        context.ioContext = input;
+        let opened = context.openInputAsync('', 'nut');
+        expect(() => input.dispose()).to.throw();
+
+        chunks.forEach(chunk => input.write(chunk));
+        input.end();
+        await opened;
+
+        context.dispose();
+        input.dispose();
+    });
+    it("should fail rather than wait for input on the Javascript thread", () => {
+        let input = new AVIOContext();
+        let context = new AVFormatContext();
+        context.ioContext = input;
+        expect(() => context.openInput('', 'nut')).to.throw();
+        context.dispose();
+    });
+});
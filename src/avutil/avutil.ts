@@ -151,6 +151,12 @@ export declare class AVUtil {
      * Get the channel with the given index in channel_layout.
      */
     static getChannelInLayoutByIndex(layout: number, index: number): number;
+
+    /**
+     * Number of native resources (frames, packets, buffers, ...) currently alive in this thread, 
+     * keyed by class name. Intended for tracking down leaks.
+     */
+    static getLiveResourceCounts(): Record<string, number>;
 }
 
 /**
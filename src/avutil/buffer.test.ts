@@ -1,6 +1,6 @@
 import { describe } from "razmin";
 import { expect } from 'chai';
-import { AVBuffer, AVBufferPool } from "..";
+import { AVBuffer, AVBufferPool, AVUtil } from "..";
 
 describe("AVBuffer", it => {
     it('can be constructed with a size', () => {
@@ -98,4 +98,46 @@ describe("AVBufferPool", it => {
         expect(buffer.data).to.exist;
         expect(new Uint8Array(buffer.data)[0]).not.to.equal(37);
     })
-});
\ No newline at end of file
+});
+
+describe("AVBuffer#dispose", it => {
+    it('makes further access throw', () => {
+        let buf = new AVBuffer(123);
+        buf.dispose();
+        expect(() => buf.size).to.throw(/disposed/);
+        expect(() => buf.makeWritable()).to.throw(/disposed/);
+    });
+
+    it('can be called more than once', () => {
+        let buf = new AVBuffer(123);
+        buf.dispose();
+        buf.dispose();
+    });
+
+    it('is no longer counted as a live resource', () => {
+        let before = AVUtil.getLiveResourceCounts().AVBuffer ?? 0;
+        let buf = new AVBuffer(123);
+        expect(AVUtil.getLiveResourceCounts().AVBuffer).to.equal(before + 1);
+        buf.dispose();
+        expect(AVUtil.getLiveResourceCounts().AVBuffer ?? 0).to.equal(before);
+    });
+});
+
+describe("AVBuffer.allocateShared", it => {
+    it('allocates buffers which other processes can map', () => {
+        if (process.platform === 'win32') {
+            expect(() => AVBuffer.allocateShared(4096)).to.throw();
+            return;
+        }
+
+        let buf = AVBuffer.allocateShared(4096);
+        let shared = buf.sharedMemory;
+
+        expect(buf.size).to.equal(4096);
+        expect(shared.fd).to.be.at.least(0);
+        expect(shared.offset).to.equal(0);
+        expect(shared.size).to.equal(4096);
+        expect(new AVBuffer(4096).sharedMemory).to.be.null;
+        buf.dispose();
+    });
+});
@@ -51,6 +51,13 @@
  * parts of the buffer (i.e. their AVBufferRef.data will not be equal).
  */
 export declare class AVBuffer {
+    /**
+     * Allocate a buffer in shared memory (an anonymous memfd on Linux, an unlinked POSIX shared memory 
+     * object on macOS and other Unixes), which another process can map from its file descriptor (see 
+     * sharedMemory). The descriptor is closed once the last reference to the buffer is gone. Throws on 
+     * platforms without shared memory support (Windows).
+     */
+    static allocateShared(size: number): AVBuffer;
 
     /**
      * Construct a new AVBuffer from the given buffer.
@@ -91,6 +98,13 @@ export declare class AVBuffer {
      * when refCount is no more than 1.
      */
     readonly writable: boolean;
+
+    /**
+     * Where the data is when it is in shared memory (see allocateShared() and 
+     * AVCodecContext#bufferPoolSharedMemory), null otherwise. The descriptor stays ours: a process 
+     * receiving it (for instance over a Unix socket) maps size bytes at offset.
+     */
+    readonly sharedMemory: AVBufferSharedMemory | null;
     
     /**
      * Immediately de-reference this buffer. Note that the buffer
@@ -99,6 +113,12 @@ export declare class AVBuffer {
      */
     free();
 
+    /**
+     * Release the underlying buffer reference now instead of waiting for the garbage collector. Accessing 
+     * the object afterwards throws. Also available as [Symbol.dispose] where the runtime supports it.
+     */
+    dispose(): void;
+
     /**
      * Make a writable buffer from this buffer, avoiding a copy. If the buffer
      * is referenced only once (ie writable is true), then the current instance 
@@ -134,6 +154,12 @@ export declare class AVBuffer {
     replace(other: AVBuffer);
 }
 
+export interface AVBufferSharedMemory {
+    fd: number;
+    offset: number;
+    size: number;
+}
+
 /**
  * Always treat the buffer as read-only, even when it has only one
  * reference.
@@ -0,0 +1,310 @@
+import { describe } from "razmin";
+import { expect } from "chai";
+import { Worker } from "worker_threads";
+import * as path from "path";
+import { AVFrame, AVFrameSideDataType, AVPixelFormat, AVSampleFormat, AV_CH_LAYOUT_STEREO } from "..";
+
+describe("AVFrame#share", it => {
+    function createFrame() {
+        let frame = new AVFrame();
+        frame.format = AVPixelFormat.AV_PIX_FMT_GRAY8;
+        frame.width = 64;
+        frame.height = 64;
+        frame.allocateBuffer();
+        new Uint8Array(frame.getPlaneBuffer(0).data)[0] = 23;
+
+        return frame;
+    }
+
+    it('shares the data of a frame with a worker thread', async () => {
+        let frame = createFrame();
+        let worker = new Worker(`
+            const { parentPort, workerData } = require('worker_threads');
+            const { AVFrame } = require(workerData.binding);
+            const frame = AVFrame.takeShared(workerData.token);
+            const data = new Uint8Array(frame.getPlaneBuffer(0).data);
+            
+            parentPort.postMessage({ width: frame.width, first: data[0] });
+            data[0] = 45;
+            frame.dispose();
+        `, { eval: true, workerData: { binding: path.resolve(__dirname, '../../binding'), token: frame.share() } });
+
+        let message = await new Promise<any>((resolve, reject) => (worker.once('message', resolve), worker.once('error', reject)));
+        await new Promise(resolve => worker.once('exit', resolve));
+
+        expect(message).to.eql({ width: 64, first: 23 });
+        expect(new Uint8Array(frame.getPlaneBuffer(0).data)[0]).to.equal(45);
+        frame.dispose();
+    });
+
+    it('can only be taken once', () => {
+        let frame = createFrame();
+        let token = frame.share();
+        let taken = AVFrame.takeShared(token);
+
+        expect(taken.width).to.equal(64);
+        expect(() => AVFrame.takeShared(token)).to.throw();
+        expect(AVFrame.releaseShared(token)).to.be.false;
+        expect(AVFrame.releaseShared(frame.share())).to.be.true;
+        taken.dispose();
+        frame.dispose();
+    });
+});
+
+describe("AVFrame plane operations", it => {
+    function createVideoFrame(width: number, height: number) {
+        let frame = new AVFrame();
+        frame.format = AVPixelFormat.AV_PIX_FMT_YUV420P;
+        frame.width = width;
+        frame.height = height;
+        frame.allocateBuffer();
+
+        return frame;
+    }
+
+    function createAudioFrame(format: AVSampleFormat) {
+        let frame = new AVFrame();
+        frame.format = format;
+        frame.sampleRate = 48000;
+        frame.channelLayout = AV_CH_LAYOUT_STEREO;
+        frame.numberOfSamples = 3000;
+        frame.allocateBuffer();
+
+        return frame;
+    }
+
+    function pixel(frame: AVFrame, plane: number, x: number, y: number) {
+        return new Uint8Array(frame.getPlaneBuffer(plane).data)[y * frame.lineSizes[plane] + x];
+    }
+
+    it('fills and crops regions of a frame', async () => {
+        let frame = createVideoFrame(64, 48);
+        let cropped = createVideoFrame(16, 16);
+
+        frame.fillRegion(null, [16, 128, 128]);
+        await frame.fillRegionAsync({ x: 8, y: 8, width: 16, height: 16 }, [235, 64, 192]);
+        expect(pixel(frame, 0, 7, 7)).to.equal(16);
+        expect(pixel(frame, 0, 8, 8)).to.equal(235);
+        expect(pixel(frame, 1, 4, 4)).to.equal(64);
+        expect(pixel(frame, 2, 11, 11)).to.equal(192);
+        expect(pixel(frame, 2, 12, 12)).to.equal(128);
+
+        frame.copyRegionTo(cropped, { x: 0, y: 0, width: 16, height: 16 });
+        expect(pixel(cropped, 0, 7, 7)).to.equal(16);
+        expect(pixel(cropped, 0, 8, 8)).to.equal(235);
+        await frame.copyRegionToAsync(cropped, { x: 8, y: 8, width: 8, height: 8 }, 8, 0);
+        expect(pixel(cropped, 0, 8, 0)).to.equal(235);
+        expect(pixel(cropped, 1, 2, 6)).to.equal(128);
+
+        expect(() => frame.copyRegionTo(cropped, { x: 1, y: 0, width: 8, height: 8 })).to.throw();
+        expect(() => frame.copyRegionTo(cropped, { x: 0, y: 0, width: 32, height: 8 })).to.throw();
+        expect(() => frame.fillRegion(null, [0, 0])).to.throw();
+        frame.dispose();
+        cropped.dispose();
+
+        let float = new AVFrame();
+        float.format = AVPixelFormat.AV_PIX_FMT_GRAYF32LE;
+        float.width = 16;
+        float.height = 16;
+        float.allocateBuffer();
+        expect(() => float.fillRegion(null, [1])).to.throw();
+        float.dispose();
+    });
+
+    it('fills and copies packed 4:2:2 frames by macropixel', () => {
+        let frame = new AVFrame();
+        frame.format = AVPixelFormat.AV_PIX_FMT_YUYV422;
+        frame.width = 64;
+        frame.height = 48;
+        frame.allocateBuffer();
+
+        let cropped = new AVFrame();
+        cropped.format = AVPixelFormat.AV_PIX_FMT_YUYV422;
+        cropped.width = 16;
+        cropped.height = 16;
+        cropped.allocateBuffer();
+
+        frame.fillRegion(null, [16, 128, 128]);
+        frame.fillRegion({ x: 8, y: 8, width: 16, height: 16 }, [235, 64, 192]);
+
+        // Y U Y V, two pixels per macropixel
+        expect([14, 15, 16, 17, 18, 19].map(x => pixel(frame, 0, x, 8))).to.eql([16, 128, 235, 64, 235, 192]);
+        expect(pixel(frame, 0, 46, 23)).to.equal(235);
+        expect(pixel(frame, 0, 48, 23)).to.equal(16);
+        expect(pixel(frame, 0, 16, 24)).to.equal(16);
+
+        frame.copyRegionTo(cropped, { x: 8, y: 8, width: 16, height: 16 });
+        expect([0, 1, 2, 3].map(x => pixel(cropped, 0, x, 0))).to.eql([235, 64, 235, 192]);
+        expect(pixel(cropped, 0, 31, 15)).to.equal(192);
+
+        frame.dispose();
+        cropped.dispose();
+    });
+
+    it('copies overlapping regions of the same frame', () => {
+        let frame = createVideoFrame(64, 48);
+
+        frame.fillRegion(null, [16, 128, 128]);
+        frame.fillRegion({ x: 0, y: 0, width: 16, height: 16 }, [235, 64, 192]);
+        frame.copyRegionTo(frame, { x: 0, y: 0, width: 32, height: 32 }, 8, 8);
+
+        expect(pixel(frame, 0, 8, 8)).to.equal(235);
+        expect(pixel(frame, 0, 20, 20)).to.equal(235);
+        expect(pixel(frame, 0, 30, 30)).to.equal(16);
+        expect(pixel(frame, 1, 10, 10)).to.equal(64);
+        expect(pixel(frame, 1, 14, 14)).to.equal(128);
+
+        // And the other way around
+        frame.copyRegionTo(frame, { x: 8, y: 8, width: 32, height: 32 }, 0, 0);
+        expect(pixel(frame, 0, 12, 12)).to.equal(235);
+        expect(pixel(frame, 0, 22, 22)).to.equal(16);
+        frame.dispose();
+    });
+
+    it('cannot dispose of frames an async operation is using', async () => {
+        let frame = createVideoFrame(64, 48);
+        let cropped = createVideoFrame(16, 16);
+
+        let copied = frame.copyRegionToAsync(cropped, { x: 0, y: 0, width: 16, height: 16 });
+        expect(() => frame.dispose()).to.throw();
+        expect(() => cropped.dispose()).to.throw();
+
+        await copied;
+        frame.dispose();
+        cropped.dispose();
+    });
+
+    it('throws when given a disposed frame', () => {
+        let frame = createVideoFrame(64, 48);
+        let other = createVideoFrame(64, 48);
+        other.dispose();
+
+        expect(() => frame.copyTo(other)).to.throw(/disposed/);
+        expect(() => frame.copyPropertiesTo(other)).to.throw(/disposed/);
+        expect(() => frame.copyRegionTo(other, null, 0, 0)).to.throw(/disposed/);
+        expect(() => frame.copyTo(<any>{})).to.throw(TypeError);
+        frame.dispose();
+    });
+
+    it('converts between planar and interleaved samples', async () => {
+        let planar = createAudioFrame(AVSampleFormat.AV_SAMPLE_FMT_FLTP);
+        let interleaved = createAudioFrame(AVSampleFormat.AV_SAMPLE_FMT_S16);
+        let back = createAudioFrame(AVSampleFormat.AV_SAMPLE_FMT_FLTP);
+        let left = new Float32Array(planar.getPlaneBuffer(0).data);
+        let right = new Float32Array(planar.getPlaneBuffer(1).data);
+
+        for (let i = 0; i < 3000; ++i) {
+            left[i] = i / 3000;
+            right[i] = -2;
+        }
+
+        planar.copySamplesTo(interleaved, 0.5);
+        let samples = new Int16Array(interleaved.getPlaneBuffer(0).data);
+        expect(samples[0]).to.equal(0);
+        expect(samples[1]).to.equal(-32768);
+        expect(samples[2 * 1500]).to.equal(8192);
+
+        await interleaved.copySamplesToAsync(back);
+        expect(new Float32Array(back.getPlaneBuffer(0).data)[1500]).to.equal(0.25);
+        expect(new Float32Array(back.getPlaneBuffer(1).data)[2999]).to.equal(-1);
+        expect(AVFrame.getKernelSet()).to.be.oneOf(['avx2', 'sse2', 'neon', 'c']);
+
+        planar.dispose();
+        interleaved.dispose();
+        back.dispose();
+    });
+});
+
+describe("AVFrame statistics", it => {
+    function createVideoFrame(value: number) {
+        let frame = new AVFrame();
+        frame.format = AVPixelFormat.AV_PIX_FMT_YUV420P;
+        frame.width = 64;
+        frame.height = 48;
+        frame.allocateBuffer();
+        frame.fillRegion(null, [value, 128, 128]);
+
+        return frame;
+    }
+
+    it('computes the statistics of video frames', async () => {
+        let black = createVideoFrame(16);
+        let gray = createVideoFrame(16).fillRegion({ x: 0, y: 0, width: 32, height: 48 }, [200, 128, 128]);
+        let statistics = black.getStatistics({ histogram: true, previous: black });
+
+        expect(statistics.planes.length).to.equal(3);
+        expect(statistics.planes[0]).to.eql({ mean: 16, variance: 0 });
+        expect(statistics.histogram[16]).to.equal(64 * 48);
+        expect(statistics.black).to.be.true;
+        expect(statistics.frozen).to.be.true;
+
+        statistics = await gray.getStatisticsAsync({ previous: black });
+        expect(statistics.planes[0].mean).to.equal(108);
+        expect(statistics.planes[0].variance).to.equal(92 * 92);
+        expect(statistics.blackRatio).to.equal(0.5);
+        expect(statistics.black).to.be.false;
+        expect(statistics.frozen).to.be.false;
+        expect(statistics.histogram).to.be.undefined;
+
+        black.dispose();
+        gray.dispose();
+    });
+
+    it('compares frames', async () => {
+        let frame = createVideoFrame(100);
+        let other = createVideoFrame(100).fillRegion({ x: 0, y: 0, width: 8, height: 8 }, [110, 128, 128]);
+        let same = frame.compare(frame);
+
+        expect(same.psnr).to.equal(Infinity);
+        expect(same.ssim).to.equal(1);
+
+        let comparison = await frame.compareAsync(other);
+        expect(comparison.planes[0].mse).to.equal(100 * 64 / (64 * 48));
+        expect(comparison.planes[1].mse).to.equal(0);
+        expect(comparison.psnr).to.be.above(30);
+        expect(comparison.ssim).to.be.below(1);
+
+        frame.dispose();
+        other.dispose();
+    });
+
+    it('computes the levels of audio channels', () => {
+        let frame = new AVFrame();
+        frame.format = AVSampleFormat.AV_SAMPLE_FMT_S16;
+        frame.sampleRate = 48000;
+        frame.channelLayout = AV_CH_LAYOUT_STEREO;
+        frame.numberOfSamples = 2000;
+        frame.allocateBuffer();
+
+        let samples = new Int16Array(frame.getPlaneBuffer(0).data);
+        for (let i = 0; i < 2000; ++i) {
+            samples[2 * i] = 16384;
+            samples[2 * i + 1] = i % 2 ? -32768 : 0;
+        }
+
+        let statistics = frame.getStatistics();
+        expect(statistics.channels).to.eql([ { rms: 0.5, peak: 0.5 }, { rms: Math.SQRT1_2, peak: 1 } ]);
+        frame.dispose();
+    });
+});
+
+describe("AVFrame raw side data", it => {
+    it('reads side data and metadata without wrapping them', () => {
+        let frame = new AVFrame();
+
+        expect(frame.sideDataTypes).to.eql([]);
+        expect(frame.getSideDataRaw(AVFrameSideDataType.AV_FRAME_DATA_A53_CC)).to.be.null;
+        expect(frame.getMetadataRaw()).to.eql({});
+
+        frame.addSideData(AVFrameSideDataType.AV_FRAME_DATA_A53_CC, 8);
+        frame.getSideDataRaw(AVFrameSideDataType.AV_FRAME_DATA_A53_CC).set([1, 2, 3]);
+
+        let data = frame.getSideDataRaw(AVFrameSideDataType.AV_FRAME_DATA_A53_CC);
+        expect(frame.sideDataTypes).to.eql([ { type: AVFrameSideDataType.AV_FRAME_DATA_A53_CC, size: 8 } ]);
+        expect(data.length).to.equal(8);
+        expect(Array.from(data.subarray(0, 3))).to.eql([1, 2, 3]);
+
+        frame.dispose();
+        expect(data[2]).to.equal(3);
+    });
+});
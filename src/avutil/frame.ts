@@ -281,6 +281,86 @@ export interface AVRegionOfInterest {
     qoffset: AVRational;
 }
 
+/**
+ * A rectangle of a video frame, in pixels of its first plane (see AVFrame#copyRegionTo() and 
+ * AVFrame#fillRegion()). With chroma subsampling, x and y must be multiples of the subsampling.
+ */
+export interface AVFrameRegion {
+    x: number;
+    y: number;
+    width: number;
+    height: number;
+}
+
+export interface AVFrameStatisticsOptions {
+    /**
+     * Count the values of the luma (or first) plane into a histogram (false by default)
+     */
+    histogram?: boolean;
+
+    /**
+     * Luma value at or below which a pixel counts as black. Like the blackdetect filter by default: 37 for
+     * limited range video, 25 for full range.
+     */
+    blackThreshold?: number;
+
+    /**
+     * Ratio of black pixels from which the frame counts as black (0.98 by default, like blackdetect)
+     */
+    blackRatio?: number;
+
+    /**
+     * Mean absolute difference of the luma with the previous frame, relative to 255, below which the 
+     * frame counts as frozen (0.001 by default, the -60dB of freezedetect)
+     */
+    frozenThreshold?: number;
+
+    /**
+     * Video only. The frame before this one, of the same format and size, for frozen frame detection.
+     */
+    previous?: AVFrame;
+}
+
+export interface AVFrameStatistics {
+    /**
+     * Video: mean and variance of the values of each plane
+     */
+    planes?: { mean: number, variance: number }[];
+
+    /**
+     * Video, with the histogram option: the number of pixels of the luma plane for each of the 256 values
+     */
+    histogram?: number[];
+
+    /**
+     * Video: ratio of the luma values at or below blackThreshold, and whether that makes a black frame
+     */
+    blackRatio?: number;
+    black?: boolean;
+
+    /**
+     * Video, with a previous frame: see frozenThreshold
+     */
+    difference?: number;
+    frozen?: boolean;
+
+    /**
+     * Audio: RMS and peak level of each channel, relative to full scale (1)
+     */
+    channels?: { rms: number, peak: number }[];
+}
+
+export interface AVFrameComparison {
+    /**
+     * Over the whole frame: PSNR in dB (Infinity for identical frames), and SSIM (1 for identical frames)
+     * weighted by the size of the planes
+     */
+    psnr: number;
+    ssim: number;
+
+    planes: { mse: number, psnr: number, ssim: number }[];
+}
+
 export const AV_NUM_DATA_POINTERS = 8;
 
 /**
@@ -341,6 +421,25 @@ export const FF_DECODE_ERROR_DECODE_SLICES =       8;
 export declare class AVFrame {
     static getSideDataName(type: AVFrameSideDataType): string;
 
+    /**
+     * Take the frame shared with the given token (see share()), for instance in a worker thread which 
+     * received the token from postMessage(). The frame refers to the same data as the shared frame, 
+     * without copying it. A shared frame can only be taken once.
+     */
+    static takeShared(token: number): AVFrame;
+
+    /**
+     * Release a frame shared with share() which will not be taken.
+     * @returns whether a frame was still shared with the token
+     */
+    static releaseShared(token: number): boolean;
+
+    /**
+     * The SIMD kernels which copyRegionTo(), fillRegion() and copySamplesTo() use on this CPU: "avx2", 
+     * "sse2", "neon" or "c". Chosen once, from the CPU flags of libavutil.
+     */
+    static getKernelSet(): string;
+
     constructor();
     /**
      * Set up a new reference to the data described by the source frame.
@@ -367,6 +466,15 @@ export declare class AVFrame {
      */
     clone(): AVFrame;
 
+    /**
+     * Share this frame with another worker thread of the process: like clone(), but the reference is 
+     * kept by the addon, under the returned token, until takeShared() is called with it (once, by any 
+     * thread) or releaseShared(). The data is shared rather than copied, so it must not be written 
+     * to while the frame is shared. Frames whose data is a Javascript ArrayBuffer (see AVBuffer) 
+     * cannot be shared.
+     */
+    share(): number;
+
     /**
      * Copy the frame data from this frame to another frame.
      *
@@ -388,6 +496,90 @@ export declare class AVFrame {
      */
     copyPropertiesTo(other: AVFrame);
 
+    /**
+     * Copy the data (and properties) of a hardware frame to the given frame in system memory, or the other 
+     * way around when uploading to a frame from AVHWFramesContext#getBuffer(). When downloading to a frame 
+     * without buffers, they are allocated in the first format the device offers.
+     */
+    transferData(other: AVFrame): void;
+
+    /**
+     * Like transferData(), on a worker thread. Neither frame may be used until the promise settles.
+     * @returns a promise resolving to the other frame
+     */
+    transferDataAsync(other: AVFrame): Promise<AVFrame>;
+
+    /**
+     * Copy a region of this video frame into the given writable frame of the same pixel format, at (x, y)
+     * (0, 0 by default), plane by plane and whatever the line sizes of either frame. Use this to crop 
+     * without going through libswscale.
+     * @param region The region to copy, or null for the whole frame
+     * @returns the other frame
+     */
+    copyRegionTo(other: AVFrame, region: AVFrameRegion | null, x?: number, y?: number): AVFrame;
+
+    /**
+     * Like copyRegionTo(), on a worker thread, for large frames. Neither frame may be used until the 
+     * promise settles.
+     */
+    copyRegionToAsync(other: AVFrame, region: AVFrameRegion | null, x?: number, y?: number): Promise<AVFrame>;
+
+    /**
+     * Fill a region of this (writable) video frame with a color, given as one value per component of 
+     * the pixel format, in the order of its descriptor: [Y, U, V] for YUV formats, [R, G, B] or 
+     * [R, G, B, A] for RGB ones (whatever their order in memory). Formats whose components share bytes 
+     * (like RGB565), components of more than 16 bits, floating point and paletted formats are not 
+     * supported.
+     * @param region The region to fill, or null for the whole frame
+     * @returns this frame
+     */
+    fillRegion(region: AVFrameRegion | null, values: number[]): AVFrame;
+
+    /**
+     * Like fillRegion(), on a worker thread. The frame may not be used until the promise settles.
+     */
+    fillRegionAsync(region: AVFrameRegion | null, values: number[]): Promise<AVFrame>;
+
+    /**
+     * Copy the samples of this audio frame into the given writable frame with the same number of 
+     * channels and at least as many samples, converting between planar and interleaved layouts and 
+     * between the s16, s32, flt and dbl sample formats (planar or not) along the way. This covers the
+     * common conversions without an SwrContext. Integer formats saturate.
+     * @param gain Factor to apply to the samples (1 by default)
+     * @returns the other frame
+     */
+    copySamplesTo(other: AVFrame, gain?: number): AVFrame;
+
+    /**
+     * Like copySamplesTo(), on a worker thread. Neither frame may be used until the promise settles.
+     */
+    copySamplesToAsync(other: AVFrame, gain?: number): Promise<AVFrame>;
+
+    /**
+     * Compute the statistics of this frame for quality control, natively: for video (in planar 8 bit
+     * pixel formats like yuv420p, gray or gbrp), the mean and variance of each plane, black frame 
+     * detection and optionally a luma histogram and frozen frame detection against the previous frame; 
+     * for audio (s16, s32, flt and dbl, planar or not), the RMS and peak level of each channel. 
+     * See also AVCodecContext#frameStatistics.
+     */
+    getStatistics(options?: AVFrameStatisticsOptions): AVFrameStatistics;
+
+    /**
+     * Like getStatistics(), on a worker thread. Neither frame may be changed until the promise settles.
+     */
+    getStatisticsAsync(options?: AVFrameStatisticsOptions): Promise<AVFrameStatistics>;
+
+    /**
+     * Compare this video frame with a reference frame of the same (planar 8 bit) pixel format and size: 
+     * mean squared error, PSNR and SSIM (over 8x8 windows, like the ssim filter) per plane and overall.
+     */
+    compare(reference: AVFrame): AVFrameComparison;
+
+    /**
+     * Like compare(), on a worker thread. Neither frame may be changed until the promise settles.
+     */
+    compareAsync(reference: AVFrame): Promise<AVFrameComparison>;
+
     /**
      * Get the buffer reference a given data plane is stored in.
      *
@@ -412,6 +604,19 @@ export declare class AVFrame {
      */
     getSideData(type: AVFrameSideDataType): AVFrameSideData;
 
+    /**
+     * Retrieve the payload of the side data with the given type, without creating an AVFrameSideData
+     * object for it. The array is a view of the side data buffer, which it keeps referenced, so writes
+     * to it are seen by the frame. Null if the frame has no side data of this type.
+     */
+    getSideDataRaw(type: AVFrameSideDataType): Uint8Array;
+
+    /**
+     * Retrieve the frame metadata as a plain object, without creating an AVDictionary object for it.
+     * This is a copy, changes to it do not affect the frame.
+     */
+    getMetadataRaw(): { [key: string]: string };
+
     /**
      * Remove the side data object with the given type, if it exists.
      */
@@ -465,6 +670,41 @@ export declare class AVFrame {
      */
     allocateBuffer(alignment?: number);
 
+    /**
+     * Free the frame now instead of waiting for the garbage collector. Frames received from a codec 
+     * context are returned to the context's pool for reuse. The frame must not be used afterwards.
+     * Throws while an async operation (transferDataAsync() and the like) is using the frame.
+     */
+    release(): void;
+
+    /**
+     * Release the underlying frame now instead of waiting for the garbage collector. Accessing 
+     * the object afterwards throws. Also available as [Symbol.dispose] where the runtime supports it.
+     * Throws while an async operation (transferDataAsync() and the like) is using the frame.
+     */
+    dispose(): void;
+
+    /**
+     * Read many properties at once, crossing into native code only once. By default the timing 
+     * and format properties (pts, packetDts, bestEffortTimestamp, packetDuration, timeBase, width, height,
+     * numberOfSamples, sampleRate, format, keyFrame, pictureType, sampleAspectRatio and flags) are read.
+     */
+    getProps(names?: (keyof AVFrame)[]): Partial<AVFrame>;
+
+    /**
+     * Set many properties at once, crossing into native code only once. Throws (without changing 
+     * anything) if the object contains an unknown or read-only property.
+     */
+    setProps(properties: Partial<AVFrame>): void;
+
+    /**
+     * Write the timing fields of the frame into the given array starting at `offset` (default 0), without 
+     * allocating any objects: pts, packetDts, bestEffortTimestamp, packetDuration, timeBase.num and 
+     * timeBase.den, in that order. With a Float64Array, values beyond 2^53 lose precision (including 
+     * AV_NOPTS_VALUE).
+     */
+    readTimings(target: BigInt64Array | Float64Array, offset?: number): void;
+
     /**
      * Check if the frame data is writable.
      *
@@ -650,11 +890,28 @@ export declare class AVFrame {
      */
     extendedBuffers: AVBuffer[];
 
+    /**
+     * Views over the data of each plane (each audio channel for planar audio). The length of each 
+     * view is derived from the format, lineSizes and height (numberOfSamples and channels for audio).
+     * Planes not backed by a reference counted buffer are null. Hardware frames have no planes.
+     *
+     * Each view keeps its buffer alive, so it stays valid after the frame is unreferenced or freed. 
+     * Like lineSizes, buffers and extendedBuffers, the returned array is cached and frozen: it is 
+     * only rebuilt when the frame's layout changes.
+     */
+    readonly planes: Uint8Array[];
+
     /**
      * Retrieve the full set of side data objects.
      */
     readonly sideData: AVFrameSideData[];
 
+    /**
+     * The type and size of each side data of this frame, in order. Unlike sideData, no objects are
+     * created for the side data themselves.
+     */
+    readonly sideDataTypes: { type: AVFrameSideDataType, size: number }[];
+
     /**
      * Frame flags, a combination of @ref lavu_frame_flags
      */
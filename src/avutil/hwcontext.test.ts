@@ -0,0 +1,24 @@
+import { describe } from "razmin";
+import { AVHWDeviceContext as AVHWDeviceContextType, AVHWDeviceType } from "./hwcontext";
+import { AVHWDeviceContext as AVHWDeviceContextImpl } from "../../binding";
+import { expect } from "chai";
+
+const AVHWDeviceContext = <typeof AVHWDeviceContextType>AVHWDeviceContextImpl;
+
+describe("AVHWDeviceContext", it => {
+    it("maps device type names", () => {
+        expect(AVHWDeviceContext.findTypeByName('vaapi')).to.equal(AVHWDeviceType.AV_HWDEVICE_TYPE_VAAPI);
+        expect(AVHWDeviceContext.getTypeName(AVHWDeviceType.AV_HWDEVICE_TYPE_CUDA)).to.equal('cuda');
+        expect(AVHWDeviceContext.findTypeByName('not-a-device')).to.equal(AVHWDeviceType.AV_HWDEVICE_TYPE_NONE);
+    });
+
+    it("lists the available device types", () => {
+        let types = AVHWDeviceContext.availableTypes();
+        expect(types).to.be.an('array');
+        expect(types).not.to.include(AVHWDeviceType.AV_HWDEVICE_TYPE_NONE);
+    });
+
+    it("rejects unknown device types", () => {
+        expect(() => new AVHWDeviceContext('not-a-device')).to.throw();
+    });
+});
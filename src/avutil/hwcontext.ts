@@ -57,55 +57,34 @@ export type AVHWDeviceInternal = OpaquePtr;
  * optionally invoking a user-specified callback for uninitializing the hardware
  * state.
  */
-export interface AVHWDeviceContext {
+export declare class AVHWDeviceContext {
     /**
-     * A class for logging. Set by av_hwdevice_ctx_alloc().
+     * Open a device of the given type (or type name, such as 'vaapi' or 'cuda'). The meaning of device 
+     * depends on the type: a DRM node for VAAPI (e.g. '/dev/dri/renderD128'), a GPU index for CUDA...
+     * Without one the default device is used.
      */
-    av_class: AVClass;
+    constructor(type: AVHWDeviceType | string, device?: string, options?: AVDictionary);
 
-    /**
-     * Private data used internally by libavutil. Must not be accessed in any
-     * way by the caller.
-     */
-    internal: AVHWDeviceInternal;
+    static findTypeByName(name: string): AVHWDeviceType;
+    static getTypeName(type: AVHWDeviceType): string;
 
     /**
-     * This field identifies the underlying API used for hardware access.
-     *
-     * This field is set when this struct is allocated and never changed
-     * afterwards.
+     * The device types libavutil was built with. Whether a device can actually be opened depends on the 
+     * hardware and drivers present.
      */
-    type: AVHWDeviceType;
+    static availableTypes(): AVHWDeviceType[];
 
     /**
-     * The format-specific data, allocated and freed by libavutil along with
-     * this context.
-     *
-     * Should be cast by the user to the format-specific context defined in the
-     * corresponding header (hwcontext_*.h) and filled as described in the
-     * documentation before calling av_hwdevice_ctx_init().
-     *
-     * After calling av_hwdevice_ctx_init() this struct should not be modified
-     * by the caller.
+     * This field identifies the underlying API used for hardware access.
      */
-    hwctx: OpaquePtr;
+    readonly type: AVHWDeviceType;
 
     /**
-     * This field may be set by the caller before calling av_hwdevice_ctx_init().
-     *
-     * If non-NULL, this callback will be called when the last reference to
-     * this context is unreferenced, immediately before it is freed.
-     *
-     * @note when other objects (e.g an AVHWFramesContext) are derived from this
-     *       struct, this callback will be invoked after all such child objects
-     *       are fully uninitialized and their respective destructors invoked.
+     * Shorthand for creating an AVHWFramesContext on this device, configuring it and calling init().
      */
-    free: (ctx: AVHWDeviceContext) => void;
+    createFramesContext(properties: Partial<AVHWFramesContext>): AVHWFramesContext;
 
-    /**
-     * Arbitrary user data, to be used e.g. by the free() callback.
-     */
-    user_opaque: OpaquePtr;
+    dispose(): void;
 }
 
 export type AVHWFramesInternal = OpaquePtr;
@@ -120,113 +99,51 @@ export type AVHWFramesInternal = OpaquePtr;
  * yields a reference, whose data field points to the actual AVHWFramesContext
  * struct.
  */
-export interface AVHWFramesContext {
-    /**
-     * A class for logging.
-     */
-    av_class: AVClass;
-
-    /**
-     * Private data used internally by libavutil. Must not be accessed in any
-     * way by the caller.
-     */
-    internal: AVHWFramesInternal;
-
+export declare class AVHWFramesContext {
     /**
-     * A reference to the parent AVHWDeviceContext. This reference is owned and
-     * managed by the enclosing AVHWFramesContext, but the caller may derive
-     * additional references from it.
+     * Allocate a frames context on the given device. Set format, swFormat, width and height (and 
+     * optionally initialPoolSize), then call init().
      */
-    device_ref: AVBuffer;
+    constructor(device: AVHWDeviceContext);
 
-    /**
-     * The parent AVHWDeviceContext. This is simply a pointer to
-     * device_ref->data provided for convenience.
-     *
-     * Set by libavutil in av_hwframe_ctx_init().
-     */
-    device_ctx: AVHWDeviceContext;
+    readonly deviceContext: AVHWDeviceContext;
+    readonly initialized: boolean;
 
     /**
-     * The format-specific data, allocated and freed automatically along with
-     * this context.
-     *
-     * Should be cast by the user to the format-specific context defined in the
-     * corresponding header (hwframe_*.h) and filled as described in the
-     * documentation before calling av_hwframe_ctx_init().
-     *
-     * After any frames using this context are created, the contents of this
-     * struct should not be modified by the caller.
+     * The pixel format identifying the underlying HW surface type, such as AV_PIX_FMT_VAAPI.
      */
-    hwctx: OpaquePtr;
+    format: AVPixelFormat;
 
     /**
-     * This field may be set by the caller before calling av_hwframe_ctx_init().
-     *
-     * If non-NULL, this callback will be called when the last reference to
-     * this context is unreferenced, immediately before it is freed.
+     * The pixel format identifying the actual data layout of the hardware frames, such as AV_PIX_FMT_NV12.
      */
-    free: (ctx: AVHWFramesContext) => void;
+    swFormat: AVPixelFormat;
 
-    /**
-     * Arbitrary user data, to be used e.g. by the free() callback.
-     */
-    user_opaque: OpaquePtr;
+    width: number;
+    height: number;
 
     /**
-     * A pool from which the frames are allocated by av_hwframe_get_buffer().
-     * This field may be set by the caller before calling av_hwframe_ctx_init().
-     * The buffers returned by calling av_buffer_pool_get() on this pool must
-     * have the properties described in the documentation in the corresponding hw
-     * type's header (hwcontext_*.h). The pool will be freed strictly before
-     * this struct's free() callback is invoked.
-     *
-     * This field may be NULL, then libavutil will attempt to allocate a pool
-     * internally. Note that certain device types enforce pools allocated at
-     * fixed size (frame count), which cannot be extended dynamically. In such a
-     * case, initial_pool_size must be set appropriately.
+     * Initial size of the frame pool. Some hardware APIs need the pool to be allocated up front.
      */
-    pool: AVBufferPool;
+    initialPoolSize: number;
 
     /**
-     * Initial size of the frame pool. If a device type does not support
-     * dynamically resizing the pool, then this is also the maximum pool size.
-     *
-     * May be set by the caller before calling av_hwframe_ctx_init(). Must be
-     * set if pool is NULL and the device type does not support dynamic pools.
+     * Set many properties at once. Only possible before init().
      */
-    initial_pool_size: number;
+    configure(properties: Partial<AVHWFramesContext>): void;
 
     /**
-     * The pixel format identifying the underlying HW surface type.
-     *
-     * Must be a hwaccel format, i.e. the corresponding descriptor must have the
-     * AV_PIX_FMT_FLAG_HWACCEL flag set.
-     *
-     * Must be set by the user before calling av_hwframe_ctx_init().
+     * Finish setting up the pool. The properties cannot be changed afterwards.
      */
-    format: AVPixelFormat;
+    init(): void;
 
     /**
-     * The pixel format identifying the actual data layout of the hardware
-     * frames.
-     *
-     * Must be set by the caller before calling av_hwframe_ctx_init().
-     *
-     * @note when the underlying API does not provide the exact data layout, but
-     * only the colorspace/bit depth, this field should be set to the fully
-     * planar version of that format (e.g. for 8-bit 420 YUV it should be
-     * AV_PIX_FMT_YUV420P, not AV_PIX_FMT_NV12 or anything else).
+     * Allocate a frame from the pool, into the given frame or a new one. To upload to it, see 
+     * AVFrame#transferData().
      */
-    sw_format: AVPixelFormat;
+    getBuffer(frame?: AVFrame): AVFrame;
 
-    /**
-     * The allocated dimensions of the frames in this pool.
-     *
-     * Must be set by the user before calling av_hwframe_ctx_init().
-     */
-    width: number;
-    height: number;
+    dispose(): void;
 }
 
 /**
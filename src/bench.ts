@@ -0,0 +1,68 @@
+import * as fs from "fs";
+import * as os from "os";
+import { BenchResult, BenchSuite } from "./bench/harness";
+import { nativeBenchmarks } from "./bench/native.bench";
+import { crossingBenchmarks } from "./bench/crossing.bench";
+import { codecBenchmarks } from "./bench/codec.bench";
+
+/**
+ * Runs the benchmarks against the nlav_bench addon (npm run build:bench), and prints the results as
+ * JSON for tracking them across changes.
+ *
+ *     node --expose-gc dist/bench [--quick] [--filter <suite>] [--out <file>]
+ *
+ * Progress goes to stderr, so stdout is only the report.
+ */
+
+const SUITES: Record<string, BenchSuite> = {
+    native: nativeBenchmarks,
+    crossing: crossingBenchmarks,
+    codec: codecBenchmarks
+};
+
+function option(name: string) {
+    let index = process.argv.indexOf(name);
+    return index >= 0 ? process.argv[index + 1] : undefined;
+}
+
+async function main() {
+    let quick = process.argv.includes('--quick');
+    let filter = option('--filter');
+    let out = option('--out');
+    let results: (BenchResult & { suite: string })[] = [];
+
+    for (let suite of Object.keys(SUITES)) {
+        if (filter && filter !== suite)
+            continue;
+
+        process.stderr.write(`${suite}...\n`);
+        (global as any).gc?.();
+
+        for (let result of await SUITES[suite](quick)) {
+            process.stderr.write(`  ${result.name}: ${result.value.toFixed(2)} ${result.unit}\n`);
+            results.push({ suite, ...result });
+        }
+    }
+
+    let report = JSON.stringify({
+        version: require('../package.json').version,
+        timestamp: new Date().toISOString(),
+        quick,
+        node: process.version,
+        platform: process.platform,
+        arch: process.arch,
+        cpus: os.cpus().length,
+        cpuModel: os.cpus()[0]?.model,
+        results
+    }, undefined, 2);
+
+    if (out)
+        fs.writeFileSync(out, report + '\n');
+
+    process.stdout.write(report + '\n');
+}
+
+main().catch(e => {
+    console.error(e);
+    process.exit(1);
+});
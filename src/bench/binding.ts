@@ -0,0 +1,5 @@
+/**
+ * The nlav_bench addon: the full binding, plus the native micro-benchmarks of native/bench. Build it
+ * with `npm run build:bench`.
+ */
+export const binding = require("bindings")("nlav_bench.node");
@@ -0,0 +1,136 @@
+import { binding } from "./binding";
+import { BenchResult, BenchSuite, elapsedMs, percentile } from "./harness";
+import { AVFrame as AVFrameType, AVPixelFormat } from "../avutil";
+import { AVCodec as AVCodecType } from "../avcodec/codec";
+import { AVCodecContext } from "../avcodec/avcodec";
+import { AVPacket } from "../avcodec/packet";
+import { performance } from "perf_hooks";
+
+const AVCodec = <typeof AVCodecType>binding.AVCodec;
+const AVFrame = <typeof AVFrameType>binding.AVFrame;
+
+const RESOLUTIONS = [ [ 640, 360 ], [ 1280, 720 ], [ 1920, 1080 ], [ 3840, 2160 ] ];
+
+function createContext(codec: AVCodecType, width: number, height: number) {
+    let context = codec.newContext();
+    context.width = width;
+    context.height = height;
+    context.timeBase = { num: 1, den: 25 };
+    context.frameRate = { num: 25, den: 1 };
+    context.pixelFormat = AVPixelFormat.AV_PIX_FMT_YUV420P;
+
+    return context;
+}
+
+function createFrame(width: number, height: number) {
+    let frame = new AVFrame();
+    frame.format = AVPixelFormat.AV_PIX_FMT_YUV420P;
+    frame.width = width;
+    frame.height = height;
+    frame.allocateBuffer();
+
+    return frame;
+}
+
+function each<T>(output: T | T[], fn: (item: T) => void) {
+    if (Array.isArray(output))
+        output.forEach(fn);
+    else
+        fn(output);
+}
+
+/**
+ * Frames per second through a raw → rawvideo encoder → rawvideo decoder loop, both contexts on their own
+ * worker threads. rawvideo does next to no work, so this measures the binding (queues, threads,
+ * delivery) rather than the codecs.
+ */
+async function loop(width: number, height: number, frames: number): Promise<BenchResult> {
+    let encoder = createContext(AVCodec.findEncoder('rawvideo'), width, height);
+    let decoder = createContext(AVCodec.findDecoder('rawvideo'), width, height);
+    let source = createFrame(width, height);
+    let decoded = 0;
+    let finished: () => void;
+    let done = new Promise<void>(resolve => finished = resolve);
+
+    encoder.onPacket = output => each(output, packet => decoder.sendPacketAsync(packet));
+    decoder.onFrame = output => each(output, () => ++decoded === frames && finished());
+    await encoder.openAsync();
+    await decoder.openAsync();
+
+    let started = performance.now();
+    for (let i = 0; i < frames; ++i) {
+        let frame = source.clone();
+        frame.pts = i;
+        await encoder.sendFrameAsync(frame);
+    }
+
+    await done;
+    let ms = elapsedMs(started);
+
+    encoder.dispose();
+    decoder.dispose();
+    source.dispose();
+
+    return { name: `loop.rawvideo.${width}x${height}`, unit: 'frames/s', value: frames * 1000 / ms, frames, ms };
+}
+
+/**
+ * From sendPacket() to onFrame for one packet at a time through a rawvideo decoder: the round trip
+ * through the worker thread and the delivery back to the JS thread.
+ */
+async function latency(samples: number): Promise<BenchResult> {
+    let width = 1280, height = 720;
+    let encoder = createContext(AVCodec.findEncoder('rawvideo'), width, height);
+    let decoder = createContext(AVCodec.findDecoder('rawvideo'), width, height);
+    let packet = await new Promise<AVPacket>(resolve => {
+        encoder.onPacket = output => each(output, resolve);
+        encoder.open();
+        encoder.sendFrame(createFrame(width, height));
+    });
+
+    let received: () => void;
+    decoder.onFrame = () => received();
+    await decoder.openAsync();
+
+    let latencies: number[] = [];
+    for (let i = 0; i < samples; ++i) {
+        let arrived = new Promise<void>(resolve => received = resolve);
+        let started = performance.now();
+        decoder.sendPacket(packet);
+        await arrived;
+        latencies.push(elapsedMs(started) * 1000);
+    }
+
+    let stats = decoder.getStats();
+    latencies.sort((a, b) => a - b);
+
+    encoder.dispose();
+    decoder.dispose();
+
+    return {
+        name: 'onFrame.latency.rawvideo.1280x720',
+        unit: 'us',
+        value: percentile(latencies, 0.5),
+        p99: percentile(latencies, 0.99),
+        max: latencies[latencies.length - 1],
+        samples,
+        queueWaitP50Us: stats.queueWait.p50Us,
+        sendP50Us: stats.send.p50Us,
+        receiveP50Us: stats.receive.p50Us,
+        deliveryP50Us: stats.delivery.p50Us,
+        deliveryP99Us: stats.delivery.p99Us
+    };
+}
+
+/**
+ * Throughput and latency through the threaded codec contexts
+ */
+export const codecBenchmarks: BenchSuite = async quick => {
+    let results: BenchResult[] = [];
+
+    for (let [ width, height ] of quick ? RESOLUTIONS.slice(0, 2) : RESOLUTIONS)
+        results.push(await loop(width, height, quick ? 100 : Math.max(100, Math.floor(250 * 1280 * 720 / (width * height)))));
+
+    results.push(await latency(quick ? 200 : 2000));
+    return results;
+};
@@ -0,0 +1,46 @@
+import { binding } from "./binding";
+import { BenchResult, BenchSuite, measure } from "./harness";
+import { AVBuffer as AVBufferType, AVFrame as AVFrameType, AVPixelFormat } from "../avutil";
+import { AVPacket as AVPacketType } from "../avcodec";
+
+const AVBuffer = <typeof AVBufferType>binding.AVBuffer;
+const AVFrame = <typeof AVFrameType>binding.AVFrame;
+const AVPacket = <typeof AVPacketType>binding.AVPacket;
+
+/**
+ * The cost of crossing from Javascript into the binding: accessors, and creating/wrapping buffers
+ */
+export const crossingBenchmarks: BenchSuite = async quick => {
+    let iterations = quick ? 100_000 : 1_000_000;
+    let results: BenchResult[] = [];
+    let sink = 0;
+
+    let frame = new AVFrame();
+    frame.format = AVPixelFormat.AV_PIX_FMT_YUV420P;
+    frame.width = 1280;
+    frame.height = 720;
+    frame.allocateBuffer();
+
+    let packet = new AVPacket(new Uint8Array(4096));
+
+    results.push(measure('frame.width.get', iterations, () => sink += frame.width));
+    results.push(measure('frame.pts.set', iterations, i => frame.pts = i));
+    results.push(measure('frame.getProps', iterations, () => sink += frame.getProps([ 'width', 'height', 'format', 'pts' ]).width));
+    results.push(measure('frame.getPlaneBuffer', iterations, () => sink += frame.getPlaneBuffer(0).size));
+    results.push(measure('packet.pts.get', iterations, () => sink += packet.pts));
+    results.push(measure('packet.pts.set', iterations, i => packet.pts = i));
+
+    // Allocations: fewer iterations, these produce garbage
+    let data = new Uint8Array(4096);
+    let padded = new Uint8Array(4096 + 64);
+    iterations /= 10;
+
+    results.push(measure('buffer.create.4KiB', iterations, () => sink += new AVBuffer(4096).size));
+    results.push(measure('buffer.wrap.4KiB', iterations, () => sink += new AVBuffer(data).size));
+    results.push(measure('packet.create.4KiB', iterations, () => new AVPacket(padded, true).dispose()));
+
+    frame.dispose();
+    packet.dispose();
+
+    return sink >= 0 ? results : [];
+};
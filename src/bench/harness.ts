@@ -0,0 +1,41 @@
+import { performance } from "perf_hooks";
+
+export interface BenchResult {
+    name: string;
+    unit: string;
+    value: number;
+    [detail: string]: number | string;
+}
+
+export type BenchSuite = (quick: boolean) => Promise<BenchResult[]>;
+
+/**
+ * Nanoseconds per call of fn, the median of several rounds of the given number of calls (after a
+ * warm-up round, so that the JIT has settled).
+ */
+export function measure(name: string, iterations: number, fn: (i: number) => void, rounds = 5): BenchResult {
+    for (let i = 0; i < iterations; ++i)
+        fn(i);
+
+    let samples: number[] = [];
+    for (let round = 0; round < rounds; ++round) {
+        let started = performance.now();
+        for (let i = 0; i < iterations; ++i)
+            fn(i);
+        samples.push(elapsedMs(started) * 1e6 / iterations);
+    }
+
+    samples.sort((a, b) => a - b);
+    return { name, unit: 'ns/op', value: percentile(samples, 0.5), min: samples[0], iterations };
+}
+
+export function percentile(sorted: number[], fraction: number) {
+    if (sorted.length === 0)
+        return 0;
+
+    return sorted[Math.min(sorted.length - 1, Math.floor(fraction * sorted.length))];
+}
+
+export function elapsedMs(started: number) {
+    return performance.now() - started;
+}
@@ -0,0 +1,27 @@
+import { binding } from "./binding";
+import { BenchResult, BenchSuite } from "./harness";
+
+interface NativeResult {
+    iterations: number;
+    ns: number;
+    nsPerOp: number;
+}
+
+function result(name: string, native: NativeResult): BenchResult {
+    return { name, unit: 'ns/op', value: native.nsPerOp, iterations: native.iterations };
+}
+
+/**
+ * The native building blocks on their own (see native/bench/index.cpp)
+ */
+export const nativeBenchmarks: BenchSuite = async quick => {
+    let iterations = quick ? 100_000 : 1_000_000;
+
+    return [
+        result('native.framePool.acquireRelease', binding.bench.framePool(iterations)),
+        result('native.resourceMap.fromHandle', binding.bench.resourceLookup(iterations)),
+        result('native.spscQueue.transfer', binding.bench.spscQueue(iterations)),
+        result('native.histogram.record', binding.bench.histogram(iterations)),
+        result('native.threadSafeFunction.call', await binding.bench.threadSafeFunction(iterations / 10))
+    ];
+};
@@ -3,4 +3,8 @@
 export * from '../binding'; 
 
 export * from './avutil';
-export * from './avcodec';
\ No newline at end of file
+export * from './avcodec';
+export * from './avfilter';
+export * from './avformat';
+export * from './swresample';
+export * from './swscale';
\ No newline at end of file
@@ -0,0 +1 @@
+export * from './swresample';
\ No newline at end of file
@@ -0,0 +1,89 @@
+import { describe } from "razmin";
+import { SwrContext as SwrContextType } from "./swresample";
+import { SwrContext as SwrContextImpl } from "../../binding";
+import { AVFrame as AVFrameType, AVSampleFormat, AV_CH_LAYOUT_STEREO } from "../avutil";
+import { AVFrame as AVFrameImpl } from "../../binding";
+import { expect } from "chai";
+
+const SwrContext = <typeof SwrContextType>SwrContextImpl;
+const AVFrame = <typeof AVFrameType>AVFrameImpl;
+
+describe("SwrContext", it => {
+    function createTestFrame(pts: number) {
+        let frame = new AVFrame();
+        frame.format = AVSampleFormat.AV_SAMPLE_FMT_FLTP;
+        frame.sampleRate = 48000;
+        frame.channelLayout = AV_CH_LAYOUT_STEREO;
+        frame.numberOfSamples = 1024;
+        frame.allocateBuffer();
+        frame.pts = pts;
+
+        return frame;
+    }
+
+    it('converts planar float to interleaved s16', () => {
+        let resampler = new SwrContext({ outputSampleFormat: AVSampleFormat.AV_SAMPLE_FMT_S16 });
+        let frame = resampler.convert(createTestFrame(0));
+
+        expect(frame.format).to.equal(AVSampleFormat.AV_SAMPLE_FMT_S16);
+        expect(frame.sampleRate).to.equal(48000);
+        expect(frame.numberOfSamples).to.equal(1024);
+    });
+
+    it('resamples and flushes the delayed samples', () => {
+        let resampler = new SwrContext({ outputSampleRate: 44100 });
+        let samples = 0;
+
+        for (let i = 0; i < 10; ++i) {
+            let frame = resampler.convert(createTestFrame(i * 1024));
+            if (frame) {
+                expect(frame.sampleRate).to.equal(44100);
+                samples += frame.numberOfSamples;
+            }
+        }
+
+        let rest = resampler.flush();
+        if (rest)
+            samples += rest.numberOfSamples;
+
+        expect(resampler.delay).to.equal(0);
+        expect(Math.abs(samples - 10 * 1024 * 44100 / 48000)).to.be.lessThan(2);
+    });
+
+    it('converts on a worker thread, in order', async () => {
+        let resampler = new SwrContext({ outputSampleRate: 24000 });
+        let frames = await Promise.all([0, 1, 2].map(i => resampler.convertAsync(createTestFrame(i * 1024))));
+        let timestamps = frames.filter(f => f).map(f => f.pts);
+
+        expect(timestamps).to.eql(timestamps.slice().sort((a, b) => a - b));
+    });
+
+    it('refuses to convert synchronously while async conversions are pending', async () => {
+        let resampler = new SwrContext({ outputSampleRate: 24000 });
+        let pending = resampler.convertAsync(createTestFrame(0));
+
+        expect(() => resampler.convert(createTestFrame(1024))).to.throw();
+        expect(() => resampler.flush()).to.throw();
+
+        await pending;
+        resampler.convert(createTestFrame(1024));
+    });
+
+    it('refuses to dispose of the input frame while it is being converted', async () => {
+        let resampler = new SwrContext({ outputSampleRate: 24000 });
+        let input = createTestFrame(0);
+        let pending = resampler.convertAsync(input);
+
+        expect(() => input.dispose()).to.throw();
+        await pending;
+        input.dispose();
+    });
+
+    it('throws when given a disposed frame', () => {
+        let resampler = new SwrContext({ outputSampleRate: 24000 });
+        let input = createTestFrame(0);
+        input.dispose();
+
+        expect(() => resampler.convert(input)).to.throw(/disposed/);
+    });
+});
@@ -0,0 +1,63 @@
+import { AVFrame, AVSampleFormat } from "../avutil";
+import { AVCodecContextPoolCounters } from "../avcodec";
+
+/**
+ * Converts audio frames to another sample format, sample rate and/or channel layout with libswresample.
+ * The input format is taken from the frames, the output format defaults to the input one for any 
+ * property left unset.
+ * 
+ * Resampling holds back a few samples (see delay), so the output of a conversion does not line up with
+ * its input: convert the frames of a stream in order, and call flush() at the end of the stream.
+ * Timestamps are carried over, in a time base of 1/outputSampleRate.
+ */
+export declare class SwrContext {
+    constructor(properties?: Partial<SwrContext>);
+
+    /**
+     * -1 (the default) for the input sample format
+     */
+    outputSampleFormat: AVSampleFormat;
+
+    /**
+     * 0 (the default) for the input sample rate
+     */
+    outputSampleRate: number;
+
+    /**
+     * Channel layout mask (AV_CH_LAYOUT_*), 0 (the default) for the input channel layout
+     */
+    outputChannelLayout: number;
+
+    /**
+     * Number of samples (at the output rate) held back, which come out with later conversions or flush()
+     */
+    readonly delay: number;
+
+    /**
+     * How well the output frames are being reused. Frames return to the pool once they are garbage 
+     * collected or disposed.
+     */
+    readonly poolStats: AVCodecContextPoolCounters;
+
+    configure(properties: Partial<SwrContext>): void;
+
+    /**
+     * Convert the samples of the given frame. Returns a frame from the pool with the samples available 
+     * so far, or null if there are none yet. Changing the input format midway drops the samples held 
+     * back. Throws while convertAsync() / flushAsync() calls are pending.
+     */
+    convert(frame: AVFrame): AVFrame | null;
+
+    /**
+     * Like convert(), but on a worker thread. Conversions run in the order they are called in. The frame
+     * must not be changed until the promise settles, and cannot be disposed of meanwhile.
+     */
+    convertAsync(frame: AVFrame): Promise<AVFrame | null>;
+
+    /**
+     * Return the samples held back, or null if there are none. Throws while convertAsync() / 
+     * flushAsync() calls are pending.
+     */
+    flush(): AVFrame | null;
+    flushAsync(): Promise<AVFrame | null>;
+}
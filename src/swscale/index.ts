@@ -0,0 +1 @@
+export * from './swscale';
\ No newline at end of file
@@ -0,0 +1,82 @@
+import { describe } from "razmin";
+import { SwsContext as SwsContextType, SWS_BILINEAR } from "./swscale";
+import { SwsContext as SwsContextImpl } from "../../binding";
+import { AVFrame as AVFrameType, AVPixelFormat } from "../avutil";
+import { AVFrame as AVFrameImpl } from "../../binding";
+import { expect } from "chai";
+
+const SwsContext = <typeof SwsContextType>SwsContextImpl;
+const AVFrame = <typeof AVFrameType>AVFrameImpl;
+
+describe("SwsContext", it => {
+    function createTestFrame() {
+        let frame = new AVFrame();
+        frame.format = AVPixelFormat.AV_PIX_FMT_YUV420P;
+        frame.width = 64;
+        frame.height = 48;
+        frame.allocateBuffer();
+        frame.pts = 42;
+
+        return frame;
+    }
+
+    it('converts into a pooled frame', () => {
+        let scaler = new SwsContext({ flags: SWS_BILINEAR });
+        let frame = scaler.scale(createTestFrame(), { width: 32, height: 24, pixelFormat: AVPixelFormat.AV_PIX_FMT_RGBA });
+
+        expect(frame.width).to.equal(32);
+        expect(frame.height).to.equal(24);
+        expect(frame.format).to.equal(AVPixelFormat.AV_PIX_FMT_RGBA);
+        expect(frame.pts).to.equal(42);
+    });
+
+    it('reuses the context for the same conversion', () => {
+        let scaler = new SwsContext();
+        let src = createTestFrame();
+
+        scaler.scale(src, { pixelFormat: AVPixelFormat.AV_PIX_FMT_RGBA });
+        scaler.scale(src, { pixelFormat: AVPixelFormat.AV_PIX_FMT_RGBA });
+        expect(scaler.contextsCreated).to.equal(1);
+        expect(scaler.cachedContexts).to.equal(1);
+
+        scaler.scale(src, { pixelFormat: AVPixelFormat.AV_PIX_FMT_GRAY8 });
+        expect(scaler.contextsCreated).to.equal(2);
+    });
+
+    it('converts into a given frame', () => {
+        let scaler = new SwsContext();
+        let dst = new AVFrame();
+        dst.format = AVPixelFormat.AV_PIX_FMT_RGB24;
+
+        expect(scaler.scale(createTestFrame(), dst)).to.equal(dst);
+        expect(dst.width).to.equal(64);
+        expect(dst.height).to.equal(48);
+    });
+
+    it('converts on a worker thread', async () => {
+        let scaler = new SwsContext();
+        let frame = await scaler.scaleAsync(createTestFrame(), { width: 128, height: 96 });
+
+        expect(frame.width).to.equal(128);
+        expect(frame.format).to.equal(AVPixelFormat.AV_PIX_FMT_YUV420P);
+    });
+
+    it('refuses to dispose of frames while a scale is pending', async () => {
+        let scaler = new SwsContext();
+        let src = createTestFrame();
+        let scaled = scaler.scaleAsync(src, { width: 128, height: 96 });
+
+        expect(() => src.dispose()).to.throw();
+        await scaled;
+        src.dispose();
+    });
+
+    it('throws when given a disposed frame', () => {
+        let scaler = new SwsContext();
+        let disposed = createTestFrame();
+        disposed.dispose();
+
+        expect(() => scaler.scale(disposed, { pixelFormat: AVPixelFormat.AV_PIX_FMT_RGBA })).to.throw(/disposed/);
+        expect(() => scaler.scale(createTestFrame(), disposed)).to.throw(/disposed/);
+    });
+});
@@ -0,0 +1,80 @@
+import { AVFrame, AVPixelFormat } from "../avutil";
+import { AVCodecContextPoolCounters } from "../avcodec";
+
+export const SWS_FAST_BILINEAR     = 1;
+export const SWS_BILINEAR          = 2;
+export const SWS_BICUBIC           = 4;
+export const SWS_X                 = 8;
+export const SWS_POINT             = 0x10;
+export const SWS_AREA              = 0x20;
+export const SWS_BICUBLIN          = 0x40;
+export const SWS_GAUSS             = 0x80;
+export const SWS_SINC              = 0x100;
+export const SWS_LANCZOS           = 0x200;
+export const SWS_SPLINE            = 0x400;
+
+export const SWS_FULL_CHR_H_INT    = 0x2000;
+export const SWS_FULL_CHR_H_INP    = 0x4000;
+export const SWS_ACCURATE_RND      = 0x40000;
+export const SWS_BITEXACT          = 0x80000;
+export const SWS_ERROR_DIFFUSION   = 0x800000;
+
+/**
+ * Describes a frame for SwsContext#scale() to take from its pool. Omitted fields are taken from the
+ * source frame.
+ */
+export interface SwsOutputFormat {
+    width?: number;
+    height?: number;
+    pixelFormat?: AVPixelFormat;
+}
+
+/**
+ * Converts and scales video frames with libswscale. The underlying libswscale contexts are set up once
+ * per distinct conversion (source and destination size and format, flags) and kept for reuse.
+ */
+export declare class SwsContext {
+    constructor(properties?: Partial<SwsContext>);
+
+    /**
+     * Scaler algorithm and options (SWS_*). Defaults to SWS_BICUBIC.
+     */
+    flags: number;
+
+    /**
+     * Number of threads a conversion is sliced across. 0 (the default) uses one thread per core for
+     * frames of 4K and above, and a single thread otherwise.
+     */
+    threads: number;
+
+    /**
+     * Number of idle libswscale contexts kept for reuse
+     */
+    readonly cachedContexts: number;
+
+    /**
+     * Number of libswscale contexts set up so far. Stays put while the same conversions repeat.
+     */
+    readonly contextsCreated: number;
+
+    /**
+     * How well the output frames are being reused. Frames from scale() return to the pool once they are 
+     * garbage collected or disposed.
+     */
+    readonly poolStats: AVCodecContextPoolCounters;
+
+    configure(properties: Partial<SwsContext>): void;
+
+    /**
+     * Convert the source frame into the given frame (width, height and format left unset are taken
+     * from the source), or into a frame from the pool described by the given format. The timestamps 
+     * and other properties of the source are copied. Returns the destination frame.
+     */
+    scale(src: AVFrame, dst: AVFrame | SwsOutputFormat): AVFrame;
+
+    /**
+     * Like scale(), but on a worker thread. The frames must not be used until the promise settles, and
+     * cannot be disposed of meanwhile.
+     */
+    scaleAsync(src: AVFrame, dst: AVFrame | SwsOutputFormat): Promise<AVFrame>;
+}